@@ -12,6 +12,8 @@
 #include "rtbkit/openrtb/openrtb.h"
 #include "soa/service/logs.h"
 #include "jml/arch/info.h"
+#include <google/protobuf/arena.h>
+#include <boost/thread/tss.hpp>
 
 using namespace Datacratic;
 using namespace RTBKIT;
@@ -48,6 +50,53 @@ namespace JamLoop {
             return str_size_tail_rec(str, 0);
         }
 
+        /* Builds the BrightRoll messages of an auction on the arena of the
+           calling thread, which is reset when the scope ends. The first
+           block of the arena is kept across resets so that, once a thread
+           is warmed up, decoding a request or encoding a response doesn't
+           allocate for the messages themselves.
+        */
+        class ArenaScope {
+        public:
+            ArenaScope() : arena(threadArena()) { }
+            ~ArenaScope() { arena.Reset(); }
+
+            template<typename Message>
+            Message& create() {
+                return *google::protobuf::Arena::CreateMessage<Message>(&arena);
+            }
+
+        private:
+            static constexpr size_t InitialBlockSize = 64 * 1024;
+
+            struct ThreadArena {
+                ThreadArena()
+                    : block(new char[InitialBlockSize])
+                    , arena(options(block.get()))
+                { }
+
+                static google::protobuf::ArenaOptions options(char* block) {
+                    google::protobuf::ArenaOptions result;
+                    result.initial_block = block;
+                    result.initial_block_size = InitialBlockSize;
+                    return result;
+                }
+
+                std::unique_ptr<char[]> block;
+                google::protobuf::Arena arena;
+            };
+
+            static google::protobuf::Arena& threadArena() {
+                static boost::thread_specific_ptr<ThreadArena> current;
+                if (!current.get()) {
+                    current.reset(new ThreadArena());
+                }
+                return current->arena;
+            }
+
+            google::protobuf::Arena& arena;
+        };
+
     }
 
     namespace BrightRoll {
@@ -353,7 +402,7 @@ namespace JamLoop {
         }
 
         OpenRTB::Content *
-        toContent(const BidRequest::Content& content) {
+        toContent(BidRequest::Content& content) {
             auto result = make_unique<OpenRTB::Content>();
 
             result->id = Id(content.id());
@@ -393,7 +442,7 @@ namespace JamLoop {
             }
 
             if (content.has_language()) {
-                result->language = content.language();
+                result->language = std::move(*content.mutable_language());
             }
 
             return result.release();
@@ -419,7 +468,7 @@ namespace JamLoop {
 
         /* Parse common fields between site and app */
         template<typename Result, typename Obj>
-        void parseCommon(const Obj &obj, Result* result) {
+        void parseCommon(Obj &obj, Result* result) {
             for (int i = 0; i < obj.cat_size(); ++i) {
                 result->cat.push_back(toContentCategory(obj.cat(i)));
             }
@@ -447,7 +496,7 @@ namespace JamLoop {
                 result->domain = Datacratic::UnicodeString(obj.domain());
             }
             if (obj.has_content()) {
-                result->content.reset(toContent(obj.content()));
+                result->content.reset(toContent(*obj.mutable_content()));
             }
             if (obj.has_publisher()) {
                 result->publisher.reset(toPublisher(obj.publisher()));
@@ -456,13 +505,13 @@ namespace JamLoop {
 
 
         OpenRTB::App *
-        toApp(const BidRequest::App& app) {
+        toApp(BidRequest::App& app) {
             auto result = make_unique<OpenRTB::App>();
             result->id = Id(app.id());
             parseCommon(app, result.get());
 
             if (app.has_ver()) {
-                result->ver = app.ver();
+                result->ver = std::move(*app.mutable_ver());
             }
             if (app.has_bundle()) {
                 result->bundle = Datacratic::UnicodeString(app.bundle());
@@ -478,7 +527,7 @@ namespace JamLoop {
         }
 
         OpenRTB::Site *
-        toSite(const BidRequest::Site& site) {
+        toSite(BidRequest::Site& site) {
             auto result = make_unique<OpenRTB::Site>();
             result->id = Id(site.id());
             parseCommon(site, result.get());
@@ -498,7 +547,7 @@ namespace JamLoop {
         }
 
         OpenRTB::Geo *
-        toGeo(const BidRequest::Geo& geo) {
+        toGeo(BidRequest::Geo& geo) {
             auto result = make_unique<OpenRTB::Geo>();
 
             if (geo.has_lat()) {
@@ -508,16 +557,16 @@ namespace JamLoop {
                 result->lon = geo.lon();
             }
             if (geo.has_country()) {
-                result->country = geo.country();
+                result->country = std::move(*geo.mutable_country());
             }
             if (geo.has_region()) {
-                result->region = geo.region();
+                result->region = std::move(*geo.mutable_region());
             }
             if (geo.has_regionfips104()) {
-                result->regionfips104 = geo.regionfips104();
+                result->regionfips104 = std::move(*geo.mutable_regionfips104());
             }
             if (geo.has_metro()) {
-                result->metro = geo.metro();
+                result->metro = std::move(*geo.mutable_metro());
             }
             if (geo.has_city()) {
                 result->city = Datacratic::UnicodeString(geo.city());
@@ -537,14 +586,14 @@ namespace JamLoop {
         }
 
         OpenRTB::Device *
-        toDevice(const BidRequest::Device& device) {
+        toDevice(BidRequest::Device& device) {
             auto result = make_unique<OpenRTB::Device>();
 
             if (device.has_dnt()) {
                 result->dnt = toBool(device.dnt());
             }
             if (device.has_ip()) {
-                result->ip = device.ip();
+                result->ip = std::move(*device.mutable_ip());
             }
             if (device.has_carrier()) {
                 result->carrier = device.carrier();
@@ -576,22 +625,22 @@ namespace JamLoop {
                     = openrtb_cast<OpenRTB::DeviceType>(device.devicetype());
             }
             if (device.has_geo()) {
-                result->geo.reset(toGeo(device.geo()));
+                result->geo.reset(toGeo(*device.mutable_geo()));
             }
             if (device.has_ipv6()) {
-                result->ipv6 = device.ipv6();
+                result->ipv6 = std::move(*device.mutable_ipv6());
             }
             if (device.has_didsha1()) {
-                result->didsha1 = device.didsha1();
+                result->didsha1 = std::move(*device.mutable_didsha1());
             }
             if (device.has_didmd5()) {
-                result->didmd5 = device.didmd5();
+                result->didmd5 = std::move(*device.mutable_didmd5());
             }
             if (device.has_dpidsha1()) {
-                result->dpidsha1 = device.dpidsha1();
+                result->dpidsha1 = std::move(*device.mutable_dpidsha1());
             }
             if (device.has_dpidmd5()) {
-                result->dpidmd5 = device.dpidmd5();
+                result->dpidmd5 = std::move(*device.mutable_dpidmd5());
             }
 
             return result.release();
@@ -599,7 +648,7 @@ namespace JamLoop {
         }
 
         OpenRTB::User *
-        toUser(const BidRequest::User& user) {
+        toUser(BidRequest::User& user) {
             auto result = make_unique<OpenRTB::User>();
 
             result->id = Datacratic::Id(user.id());
@@ -616,10 +665,10 @@ namespace JamLoop {
                 }
             }
             if (user.has_gender()) {
-                result->gender = user.gender();
+                result->gender = std::move(*user.mutable_gender());
             }
             if (user.has_geo()) {
-                result->geo.reset(toGeo(user.geo()));
+                result->geo.reset(toGeo(*user.mutable_geo()));
             }
 
             return result.release();
@@ -735,7 +784,7 @@ namespace JamLoop {
                 std::vector<std::string> wseat;
                 wseat.reserve(request.wseat_size());
                 for (int i = 0; i < request.wseat_size(); ++i) {
-                    wseat.push_back(request.wseat(i));
+                    wseat.push_back(std::move(*request.mutable_wseat(i)));
                 }
                 result->segments.addStrings("openrtb-wseat", std::move(wseat));
             }
@@ -749,9 +798,9 @@ namespace JamLoop {
                 std::vector<std::string> badv;
                 badv.reserve(request.badv_size());
                 for (int i = 0; i < request.badv_size(); ++i) {
-                    auto val = request.badv(i);
-                    badv.push_back(val);
+                    auto& val = *request.mutable_badv(i);
                     result->badv.push_back(Datacratic::UnicodeString(val));
+                    badv.push_back(std::move(val));
                 }
                 result->restrictions.addStrings("badv", badv);
             }
@@ -760,7 +809,7 @@ namespace JamLoop {
             result->imp.push_back(toAdSpot(request.imp()));
 
             if (request.has_site()) {
-                result->site.reset(toSite(request.site()));
+                result->site.reset(toSite(*request.mutable_site()));
 
                 if (!result->site->page.empty()) {
                     result->url = result->site->page;
@@ -775,7 +824,7 @@ namespace JamLoop {
                 }
             }
             if (request.has_app()) {
-                result->app.reset(toApp(request.app()));
+                result->app.reset(toApp(*request.mutable_app()));
 
                 if (!result->app->bundle.empty()) {
                     result->url = Url(result->app->bundle);
@@ -790,7 +839,7 @@ namespace JamLoop {
                 }
             }
             if (request.has_device()) {
-                result->device.reset(toDevice(request.device()));
+                result->device.reset(toDevice(*request.mutable_device()));
                 auto device = result->device;
 
                 result->language = device->language;
@@ -817,7 +866,7 @@ namespace JamLoop {
                 }
             }
             if (request.has_user()) {
-                result->user.reset(toUser(request.user()));
+                result->user.reset(toUser(*request.mutable_user()));
 
                 if (result->user->tz.val != -1) {
                     result->location.timezoneOffsetMinutes = result->user->tz.val;
@@ -1138,7 +1187,8 @@ namespace JamLoop {
             return nullptr;
         }  
 
-        BrightRoll::BidRequest request;
+        ArenaScope arena;
+        auto& request = arena.create<BrightRoll::BidRequest>();
         if (!request.ParseFromString(payload)) {
             handler.sendErrorResponse("Error parsing BidRequest");
             return nullptr;
@@ -1173,7 +1223,8 @@ namespace JamLoop {
             return getErrorResponse(connection, current->error + ": " + current->details);
         }
 
-        BrightRoll::BidResponse response;
+        ArenaScope arena;
+        auto& response = arena.create<BrightRoll::BidResponse>();
         response.set_id(auction.id.toString());
         // BrightRoll only supports USD -- return a value of "USD".
         response.set_cur("USD");
@@ -1189,10 +1240,9 @@ namespace JamLoop {
             return HttpResponse(204, "none", "");
         }
 
-        std::string payload;
-        response.SerializeToString(&payload);
-
-        return HttpResponse(200, "application/octet-stream", payload);
+        HttpResponse result(200, "application/octet-stream", std::string());
+        response.SerializeToString(&result.body);
+        return result;
     }
 
     void
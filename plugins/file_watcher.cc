@@ -106,7 +106,7 @@ namespace Utils {
     WatchFor
     FileWatcher::toWatchFor(uint32_t mask) const
     {
-        WatchFor result;
+        WatchFor result { };
 
         static constexpr int flags[][2] = {
             #define FLAG(from, to) { to, static_cast<int>(WatchFor::from) },
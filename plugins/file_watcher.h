@@ -6,6 +6,8 @@
    underneath
 */
 
+#pragma once
+
 #include <sys/inotify.h>
 #include <type_traits>
 #include "soa/service/async_event_source.h"
@@ -43,6 +43,8 @@ ForensiqAugmentor::ForensiqAugmentor(
 void
 ForensiqAugmentor::init(int nthreads, const std::string& apiKey)
 {
+    setRequestFields({
+            BRF_EXCHANGE, BRF_USER_AGENT, BRF_DEVICE, BRF_APP, BRF_SITE, BRF_USER });
     AsyncAugmentor::init(nthreads);
 
     agentConfig = std::make_shared<AgentConfigurationListener>(getZmqContext());
@@ -75,8 +77,8 @@ ForensiqAugmentor::onRequest(
         }
     };
 
-    auto br = request.bidRequest;
-    std::string seller = br->exchange;
+    const auto& br = request.view;
+    std::string seller = br.exchange();
 
     auto addPublisher = [&](const Optional<OpenRTB::Publisher>& publisher) {
         if (publisher) {
@@ -88,32 +90,36 @@ ForensiqAugmentor::onRequest(
 
     };
 
-    if (br->device) {
-        auto ip = br->device->ip;
+    auto device = br.device();
+    if (device) {
+        auto ip = device->ip;
         if (!ip.empty())
             queryParams.push_back(std::make_pair("ip", ip));
-        addGeo(br->device->geo);
+        addGeo(device->geo);
     }
-    if (br->app) {
-        auto bundle = br->app->bundle;
+    auto app = br.app();
+    if (app) {
+        auto bundle = app->bundle;
         if (!bundle.empty())
             queryParams.push_back(std::make_pair("aid", bundle.rawString()));
-        addPublisher(br->app->publisher);
+        addPublisher(app->publisher);
     }
-    if (br->site) {
-        auto page = br->site->page;
+    auto site = br.site();
+    if (site) {
+        auto page = site->page;
         if (!page.empty())
             queryParams.push_back(std::make_pair("url", urlencode(page.toString())));
-        addPublisher(br->site->publisher);
+        addPublisher(site->publisher);
     }
-    if (br->user) {
-        auto uid = br->user->id;
+    auto user = br.user();
+    if (user) {
+        auto uid = user->id;
         if (uid)
             queryParams.push_back(std::make_pair("id", uid.toString()));
-        addGeo(br->user->geo);
+        addGeo(user->geo);
     }
 
-    auto ua = br->userAgent;
+    auto ua = br.userAgent();
     if (!ua.empty())
         queryParams.push_back(std::make_pair("ua", urlencode(ua.rawString())));
 
@@ -248,3 +254,21 @@ ForensiqAugmentor::handleHttpResponse(
 }
 
 } // namespace JamLoop
+
+namespace {
+
+struct Init {
+    Init() {
+        PluginInterface<HostedAugmentor>::registerPlugin("forensiq",
+                [](std::string serviceName,
+                   std::shared_ptr<ServiceProxies> proxies,
+                   const Json::Value& config) {
+                auto augmentor = new JamLoop::ForensiqAugmentor(
+                        std::move(proxies), std::move(serviceName));
+                augmentor->init(1, config["apiKey"].asString());
+                return augmentor;
+        });
+    }
+} init;
+
+}
@@ -6,9 +6,20 @@
 */
 
 #include "geo_pipeline.h"
+#include "file_watcher.h"
 #include "jml/utils/filter_streams.h"
 #include "soa/utils/scope.h"
 
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace Datacratic;
 using namespace RTBKIT;
 
@@ -140,33 +151,360 @@ std::vector<std::string> split(const std::string& str, char c) {
     return res;
 }
 
-GeoDatabase::Entry
-GeoDatabase::Entry::fromIp(InAddr ip) {
-    Entry e;
-    e.u.ip = ip;
-    return e;
+namespace {
+
+/* Branch-free binary searches: the loop only has a conditional move, so the
+   cost doesn't depend on how well the branch predictor guesses the way
+   through a 3M entries array.
+*/
+
+// Index of the first element that is >= value
+template<typename T>
+size_t lowerBound(const T* data, size_t size, T value) {
+    if (size == 0) return 0;
+
+    const T* base = data;
+    while (size > 1) {
+        size_t half = size / 2;
+        base = (base[half] < value) ? base + half : base;
+        size -= half;
+    }
+
+    return (base - data) + (*base < value);
+}
+
+// Index of the first element that is > value
+template<typename T>
+size_t upperBound(const T* data, size_t size, T value) {
+    if (size == 0) return 0;
+
+    const T* base = data;
+    while (size > 1) {
+        size_t half = size / 2;
+        base = (base[half] <= value) ? base + half : base;
+        size -= half;
+    }
+
+    return (base - data) + (*base <= value);
+}
+
+size_t align(size_t offset) {
+    return (offset + 7) & ~size_t(7);
 }
 
-GeoDatabase::Entry
-GeoDatabase::Entry::fromGeo(double latitude, double longitude) {
-    Entry e;
-    e.u.latitude = latitude;
-    e.u.longitude = longitude;
-    return e;
+/* Identifies the version of a csv file that a snapshot was built from.
+   Tools like rsync -t or tar keep the mtime of the files they replace, so
+   the size is checked as well and the mtime has to match exactly. */
+struct FileStamp {
+    int64_t size;
+    int64_t mtimeNs;
+
+    bool missing() const { return size == -1; }
+
+    bool operator==(const FileStamp& other) const {
+        return size == other.size && mtimeNs == other.mtimeNs;
+    }
+};
+
+FileStamp stampOf(const std::string& file) {
+    struct stat st;
+    if (::stat(file.c_str(), &st) == -1) return FileStamp { -1, -1 };
+    return FileStamp {
+        int64_t(st.st_size),
+        int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec
+    };
 }
 
-InAddr
-GeoDatabase::Entry::ip() const {
-    return u.ip;
+std::string directoryOf(const std::string& file) {
+    auto slash = file.rfind('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return file.substr(0, slash);
 }
 
-std::pair<double, double>
-GeoDatabase::Entry::geo() const {
-    return std::make_pair(u.latitude, u.longitude);
+std::string baseNameOf(const std::string& file) {
+    auto slash = file.rfind('/');
+    if (slash == std::string::npos) return file;
+    return file.substr(slash + 1);
 }
 
+} // file scope
+
+struct GeoDatabase::Header {
+    static constexpr uint64_t Magic = 0x324f45474c4d414aULL; // JAMLGEO2
+
+    uint64_t magic;
+    double precision;
+
+    // The csv files that the database was built from
+    FileStamp ipFile;
+    FileStamp locationFile;
+
+    uint64_t ranges;
+    uint64_t locations;
+    uint64_t points;
+    uint64_t stringsSize;
+
+    size_t firstOffset() const { return align(sizeof(Header)); }
+    size_t lastOffset() const { return align(firstOffset() + ranges * sizeof(InAddr)); }
+    size_t rangeLocationOffset() const { return align(lastOffset() + ranges * sizeof(InAddr)); }
+    size_t locationsOffset() const { return align(rangeLocationOffset() + ranges * sizeof(uint32_t)); }
+    size_t cellHashOffset() const { return align(locationsOffset() + locations * sizeof(Location)); }
+    size_t pointsOffset() const { return align(cellHashOffset() + points * sizeof(uint64_t)); }
+    size_t stringsOffset() const { return align(pointsOffset() + points * sizeof(Point)); }
+    size_t size() const { return stringsOffset() + stringsSize; }
+};
+
+
+/******************************************************************************/
+/* GEO DATABASE DATA                                                          */
+/******************************************************************************/
+
+struct GeoDatabase::Data {
+    // Takes ownership of a database image built in memory
+    explicit Data(std::vector<char> image)
+        : buffer(std::move(image))
+        , mapping(nullptr)
+        , mappingSize(0)
+    {
+        attach(buffer.data(), buffer.size());
+    }
+
+    // Maps a snapshot file
+    explicit Data(const std::string& snapshotFile)
+        : mapping(nullptr)
+        , mappingSize(0)
+    {
+        int fd = ::open(snapshotFile.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw ML::Exception(errno, "open('" + snapshotFile + "')");
+
+        Scope_Exit(::close(fd));
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1)
+            throw ML::Exception(errno, "fstat('" + snapshotFile + "')");
+
+        mappingSize = st.st_size;
+        if (mappingSize < sizeof(Header))
+            throw ML::Exception("Geo snapshot '%s' is truncated", snapshotFile.c_str());
+
+        void* addr = ::mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (addr == MAP_FAILED)
+            throw ML::Exception(errno, "mmap('" + snapshotFile + "')");
+
+        mapping = addr;
+
+        try {
+            attach(static_cast<const char *>(mapping), mappingSize);
+        } catch (...) {
+            ::munmap(mapping, mappingSize);
+            throw;
+        }
+    }
+
+    ~Data() {
+        if (mapping) ::munmap(mapping, mappingSize);
+    }
+
+    Data(const Data&) = delete;
+    Data& operator=(const Data&) = delete;
+
+    const char* image() const { return reinterpret_cast<const char *>(header); }
+
+    const char* string(uint32_t offset) const {
+        return strings + offset;
+    }
+
+    Result toResult(uint32_t locationIndex) const {
+        const auto& location = locations[locationIndex];
+        return Result {
+            string(location.metroCode), string(location.zipCode),
+            string(location.countryCode), string(location.region)
+        };
+    }
+
+    const Header* header;
+    const InAddr* first;
+    const InAddr* last;
+    const uint32_t* rangeLocation;
+    const Location* locations;
+    const uint64_t* cellHash;
+    const Point* points;
+    const char* strings;
+
+    Precision precision;
+
+private:
+    std::vector<char> buffer;
+    void* mapping;
+    size_t mappingSize;
+
+    void attach(const char* image, size_t size) {
+        header = reinterpret_cast<const Header *>(image);
+        if (header->magic != Header::Magic)
+            throw ML::Exception("Invalid geo database image");
+        if (header->size() != size)
+            throw ML::Exception("Geo database image has %lu bytes, expected %lu",
+                                size, header->size());
+
+        first = reinterpret_cast<const InAddr *>(image + header->firstOffset());
+        last = reinterpret_cast<const InAddr *>(image + header->lastOffset());
+        rangeLocation = reinterpret_cast<const uint32_t *>(image + header->rangeLocationOffset());
+        locations = reinterpret_cast<const Location *>(image + header->locationsOffset());
+        cellHash = reinterpret_cast<const uint64_t *>(image + header->cellHashOffset());
+        points = reinterpret_cast<const Point *>(image + header->pointsOffset());
+        strings = image + header->stringsOffset();
+
+        precision = Precision(header->precision);
+    }
+};
+
+
+/******************************************************************************/
+/* GEO DATABASE BUILDER                                                       */
+/******************************************************************************/
+
+struct GeoDatabase::Builder {
+    Builder() {
+        // Offset 0 is the empty string
+        strings.push_back('\0');
+        stringIndex[""] = 0;
+    }
+
+    uint32_t addLocation(
+            const std::string& metroCode, const std::string& zipCode,
+            const std::string& countryCode, const std::string& region) {
+        Location location {
+            intern(metroCode), intern(zipCode), intern(countryCode), intern(region)
+        };
+
+        auto key = std::make_tuple(
+                location.metroCode, location.zipCode, location.countryCode, location.region);
+        auto it = locationIndex.find(key);
+        if (it != locationIndex.end()) return it->second;
+
+        uint32_t index = locations.size();
+        locations.push_back(location);
+        locationIndex.insert(std::make_pair(key, index));
+        return index;
+    }
+
+    void addRange(InAddr first, InAddr last, uint32_t location) {
+        ranges.push_back(Range { first, last, location });
+    }
+
+    void addPoint(uint64_t hash, double latitude, double longitude, uint32_t location) {
+        points.push_back(PointEntry {
+            hash, Point { float(latitude), float(longitude), location }, uint32_t(points.size())
+        });
+    }
+
+    std::vector<char> image(
+            Precision precision, FileStamp ipFile, FileStamp locationFile) {
+        std::sort(ranges.begin(), ranges.end(), [](const Range& lhs, const Range& rhs) {
+            return lhs.first < rhs.first;
+        });
+
+        /* Every ip block of a location adds the same point over and over.
+           Only the first one of each could ever be returned by a lookup, so
+           we keep that one and the order in which they were added. */
+        auto key = [](const PointEntry& entry) {
+            return std::make_tuple(
+                    entry.hash, entry.point.latitude, entry.point.longitude, entry.point.location);
+        };
+
+        std::sort(points.begin(), points.end(), [&](const PointEntry& lhs, const PointEntry& rhs) {
+            return std::make_tuple(key(lhs), lhs.order) < std::make_tuple(key(rhs), rhs.order);
+        });
+        points.erase(std::unique(points.begin(), points.end(),
+                    [&](const PointEntry& lhs, const PointEntry& rhs) {
+                        return key(lhs) == key(rhs);
+                    }), points.end());
+        std::sort(points.begin(), points.end(), [](const PointEntry& lhs, const PointEntry& rhs) {
+            return std::tie(lhs.hash, lhs.order) < std::tie(rhs.hash, rhs.order);
+        });
+
+        Header header;
+        header.magic = Header::Magic;
+        header.precision = precision.value();
+        header.ipFile = ipFile;
+        header.locationFile = locationFile;
+        header.ranges = ranges.size();
+        header.locations = locations.size();
+        header.points = points.size();
+        header.stringsSize = strings.size();
+
+        std::vector<char> result(header.size(), 0);
+        char* image = result.data();
+
+        std::memcpy(image, &header, sizeof(header));
+
+        auto first = reinterpret_cast<InAddr *>(image + header.firstOffset());
+        auto last = reinterpret_cast<InAddr *>(image + header.lastOffset());
+        auto rangeLocation = reinterpret_cast<uint32_t *>(image + header.rangeLocationOffset());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            first[i] = ranges[i].first;
+            last[i] = ranges[i].last;
+            rangeLocation[i] = ranges[i].location;
+        }
+
+        std::copy(locations.begin(), locations.end(),
+                  reinterpret_cast<Location *>(image + header.locationsOffset()));
+
+        auto cellHash = reinterpret_cast<uint64_t *>(image + header.cellHashOffset());
+        auto cellPoints = reinterpret_cast<Point *>(image + header.pointsOffset());
+        for (size_t i = 0; i < points.size(); ++i) {
+            cellHash[i] = points[i].hash;
+            cellPoints[i] = points[i].point;
+        }
+
+        std::copy(strings.begin(), strings.end(), image + header.stringsOffset());
+
+        return result;
+    }
+
+private:
+    struct Range {
+        InAddr first;
+        InAddr last;
+        uint32_t location;
+    };
+
+    struct PointEntry {
+        uint64_t hash;
+        Point point;
+        uint32_t order;
+    };
+
+    std::vector<Range> ranges;
+    std::vector<PointEntry> points;
+
+    std::vector<Location> locations;
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, uint32_t> locationIndex;
+
+    std::vector<char> strings;
+    std::unordered_map<std::string, uint32_t> stringIndex;
+
+    uint32_t intern(const std::string& str) {
+        auto it = stringIndex.find(str);
+        if (it != stringIndex.end()) return it->second;
+
+        uint32_t offset = strings.size();
+        strings.insert(strings.end(), str.begin(), str.end());
+        strings.push_back('\0');
+        stringIndex.insert(std::make_pair(str, offset));
+        return offset;
+    }
+};
+
+
+/******************************************************************************/
+/* GEO DATABASE                                                               */
+/******************************************************************************/
+
 bool
-GeoDatabase::Entry::isLocated(double latitude, double longitude) const {
+GeoDatabase::Point::isLocated(double latitude, double longitude) const {
     // @Note Might need to tweak it a little bit or even put it configurable
     static constexpr double Epsilon = 1e-2;
 
@@ -174,12 +512,7 @@ GeoDatabase::Entry::isLocated(double latitude, double longitude) const {
         return std::fabs(lhs - rhs) < Epsilon;
     };
 
-    return almostEquals(latitude, u.latitude) && almostEquals(longitude, u.longitude);
-}
-
-GeoDatabase::Result
-GeoDatabase::Entry::toResult() const {
-    return Result { metroCode, zipCode, countryCode, region };
+    return almostEquals(latitude, this->latitude) && almostEquals(longitude, this->longitude);
 }
 
 GeoDatabase::GeoDatabase(
@@ -191,8 +524,11 @@ GeoDatabase::GeoDatabase(
 }
 
 GeoDatabase::~GeoDatabase() {
-    auto *d = dataGuard.load(std::memory_order_acquire);
-    if (d) delete d;
+    if (watchLoop) watchLoop->shutdown();
+
+    auto *d = dataGuard.exchange(nullptr, std::memory_order_acq_rel);
+    if (d) gc.defer([=] { delete d; });
+    gc.deferBarrier();
 }
 
 uint64_t
@@ -200,19 +536,6 @@ GeoDatabase::makeGeoHash(double latitude, double longitude, Precision precision)
     return precision.scale<uint64_t>(latitude) << 32 | precision.scale<uint32_t>(longitude);
 }
 
-uint64_t
-GeoDatabase::makeGeoHash(const GeoDatabase::Entry& entry, Precision precision) {
-    /* Structured binding soon ?
-     * auto {latitude, longitude} = entry.geo();
-     */
-
-    double latitude;
-    double longitude;
-
-    std::tie(latitude, longitude) = entry.geo();
-    return makeGeoHash(latitude, longitude, precision);
-}
-
 uint64_t
 GeoDatabase::makeGeoHash(const GeoDatabase::Context& context, Precision precision) {
     ExcAssert(context.hasValidGeo());
@@ -220,11 +543,15 @@ GeoDatabase::makeGeoHash(const GeoDatabase::Context& context, Precision precisio
     return makeGeoHash(context.latitude, context.longitude, precision);
 }
 
-void
-GeoDatabase::load(
+GeoDatabase::Data*
+GeoDatabase::parse(
         const std::string& ipFile, const std::string& locationFile,
         Precision precision)
 {
+    // Taken before reading so that a file replaced meanwhile is reparsed
+    auto ipStamp = stampOf(ipFile);
+    auto locationStamp = stampOf(locationFile);
+
     ML::filter_istream ipFs(ipFile);
     if (!ipFs)
         throw ML::Exception("Could not open IP file '%s'", ipFile.c_str());
@@ -255,7 +582,7 @@ GeoDatabase::load(
         std::string subDivision1Name;
     };
 
-    Data* d = new Data();
+    Builder builder;
 
     std::unordered_map<uint32_t, LocationEntry> locationIndex;
     while (std::getline(locationFs, line)) {
@@ -296,13 +623,17 @@ GeoDatabase::load(
         auto longitude = fields.at(8);
 
         std::string ip;
+        int bits = 32;
         auto cidrPos = subnet.find('/');
         if (cidrPos == std::string::npos) ip = std::move(subnet);
-        else ip = subnet.substr(0, cidrPos);
+        else {
+            ip = subnet.substr(0, cidrPos);
+            bits = std::stoi(subnet.substr(cidrPos + 1));
+        }
 
         InAddr addr;
         auto ok = toAddr(ip.c_str(), &addr);
-        if (!ok)
+        if (!ok || bits <= 0 || bits > 32)
             throw ML::Exception("Encountered invalid IP '%s', line '%lu'", ip.c_str(), count);
 
         auto geoNameId = std::stoi(geoName);
@@ -314,34 +645,98 @@ GeoDatabase::load(
 
         const auto& locationEntry = locationIt->second;
 
-        auto ipEntry = Entry::fromIp(addr);
-        ipEntry.metroCode = locationEntry.metroCode;
-        ipEntry.zipCode = postalCode;
-        ipEntry.countryCode = locationEntry.countryCode;
-        ipEntry.region = locationEntry.region;
-        d->subnets.push_back(ipEntry);
+        auto location = builder.addLocation(
+                locationEntry.metroCode, postalCode,
+                locationEntry.countryCode, locationEntry.region);
+
+        Subnet block(addr, bits);
+        builder.addRange(block.host(), block.host() | ~(uint32_t(-1) << (32 - bits)), location);
+
+        auto lat = std::stod(latitude);
+        auto lon = std::stod(longitude);
+        builder.addPoint(makeGeoHash(lat, lon, precision), lat, lon, location);
+    }
+
+    std::cout << "Parsed " << count << " lines, skipped " << skipped << " (" << ((skipped * 100) / count) << "%)" << std::endl;
+
+    return new Data(builder.image(precision, ipStamp, locationStamp));
+}
+
+void
+GeoDatabase::load(
+        const std::string& ipFile, const std::string& locationFile,
+        Precision precision, const std::string& snapshotFile)
+{
+    std::unique_ptr<Data> d;
+
+    if (!snapshotFile.empty()) {
+        auto ipStamp = stampOf(ipFile);
+        auto locationStamp = stampOf(locationFile);
 
-        auto geoEntry = Entry::fromGeo(std::stod(latitude), std::stod(longitude));
-        geoEntry.metroCode = locationEntry.metroCode;
-        geoEntry.zipCode = postalCode;
-        geoEntry.countryCode = locationEntry.countryCode;
-        geoEntry.region = locationEntry.region;
+        // A missing csv file doesn't make the snapshot stale
+        auto matches = [](const FileStamp& current, const FileStamp& built) {
+            return current.missing() || current == built;
+        };
 
-        auto geoHash = makeGeoHash(geoEntry, precision);
-        auto& geoEntries = d->geoloc[geoHash];
-        geoEntries.push_back(geoEntry);
+        if (!stampOf(snapshotFile).missing()) {
+            try {
+                d.reset(new Data(snapshotFile));
+                if (d->precision.value() != precision.value()
+                    || !matches(ipStamp, d->header->ipFile)
+                    || !matches(locationStamp, d->header->locationFile))
+                    d.reset();
+            } catch (const std::exception& exc) {
+                std::cerr << "Ignoring geo snapshot '" << snapshotFile << "': "
+                          << exc.what() << std::endl;
+                d.reset();
+            }
+        }
 
+        if (d)
+            events->recordHit("load.snapshot");
     }
 
-    std::sort(std::begin(d->subnets), std::end(d->subnets), [](const Entry& lhs, const Entry& rhs) {
-        return lhs.ip() < rhs.ip();
-    });
+    if (!d) {
+        d.reset(parse(ipFile, locationFile, precision));
+        events->recordHit("load.csv");
 
-    d->precision = precision;
+        if (!snapshotFile.empty())
+            writeSnapshot(*d, snapshotFile);
+    }
 
-    dataGuard.store(d, std::memory_order_release);
+    replaceData(d.release());
+}
 
-    std::cout << "Parsed " << count << " lines, skipped " << skipped << " (" << ((skipped * 100) / count) << "%)" << std::endl;
+void
+GeoDatabase::writeSnapshot(const Data& data, const std::string& snapshotFile) {
+    /* Written aside then renamed so that a reader never maps half of it.
+       Loads can run concurrently, so each one writes its own file. */
+    auto tmpFile = snapshotFile + ".tmp." + std::to_string(::getpid())
+                 + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    try {
+        {
+            std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+            out.write(data.image(), data.header->size());
+            if (!out)
+                throw ML::Exception("Could not write geo snapshot '%s'", tmpFile.c_str());
+        }
+        if (::rename(tmpFile.c_str(), snapshotFile.c_str()) == -1)
+            throw ML::Exception(errno, "rename('" + tmpFile + "')");
+    } catch (const std::exception& exc) {
+        // The database is still good, it will just be parsed again next time
+        std::cerr << "Could not write the geo snapshot: " << exc.what() << std::endl;
+        events->recordHit("snapshot.error");
+        ::unlink(tmpFile.c_str());
+    }
+}
+
+void
+GeoDatabase::replaceData(Data* data) {
+    auto old = dataGuard.exchange(data, std::memory_order_acq_rel);
+
+    // Lookups in flight might still be using the old database
+    if (old) gc.defer([=] { delete old; });
 }
 
 bool
@@ -356,6 +751,9 @@ GeoDatabase::lookup(const GeoDatabase::Context& context) {
         auto end = Date::now();
         events->recordOutcome(end.secondsSince(start) * 1000, "matchTimeMs");
     });
+
+    GcLockBase::SharedGuard guard(gc);
+
     // @Note since we have a data-dependency here (pointer load), we could
     // in theory use consume memory ordering. However, compilers do not
     // implement it correctly and emit a simple acquire barrier. Also,
@@ -370,8 +768,8 @@ GeoDatabase::lookup(const GeoDatabase::Context& context) {
 
     static const auto NoEntry = std::make_pair(false, Result { });
 
-    auto makeResult = [](const Entry& entry) {
-        return std::make_pair(true, entry.toResult());
+    auto makeResult = [&](uint32_t location) {
+        return std::make_pair(true, data->toResult(location));
     };
 
     if (!data) {
@@ -380,13 +778,16 @@ GeoDatabase::lookup(const GeoDatabase::Context& context) {
     }
 
     if (context.hasValidGeo()) {
-        auto it = data->geoloc.find(makeGeoHash(context, data->precision));
-        if (it != std::end(data->geoloc)) {
-            const auto& entries = it->second;
-            for (const auto& entry: entries) {
-                if (entry.isLocated(context.latitude, context.longitude)) {
+        const auto hash = makeGeoHash(context, data->precision);
+        const size_t points = data->header->points;
+
+        size_t i = lowerBound(data->cellHash, points, hash);
+        if (i < points && data->cellHash[i] == hash) {
+            for (; i < points && data->cellHash[i] == hash; ++i) {
+                const auto& point = data->points[i];
+                if (point.isLocated(context.latitude, context.longitude)) {
                     events->recordHit("match.latlon");
-                    return makeResult(entry);
+                    return makeResult(point.location);
                 }
             }
 
@@ -410,31 +811,91 @@ GeoDatabase::lookup(const GeoDatabase::Context& context) {
         return NoEntry;
     }
 
-    auto it = std::lower_bound(
-            std::begin(data->subnets), std::end(data->subnets), addr, [&](const Entry& lhs, InAddr rhs) {
-            return lhs.ip() < rhs;
-    });
-
-    if (it == std::end(data->subnets) || it == std::begin(data->subnets)) {
+    // The range that contains addr, if any, is the last one starting before it
+    size_t i = upperBound(data->first, data->header->ranges, addr);
+    if (i == 0 || data->last[i - 1] < addr) {
         recordUnmatch("unknownSubnet");
         return NoEntry;
     }
 
-    if (it->ip() > addr)
-        --it;
-
     events->recordHit("match.ip");
-    return makeResult(*it);
+    return makeResult(data->rangeLocation[i - 1]);
 }
 
 void
 GeoDatabase::loadAsync(
         const std::string& ipFile, const std::string& locationFile,
-        GeoDatabase::Precision precision) {
-    std::thread thr([=]() { load(ipFile, locationFile, precision); });
+        GeoDatabase::Precision precision, const std::string& snapshotFile) {
+    std::thread thr([=]() {
+        try {
+            load(ipFile, locationFile, precision, snapshotFile);
+        } catch (const std::exception& exc) {
+            // Thrown out of the thread, it would terminate the process
+            std::cerr << "Could not load the geo database: " << exc.what() << std::endl;
+            events->recordHit("load.error");
+        }
+    });
     thr.detach();
 };
 
+void
+GeoDatabase::watch(
+        const std::string& ipFile, const std::string& locationFile,
+        GeoDatabase::Precision precision, const std::string& snapshotFile) {
+    using namespace JamLoop::Utils;
+
+    ExcCheck(!watchLoop, "Already watching the geo database files");
+
+    /* A new release is usually copied or moved over the old files, one after
+       the other, so we wait for the files to stay still for a little while
+       before reloading. */
+    static constexpr double SettleDelay = 10.0;
+
+    struct State {
+        std::mutex lock;
+        Date lastChange;
+        bool pending = false;
+    };
+    auto state = std::make_shared<State>();
+
+    const auto ipName = baseNameOf(ipFile);
+    const auto locationName = baseNameOf(locationFile);
+
+    auto watcher = std::make_shared<FileWatcher>([=](FileWatcher::Event event) {
+        if (event.name != ipName && event.name != locationName) return;
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->lastChange = Date::now();
+        state->pending = true;
+    });
+
+    const auto flags = WatchFor::ClosingWrite | WatchFor::MovedTo;
+    watcher->startWatching(directoryOf(ipFile), flags);
+    if (directoryOf(locationFile) != directoryOf(ipFile))
+        watcher->startWatching(directoryOf(locationFile), flags);
+
+    watchLoop.reset(new MessageLoop());
+    watchLoop->addSource("GeoDatabase::watcher", watcher);
+    watchLoop->addPeriodic("GeoDatabase::reload", 1.0, [=](uint64_t) {
+        {
+            std::lock_guard<std::mutex> guard(state->lock);
+            if (!state->pending || Date::now().secondsSince(state->lastChange) < SettleDelay)
+                return;
+            state->pending = false;
+        }
+
+        try {
+            load(ipFile, locationFile, precision, snapshotFile);
+            events->recordHit("reload.success");
+        } catch (const std::exception& exc) {
+            // Keep the current database
+            std::cerr << "Could not reload the geo database: " << exc.what() << std::endl;
+            events->recordHit("reload.error");
+        }
+    });
+    watchLoop->start();
+}
+
 GeoPipeline::GeoPipeline(
         const std::shared_ptr<Datacratic::ServiceProxies>& proxies,
         std::string serviceName, const Json::Value& config)
@@ -443,9 +904,13 @@ GeoPipeline::GeoPipeline(
     auto ipFile = config["ipFile"].asString();
     auto locationFile = config["locationFile"].asString();
     auto prec = config["precision"].asDouble();
+    auto snapshotFile = config["snapshotFile"].asString();
 
     db.reset(new GeoDatabase(this->serviceName() + ".geo", proxies));
-    db->loadAsync(ipFile, locationFile, GeoDatabase::Precision(prec));
+    db->loadAsync(ipFile, locationFile, GeoDatabase::Precision(prec), snapshotFile);
+
+    if (config["watch"].asBool())
+        db->watch(ipFile, locationFile, GeoDatabase::Precision(prec), snapshotFile);
 }
 
 PipelineStatus
@@ -8,6 +8,8 @@
 #pragma once
 
 #include "rtbkit/common/bid_request_pipeline.h"
+#include "soa/service/message_loop.h"
+#include "soa/gc/gc_lock.h"
 #include <cmath>
 #include <atomic>
 
@@ -34,6 +36,19 @@ private:
 };
         
 
+/* The database is kept in a single block of memory so that it can be written
+   to a snapshot file and mapped back as is when the router restarts:
+
+     Header
+     InAddr   first[ranges]          first address of each ip range, sorted
+     InAddr   last[ranges]           last address of each ip range
+     uint32_t rangeLocation[ranges]  index in the location table
+     Location locations[locations]   distinct locations
+     uint64_t cellHash[points]       geo hash of each point, sorted
+     Point    points[points]         located points of each geo hash
+     char     strings[stringsSize]   interned strings, nul terminated
+*/
+
 struct GeoDatabase {
 
 
@@ -58,6 +73,8 @@ struct GeoDatabase {
             return static_cast<T>(value / s);
         }
 
+        double value() const { return s; }
+
     private:
         double s;
     };
@@ -74,13 +91,28 @@ struct GeoDatabase {
             std::shared_ptr<Datacratic::ServiceProxies> proxies);
     ~GeoDatabase();
 
+    /* Same as load() on a thread of its own.  Failures are logged and
+       leave the current database in place.
+    */
     void loadAsync(
             const std::string& ipFile, const std::string& locationFile,
-            Precision precision);
-
+            Precision precision, const std::string& snapshotFile = "");
+
+    /* Loads the database and atomically replaces the current one.  If a
+       snapshot file is given and it was built from csv files of the same
+       size and modification time, it is mapped instead of parsing the csv
+       files, otherwise it is rewritten after parsing them.  Writing the
+       snapshot is best-effort: a failure is logged and doesn't stop the
+       parsed database from being used.
+    */
     void load(
             const std::string& ipFile, const std::string& locationFile,
-            Precision precision);
+            Precision precision, const std::string& snapshotFile = "");
+
+    /* Reloads the database whenever one of the csv files is replaced. */
+    void watch(
+            const std::string& ipFile, const std::string& locationFile,
+            Precision precision, const std::string& snapshotFile = "");
 
     std::pair<bool, Result> lookup(const Context &context);
 
@@ -88,46 +120,42 @@ struct GeoDatabase {
 
 private:
 
-    struct Entry {
-        std::string metroCode;
-        std::string zipCode;
-        std::string countryCode;
-        std::string region;
+    struct Header;
 
-        static Entry fromIp(InAddr ip);
-        static Entry fromGeo(double latitude, double longitude);
+    struct Location {
+        // Offsets in the string table
+        uint32_t metroCode;
+        uint32_t zipCode;
+        uint32_t countryCode;
+        uint32_t region;
+    };
 
-        InAddr ip() const;
-        std::pair<double, double> geo() const;
+    struct Point {
+        float latitude;
+        float longitude;
+        uint32_t location;
 
         bool isLocated(double latitude, double longitude) const;
-
-        Result toResult() const;
-
-        union {
-            struct {
-                InAddr ip;
-            };
-            struct {
-                double latitude;
-                double longitude;
-            };
-        } u;
-
     };
 
+    struct Builder;
+    struct Data;
+
     uint64_t makeGeoHash(double latitude, double longitude, Precision precision);
-    uint64_t makeGeoHash(const Entry& entry, Precision precision);
     uint64_t makeGeoHash(const Context& context, Precision precision);
 
-    struct Data {
-        std::vector<Entry> subnets;
-        std::unordered_map<uint64_t, std::vector<Entry>> geoloc;
-        Precision precision;
-    };
+    Data* parse(
+            const std::string& ipFile, const std::string& locationFile,
+            Precision precision);
+
+    void replaceData(Data* data);
+    void writeSnapshot(const Data& data, const std::string& snapshotFile);
 
     std::atomic<Data *> dataGuard;
+    Datacratic::GcLock gc;
     std::unique_ptr<Datacratic::EventRecorder> events;
+
+    std::unique_ptr<Datacratic::MessageLoop> watchLoop;
 };
 
 class GeoPipeline : public RTBKIT::BidRequestPipeline {
@@ -8,6 +8,7 @@
 #include "liverail_exchange_connector.h"
 #include "utils.h"
 #include "soa/utils/generic_utils.h"
+#include "rtbkit/common/filter.h"
 
 using namespace RTBKIT;
 using namespace Datacratic;
@@ -120,6 +121,22 @@ namespace Jamloop {
         return br;
     }
 
+    unsigned
+    LiveRailExchangeConnector::preParseBidRequest(
+            const HttpHeader& header,
+            const std::string& payload,
+            BidRequest& request)
+    {
+        // The url is decoded the same way as in parseBidRequest so that the
+        // url filters see the same thing on both paths
+        unsigned fields = OpenRTBExchangeConnector::preParseBidRequest(header, payload, request);
+        if (fields & PF_URL) {
+            request.url = Url(urldecode(request.url.toString()));
+        }
+
+        return fields;
+    }
+
     void
     LiveRailExchangeConnector::setSeatBid(
             const Auction& auction,
@@ -46,6 +46,11 @@ public:
                     const Datacratic::HttpHeader& header,
                     const std::string& payload);
 
+    unsigned
+    preParseBidRequest(const Datacratic::HttpHeader& header,
+                       const std::string& payload,
+                       RTBKIT::BidRequest& request);
+
     struct CreativeInfo {
         std::string adm; //< Valid inline VAST
 
@@ -0,0 +1,211 @@
+/* brightroll_exchange_connector_bench.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Cost of decoding the sample BrightRoll bid request and of encoding a bid
+   response, on a fresh heap allocated message versus on a thread arena that
+   is reset after each auction the way the exchange connector does, and of
+   the connector's whole parseBidRequest.
+*/
+
+#include "brightroll_exchange_connector.h"
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include "soa/service/http_header.h"
+#include "soa/types/date.h"
+
+#include <google/protobuf/arena.h>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+using namespace JamLoop;
+
+namespace {
+
+/******************************************************************************/
+/* CONFIG                                                                     */
+/******************************************************************************/
+
+struct Config
+{
+    Config() :
+        request("brightroll-bidrequest.dat"), iterations(200000)
+    {}
+
+    string request;
+    size_t iterations;
+};
+
+Config getConfig(int argc, char** argv)
+{
+    using namespace boost::program_options;
+
+    Config config;
+
+    options_description opt("Bench options");
+    opt.add_options()
+        ("request,r", value<string>(&config.request),
+         "file holding a single BrightRoll bid request")
+        ("iterations,n", value<size_t>(&config.iterations),
+         "number of requests decoded and responses encoded")
+        ("help,h","print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(opt).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << opt << endl;
+        exit(1);
+    }
+
+    return config;
+}
+
+/******************************************************************************/
+/* FIXTURES                                                                   */
+/******************************************************************************/
+
+string readRequest(const string& filename)
+{
+    ifstream stream(filename, ios::in | ios::binary);
+    if (!stream) {
+        throw ML::Exception("couldn't open " + filename);
+    }
+
+    return string((istreambuf_iterator<char>(stream)),
+                  istreambuf_iterator<char>());
+}
+
+/** Roughly what the connector answers with one winning bid. */
+void fillResponse(::BidResponse& response, const ::BidRequest& request)
+{
+    response.set_id(request.id());
+    response.set_cur("USD");
+
+    auto seatBid = response.add_seatbid();
+    seatBid->set_seat("12341");
+
+    auto bid = seatBid->add_bid();
+    bid->set_id(request.id() + ":" + request.imp().id());
+    bid->set_impid(request.imp().id());
+    bid->set_price(10.0);
+    bid->set_nurl("http://adserver.com?brid=" + request.id()
+                  + "&impid=1&price=##BRX_CLEARING_PRICE##");
+    bid->add_adomain("jamloop.com");
+    bid->set_cid("agent");
+    bid->set_crid("1");
+
+    auto ext = bid->mutable_ext();
+    ext->set_campaign_name("test_campaign");
+    ext->set_line_item_name("line_item");
+    ext->set_creative_name("test_creative");
+    ext->set_creative_duration(10);
+    auto mediaDesc = ext->add_media_desc();
+    mediaDesc->set_media_mime(FLV);
+    mediaDesc->set_media_bitrate(600);
+    ext->set_lid("428885");
+    ext->set_landingpage_url("http://jamloop.com");
+    ext->set_advertiser_name("jamloop");
+    ext->set_adtype(ADTYPE_VIDEO);
+    ext->set_adserver_processing_time(5);
+}
+
+template<typename Fn>
+double timeIt(size_t iterations, Fn fn)
+{
+    Date start = Date::now();
+    for (size_t i = 0; i < iterations; ++i)
+        fn();
+    return Date::now().secondsSince(start) / iterations * 1e9;
+}
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+void bench(const Config& config, const string& payload)
+{
+    size_t failed = 0;
+
+    double decodeHeap = timeIt(config.iterations, [&] {
+            ::BidRequest request;
+            failed += !request.ParseFromString(payload);
+        });
+
+    static char block[64 * 1024];
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = sizeof(block);
+    google::protobuf::Arena arena(options);
+
+    double decodeArena = timeIt(config.iterations, [&] {
+            auto request = google::protobuf::Arena::CreateMessage< ::BidRequest>(&arena);
+            failed += !request->ParseFromString(payload);
+            arena.Reset();
+        });
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    BrightRollExchangeConnector connector("brightroll", proxies);
+    HttpAuctionHandler handler;
+    HttpHeader header;
+    header.contentType = "application/octet-stream";
+
+    double parse = timeIt(config.iterations, [&] {
+            failed += !connector.parseBidRequest(handler, header, payload);
+        });
+
+    if (failed) {
+        throw ML::Exception("failed to decode the request");
+    }
+
+    ::BidRequest request;
+    request.ParseFromString(payload);
+    size_t bytes = 0;
+
+    double encodeHeap = timeIt(config.iterations, [&] {
+            ::BidResponse response;
+            fillResponse(response, request);
+            string body;
+            response.SerializeToString(&body);
+            bytes += body.size();
+        });
+
+    double encodeArena = timeIt(config.iterations, [&] {
+            auto response = google::protobuf::Arena::CreateMessage< ::BidResponse>(&arena);
+            fillResponse(*response, request);
+            HttpResponse result(200, "application/octet-stream", string());
+            response->SerializeToString(&result.body);
+            bytes += result.body.size();
+            arena.Reset();
+        });
+
+    cerr << "request:             " << payload.size() << " bytes" << endl
+         << "decode (heap):       " << decodeHeap << " ns" << endl
+         << "decode (arena):      " << decodeArena << " ns" << endl
+         << "parseBidRequest:     " << parse << " ns" << endl
+         << "response:            " << bytes / (2 * config.iterations) << " bytes" << endl
+         << "encode (heap):       " << encodeHeap << " ns" << endl
+         << "encode (arena):      " << encodeArena << " ns" << endl;
+}
+
+} // namespace anonymous
+
+
+int main(int argc, char** argv)
+{
+    auto config = getConfig(argc, argv);
+
+    auto payload = readRequest(config.request);
+    if (payload.empty()) {
+        cerr << config.request << " is empty" << endl;
+        return 1;
+    }
+
+    bench(config, payload);
+    return 0;
+}
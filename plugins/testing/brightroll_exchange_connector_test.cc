@@ -14,6 +14,7 @@
 #include "brightroll_exchange_connector.h"
 
 #include "rtbkit/common/testing/exchange_source.h"
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
 #include "rtbkit/testing/bid_stack.h"
 #include "soa/service/http_header.h"
 
@@ -41,6 +42,47 @@ std::string readBidRequest() {
 using namespace RTBKIT;
 using namespace JamLoop;
 
+BOOST_AUTO_TEST_CASE( test_brightroll_parse_reused_arena )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    BrightRollExchangeConnector connector("brightroll", proxies);
+
+    HttpAuctionHandler handler;
+    HttpHeader header;
+    header.contentType = "application/octet-stream";
+
+    auto payload = readBidRequest();
+
+    // The second parse reuses the arena of the first one
+    for (int i = 0; i < 2; ++i) {
+        auto br = connector.parseBidRequest(handler, header, payload);
+        BOOST_REQUIRE(br);
+
+        BOOST_CHECK_EQUAL(br->auctionId.toString(), "adop82QlCRtT8AOq1BTm_nfPEKNig");
+        BOOST_CHECK_EQUAL(br->exchange, "brightroll");
+        BOOST_CHECK_EQUAL(br->timeAvailableMs, 90);
+
+        BOOST_REQUIRE_EQUAL(br->imp.size(), 1);
+        BOOST_CHECK_EQUAL(br->imp[0].id.toString(), "1");
+        BOOST_REQUIRE(br->imp[0].video);
+        BOOST_CHECK_EQUAL(br->imp[0].video->w.value(), 640);
+        BOOST_CHECK_EQUAL(br->imp[0].video->h.value(), 480);
+
+        BOOST_REQUIRE(br->site);
+        BOOST_CHECK_EQUAL(br->site->id.toString(), "3845441");
+
+        BOOST_REQUIRE(br->device);
+        BOOST_CHECK_EQUAL(br->device->ip, "66.54.159.162");
+        BOOST_CHECK_EQUAL(br->ipAddress, "66.54.159.162");
+        BOOST_CHECK_EQUAL(br->language.rawString(), "en");
+
+        BOOST_REQUIRE(br->user);
+        BOOST_CHECK_EQUAL(br->user->id.toString(), "3UGsjDg_HGVUBF3PrUg");
+
+        BOOST_CHECK_EQUAL(br->ext["inventory_class"].asString(), "reach");
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_brightroll )
 {
     BidStack stack;
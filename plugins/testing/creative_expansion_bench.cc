@@ -0,0 +1,267 @@
+/* creative_expansion_bench.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Benchmark of the creative macro expansion on the real adaptv and publisher
+   creatives of our zip campaigns (JAKzip, LUB).
+*/
+
+#include "rtbkit/common/creative_configuration.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "soa/jsoncpp/json.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+namespace {
+
+struct Snippets { };
+
+typedef CreativeConfiguration<Snippets> BenchCreativeConfiguration;
+
+/******************************************************************************/
+/* CONFIG                                                                     */
+/******************************************************************************/
+
+struct Config
+{
+    Config() :
+        biddersDir("configs/bidders"), iterations(100000)
+    {}
+
+    string biddersDir;
+    vector<string> prefixes;
+    size_t iterations;
+};
+
+Config getConfig(int argc, char** argv)
+{
+    using namespace boost::program_options;
+
+    Config config;
+
+    options_description opt("Bench options");
+    opt.add_options()
+        ("bidders-dir,b", value<string>(&config.biddersDir),
+         "directory holding the bidder configurations")
+        ("prefix,p", value<vector<string>>(&config.prefixes),
+         "prefix of the configurations to load (default JAKzip and LUB)")
+        ("iterations,n", value<size_t>(&config.iterations),
+         "number of expansions per snippet")
+        ("help,h","print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(opt).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << opt << endl;
+        exit(1);
+    }
+
+    if (config.prefixes.empty())
+        config.prefixes = { "JAKzip", "LUB" };
+
+    return config;
+}
+
+/******************************************************************************/
+/* FIXTURES                                                                   */
+/******************************************************************************/
+
+BidRequest makeBidRequest()
+{
+    BidRequest br;
+    br.auctionId = Id("a1b2c3d4-0000-1111-2222-333344445555");
+    br.timestamp = Date::now();
+    br.language = "en";
+    br.userAgent = "Mozilla/5.0 (iPhone; CPU iPhone OS 9_2 like Mac OS X) "
+                   "AppleWebKit/601.1.46 (KHTML, like Gecko) Mobile/13C75";
+
+    br.app.reset(new OpenRTB::App());
+    br.app->bundle = "com.example.weather";
+    br.app->name = "Weather";
+    br.app->storeurl = Url("https://itunes.apple.com/us/app/weather/id123456");
+    br.app->publisher.reset(new OpenRTB::Publisher());
+    br.app->publisher->id = Id("pub-8812");
+
+    br.device.reset(new OpenRTB::Device());
+    br.device->ip = "73.12.201.44";
+    br.device->devicetype.val = 4;
+    br.device->geo.reset(new OpenRTB::Geo());
+    br.device->geo->country = "US";
+    br.device->geo->region = "IN";
+    br.device->geo->metro = "527";
+    br.device->geo->zip = "46201";
+
+    br.user.reset(new OpenRTB::User());
+    br.user->id = Id("user-42");
+
+    br.imp.emplace_back();
+    br.imp[0].id = Id("1");
+    br.imp[0].video.reset(new OpenRTB::Video());
+    br.imp[0].video->w = 320;
+    br.imp[0].video->h = 480;
+
+    br.ext["deviceid"] = "6D92078A-8246-4BA4-AE5B-76104861E7DC";
+    br.ext["videotype"] = "VPAID";
+    br.ext["price"] = 4500;
+
+    return br;
+}
+
+vector<Creative> loadCreatives(const Config& config)
+{
+    namespace fs = boost::filesystem;
+
+    vector<Creative> creatives;
+
+    for (fs::directory_iterator it(config.biddersDir), end; it != end; ++it) {
+        auto name = it->path().filename().string();
+        if (it->path().extension() != ".json") continue;
+
+        bool match = false;
+        for (const auto& prefix: config.prefixes)
+            match = match || name.compare(0, prefix.size(), prefix) == 0;
+        if (!match) continue;
+
+        ifstream stream(it->path().string());
+        string contents((istreambuf_iterator<char>(stream)),
+                         istreambuf_iterator<char>());
+
+        auto json = Json::parse(contents);
+        for (const auto& jsonCreative: json["creatives"]) {
+            Creative creative;
+            creative.id = jsonCreative["id"].asInt();
+            creative.name = name;
+            creative.providerConfig = jsonCreative["providerConfig"];
+            creatives.push_back(std::move(creative));
+        }
+    }
+
+    return creatives;
+}
+
+struct Snippet {
+    const Creative* creative;
+    const BenchCreativeConfiguration* config;
+    string value;
+};
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+void bench(const Config& config, const vector<Snippet>& snippets,
+           const BidRequest& br)
+{
+    Auction::Response response;
+    response.price.maxPrice = USD_CPM(6.1);
+    response.account = AccountKey("JAKzip_AllMobile:1");
+
+    size_t bytes = 0;
+    size_t variables = 0;
+    size_t jsonVariables = 0;
+
+    for (const auto& snippet: snippets) {
+        for (auto pos = snippet.value.find("%{"); pos != string::npos;
+             pos = snippet.value.find("%{", pos + 1)) {
+            ++variables;
+            if (snippet.value.compare(pos, 17, "%{bidrequest.ext.") == 0)
+                ++jsonVariables;
+        }
+    }
+
+    Date start = Date::now();
+    for (size_t i = 0; i < config.iterations; ++i) {
+        for (const auto& snippet: snippets) {
+            BenchCreativeConfiguration::Context context {
+                *snippet.creative, response, br, 0
+            };
+            bytes += snippet.config->expand(snippet.value, context).size();
+        }
+    }
+    double elapsed = Date::now().secondsSince(start);
+
+    /* The previous implementation serialized the whole request to json for
+       each variable without a typed accessor; time one serialization to put
+       the numbers in perspective. */
+    Date jsonStart = Date::now();
+    size_t jsonFields = 0;
+    for (size_t i = 0; i < config.iterations / 10 + 1; ++i)
+        jsonFields += br.toJson().size();
+    double jsonElapsed =
+        Date::now().secondsSince(jsonStart) / (config.iterations / 10 + 1);
+
+    size_t expansions = config.iterations * snippets.size();
+    cerr << "snippets:          " << snippets.size() << endl
+         << "variables:         " << variables
+         << " (" << jsonVariables << " ext lookups)" << endl
+         << "expansions:        " << expansions << endl
+         << "avg output bytes:  " << bytes / expansions << endl
+         << "time/expansion:    " << elapsed / expansions * 1e9 << " ns" << endl
+         << "expansions/sec:    " << expansions / elapsed << endl
+         << "toJson() cost:     " << jsonElapsed * 1e9 << " ns "
+         << "(" << jsonFields / (config.iterations / 10 + 1)
+         << " top-level fields)" << endl;
+}
+
+} // namespace anonymous
+
+
+int main(int argc, char** argv)
+{
+    auto config = getConfig(argc, argv);
+
+    BenchCreativeConfiguration adaptv("adaptv");
+    adaptv.addField("adm", [](const Json::Value&, Snippets&) { return true; })
+        .snippet();
+    adaptv.addField("nurl", [](const Json::Value&, Snippets&) { return true; })
+        .snippet().optional();
+
+    BenchCreativeConfiguration publisher("publisher");
+    publisher.addExpanderVariable(
+        "tag.price",
+        [](const BenchCreativeConfiguration::Context& context) {
+            const double price = context.bidrequest.ext["price"].asDouble();
+            return std::to_string(price / 1000.0);
+    });
+    publisher.addField("vast", [](const Json::Value&, Snippets&) { return true; })
+        .snippet();
+
+    auto creatives = loadCreatives(config);
+    vector<Snippet> snippets;
+
+    for (const auto& creative: creatives) {
+        auto add = [&](const BenchCreativeConfiguration& conf,
+                       const string& exchange, const string& field) {
+            const auto& value = creative.providerConfig[exchange][field];
+            if (value.isString())
+                snippets.push_back(Snippet { &creative, &conf, value.asString() });
+        };
+
+        if (adaptv.handleCreativeCompatibility(creative, false).isCompatible) {
+            add(adaptv, "adaptv", "adm");
+            add(adaptv, "adaptv", "nurl");
+        }
+        if (publisher.handleCreativeCompatibility(creative, false).isCompatible)
+            add(publisher, "publisher", "vast");
+    }
+
+    if (snippets.empty()) {
+        cerr << "no snippet found in " << config.biddersDir << endl;
+        return 1;
+    }
+
+    cerr << "loaded " << creatives.size() << " creatives" << endl;
+
+    bench(config, snippets, makeBidRequest());
+    return 0;
+}
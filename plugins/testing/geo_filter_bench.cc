@@ -0,0 +1,234 @@
+/* geo_filter_bench.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Benchmark of the set based Geo filter against the regex Location filter on
+   the zip targeting of our real bidder configs (JAKzip, LUB_ZIP, LAFzip).
+*/
+
+#include "rtbkit/core/router/filters/static_filters.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "soa/jsoncpp/json.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+namespace {
+
+/******************************************************************************/
+/* CONFIG                                                                     */
+/******************************************************************************/
+
+struct Config
+{
+    Config() :
+        biddersDir("configs/bidders"), requests(10000), iterations(20)
+    {}
+
+    string biddersDir;
+    vector<string> prefixes;
+    size_t requests;
+    size_t iterations;
+};
+
+Config getConfig(int argc, char** argv)
+{
+    using namespace boost::program_options;
+
+    Config config;
+
+    options_description opt("Bench options");
+    opt.add_options()
+        ("bidders-dir,b", value<string>(&config.biddersDir),
+         "directory holding the bidder configurations")
+        ("prefix,p", value<vector<string>>(&config.prefixes),
+         "prefix of the configurations to load (default JAKzip, LUB_ZIP and LAFzip)")
+        ("requests,r", value<size_t>(&config.requests),
+         "number of distinct locations to filter")
+        ("iterations,n", value<size_t>(&config.iterations),
+         "number of passes over the locations")
+        ("help,h","print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(opt).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << opt << endl;
+        exit(1);
+    }
+
+    if (config.prefixes.empty())
+        config.prefixes = { "JAKzip", "LUB_ZIP", "LAFzip" };
+
+    return config;
+}
+
+/******************************************************************************/
+/* FIXTURES                                                                   */
+/******************************************************************************/
+
+vector<AgentConfig> loadConfigs(const Config& config)
+{
+    namespace fs = boost::filesystem;
+
+    vector<AgentConfig> configs;
+
+    for (fs::directory_iterator it(config.biddersDir), end; it != end; ++it) {
+        auto name = it->path().filename().string();
+        if (it->path().extension() != ".json") continue;
+
+        bool match = false;
+        for (const auto& prefix: config.prefixes)
+            match = match || name.compare(0, prefix.size(), prefix) == 0;
+        if (!match) continue;
+
+        ifstream stream(it->path().string());
+        string contents((istreambuf_iterator<char>(stream)),
+                         istreambuf_iterator<char>());
+
+        try {
+            configs.push_back(AgentConfig::createFromJson(Json::parse(contents)));
+        } catch (const std::exception& exc) {
+            cerr << "skipping " << name << ": " << exc.what() << endl;
+        }
+    }
+
+    return configs;
+}
+
+/** Half of the locations are in one of the targeted zips, the other half in a
+    zip of the same area that nobody targets. */
+vector<Location> makeLocations(const Config& config, const vector<AgentConfig>& configs)
+{
+    vector<string> zips;
+    for (const auto& agent: configs) {
+        for (const auto& zip: agent.geoFilter.include.zips)
+            zips.push_back(zip);
+    }
+
+    mt19937 rng(42);
+    vector<Location> locations;
+
+    for (size_t i = 0; i < config.requests; ++i) {
+        Location location;
+        location.countryCode = "US";
+        location.regionCode = "IN";
+        location.cityName = Datacratic::UnicodeString("Columbus");
+        location.dma = 527;
+
+        string zip = zips[rng() % zips.size()];
+        if (i % 2) zip[4] = '0' + (zip[4] - '0' + 1 + rng() % 9) % 10;
+        location.postalCode = Datacratic::UnicodeString(zip);
+
+        locations.push_back(std::move(location));
+    }
+
+    return locations;
+}
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+typedef IncludeExcludeFilter<
+    RegexFilter<boost::u32regex, Datacratic::UnicodeString>
+> RegexImpl;
+
+typedef IncludeExcludeFilter<JamLoop::GeoIndex> GeoImpl;
+
+template<typename Fn>
+double timeFilter(const Config& config, const vector<Location>& locations, Fn&& fn)
+{
+    size_t matches = 0;
+
+    Date start = Date::now();
+    for (size_t i = 0; i < config.iterations; ++i) {
+        for (const auto& location: locations)
+            matches += fn(location).count();
+    }
+    double elapsed = Date::now().secondsSince(start);
+
+    // Keeps the loop from being optimized away.
+    if (matches == size_t(-1)) cerr << matches << endl;
+
+    return elapsed / (config.iterations * locations.size());
+}
+
+void bench(const Config& config, const vector<AgentConfig>& configs)
+{
+    RegexImpl regexImpl;
+    GeoImpl geoImpl;
+
+    size_t compiled = 0;
+    size_t regexes = 0;
+    for (size_t i = 0; i < configs.size(); ++i) {
+        regexImpl.addIncludeExclude(i, configs[i].locationFilter);
+        regexes += configs[i].locationFilter.include.size()
+            + configs[i].locationFilter.exclude.size();
+
+        geoImpl.addInclude(i, configs[i].geoFilter.include);
+        geoImpl.addExclude(i, configs[i].geoFilter.exclude);
+        compiled += configs[i].locationFilterCompiled;
+    }
+
+    auto locations = makeLocations(config, configs);
+
+    size_t mismatches = 0;
+    for (const auto& location: locations) {
+        ConfigSet expected = regexImpl.filter(location.fullLocationString());
+        ConfigSet actual = geoImpl.filter(location);
+        if (!(expected ^ actual).empty()) ++mismatches;
+    }
+
+    double regexTime = timeFilter(config, locations, [&](const Location& location) {
+                return regexImpl.filter(location.fullLocationString());
+            });
+
+    double geoTime = timeFilter(config, locations, [&](const Location& location) {
+                return geoImpl.filter(location);
+            });
+
+    cerr << "configs:           " << configs.size()
+         << " (" << compiled << " compiled)" << endl
+         << "regexes:           " << regexes << endl
+         << "locations:         " << locations.size() << endl
+         << "mismatches:        " << mismatches << endl
+         << "regex time/req:    " << regexTime * 1e9 << " ns" << endl
+         << "geo time/req:      " << geoTime * 1e9 << " ns" << endl
+         << "speedup:           " << regexTime / geoTime << "x" << endl;
+}
+
+} // namespace anonymous
+
+
+int main(int argc, char** argv)
+{
+    auto config = getConfig(argc, argv);
+
+    auto configs = loadConfigs(config);
+    if (configs.empty()) {
+        cerr << "no config found in " << config.biddersDir << endl;
+        return 1;
+    }
+
+    // The locations are drawn from the compiled zips.
+    bool hasZips = false;
+    for (const auto& agent: configs)
+        hasZips = hasZips || !agent.geoFilter.include.zips.empty();
+    if (!hasZips) {
+        cerr << "no zip targeting compiled in " << config.biddersDir << endl;
+        return 1;
+    }
+
+    bench(config, configs);
+    return 0;
+}
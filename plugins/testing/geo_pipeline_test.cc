@@ -10,6 +10,9 @@
 
 #include <boost/test/unit_test.hpp>
 #include "geo_pipeline.h"
+#include <fstream>
+#include <cstdio>
+#include <sys/time.h>
 
 using namespace RTBKIT;
 using namespace Datacratic;
@@ -225,3 +228,178 @@ BOOST_AUTO_TEST_CASE( test_geo_mapping )
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+/* The tests underneath use a tiny database of their own so that they don't
+   depend on the MaxMind files */
+
+namespace Small {
+
+constexpr const char *IpFile       = "geo_pipeline_test_blocks.csv";
+constexpr const char *LocationFile = "geo_pipeline_test_locations.csv";
+constexpr const char *SnapshotFile = "geo_pipeline_test.snapshot";
+
+void writeLocations() {
+    std::ofstream out(LocationFile);
+    out << "geoname_id,locale_code,continent_code,continent_name,country_iso_code,country_name,"
+           "subdivision_1_iso_code,subdivision_1_name,subdivision_2_iso_code,subdivision_2_name,"
+           "city_name,metro_code,time_zone\n"
+        << "1,en,NA,North America,US,United States,AL,Alabama,,,Dothan,606,America/Chicago\n"
+        << "2,en,NA,North America,US,United States,IL,Illinois,,,Quincy,717,America/Chicago\n"
+        << "3,en,EU,Europe,CY,Cyprus,02,Limassol,,,Souni,,Asia/Nicosia\n";
+}
+
+void writeBlocks(const char* secondZip) {
+    std::ofstream out(IpFile);
+    out << "network,geoname_id,registered_country_geoname_id,represented_country_geoname_id,"
+           "is_anonymous_proxy,is_satellite_provider,postal_code,latitude,longitude\n"
+        << "10.0.0.0/24,1,6252001,,0,0,36322,31.2,-85.4\n"
+        << "10.0.2.0/23,2,6252001,,0,0," << secondZip << ",39.9,-91.4\n"
+        // No metro code, never matches
+        << "10.0.4.0/24,3,146669,,0,0,,34.7,33.0\n"
+        << "10.0.5.0/24,1,6252001,,0,0,36322,31.2,-85.4\n";
+}
+
+GeoDatabase::Context ip(const char* addr) {
+    return GeoDatabase::Context {
+        addr,
+        std::numeric_limits<double>::quiet_NaN(),
+        std::numeric_limits<double>::quiet_NaN()
+    };
+}
+
+void check(GeoDatabase& db, const char* addr, const char* zip) {
+    bool found;
+    GeoDatabase::Result result;
+    std::tie(found, result) = db.lookup(ip(addr));
+
+    BOOST_CHECK_MESSAGE(found == (zip != nullptr), "lookup of " << addr);
+    if (found && zip)
+        BOOST_CHECK_EQUAL(result.zipCode, zip);
+}
+
+void checkAll(GeoDatabase& db, const char* secondZip) {
+    check(db, "9.255.255.255", nullptr);
+    check(db, "10.0.0.0", "36322");
+    check(db, "10.0.0.255", "36322");
+    check(db, "10.0.1.7", nullptr);
+    check(db, "10.0.2.0", secondZip);
+    check(db, "10.0.3.255", secondZip);
+    check(db, "10.0.4.1", nullptr);
+    check(db, "10.0.5.255", "36322");
+    check(db, "10.0.6.0", nullptr);
+
+    GeoDatabase::Context context { "0.0.0.0", 39.9, -91.4 };
+    bool found;
+    GeoDatabase::Result result;
+    std::tie(found, result) = db.lookup(context);
+    BOOST_CHECK(found);
+    BOOST_CHECK_EQUAL(result.metroCode, "717");
+    BOOST_CHECK_EQUAL(result.region, "IL");
+    BOOST_CHECK_EQUAL(result.zipCode, secondZip);
+}
+
+} // namespace Small
+
+BOOST_AUTO_TEST_CASE( test_ip_ranges )
+{
+    Small::writeLocations();
+    Small::writeBlocks("62301");
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    GeoDatabase db("test.geo", proxies);
+    BOOST_CHECK(!db.isLoaded());
+
+    db.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1));
+    BOOST_CHECK(db.isLoaded());
+
+    // Addresses that fall between two ranges or around them do not match
+    Small::checkAll(db, "62301");
+}
+
+BOOST_AUTO_TEST_CASE( test_snapshot )
+{
+    Small::writeLocations();
+    Small::writeBlocks("62301");
+    std::remove(Small::SnapshotFile);
+
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    GeoDatabase parsed("test.geo", proxies);
+    parsed.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1), Small::SnapshotFile);
+    Small::checkAll(parsed, "62301");
+
+    std::ifstream snapshot(Small::SnapshotFile);
+    BOOST_CHECK(snapshot.good());
+
+    // Mapped back from the snapshot without parsing the csv files
+    std::remove(Small::IpFile);
+    GeoDatabase mapped("test.geo", proxies);
+    mapped.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1), Small::SnapshotFile);
+    BOOST_CHECK(mapped.isLoaded());
+    Small::checkAll(mapped, "62301");
+
+    std::remove(Small::SnapshotFile);
+}
+
+BOOST_AUTO_TEST_CASE( test_snapshot_not_writable )
+{
+    Small::writeLocations();
+    Small::writeBlocks("62301");
+
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    // The snapshot is best-effort, the parsed database is still used
+    GeoDatabase db("test.geo", proxies);
+    db.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1),
+            "geo_pipeline_test_missing/geo.snapshot");
+    BOOST_CHECK(db.isLoaded());
+    Small::checkAll(db, "62301");
+}
+
+BOOST_AUTO_TEST_CASE( test_snapshot_older_csv )
+{
+    Small::writeLocations();
+    Small::writeBlocks("62301");
+    std::remove(Small::SnapshotFile);
+
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    GeoDatabase parsed("test.geo", proxies);
+    parsed.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1), Small::SnapshotFile);
+    Small::checkAll(parsed, "62301");
+
+    // Replaced by a file that kept an older mtime, as rsync -t or tar do
+    Small::writeBlocks("62305");
+    struct timeval past[2];
+    ::gettimeofday(&past[0], nullptr);
+    past[0].tv_sec -= 3600;
+    past[1] = past[0];
+    BOOST_REQUIRE_EQUAL(::utimes(Small::IpFile, past), 0);
+
+    GeoDatabase reloaded("test.geo", proxies);
+    reloaded.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1), Small::SnapshotFile);
+    Small::checkAll(reloaded, "62305");
+
+    std::remove(Small::SnapshotFile);
+}
+
+BOOST_AUTO_TEST_CASE( test_reload )
+{
+    Small::writeLocations();
+    Small::writeBlocks("62301");
+
+    auto proxies = std::make_shared<ServiceProxies>();
+    GeoDatabase db("test.geo", proxies);
+    db.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1));
+    Small::checkAll(db, "62301");
+
+    Small::writeBlocks("62305");
+    db.load(Small::IpFile, Small::LocationFile, GeoDatabase::Precision(0.1));
+    Small::checkAll(db, "62305");
+
+    // A file that can not be read leaves the current database in place
+    BOOST_CHECK_THROW(
+            db.load("geo_pipeline_test_missing.csv", Small::LocationFile, GeoDatabase::Precision(0.1)),
+            ML::Exception);
+    Small::checkAll(db, "62305");
+}
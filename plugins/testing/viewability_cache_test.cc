@@ -0,0 +1,114 @@
+/* viewability_cache_test.cc
+   Copyright (c) 2015 Datacratic.  All rights reserved.
+
+   Unit tests for the ViewabilityCache
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "viewability_cache.h"
+
+using namespace Datacratic;
+using namespace JamLoop;
+
+typedef ViewabilityCache::Lookup Lookup;
+
+namespace {
+    const std::string Body = "{\"metrics\":{\"vr\":70}}";
+
+    ViewabilityCache::Callback unexpected() {
+        return [](HttpClientError, int, std::string&&) {
+            BOOST_CHECK(false);
+        };
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hit_and_expiry ) {
+    ViewabilityCache cache(16, 10.0, 2.0);
+    Date now = Date::fromSecondsSinceEpoch(1000);
+
+    auto key = ViewabilityCache::makeKey("adaptv", "pub", "http://a.com", 640, "above");
+    BOOST_CHECK(key != ViewabilityCache::makeKey("adaptv", "pub", "http://a.com", 640, "below"));
+
+    ViewabilityCache::Answer answer;
+    BOOST_CHECK(cache.lookup(key, answer, unexpected(), now) == Lookup::Miss);
+    BOOST_CHECK_EQUAL(cache.complete(key, HttpClientError::None, 200, Body, now), 0);
+
+    BOOST_CHECK(cache.lookup(key, answer, unexpected(), now.plusSeconds(9)) == Lookup::Hit);
+    BOOST_CHECK_EQUAL(answer.statusCode, 200);
+    BOOST_CHECK_EQUAL(answer.body, Body);
+
+    BOOST_CHECK(cache.lookup(key, answer, unexpected(), now.plusSeconds(11)) == Lookup::Miss);
+}
+
+BOOST_AUTO_TEST_CASE( test_negative_and_errors ) {
+    ViewabilityCache cache(16, 10.0, 2.0);
+    Date now = Date::fromSecondsSinceEpoch(1000);
+    ViewabilityCache::Answer answer;
+
+    BOOST_CHECK(cache.lookup("unknown", answer, unexpected(), now) == Lookup::Miss);
+    cache.complete("unknown", HttpClientError::None, 204, "", now);
+
+    BOOST_CHECK(cache.lookup("unknown", answer, unexpected(), now.plusSeconds(1)) == Lookup::Hit);
+    BOOST_CHECK(answer.negative());
+    BOOST_CHECK(cache.lookup("unknown", answer, unexpected(), now.plusSeconds(3)) == Lookup::Miss);
+
+    BOOST_CHECK(cache.lookup("error", answer, unexpected(), now) == Lookup::Miss);
+    cache.complete("error", HttpClientError::Timeout, 0, "", now);
+    BOOST_CHECK(cache.lookup("error", answer, unexpected(), now) == Lookup::Miss);
+
+    BOOST_CHECK(cache.lookup("invalid", answer, unexpected(), now) == Lookup::Miss);
+    cache.complete("invalid", HttpClientError::None, 500, "", now);
+    BOOST_CHECK(cache.lookup("invalid", answer, unexpected(), now) == Lookup::Miss);
+}
+
+BOOST_AUTO_TEST_CASE( test_coalescing ) {
+    ViewabilityCache cache(16, 10.0, 2.0);
+    ViewabilityCache::Answer answer;
+
+    int called = 0;
+    auto onPending = [&](HttpClientError error, int status, std::string&& body) {
+        BOOST_CHECK(error == HttpClientError::None);
+        BOOST_CHECK_EQUAL(status, 200);
+        BOOST_CHECK_EQUAL(body, Body);
+        ++called;
+    };
+
+    BOOST_CHECK(cache.lookup("key", answer, unexpected()) == Lookup::Miss);
+    BOOST_CHECK(cache.lookup("key", answer, onPending) == Lookup::Pending);
+    BOOST_CHECK(cache.lookup("key", answer, onPending) == Lookup::Pending);
+    BOOST_CHECK_EQUAL(called, 0);
+
+    BOOST_CHECK_EQUAL(cache.complete("key", HttpClientError::None, 200, Body), 2);
+    BOOST_CHECK_EQUAL(called, 2);
+
+    BOOST_CHECK(cache.lookup("key", answer, unexpected()) == Lookup::Hit);
+}
+
+BOOST_AUTO_TEST_CASE( test_capacity ) {
+    ViewabilityCache cache(2, 10.0, 2.0);
+    ViewabilityCache::Answer answer;
+
+    for (auto key: { "a", "b" }) {
+        cache.lookup(key, answer, unexpected());
+        cache.complete(key, HttpClientError::None, 200, Body);
+    }
+
+    /* Touching a makes b the least recently used */
+    BOOST_CHECK(cache.lookup("a", answer, unexpected()) == Lookup::Hit);
+
+    cache.lookup("c", answer, unexpected());
+    cache.complete("c", HttpClientError::None, 200, Body);
+
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+    BOOST_CHECK(cache.lookup("a", answer, unexpected()) == Lookup::Hit);
+    BOOST_CHECK(cache.lookup("c", answer, unexpected()) == Lookup::Hit);
+    BOOST_CHECK(cache.lookup("b", answer, unexpected()) == Lookup::Miss);
+
+    ViewabilityCache disabled(0, 10.0, 2.0);
+    disabled.lookup("a", answer, unexpected());
+    disabled.complete("a", HttpClientError::None, 200, Body);
+    BOOST_CHECK_EQUAL(disabled.size(), 0);
+}
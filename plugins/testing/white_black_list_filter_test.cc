@@ -15,6 +15,7 @@
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "rtbkit/common/bid_request.h"
 #include "soa/types/url.h"
+#include "jml/utils/filter_streams.h"
 
 using namespace RTBKIT;
 using namespace JamLoop;
@@ -203,3 +204,95 @@ BOOST_AUTO_TEST_CASE( empty_white_list ) {
     doCheck(br0, "bad", { });
     doCheck(br1, "good", { 0, 1 });
 }
+
+BOOST_AUTO_TEST_CASE( remove_config )
+{
+    WhiteBlackListFilter filter;
+    ConfigSet configMask;
+
+    auto doCheck = [&] (
+            BidRequest& request,
+            const string& exchangeName,
+            const initializer_list<size_t>& expected)
+    {
+        check(filter, request, exchangeName, configMask, expected);
+    };
+
+    auto c0 = makeConfig({ "good.com", "nytimes.com/info" }, { "bad.com" });
+    auto c1 = makeConfig({ "good.com", "other.com" }, { });
+    auto c2 = makeConfig({ }, { "bad.com", "nytimes.com/site" });
+
+    addConfig(filter, 0, c0);   configMask.set(0);
+    addConfig(filter, 1, c1);   configMask.set(1);
+    addConfig(filter, 2, c2);   configMask.set(2);
+
+    auto br0 = makeBr("http://www.nytimes.com/info/index.html", Level::Url);
+    auto br1 = makeBr("good.com", Level::Site);
+    auto br2 = makeBr("other.com", Level::Site);
+
+    doCheck(br0, "nytimes", { 0, 2 });
+    doCheck(br1, "good", { 0, 1, 2 });
+
+    // A clone shares the index until one of them changes
+    std::unique_ptr<FilterBase> clone(filter.clone());
+    const ConfigSet allConfigs = configMask;
+
+    removeConfig(filter, 1, c1);   configMask.reset(1);
+    doCheck(br1, "good", { 0, 2 });
+    doCheck(br2, "other", { 2 });
+    BOOST_CHECK_EQUAL(filter.getIndex().domains(), 3);
+
+    check(*clone, br2, "other", allConfigs, { 1, 2 });
+
+    removeConfig(filter, 0, c0);
+    removeConfig(filter, 2, c2);
+    BOOST_CHECK_EQUAL(filter.getIndex().domains(), 0);
+    BOOST_CHECK_EQUAL(filter.getIndex().distinctSets(), 1);
+    check(filter, br0, "none", allConfigs, { 0, 1, 2 });
+}
+
+BOOST_AUTO_TEST_CASE( shared_lists )
+{
+    const std::string whiteFile = "white_black_list_white.txt";
+    const std::string blackFile = "white_black_list_black.txt";
+
+    {
+        ML::filter_ostream white(whiteFile);
+        white << "good.com" << std::endl << "nytimes.com/info" << std::endl;
+        ML::filter_ostream black(blackFile);
+        black << "bad.com" << std::endl;
+    }
+
+    Json::Value json;
+    json["whiteFile"] = whiteFile;
+    json["blackFile"] = blackFile;
+
+    AgentConfig c0, c1;
+    c0.whiteBlackList.createFromJson(json);
+    c1.whiteBlackList.createFromJson(json);
+
+    // Both configs use the same copy of the lists
+    BOOST_CHECK_EQUAL(&c0.whiteBlackList.whiteList(), &c1.whiteBlackList.whiteList());
+    BOOST_CHECK_EQUAL(c0.whiteBlackList.whiteList().size(), 2);
+    BOOST_CHECK_EQUAL(c0.whiteBlackList.blackList().size(), 1);
+
+    // Adding to a shared list doesn't change the others
+    c1.whiteBlackList.addWhite("other.com");
+    BOOST_CHECK_EQUAL(c0.whiteBlackList.whiteList().size(), 2);
+    BOOST_CHECK_EQUAL(c1.whiteBlackList.whiteList().size(), 3);
+
+    WhiteBlackListFilter filter;
+    ConfigSet configMask;
+    addConfig(filter, 0, c0);   configMask.set(0);
+    addConfig(filter, 1, c1);   configMask.set(1);
+
+    // good.com, nytimes.com, bad.com and other.com
+    BOOST_CHECK_EQUAL(filter.getIndex().domains(), 4);
+
+    auto br0 = makeBr("good.com", Level::Site);
+    auto br1 = makeBr("other.com", Level::Site);
+    auto br2 = makeBr("http://nytimes.com/info/today", Level::Url);
+    check(filter, br0, "good", configMask, { 0, 1 });
+    check(filter, br1, "other", configMask, { 1 });
+    check(filter, br2, "nytimes", configMask, { 0, 1 });
+}
@@ -36,36 +36,55 @@ namespace {
      * We use that score to determine whether an impression is viewable or not if is unknown to the
      * go service
     */
-    ExchangeViewability getExchangeViewability(const std::shared_ptr<RTBKIT::BidRequest>& br, int threshold) {
+    struct ExchangeSignal {
+        ExchangeSignal() : viewability(ExchangeViewability::Unknown), score(-1) {}
+
+        /* BrightRoll says whether the impression is viewable */
+        ExchangeViewability viewability;
+        /* Adaptv sends a score that is compared to each account's threshold */
+        int score;
+    };
+
+    /* Decoded once per request: the view decodes the fields on every call */
+    ExchangeSignal getExchangeSignal(const RTBKIT::BidRequestView& br, const std::string& exchange) {
+        ExchangeSignal signal;
+
         /* BrightRoll sends an int inside the ext of the BR */
-        if (br->exchange == "brightroll") {
-            auto ext = br->ext;
+        if (exchange == "brightroll") {
+            auto ext = br.ext();
             if (ext.isMember("viewability")) {
                 auto viewability = ext["viewability"].asInt();
                 switch (viewability) {
                     case 1:
-                        return ExchangeViewability::Viewable;
+                        signal.viewability = ExchangeViewability::Viewable;
+                        break;
                     case 2:
-                        return ExchangeViewability::NonViewable;
+                        signal.viewability = ExchangeViewability::NonViewable;
+                        break;
                 }
             }
-        } else if (br->exchange == "adaptv") {
+        } else if (exchange == "adaptv") {
             /* Adaptv sends only one impression and puts the viewability flag inside
              * the ext of the video object */
-            const auto& spot = br->imp[0];
+            auto imp = br.imp();
+            const auto& spot = imp[0];
             auto ext = spot.video->ext;
-            if (ext.isMember("viewability")) {
-                auto score = ext["viewability"].asInt();
-                if (score > -1) {
-                    if (score >= threshold)
-                        return ExchangeViewability::Viewable;
-                    else
-                        return ExchangeViewability::NonViewable;
-                }
-            }
+            if (ext.isMember("viewability"))
+                signal.score = ext["viewability"].asInt();
+        }
+
+        return signal;
+    }
+
+    ExchangeViewability getExchangeViewability(const ExchangeSignal& signal, int threshold) {
+        if (signal.score > -1) {
+            if (signal.score >= threshold)
+                return ExchangeViewability::Viewable;
+            else
+                return ExchangeViewability::NonViewable;
         }
 
-        return ExchangeViewability::Unknown;
+        return signal.viewability;
     }
 }
 
@@ -74,6 +93,7 @@ ViewabilityAugmentor::ViewabilityAugmentor(
     string serviceName)
     : AsyncAugmentor(
         ViewabilityAugmentor::Name, std::move(serviceName), std::move(proxies))
+    , goLatencyUs(0)
 {
 }
 
@@ -84,6 +104,7 @@ ViewabilityAugmentor(
         string serviceName)
 : AsyncAugmentor(
         ViewabilityAugmentor::Name, std::move(serviceName), parent)
+    , goLatencyUs(0)
 {
 }
 
@@ -91,6 +112,7 @@ ViewabilityAugmentor(
 void
 ViewabilityAugmentor::init(int nthreads)
 {
+    setRequestFields({ BRF_EXCHANGE, BRF_URL, BRF_EXT, BRF_IMP, BRF_SITE });
     AsyncAugmentor::init(nthreads);
     agentConfig = std::make_shared<AgentConfigurationListener>(getZmqContext());
     agentConfig->init(getServices()->config);
@@ -105,6 +127,18 @@ ViewabilityAugmentor::useGoView(const std::string& baseUrl)
     addSource("ViewabilityAugmentor::httpClient", httpClient);
 }
 
+void
+ViewabilityAugmentor::useCache(size_t capacity, double ttl, double negativeTtl)
+{
+    cache = std::make_shared<ViewabilityCache>(capacity, ttl, negativeTtl);
+}
+
+void
+ViewabilityAugmentor::recordLatencySaved()
+{
+    recordOutcome(goLatencyUs.load(std::memory_order_relaxed) / 1000.0, "cache.latencySavedMs");
+}
+
 void
 ViewabilityAugmentor::onRequest(
         const AugmentationRequest& request,
@@ -138,9 +172,10 @@ ViewabilityAugmentor::onRequest(
         AugmentationList emptyResult;
         Scope_Failure(sendResponse(emptyResult));
 
-        const auto& br = request.bidRequest;
-        if (br->ext.isMember("inventoryType")) {
-            auto type = br->ext["inventoryType"].asString();
+        const auto& br = request.view;
+        auto ext = br.ext();
+        if (ext.isMember("inventoryType")) {
+            auto type = ext["inventoryType"].asString();
             if (type == "highviewable") {
                 AugmentationList result;
 
@@ -162,35 +197,95 @@ ViewabilityAugmentor::onRequest(
 
         if (httpClient) {
 
-            auto& imp = br->imp[0];
+            auto imps = br.imp();
+            auto& imp = imps[0];
             auto w = imp.formats[0].width;
+            auto exchange = br.exchange();
+            auto site = br.site();
+
+            std::string publisher;
+            std::string position;
 
             Json::Value payload(Json::objectValue);
-            payload["exchange"] = br->exchange;
-            if (br->site && br->site->publisher) {
-                payload["publisher"] = br->site->publisher->id.toString();
+            payload["exchange"] = exchange;
+            if (site && site->publisher) {
+                publisher = site->publisher->id.toString();
+                payload["publisher"] = publisher;
             }
-            payload["url"] = br->url.toString();
+            payload["url"] = br.url().toString();
             payload["w"] = w;
             if (imp.video) {
-                payload["position"] = adPosition(imp.video->pos);
+                position = adPosition(imp.video->pos);
+                payload["position"] = position;
             }
 
+            std::string key;
+            if (cache) {
+                key = ViewabilityCache::makeKey(
+                        exchange, publisher, payload["url"].asString(), w, position);
+
+                auto onCoalesced = [=](HttpClientError error, int status, std::string&& body) {
+                    sendResponse(handleHttpResponse(
+                            request, error, status, std::move(body)));
+                };
+
+                ViewabilityCache::Answer answer;
+                switch (cache->lookup(key, answer, onCoalesced)) {
+                    case ViewabilityCache::Lookup::Hit:
+                        recordHit("cache.hit");
+                        if (answer.negative())
+                            recordHit("cache.negativeHit");
+                        recordLatencySaved();
+                        sendResponse(handleHttpResponse(
+                                request, HttpClientError::None,
+                                answer.statusCode, std::move(answer.body)));
+                        return;
+                    case ViewabilityCache::Lookup::Pending:
+                        recordHit("cache.coalesced");
+                        recordLatencySaved();
+                        return;
+                    case ViewabilityCache::Lookup::Miss:
+                        recordHit("cache.miss");
+                        break;
+                }
+            }
+
+            /* Whatever was coalesced behind us must not wait forever */
+            Scope_Failure(if (cache) cache->complete(key, HttpClientError::Unknown, 0, ""));
+
+            Date start = Date::now();
             auto onResponse =
                 std::make_shared<HttpClientSimpleCallbacks>(
                         [=](const HttpRequest& req, HttpClientError error,
                             int status, std::string&&, std::string&& body)
                 {
+                    if (error == HttpClientError::None) {
+                        double us = Date::now().secondsSince(start) * 1e6;
+                        uint64_t avg = goLatencyUs.load(std::memory_order_relaxed);
+                        goLatencyUs.store(
+                                avg ? (avg * 7 + us) / 8 : us, std::memory_order_relaxed);
+                    }
+
+                    if (cache)
+                        cache->complete(key, error, status, body);
+
                     sendResponse(handleHttpResponse(
                             request, error, status, std::move(body)));
 
                 });
 
-            httpClient->post("/viewability", onResponse,
+            bool queued = httpClient->post("/viewability", onResponse,
                     HttpRequest::Content(payload),
                     { } /* queryParams */,
                     { } /* headers */,
                     1);
+
+            if (!queued) {
+                if (cache)
+                    cache->complete(key, HttpClientError::Unknown, 0, "");
+                sendResponse(handleHttpResponse(
+                        request, HttpClientError::Unknown, 0, ""));
+            }
         }
     } catch (const std::exception& e) {
         LOG(Logs::error) << "Error when processing BidRequest: " << e.what() << endl;
@@ -271,6 +366,13 @@ ViewabilityAugmentor::handleHttpResponse(
             lookupStage = response.get("stage", "").asString();
         }
 
+        std::string exchange;
+        ExchangeSignal exchangeSignal;
+        if (statusCode == 204) {
+            exchange = augRequest.view.exchange();
+            exchangeSignal = getExchangeSignal(augRequest.view, exchange);
+        }
+
         for (const auto& agent: augRequest.agents) {
             const AgentConfigEntry& configEntry = agentConfig->getAgentEntry(agent);
             if (!configEntry.valid()) continue;
@@ -305,13 +407,11 @@ ViewabilityAugmentor::handleHttpResponse(
                 if (statusCode == 204) {
                     recordHit("accounts.%s.lookup.NoHit", account.toString());
 
-                    const auto& br = augRequest.bidRequest;
-
                     auto recordExchangeResult = [&](const char* result) {
-                        recordHit("accounts.%s.result.%s.%s", account.toString(), br->exchange, result);
+                        recordHit("accounts.%s.result.%s.%s", account.toString(), exchange, result);
                     };
 
-                    auto ev = getExchangeViewability(br, viewableRateThreshold);
+                    auto ev = getExchangeViewability(exchangeSignal, viewableRateThreshold);
                     if (ev == ExchangeViewability::Viewable) {
                         result[account].tags.insert("pass-viewability");
 
@@ -408,3 +508,30 @@ ViewabilityAugmentor::handleHttpResponse(
 }
 
 } // namespace JamLoop
+
+namespace {
+
+struct Init {
+    Init() {
+        PluginInterface<HostedAugmentor>::registerPlugin(JamLoop::ViewabilityAugmentor::Name,
+                [](std::string serviceName,
+                   std::shared_ptr<ServiceProxies> proxies,
+                   const Json::Value& config) {
+                auto augmentor = new JamLoop::ViewabilityAugmentor(
+                        std::move(proxies), std::move(serviceName));
+                augmentor->init(1);
+
+                auto goViewUrl = config["goViewUrl"].asString();
+                if (!goViewUrl.empty()) {
+                    augmentor->useGoView(goViewUrl);
+                    augmentor->useCache(
+                            config.get("cacheCapacity", Json::UInt(JamLoop::CacheDefault::Capacity)).asUInt(),
+                            config.get("cacheTtl", JamLoop::CacheDefault::Ttl).asDouble(),
+                            config.get("negativeCacheTtl", JamLoop::CacheDefault::NegativeTtl).asDouble());
+                }
+                return augmentor;
+        });
+    }
+} init;
+
+}
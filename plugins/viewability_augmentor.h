@@ -13,6 +13,8 @@
 #include "soa/logger/logger.h"
 #include "soa/service/logs.h"
 #include "soa/service/http_client.h"
+#include "viewability_cache.h"
+#include <atomic>
 
 namespace JamLoop {
 
@@ -32,6 +34,11 @@ public:
     void init(int nthreads);
     void useGoView(const std::string& baseUrl);
 
+    /* Caches the answers of the go service for ttl seconds, negativeTtl for
+     * the unknown ones, and coalesces the lookups of a same key
+    */
+    void useCache(size_t capacity, double ttl, double negativeTtl);
+
 private:
     struct Logs {
         static Datacratic::Logging::Category print;
@@ -48,8 +55,16 @@ private:
             const RTBKIT::AugmentationRequest& request,
             Datacratic::HttpClientError error, int statusCode, std::string&& body);
 
+    void recordLatencySaved();
+
     std::shared_ptr<RTBKIT::AgentConfigurationListener> agentConfig;
     std::shared_ptr<Datacratic::HttpClient> httpClient;
+    std::shared_ptr<ViewabilityCache> cache;
+
+    /* Moving average of the go service latency in microseconds, which is
+     * what a cache hit saves
+    */
+    std::atomic<uint64_t> goLatencyUs;
 
 };
 
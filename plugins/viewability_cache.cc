@@ -0,0 +1,137 @@
+/* viewability_cache.cc
+   Copyright (c) 2015 Datacratic.  All rights reserved.
+
+   Implementation of the viewability cache
+*/
+
+#include "viewability_cache.h"
+
+using namespace std;
+using namespace Datacratic;
+
+namespace JamLoop {
+
+ViewabilityCache::ViewabilityCache(size_t capacity, double ttl, double negativeTtl)
+    : capacity(capacity)
+    , ttl(ttl)
+    , negativeTtl(negativeTtl)
+{
+}
+
+std::string
+ViewabilityCache::makeKey(
+        const std::string& exchange, const std::string& publisher,
+        const std::string& url, int width, const std::string& position)
+{
+    /* The unit separator can't appear in any of the fields */
+    static constexpr char Sep = '\x1f';
+
+    std::string key;
+    key.reserve(exchange.size() + publisher.size() + url.size() + position.size() + 16);
+    key += exchange;
+    key += Sep;
+    key += publisher;
+    key += Sep;
+    key += url;
+    key += Sep;
+    key += std::to_string(width);
+    key += Sep;
+    key += position;
+    return key;
+}
+
+ViewabilityCache::Lookup
+ViewabilityCache::lookup(
+        const std::string& key, Answer& answer, Callback onPending, Date now)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        Entry& entry = it->second;
+        if (now < entry.expiry) {
+            lru.splice(lru.begin(), lru, entry.lru);
+            answer = entry.answer;
+            return Lookup::Hit;
+        }
+
+        lru.erase(entry.lru);
+        entries.erase(it);
+    }
+
+    auto pending = inFlight.find(key);
+    if (pending != inFlight.end()) {
+        pending->second.push_back(std::move(onPending));
+        return Lookup::Pending;
+    }
+
+    inFlight[key];
+    return Lookup::Miss;
+}
+
+size_t
+ViewabilityCache::complete(
+        const std::string& key,
+        HttpClientError error, int statusCode, const std::string& body,
+        Date now)
+{
+    std::vector<Callback> waiting;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto it = inFlight.find(key);
+        if (it != inFlight.end()) {
+            waiting = std::move(it->second);
+            inFlight.erase(it);
+        }
+
+        /* Errors are not cached so that the next lookup tries again */
+        if (error == HttpClientError::None && (statusCode == 200 || statusCode == 204))
+            insert(key, Answer(statusCode, body), now);
+    }
+
+    for (auto& callback: waiting) {
+        std::string copy(body);
+        callback(error, statusCode, std::move(copy));
+    }
+
+    return waiting.size();
+}
+
+void
+ViewabilityCache::insert(const std::string& key, Answer answer, Date now)
+{
+    if (capacity == 0) return;
+
+    Date expiry = now.plusSeconds(answer.negative() ? negativeTtl : ttl);
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        it->second.answer = std::move(answer);
+        it->second.expiry = expiry;
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return;
+    }
+
+    while (entries.size() >= capacity) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+
+    lru.push_front(key);
+
+    Entry& entry = entries[key];
+    entry.answer = std::move(answer);
+    entry.expiry = expiry;
+    entry.lru = lru.begin();
+}
+
+size_t
+ViewabilityCache::size() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
+
+} // namespace JamLoop
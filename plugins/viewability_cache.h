@@ -0,0 +1,103 @@
+/* viewability_cache.h
+   Copyright (c) 2015 Datacratic.  All rights reserved.
+
+   Bounded cache of the go viewability service answers which also coalesces
+   the lookups of a key that is already being fetched
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/service/http_client.h"
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace JamLoop {
+
+namespace CacheDefault {
+    static constexpr size_t Capacity = 100000;
+    static constexpr double Ttl = 300.0;
+    static constexpr double NegativeTtl = 60.0;
+}
+
+class ViewabilityCache {
+public:
+
+    /* A 204 is the go service's way to say that the url is unknown to it
+     * and is cached as a negative entry
+    */
+    struct Answer {
+        Answer()
+            : statusCode(0)
+        { }
+
+        Answer(int statusCode, std::string body)
+            : statusCode(statusCode)
+            , body(std::move(body))
+        { }
+
+        bool negative() const { return statusCode == 204; }
+
+        int statusCode;
+        std::string body;
+    };
+
+    typedef std::function<
+        void (Datacratic::HttpClientError error, int statusCode, std::string&& body)
+    > Callback;
+
+    enum class Lookup {
+        Hit,      // answer was filled from the cache
+        Pending,  // the key is being fetched and the callback will be called with its result
+        Miss      // the caller must fetch the key and call complete()
+    };
+
+    /* A capacity of 0 disables the caching but lookups are still coalesced */
+    ViewabilityCache(size_t capacity, double ttl, double negativeTtl);
+
+    static std::string makeKey(
+            const std::string& exchange, const std::string& publisher,
+            const std::string& url, int width, const std::string& position);
+
+    /* On a Miss, the key is marked in-flight and onPending will be called
+     * for every other lookup of the key until complete() is called
+    */
+    Lookup lookup(
+            const std::string& key, Answer& answer, Callback onPending,
+            Datacratic::Date now = Datacratic::Date::now());
+
+    /* Stores the answer of a fetch if it is cacheable and calls back every
+     * lookup that was coalesced behind it. Returns how many there were.
+    */
+    size_t complete(
+            const std::string& key,
+            Datacratic::HttpClientError error, int statusCode, const std::string& body,
+            Datacratic::Date now = Datacratic::Date::now());
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        Answer answer;
+        Datacratic::Date expiry;
+        std::list<std::string>::iterator lru;
+    };
+
+    void insert(const std::string& key, Answer answer, Datacratic::Date now);
+
+    size_t capacity;
+    double ttl;
+    double negativeTtl;
+
+    mutable std::mutex lock;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // most recently used first
+    std::unordered_map<std::string, std::vector<Callback>> inFlight;
+};
+
+} // namespace JamLoop
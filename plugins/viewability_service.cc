@@ -9,6 +9,9 @@ namespace JamLoop {
 
     namespace Default {
         static constexpr int AugmentorThreads = 4;
+        static constexpr size_t CacheCapacity = CacheDefault::Capacity;
+        static constexpr double CacheTtl = CacheDefault::Ttl;
+        static constexpr double NegativeCacheTtl = CacheDefault::NegativeTtl;
     }
 
     boost::program_options::options_description
@@ -19,7 +22,13 @@ namespace JamLoop {
         options_description goView("Go Viewabilitty service options");
         goView.add_options()
         ("goview-url", value<string>(&goViewUrl),
-            "Base URL of the go viewability service");
+            "Base URL of the go viewability service")
+        ("cache-capacity", value<size_t>(&cacheCapacity)->default_value(Default::CacheCapacity),
+            "Maximum number of go viewability answers to cache (0 to disable)")
+        ("cache-ttl", value<double>(&cacheTtl)->default_value(Default::CacheTtl),
+            "Seconds during which a go viewability answer is cached")
+        ("negative-cache-ttl", value<double>(&negativeCacheTtl)->default_value(Default::NegativeCacheTtl),
+            "Seconds during which an unknown go viewability answer is cached");
 
         options_description commonOptions("Common Options");
         commonOptions.add_options()
@@ -61,6 +70,8 @@ namespace JamLoop {
 
         if (!config.goViewUrl.empty()) {
             augmentor->useGoView(config.goViewUrl);
+            augmentor->useCache(
+                    config.cacheCapacity, config.cacheTtl, config.negativeCacheTtl);
         }
 
     }
@@ -25,6 +25,10 @@ public:
         unsigned augmentorThreads;
         std::string goViewUrl;
 
+        size_t cacheCapacity;
+        double cacheTtl;
+        double negativeCacheTtl;
+
     };
 
     void setConfig(const Config& config);
@@ -117,7 +117,7 @@ struct AccountKey : public AccountKeyBase {
     uint64_t hash() const
     {
         uint64_t res = 1232134;
-        for (auto s: *this)
+        for (const auto & s: *this)
             res = CityHash64WithSeed(s.c_str(), s.size(), res);
         return res;
     }
@@ -7,10 +7,14 @@
 
 #include <iostream>
 #include <functional>
+#include <algorithm>
 
 #include "analytics_publisher.h"
 #include "soa/jsoncpp/value.h"
 #include "soa/jsoncpp/reader.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 using namespace std;
 using namespace Datacratic;
@@ -19,10 +23,32 @@ using namespace Datacratic;
 /* ANALYTICS PUBLISHER                                                          */
 /********************************************************************************/
 
+AnalyticsPublisher::
+AnalyticsPublisher()
+    : initialized(false), numDropped(0), live(false), compress(false),
+      channelFilter(new ChannelFilter()),
+      generation(nextGeneration.fetch_add(1))
+{
+}
+
+std::atomic<uint64_t> AnalyticsPublisher::nextGeneration(0);
+
+AnalyticsPublisher::
+~AnalyticsPublisher()
+{
+    shutdown();
+
+    gc.deferBarrier();
+    delete channelFilter.load();
+}
+
 void
 AnalyticsPublisher::
-init(const string & baseUrl, const int numConnections)
+init(const string & baseUrl, const int numConnections,
+     double flushInterval, bool compress)
 {
+    this->compress = compress;
+
     client = make_shared<HttpClient>(baseUrl, numConnections);
     client->sendExpect100Continue(false);
     addSource("analytics::client", client);
@@ -38,6 +64,11 @@ init(const string & baseUrl, const int numConnections)
     };
     addPeriodic("analytics::syncFilters", 10.0, syncFilters);
 
+    auto flushBatches = [&] (uint64_t wakeups) {
+        flush();
+    };
+    addPeriodic("analytics::flush", flushInterval, flushBatches);
+
     initialized = true;
 }
 
@@ -55,11 +86,80 @@ shutdown()
     MessageLoop::shutdown();
 }
 
+AnalyticsPublisher::Batch *
+AnalyticsPublisher::
+newBatch()
+{
+    std::unique_ptr<Batch> batch(new Batch());
+    currentBatch.reset(new BatchRef { generation, batch.get() });
+
+    std::lock_guard<std::mutex> guard(batchesLock);
+    batches.push_back(std::move(batch));
+    return batches.back().get();
+}
+
+void
+AnalyticsPublisher::
+escape(string & events, size_t start)
+{
+    size_t first = events.find_first_of("\\\n", start);
+    if (first == string::npos) return;
+
+    string escaped;
+    for (size_t pos = first;  pos < events.size();  ++pos) {
+        char c = events[pos];
+        if (c == '\n') escaped += "\\n";
+        else if (c == '\\') escaped += "\\\\";
+        else escaped += c;
+    }
+
+    events.resize(first);
+    events += escaped;
+}
+
+void
+AnalyticsPublisher::
+flush()
+{
+    vector<Batch *> toFlush;
+    {
+        std::lock_guard<std::mutex> guard(batchesLock);
+        toFlush.reserve(batches.size());
+        for (auto & batch : batches)
+            toFlush.push_back(batch.get());
+    }
+
+    // Each batch gets back the (empty) buffer of the one before it so that
+    // the publishing threads keep reusing the memory they already have.
+    string spare;
+    for (Batch * batch : toFlush) {
+        {
+            std::lock_guard<ML::Spinlock> guard(batch->lock);
+            batch->events.swap(spare);
+        }
+        sending.append(spare);
+        spare.clear();
+    }
+
+    if (sending.empty()) return;
+
+    size_t numEvents = std::count(sending.begin(), sending.end(), '\n');
+
+    if (!live) {
+        numDropped += numEvents;
+        sending.clear();
+        return;
+    }
+
+    sendEvents(std::move(sending), numEvents);
+    sending.clear();
+}
+
 void
 AnalyticsPublisher::
-sendEvent(const string & channel, const string & event)
+sendEvents(string && body, size_t numEvents)
 {
-    auto onResponse = [] (const HttpRequest & rq,
+    auto onResponse = [=] (const HttpRequest & rq,
             HttpClientError error,
             int status,
             string && headers,
@@ -68,14 +168,29 @@ sendEvent(const string & channel, const string & event)
         if (status != 200) {
             cout << "status: " << status << endl
                  << "error: " << error << endl;
+            numDropped += numEvents;
         }
     };
-    string ressource("/v1/event");
+    string ressource("/v1/events");
     auto const & cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
-    Json::Value payload(Json::objectValue);
-    payload["channel"] = channel;
-    payload["event"] = event;
-    client->post(ressource, cbs, payload);
+
+    RestParams headers;
+    if (compress) {
+        string compressed;
+        {
+            namespace io = boost::iostreams;
+            io::filtering_ostream stream;
+            stream.push(io::gzip_compressor());
+            stream.push(io::back_inserter(compressed));
+            stream.write(body.data(), body.size());
+        }
+        body = std::move(compressed);
+        headers.push_back(make_pair("Content-Encoding", "gzip"));
+    }
+
+    HttpRequest::Content content(body, "text/plain");
+    if (!client->post(ressource, cbs, content, RestParams(), headers))
+        numDropped += numEvents;
 }
 
 void
@@ -114,10 +229,14 @@ syncChannelFilters()
         if (status != 200) return;
         Json::Value filters = Json::parse(body);
         if (filters.isObject()) {
-            std::lock_guard<std::mutex> lock(mu);
+            // Only ever replaced from the message loop
+            const ChannelFilter * current = channelFilter.load();
+            std::unique_ptr<ChannelFilter> newFilter(new ChannelFilter(*current));
             for ( auto it = filters.begin(); it != filters.end(); ++it) {
-                channelFilter[it.memberName()] = (*it).asBool();
+                (*newFilter)[it.memberName()] = (*it).asBool();
             }
+            channelFilter = newFilter.release();
+            gc.defer([=] { delete current; });
         }
     };
     if (!live) return;
@@ -7,13 +7,22 @@
 #pragma once
 
 #include <string>
-#include <sstream>
+#include <ostream>
+#include <streambuf>
 #include <unordered_map>
 #include <utility>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/thread/tss.hpp>
 
 #include "soa/service/message_loop.h"
 #include "soa/service/http_client.h"
 #include "soa/service/service_utils.h"
+#include "soa/gc/gc_lock.h"
+#include "jml/arch/spinlock.h"
 
 typedef std::unordered_map< std::string, bool > ChannelFilter;
 
@@ -21,11 +30,24 @@ typedef std::unordered_map< std::string, bool > ChannelFilter;
 /* ANALYTICS PUBLISHER                                                          */
 /********************************************************************************/
 
+/** Publishing doesn't send anything by itself: each thread serializes its
+    events into its own batch, and the message loop sends everything that
+    was batched to the /v1/events route every flush interval, one event per
+    line as "channel<TAB>event".  Newlines and backslashes in the events are
+    escaped with a backslash.
+*/
+
 struct AnalyticsPublisher : public Datacratic::MessageLoop {
 
-    AnalyticsPublisher() : initialized(false) {}
+    AnalyticsPublisher();
 
-    void init(const std::string & baseUrl, const int numConnections);
+    ~AnalyticsPublisher();
+
+    /** Batches are sent every flushInterval seconds, gzipped if compress is
+        set.
+    */
+    void init(const std::string & baseUrl, const int numConnections,
+              double flushInterval = 0.1, bool compress = false);
     bool initialized;
 
     void start();
@@ -34,41 +56,145 @@ struct AnalyticsPublisher : public Datacratic::MessageLoop {
 
     void syncChannelFilters();
 
+    /** Whether events published on the channel are sent anywhere.  Lets
+        callers skip building expensive arguments.
+    */
+    bool isChannelEnabled(const std::string & channel) const
+    {
+        if (!live) return false;
+
+        Datacratic::GcLockBase::SharedGuard
+            guard(gc, Datacratic::GcLockBase::RD_NO);
+        const ChannelFilter * filter = channelFilter.load();
+        auto it = filter->find(channel);
+        return it != filter->end() && it->second;
+    }
+
     template<typename... Args>
     void publish(const std::string & channel, const Args & ... args)
     {
-        if (!live) return;
+        if (!isChannelEnabled(channel)) return;
 
-        std::lock_guard<std::mutex> lock(mu);
-        auto it = channelFilter.find(channel);
-        if (it == channelFilter.end() || !it->second) return;
+        Batch & batch = threadBatch();
 
-        std::stringstream ss;
-        make_message(ss, args...);
-        sendEvent(channel, ss.str());
+        // Only ever contended by flush(), once per flush interval
+        std::lock_guard<ML::Spinlock> guard(batch.lock);
+
+        batch.events.append(channel);
+        batch.events.push_back('\t');
+        size_t start = batch.events.size();
+        make_message(batch.stream, args...);
+        escape(batch.events, start);
+        batch.events.push_back('\n');
     }
 
+    /** Send everything that was batched so far.  Called periodically from
+        the message loop.
+    */
+    void flush();
+
+    /** Number of events that were dropped because the endpoint wasn't
+        reachable, the client's queue was full or the endpoint didn't
+        answer with a 200.
+    */
+    std::atomic<uint64_t> numDropped;
+
 private:
-    std::mutex mu;
     std::shared_ptr<Datacratic::HttpClient> client;
-    bool live;
-    ChannelFilter channelFilter;
+    std::atomic<bool> live;
+    bool compress;
+
+    /** Enabled channels.  Replaced as a whole when they are synced, and
+        read under the GC lock.
+    */
+    std::atomic<const ChannelFilter *> channelFilter;
+    mutable Datacratic::GcLock gc;
+
+    /** Stream buffer which appends everything to a string. */
+    struct AppendBuffer : public std::streambuf {
+        AppendBuffer(std::string & out)
+            : out(out)
+        {
+        }
+
+        virtual int_type overflow(int_type c)
+        {
+            if (c != traits_type::eof())
+                out.push_back(c);
+            return c;
+        }
+
+        virtual std::streamsize xsputn(const char * s, std::streamsize n)
+        {
+            out.append(s, n);
+            return n;
+        }
+
+        std::string & out;
+    };
+
+    struct Batch {
+        Batch()
+            : buffer(events), stream(&buffer)
+        {
+        }
+
+        ML::Spinlock lock;
+        std::string events;
+        AppendBuffer buffer;
+        std::ostream stream;
+    };
+
+    Batch & threadBatch()
+    {
+        BatchRef * ref = currentBatch.get();
+        if (!ref || ref->generation != generation) return *newBatch();
+        return *ref->batch;
+    }
+
+    Batch * newBatch();
+
+    /** The thread's pointer to its batch, which it doesn't own.  Tagged
+        with the publisher's generation since the thread specific storage
+        is keyed by address: a publisher allocated where a destroyed one
+        was would otherwise pick up the batches that went with it.
+    */
+    struct BatchRef {
+        uint64_t generation;
+        Batch * batch;
+    };
 
-    void sendEvent(const std::string & channel, const std::string & event);
+    /** Batch of the calling thread.  The batches are owned by the publisher
+        so that what a thread published is still sent after it exits.
+    */
+    boost::thread_specific_ptr<BatchRef> currentBatch;
+    const uint64_t generation;
+    static std::atomic<uint64_t> nextGeneration;
+
+    std::mutex batchesLock;
+    std::vector<std::unique_ptr<Batch> > batches;
+
+    /** Only used by flush() which runs in the message loop. */
+    std::string sending;
+
+    void sendEvents(std::string && body, size_t numEvents);
 
     void checkHeartbeat();
 
+    /** Escape the newlines and backslashes appended since start. */
+    static void escape(std::string & events, size_t start);
+
     template<typename Head>
-    void make_message(std::stringstream & ss, const Head & head)
+    void make_message(std::ostream & stream, const Head & head)
     {
-        ss << head;
+        stream << head;
     }
 
     template<typename Head, typename... Tail>
-    void make_message(std::stringstream & ss, const Head & head, const Tail & ... tail)
+    void make_message(std::ostream & stream, const Head & head, const Tail & ... tail)
     {
-        ss << head << " ";
-        make_message(ss, tail...);
+        stream << head << " ";
+        make_message(stream, tail...);
     }
 
 };
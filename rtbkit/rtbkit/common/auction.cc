@@ -6,6 +6,7 @@
 */
 
 #include "rtbkit/common/auction.h"
+#include "rtbkit/common/exchange_connector.h"
 #include "jml/arch/exception.h"
 #include "jml/arch/format.h"
 #include "jml/arch/backtrace.h"
@@ -218,7 +219,8 @@ createDescription(AuctionResponseDescription & d) {
 
 Auction::
 Auction()
-    : isZombie(false), exchangeConnector(nullptr), data(new Data())
+    : isZombie(false), exchangeConnector(nullptr), data(new Data()),
+      requestStrDone(true)
 {
 }
 
@@ -232,22 +234,74 @@ Auction(ExchangeConnector * exchangeConnector,
         Date expiry)
     : isZombie(false), start(start), expiry(expiry),
       request(request),
-      requestStr(requestStr),
-      requestStrFormat(requestStrFormat),
       exchangeConnector(exchangeConnector),
       handleAuction(handleAuction),
-      data(new Data(numSpots()))
+      data(new Data(numSpots())),
+      requestStrDone(true),
+      requestStr_(requestStr),
+      requestStrFormat_(requestStrFormat)
 {
     ML::atomic_add(created, 1);
 
     this->id = request->auctionId;
+}
+
+Auction::
+Auction(ExchangeConnector * exchangeConnector,
+        HandleAuction handleAuction,
+        std::shared_ptr<BidRequest> request,
+        std::shared_ptr<const std::string> payload,
+        const std::string & payloadFormat,
+        Date start,
+        Date expiry)
+    : isZombie(false), start(start), expiry(expiry),
+      request(request),
+      exchangeConnector(exchangeConnector),
+      handleAuction(handleAuction),
+      data(new Data(numSpots())),
+      payload(std::move(payload)),
+      payloadFormat(payloadFormat),
+      requestStrDone(false),
+      requestStrFormat_("datacratic")
+{
+    ML::atomic_add(created, 1);
 
-    auto t0 = Date::now();
-    this->requestSerialized = request->serializeToString();
-    auto t1 = Date::now();
-    if(Date::now().secondsSince(t0) > 0.5) {
-        std::cerr << "THIS MAKES THE JSON PRINTER CRY BEGIN\n" << requestStr << "\nEND\n";
+    this->id = request->auctionId;
+}
+
+std::string
+Auction::
+requestStr() const
+{
+    std::lock_guard<std::mutex> guard(requestStrLock);
+    if (!requestStrDone.load(std::memory_order_relaxed)) {
+        requestStr_ = request->toJsonStr();
+        requestStrDone.store(true, std::memory_order_release);
+
+        ML::atomic_add(requestStrEncoded, 1);
+        if (exchangeConnector)
+            exchangeConnector->recordHit("auctionRequestStrEncoded");
     }
+
+    return requestStr_;
+}
+
+std::string
+Auction::
+requestStrFormat() const
+{
+    std::lock_guard<std::mutex> guard(requestStrLock);
+    return requestStrFormat_;
+}
+
+void
+Auction::
+setRequestStr(const std::string & str, const std::string & format)
+{
+    std::lock_guard<std::mutex> guard(requestStrLock);
+    requestStr_ = str;
+    requestStrFormat_ = format;
+    requestStrDone.store(true, std::memory_order_release);
 }
 
 Auction::
@@ -266,6 +320,7 @@ Auction::
 
 long long Auction::created = 0;
 long long Auction::destroyed = 0;
+long long Auction::requestStrEncoded = 0;
 
 double
 Auction::
@@ -16,6 +16,8 @@
 #include "rtbkit/common/win_cost_model.h"
 #include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <atomic>
+#include <mutex>
 #include "soa/jsoncpp/json.h"
 #include "soa/types/date.h"
 #include "jml/arch/atomic_ops.h"
@@ -53,6 +55,19 @@ struct Auction : public std::enable_shared_from_this<Auction> {
             const std::string & requestStrFormat,
             Date start,
             Date expiry);
+
+    /** Create an auction whose stringified request is only encoded when a
+        consumer asks for it.  The payload received from the exchange is kept
+        as is and can be used instead by consumers that understand the
+        exchange's format.
+    */
+    Auction(ExchangeConnector * exchangeConnector,
+            HandleAuction handleAuction,
+            std::shared_ptr<BidRequest> request,
+            std::shared_ptr<const std::string> payload,
+            const std::string & payloadFormat,
+            Date start,
+            Date expiry);
     
     ~Auction();
 
@@ -70,9 +85,39 @@ struct Auction : public std::enable_shared_from_this<Auction> {
 
     Id id;
     std::shared_ptr<BidRequest>  request;
-    std::string requestStr;  ///< Stringified version of request
-    std::string requestStrFormat;  ///< Format of stringified request
-    std::string requestSerialized; ///< Serialized bid request (canonical)
+
+    /** Stringified version of the request.  For auctions created from an
+        exchange payload this is the canonical "datacratic" encoding, which
+        is computed the first time it's asked for and then cached.
+        Returned by value, like the format, as setRequestStr() can change
+        it while other threads hold the auction.
+    */
+    std::string requestStr() const;
+
+    /** Format of the stringified request. */
+    std::string requestStrFormat() const;
+
+    /** Payload as received from the exchange; null if the auction was
+        created from an already stringified request.
+    */
+    std::shared_ptr<const std::string> requestPayload() const
+    {
+        return payload;
+    }
+
+    const std::string & requestPayloadFormat() const
+    {
+        return payloadFormat;
+    }
+
+    /** Replace the stringified request. */
+    void setRequestStr(const std::string & str, const std::string & format);
+
+    /** Whether requestStr() has already been computed or provided */
+    bool hasRequestStr() const
+    {
+        return requestStrDone.load(std::memory_order_acquire);
+    }
 
     ///< AugmentationList for each augmentors.
     std::unordered_map<std::string, AugmentationList> augmentations;
@@ -298,10 +343,21 @@ struct Auction : public std::enable_shared_from_this<Auction> {
 private:
     Data * data;
 
+    std::shared_ptr<const std::string> payload;
+    std::string payloadFormat;
+
+    mutable std::mutex requestStrLock;
+    mutable std::atomic<bool> requestStrDone;
+    mutable std::string requestStr_;
+    std::string requestStrFormat_;
+
 public:
     /// Memory leak tracking
     static long long created;
     static long long destroyed;
+
+    /// Number of auctions for which requestStr() had to be encoded
+    static long long requestStrEncoded;
 };
 
 CREATE_CLASS_DESCRIPTION_NAMED(AuctionPriceDescription,
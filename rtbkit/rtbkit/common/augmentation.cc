@@ -185,4 +185,88 @@ fromJson(const Json::Value& json)
     return list;
 }
 
+
+/******************************************************************************/
+/* AGENT AUGMENTATIONS                                                        */
+/******************************************************************************/
+
+size_t
+AgentAugmentations::
+add(const string& agent, const AccountKey& account,
+    const Augmentations& augs)
+{
+    ExcCheck(!augmentations || augmentations == &augs,
+            "Agents added with different augmentations");
+    augmentations = &augs;
+
+    Matches matches;
+    for (const auto& aug : augs) {
+        AccountKey key = account;
+        while (true) {
+            auto it = aug.second.find(key);
+            if (it != aug.second.end()) matches.push_back(&it->second);
+
+            if (key.empty()) break;
+            key.pop_back();
+        }
+    }
+
+    size_t encoding = 0;
+    while (encoding < encodings.size()
+            && encodings[encoding].matches != matches)
+        ++encoding;
+
+    if (encoding == encodings.size()) {
+        encodings.emplace_back();
+        encodings.back().matches = std::move(matches);
+        encodings.back().account = account;
+        encodings.back().done = false;
+    }
+
+    agents.push_back(Agent{ agent, encoding });
+    return agents.size() - 1;
+}
+
+int
+AgentAugmentations::
+slot(const string& agent) const
+{
+    for (size_t i = 0; i < agents.size(); ++i)
+        if (agents[i].name == agent) return i;
+    return -1;
+}
+
+const string&
+AgentAugmentations::
+get(size_t slot) const
+{
+    const Encoding& encoding = encodings.at(agents.at(slot).encoding);
+
+    std::lock_guard<std::mutex> guard(encodeLock);
+    if (!encoding.done) {
+        Json::Value aggregatedAug;
+        for (const auto& aug : *augmentations) {
+            aggregatedAug[aug.first] =
+                aug.second.filterForAccount(encoding.account).toJson();
+        }
+
+        encoding.str = aggregatedAug.toString();
+        while (!encoding.str.empty() && encoding.str.back() == '\n')
+            encoding.str.erase(encoding.str.size() - 1);
+        encoding.done = true;
+    }
+
+    return encoding.str;
+}
+
+const string&
+AgentAugmentations::
+get(const string& agent) const
+{
+    static const string none;
+
+    int i = slot(agent);
+    return i < 0 ? none : get(i);
+}
+
 } // namespace RTBKIT
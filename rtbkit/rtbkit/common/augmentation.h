@@ -14,6 +14,9 @@
 
 #include <set>
 #include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
 
 namespace RTBKIT {
 
@@ -45,12 +48,6 @@ struct Augmentation
     static Augmentation fromJson(const Json::Value& json);
 };
 
-/** Agent name to stringified augemntation.
-    In other words, it's a collapsed version of the AumgnetationList structure.
-*/
-typedef std::map<std::string, std::string> AgentAugmentations;
-
-
 /******************************************************************************/
 /* AUGMENTATION LIST                                                          */
 /******************************************************************************/
@@ -87,6 +84,79 @@ struct AugmentationList : public AugmentationListBase
 };
 
 
+/******************************************************************************/
+/* AGENT AUGMENTATIONS                                                        */
+/******************************************************************************/
+
+/** Stringified augmentations of an auction as seen by each of the agents it
+    was sent to.  In other words, it's a collapsed version of the
+    AugmentationList of every augmentor, filtered for the account of the agent.
+
+    Agents are stored in the order they were added, which is their slot.  Most
+    bidder interfaces never send the augmentations so the string is only built
+    the first time it's asked for, and agents that see the same entries of the
+    augmentation lists share the same string.
+ */
+struct AgentAugmentations
+{
+    typedef std::unordered_map<std::string, AugmentationList> Augmentations;
+
+    AgentAugmentations() : augmentations(nullptr) {}
+
+    /** Adds the agent, filtering augmentations for the given account, and
+        returns its slot.  The augmentations must outlive this object and not
+        change anymore.
+     */
+    size_t add(const std::string& agent, const AccountKey& account,
+               const Augmentations& augmentations);
+
+    /** Slot of the given agent or -1 if it wasn't added. */
+    int slot(const std::string& agent) const;
+
+    /** Stringified augmentations of the agent in the given slot. */
+    const std::string& get(size_t slot) const;
+
+    /** Stringified augmentations of the given agent or an empty string if it
+        wasn't added.
+     */
+    const std::string& get(const std::string& agent) const;
+
+    size_t size() const { return agents.size(); }
+
+    /** Number of distinct strings; they aren't necessarily built yet. */
+    size_t numEncodings() const { return encodings.size(); }
+
+private:
+    AgentAugmentations(const AgentAugmentations&) = delete;
+    AgentAugmentations& operator=(const AgentAugmentations&) = delete;
+
+    /** Entries of the augmentation lists that apply to an account.  Since
+        the augmentations can't change, two accounts that match the same
+        entries get the same string.
+     */
+    typedef std::vector<const Augmentation*> Matches;
+
+    struct Encoding
+    {
+        Matches matches;
+        AccountKey account;
+        mutable bool done;
+        mutable std::string str;
+    };
+
+    struct Agent
+    {
+        std::string name;
+        size_t encoding;
+    };
+
+    const Augmentations* augmentations;
+    std::vector<Encoding> encodings;
+    std::vector<Agent> agents;
+    mutable std::mutex encodeLock;
+};
+
+
 } // namespace RTBKIT
 
 #endif // __rtb__augmentation_h__
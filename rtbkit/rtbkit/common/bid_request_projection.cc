@@ -0,0 +1,383 @@
+/* bid_request_projection.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Implementation of the bid request projection.
+*/
+
+#include "bid_request_projection.h"
+#include "soa/types/json_printing.h"
+#include "soa/types/value_description.h"
+#include "rtbkit/openrtb/openrtb_parsing.h"
+#include "jml/utils/string_functions.h"
+
+using namespace std;
+using namespace Datacratic;
+
+namespace RTBKIT {
+
+const std::string BidRequestProjectionFormat = "rtbkit.projection.v1";
+
+namespace {
+
+const unsigned ProjectionVersion = 1;
+
+const char * FieldNames[BRF_MAX_FIELD] = {
+    nullptr,
+    "exchange", "url", "language", "userAgent", "ipAddress", "ext",
+    "imp", "site", "app", "device", "user", "location"
+};
+
+void writeVarint(string & out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+uint64_t readVarint(const string & in, size_t & pos)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size())
+            throw ML::Exception("truncated bid request projection");
+
+        uint8_t byte = in[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw ML::Exception("invalid varint in bid request projection");
+}
+
+void writeRecord(string & out, BidRequestField field, const string & value)
+{
+    writeVarint(out, field);
+    writeVarint(out, value.size());
+    out += value;
+}
+
+template<typename T>
+string printJson(const T & value)
+{
+    static auto desc = getDefaultDescriptionShared((T *)0);
+
+    ostringstream stream;
+    StreamJsonPrintingContext context(stream);
+    desc->printJson(&value, context);
+    return stream.str();
+}
+
+template<typename T>
+void writeJson(string & out, BidRequestField field, const OpenRTB::Optional<T> & value)
+{
+    if (value) writeRecord(out, field, printJson(*value));
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* BID REQUEST FIELD                                                         */
+/*****************************************************************************/
+
+const char *
+toString(BidRequestField field)
+{
+    if (field <= 0 || field >= BRF_MAX_FIELD)
+        throw ML::Exception("unknown bid request field %d", int(field));
+    return FieldNames[field];
+}
+
+BidRequestField
+parseBidRequestField(const std::string & name)
+{
+    for (int field = 1; field < BRF_MAX_FIELD; ++field) {
+        if (name == FieldNames[field])
+            return BidRequestField(field);
+    }
+    throw ML::Exception("unknown bid request field '%s'", name.c_str());
+}
+
+
+/*****************************************************************************/
+/* BID REQUEST FIELDS                                                        */
+/*****************************************************************************/
+
+BidRequestFields::
+BidRequestFields(std::initializer_list<BidRequestField> fields)
+    : bits(0)
+{
+    for (auto field : fields) add(field);
+}
+
+std::string
+BidRequestFields::
+toString() const
+{
+    string result;
+    for (int field = 1; field < BRF_MAX_FIELD; ++field) {
+        if (!has(BidRequestField(field))) continue;
+        if (!result.empty()) result += ',';
+        result += FieldNames[field];
+    }
+    return result;
+}
+
+BidRequestFields
+BidRequestFields::
+parse(const std::string & str)
+{
+    BidRequestFields result;
+    if (str.empty()) return result;
+
+    for (const auto & name : ML::split(str, ','))
+        result.add(parseBidRequestField(name));
+    return result;
+}
+
+
+/*****************************************************************************/
+/* BID REQUEST PROJECTION                                                    */
+/*****************************************************************************/
+
+std::string
+projectBidRequest(const BidRequest & br, BidRequestFields fields)
+{
+    string out;
+    writeVarint(out, ProjectionVersion);
+
+    if (fields.has(BRF_EXCHANGE))
+        writeRecord(out, BRF_EXCHANGE, br.exchange);
+    if (fields.has(BRF_URL) && !br.url.empty())
+        writeRecord(out, BRF_URL, br.url.toString());
+    if (fields.has(BRF_LANGUAGE))
+        writeRecord(out, BRF_LANGUAGE, br.language.rawString());
+    if (fields.has(BRF_USER_AGENT))
+        writeRecord(out, BRF_USER_AGENT, br.userAgent.rawString());
+    if (fields.has(BRF_IP_ADDRESS))
+        writeRecord(out, BRF_IP_ADDRESS, br.ipAddress);
+    if (fields.has(BRF_EXT) && !br.ext.isNull())
+        writeRecord(out, BRF_EXT, br.ext.toStringNoNewLine());
+    if (fields.has(BRF_IMP))
+        writeRecord(out, BRF_IMP, printJson(br.imp));
+    if (fields.has(BRF_SITE))
+        writeJson(out, BRF_SITE, br.site);
+    if (fields.has(BRF_APP))
+        writeJson(out, BRF_APP, br.app);
+    if (fields.has(BRF_DEVICE))
+        writeJson(out, BRF_DEVICE, br.device);
+    if (fields.has(BRF_USER))
+        writeJson(out, BRF_USER, br.user);
+    if (fields.has(BRF_LOCATION))
+        writeRecord(out, BRF_LOCATION, printJson(br.location));
+
+    return out;
+}
+
+
+/*****************************************************************************/
+/* BID REQUEST VIEW                                                          */
+/*****************************************************************************/
+
+BidRequestView::
+BidRequestView(std::string projection)
+    : data(std::move(projection))
+{
+    size_t pos = 0;
+    uint64_t version = readVarint(data, pos);
+    if (version != ProjectionVersion)
+        throw ML::Exception("unknown bid request projection version %d",
+                            int(version));
+
+    while (pos < data.size()) {
+        uint64_t tag = readVarint(data, pos);
+        uint64_t size = readVarint(data, pos);
+        if (size > data.size() - pos)
+            throw ML::Exception("truncated bid request projection");
+
+        // Unknown tags come from a newer router and are skipped.
+        if (tag > 0 && tag < BRF_MAX_FIELD) {
+            Record & rec = records[tag];
+            rec.offset = pos;
+            rec.size = size;
+            rec.present = true;
+        }
+        pos += size;
+    }
+}
+
+BidRequestView::
+BidRequestView(std::shared_ptr<const BidRequest> br)
+    : full(std::move(br))
+{
+}
+
+bool
+BidRequestView::
+has(BidRequestField field) const
+{
+    return full || record(field);
+}
+
+const BidRequestView::Record *
+BidRequestView::
+record(BidRequestField field) const
+{
+    const Record & rec = records[field];
+    return rec.present ? &rec : nullptr;
+}
+
+std::string
+BidRequestView::
+raw(BidRequestField field) const
+{
+    auto rec = record(field);
+    return rec ? data.substr(rec->offset, rec->size) : string();
+}
+
+template<typename T>
+T
+BidRequestView::
+decode(BidRequestField field) const
+{
+    auto rec = record(field);
+    if (!rec) return T();
+
+    static auto desc = getDefaultDescriptionShared((T *)0);
+
+    T result;
+    const char * start = data.c_str() + rec->offset;
+    StreamingJsonParsingContext context(
+            toString(field), start, start + rec->size);
+    desc->parseJson(&result, context);
+    return result;
+}
+
+std::string
+BidRequestView::
+exchange() const
+{
+    return full ? full->exchange : raw(BRF_EXCHANGE);
+}
+
+Url
+BidRequestView::
+url() const
+{
+    if (full) return full->url;
+    auto rec = record(BRF_URL);
+    return rec ? Url(raw(BRF_URL)) : Url();
+}
+
+Datacratic::UnicodeString
+BidRequestView::
+language() const
+{
+    return full ? full->language : Datacratic::UnicodeString(raw(BRF_LANGUAGE));
+}
+
+Datacratic::UnicodeString
+BidRequestView::
+userAgent() const
+{
+    return full ? full->userAgent : Datacratic::UnicodeString(raw(BRF_USER_AGENT));
+}
+
+std::string
+BidRequestView::
+ipAddress() const
+{
+    return full ? full->ipAddress : raw(BRF_IP_ADDRESS);
+}
+
+Json::Value
+BidRequestView::
+ext() const
+{
+    if (full) return full->ext;
+    auto rec = record(BRF_EXT);
+    return rec ? Json::parse(raw(BRF_EXT)) : Json::Value();
+}
+
+std::vector<AdSpot>
+BidRequestView::
+imp() const
+{
+    return full ? full->imp : decode<std::vector<AdSpot> >(BRF_IMP);
+}
+
+namespace {
+
+template<typename T>
+OpenRTB::Optional<T> wrap(bool present, T && value)
+{
+    OpenRTB::Optional<T> result;
+    if (present) result.reset(new T(std::move(value)));
+    return result;
+}
+
+} // file scope
+
+OpenRTB::Optional<OpenRTB::Site>
+BidRequestView::
+site() const
+{
+    if (full) return full->site;
+    return wrap(has(BRF_SITE), decode<OpenRTB::Site>(BRF_SITE));
+}
+
+OpenRTB::Optional<OpenRTB::App>
+BidRequestView::
+app() const
+{
+    if (full) return full->app;
+    return wrap(has(BRF_APP), decode<OpenRTB::App>(BRF_APP));
+}
+
+OpenRTB::Optional<OpenRTB::Device>
+BidRequestView::
+device() const
+{
+    if (full) return full->device;
+    return wrap(has(BRF_DEVICE), decode<OpenRTB::Device>(BRF_DEVICE));
+}
+
+OpenRTB::Optional<OpenRTB::User>
+BidRequestView::
+user() const
+{
+    if (full) return full->user;
+    return wrap(has(BRF_USER), decode<OpenRTB::User>(BRF_USER));
+}
+
+Location
+BidRequestView::
+location() const
+{
+    return full ? full->location : decode<Location>(BRF_LOCATION);
+}
+
+std::shared_ptr<const BidRequest>
+BidRequestView::
+toBidRequest() const
+{
+    if (full) return full;
+
+    auto br = std::make_shared<BidRequest>();
+    br->exchange = exchange();
+    br->url = url();
+    br->language = language();
+    br->userAgent = userAgent();
+    br->ipAddress = ipAddress();
+    br->ext = ext();
+    br->imp = imp();
+    br->site = site();
+    br->app = app();
+    br->device = device();
+    br->user = user();
+    br->location = location();
+    return br;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,159 @@
+/* bid_request_projection.h                                         -*- C++ -*-
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Compact binary projection of a bid request onto the handful of fields an
+   augmentor actually reads.
+*/
+
+#pragma once
+
+#include "rtbkit/common/bid_request.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* BID REQUEST FIELD                                                         */
+/*****************************************************************************/
+
+/** Fields of a bid request that can be projected.  The values are the tags
+    used on the wire so they must never be reused or renumbered.
+*/
+enum BidRequestField {
+    BRF_EXCHANGE   = 1,
+    BRF_URL        = 2,
+    BRF_LANGUAGE   = 3,
+    BRF_USER_AGENT = 4,
+    BRF_IP_ADDRESS = 5,
+    BRF_EXT        = 6,
+    BRF_IMP        = 7,
+    BRF_SITE       = 8,
+    BRF_APP        = 9,
+    BRF_DEVICE     = 10,
+    BRF_USER       = 11,
+    BRF_LOCATION   = 12,
+
+    BRF_MAX_FIELD  = 13
+};
+
+const char * toString(BidRequestField field);
+BidRequestField parseBidRequestField(const std::string & name);
+
+
+/*****************************************************************************/
+/* BID REQUEST FIELDS                                                        */
+/*****************************************************************************/
+
+/** Set of projected fields.  Its string form is the comma separated list of
+    field names (eg. "exchange,url,imp") which is what augmentors send in
+    their CONFIG message.
+*/
+struct BidRequestFields {
+    BidRequestFields() : bits(0) {}
+    BidRequestFields(std::initializer_list<BidRequestField> fields);
+
+    bool empty() const { return bits == 0; }
+    bool has(BidRequestField field) const { return bits & (1 << field); }
+    void add(BidRequestField field) { bits |= 1 << field; }
+
+    std::string toString() const;
+    static BidRequestFields parse(const std::string & str);
+
+    bool operator == (const BidRequestFields & other) const
+    {
+        return bits == other.bits;
+    }
+
+    bool operator < (const BidRequestFields & other) const
+    {
+        return bits < other.bits;
+    }
+
+    uint32_t bits;
+};
+
+
+/*****************************************************************************/
+/* BID REQUEST PROJECTION                                                    */
+/*****************************************************************************/
+
+/** Encodes the given fields of the bid request.
+
+    The encoding is a varint version followed by one record per field that
+    is present: a varint tag, a varint length and the value.  Strings are
+    stored as is while structured fields (imp, site, ...) are stored in their
+    compact JSON form.
+*/
+std::string projectBidRequest(const BidRequest & br, BidRequestFields fields);
+
+/** Format string that identifies a projection in the AUGMENT message. */
+extern const std::string BidRequestProjectionFormat;
+
+
+/*****************************************************************************/
+/* BID REQUEST VIEW                                                          */
+/*****************************************************************************/
+
+/** Read only access to the fields of a bid request which is either a
+    projection or a full BidRequest.
+
+    Building a view from a projection only indexes the records; each accessor
+    then decodes its field every time it's called, so callers should hold on
+    to the result rather than calling it repeatedly.  A field that isn't part
+    of the projection reads as its default value.
+*/
+struct BidRequestView {
+    BidRequestView() {}
+
+    /** View over an encoded projection. */
+    explicit BidRequestView(std::string projection);
+
+    /** View over a fully parsed bid request. */
+    explicit BidRequestView(std::shared_ptr<const BidRequest> br);
+
+    bool empty() const { return !full && data.empty(); }
+
+    /** Whether the field can be read through this view. */
+    bool has(BidRequestField field) const;
+
+    std::string exchange() const;
+    Url url() const;
+    Datacratic::UnicodeString language() const;
+    Datacratic::UnicodeString userAgent() const;
+    std::string ipAddress() const;
+    Json::Value ext() const;
+    std::vector<AdSpot> imp() const;
+    OpenRTB::Optional<OpenRTB::Site> site() const;
+    OpenRTB::Optional<OpenRTB::App> app() const;
+    OpenRTB::Optional<OpenRTB::Device> device() const;
+    OpenRTB::Optional<OpenRTB::User> user() const;
+    Location location() const;
+
+    /** Bid request with only the projected fields filled in.  Returns the
+        original when the view is over a full bid request.
+    */
+    std::shared_ptr<const BidRequest> toBidRequest() const;
+
+private:
+    struct Record {
+        Record() : offset(0), size(0), present(false) {}
+        uint32_t offset;
+        uint32_t size;
+        bool present;
+    };
+
+    std::string data;
+    Record records[BRF_MAX_FIELD];
+    std::shared_ptr<const BidRequest> full;
+
+    const Record * record(BidRequestField field) const;
+    std::string raw(BidRequestField field) const;
+
+    template<typename T>
+    T decode(BidRequestField field) const;
+};
+
+} // namespace RTBKIT
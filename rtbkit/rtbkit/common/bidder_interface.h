@@ -101,6 +101,12 @@ struct BidderInterface : public ServiceBase
 
     virtual void registerLoopMonitor(LoopMonitor *monitor) const { }
 
+    /** Can the send*() methods be called from several threads at once?  If
+        not, a router with several shards makes all of its calls from its
+        main loop.
+    */
+    virtual bool isThreadSafe() const { return false; }
+
     //
     // factory
     //
@@ -5,7 +5,8 @@ LIBBIDREQUEST_SOURCES := \
 	segments.cc \
 	json_holder.cc \
 	currency.cc \
-	expand_variable.cc 
+	expand_variable.cc \
+	bid_request_projection.cc
 
 LIBBIDREQUEST_LINK := \
 	types boost_regex db openrtb value_description
@@ -23,10 +24,12 @@ LIBRTB_SOURCES := \
 	win_cost_model.cc \
 	post_auction_proxy.cc \
 	analytics_publisher.cc \
-	bid_request_pipeline.cc
+	bid_request_pipeline.cc \
+	hosted_augmentor.cc
 
 LIBRTB_LINK := \
-	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request
+	ACE arch utils jsoncpp boost_thread endpoint boost_regex zmq opstats bid_request \
+	boost_iostreams gc
 
 $(eval $(call library,rtb,$(LIBRTB_SOURCES),$(LIBRTB_LINK)))
 
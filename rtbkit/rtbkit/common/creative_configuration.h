@@ -9,6 +9,9 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 
 #include <boost/thread.hpp>
 
@@ -33,6 +36,40 @@ namespace {
 
         return nullptr;
     }
+
+    /* Formatting helpers used by the typed accessors.  They append straight
+       to the output buffer instead of going through a temporary string.
+    */
+
+    void appendInt(std::string& out, long long value) {
+        char buf[24];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+
+        unsigned long long v = value < 0 ? -(unsigned long long)value : value;
+        do {
+            *--p = '0' + (v % 10);
+            v /= 10;
+        } while (v);
+        if (value < 0) *--p = '-';
+
+        out.append(p, end - p);
+    }
+
+    /* Same output as std::to_string(double) */
+    void appendDouble(std::string& out, double value) {
+        char buf[328];
+        int n = snprintf(buf, sizeof(buf), "%f", value);
+        if (n > 0) out.append(buf, std::min<size_t>(n, sizeof(buf) - 1));
+    }
+
+    template<typename Vals>
+    void appendList(std::string& out, const Vals& vals) {
+        for (size_t i = 0; i < vals.size(); ++i) {
+            if (i > 0) out += ',';
+            appendInt(out, vals[i].val);
+        }
+    }
 }
 
 template <typename CreativeData>
@@ -59,93 +96,99 @@ public:
     typedef std::function<std::string(const Context &)> ExpanderCallable;
     typedef std::map<std::string, ExpanderCallable> ExpanderMap;
 
+    /** Typed accessor that appends the value of a variable to the output
+        buffer of the expansion.  All the built-in variables are implemented
+        that way so that expanding a snippet never builds an intermediate
+        string or Json::Value per variable.
+    */
+    typedef std::function<void(const Context &, std::string &)> ExpanderWriter;
+    typedef std::map<std::string, ExpanderWriter> ExpanderWriterMap;
+
     struct Expander;
 
     CreativeConfiguration(const std::string& exchange)
     : exchange_(exchange)
     {
-        expanderDict_ = {
+        writerDict_ = {
         {
-                "exchange",
-                std::bind(&CreativeConfiguration::exchange_, this)
+            "exchange",
+            [this](const Context&, std::string& out)
+            { out += exchange_; }
         },
 
         {
             "creative.id",
-            [](const Context& ctx)
-            { return std::to_string(ctx.creative.id); }
+            [](const Context& ctx, std::string& out)
+            { appendInt(out, ctx.creative.id); }
         },
 
         {
             "creative.name",
-            [](const Context& ctx)
-            { return ctx.creative.name; }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.creative.name; }
         },
 
         {
             "creative.width",
-            [](const Context& ctx)
-            { return std::to_string(ctx.creative.format.width); }
+            [](const Context& ctx, std::string& out)
+            { appendInt(out, ctx.creative.format.width); }
         },
 
         {
             "creative.height",
-            [](const Context& ctx)
-            { return std::to_string(ctx.creative.format.height); }
+            [](const Context& ctx, std::string& out)
+            { appendInt(out, ctx.creative.format.height); }
         },
 
         {
             "bidrequest.id",
-            [](const Context& ctx)
-            { return ctx.bidrequest.auctionId.toString(); }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.bidrequest.auctionId.toString(); }
         },
 
         {
             "bidrequest.user.id",
-            [](const Context& ctx) -> std::string
+            [](const Context& ctx, std::string& out)
             {
-                if ( ctx.bidrequest.user){
-                    return ctx.bidrequest.user->id.toString();
+                if (ctx.bidrequest.user) {
+                    out += ctx.bidrequest.user->id.toString();
                 }
-                return "";
             }
         },
 
         {
             "bidrequest.video.width",
-            [](const Context& ctx) -> std::string
+            [](const Context& ctx, std::string& out)
             {
-		const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
+                const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
                 if (imp.video) {
                     auto w = imp.video->w.value();
-                    if (w != -1) { 
-		        return std::to_string(w);
+                    if (w != -1) {
+                        appendInt(out, w);
                     }
                 }
-                return "";
             }
         },
 
         {
             "bidrequest.video.height",
-            [](const Context& ctx) -> std::string
+            [](const Context& ctx, std::string& out)
             {
-		const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
+                const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
                 if (imp.video) {
                     auto h = imp.video->h.value();
-                    if (h != -1) { 
-		        return std::to_string(h);
+                    if (h != -1) {
+                        appendInt(out, h);
                     }
                 }
-                return "";
             }
         },
 
         {
             "bidrequest.video.pos",
-            [](const Context& ctx) -> std::string
+            [](const Context& ctx, std::string& out)
             {
-		const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
+                const auto& imp = ctx.bidrequest.imp[ctx.spotNum];
                 if (imp.video) {
                      using OpenRTB::AdPosition;
 
@@ -153,255 +196,216 @@ public:
                      switch (static_cast<AdPosition::Vals>(pos.value()))
                      {
                      case AdPosition::UNSPECIFIED:
-                         return "unspecified";
+                         out += "unspecified"; break;
                      case AdPosition::UNKNOWN:
-                         return "unknown";
+                         out += "unknown"; break;
                      case  AdPosition::ABOVE:
-                         return "above";
+                         out += "above"; break;
                      case AdPosition::BETWEEN_DEPRECATED:
-                         return "between";
+                         out += "between"; break;
                      case AdPosition::BELOW:
-                         return "below";
+                         out += "below"; break;
                      case AdPosition::HEADER:
-                         return "header";
+                         out += "header"; break;
                      case AdPosition::FOOTER:
-                         return "footer";
+                         out += "footer"; break;
                      case AdPosition::SIDEBAR:
-                         return "sidebar";
+                         out += "sidebar"; break;
                      case AdPosition::FULLSCREEN:
-                         return "fullscreen";
+                         out += "fullscreen"; break;
                      }
                 }
-                return "";
             }
         },
 
         {
             "bidrequest.publisher.id",
-            [](const Context& ctx) -> std::string
+            [](const Context& ctx, std::string& out)
             {
                 auto const& br = ctx.bidrequest;
                 if (br.site && br.site->publisher) {
-                    return br.site->publisher->id.toString();
+                    out += br.site->publisher->id.toString();
                 } else if (br.app && br.app->publisher) {
-                    return br.app->publisher->id.toString();
+                    out += br.app->publisher->id.toString();
                 }
-		return "";
             }
         },
-    	{
+        {
             "bidrequest.site.page",
-            [](const Context& ctx) -> std::string { 
+            [](const Context& ctx, std::string& out)
+            {
                 if (ctx.bidrequest.site) {
-                    std::string SP_long = ctx.bidrequest.site->page.toString();
-                    std::size_t found = SP_long.find("?");
+                    const char* page = ctx.bidrequest.site->page.c_str();
+                    const char* query = std::strchr(page, '?');
 
-                    if (found!=std::string::npos){
-                        return SP_long.substr(0,found+1);
-                    }
-                    else {
-                        return SP_long;
-                    }
+                    // Keep everything up to and including the '?'
+                    if (query) out.append(page, query + 1 - page);
+                    else out.append(page);
                 } else if (ctx.bidrequest.app) {
-                    return std::string("apps://") + ctx.bidrequest.app->name.rawString() + '/';
+                    out += "apps://";
+                    out += ctx.bidrequest.app->name.rawString();
+                    out += '/';
                 }
-
-                return ""; 
-            } 
+            }
         },
         {
             "bidrequest.device.ip",
-            [](const Context& ctx) -> std::string { 
-                if (ctx.bidrequest.device && !ctx.bidrequest.device->ip.empty()) {
-                    return ctx.bidrequest.device->ip; 
+            [](const Context& ctx, std::string& out)
+            {
+                if (ctx.bidrequest.device) {
+                    out += ctx.bidrequest.device->ip;
                 }
-                return "";
             }
         },
         {
             "bidrequest.language",
-            [](const Context& ctx) -> std::string { 
-                if (!ctx.bidrequest.language.empty()) {
-                    return ctx.bidrequest.language.rawString();
-                }
-                return "";
-            }
-	},
+            [](const Context& ctx, std::string& out)
+            { out += ctx.bidrequest.language.rawString(); }
+        },
         {
             "bidrequest.ip",
-            [](const Context& ctx) -> std::string { 
-                if (!ctx.bidrequest.ipAddress.empty()) {
-                    return ctx.bidrequest.ipAddress;
-                }
-                return "";
-            }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.bidrequest.ipAddress; }
         },
         {
             "bidrequest.ua",
-            [](const Context& ctx) -> std::string { 
-                if (!ctx.bidrequest.userAgent.empty()) {
-                    return ctx.bidrequest.userAgent.rawString();
-                }
-                return "";
-            }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.bidrequest.userAgent.rawString(); }
         },
         {
             "bidrequest.timestamp",
-            [](const Context& ctx)
-            { return std::to_string( ctx.bidrequest.timestamp.secondsSinceEpoch() ); }
+            [](const Context& ctx, std::string& out)
+            { appendDouble(out, ctx.bidrequest.timestamp.secondsSinceEpoch()); }
         },
         {
             "bidrequest.geo.zip",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto geo = getGeo(ctx.bidrequest);
-                if (geo) {
-                    if (!geo->zip.empty())
-                        return geo->zip.rawString();
-                }
-
-                return "";
+                if (geo) out += geo->zip.rawString();
             }
         },
         {
             "bidrequest.geo.region",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto geo = getGeo(ctx.bidrequest);
-                if (geo) {
-                    if (!geo->region.empty())
-                        return geo->region;
-                }
-                return "";
+                if (geo) out += geo->region;
             }
         },
         {
             "bidrequest.geo.country",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto geo = getGeo(ctx.bidrequest);
-                if (geo) {
-                    if (!geo->country.empty())
-                        return geo->country;
-                }
-                return "";
+                if (geo) out += geo->country;
             }
         },
         {
             "bidrequest.geo.metro",
-            [](const Context& ctx) -> std::string {
-                auto* geo = getGeo(ctx.bidrequest);
-                if (geo) {
-                    if (!geo->metro.empty())
-                        return geo->metro;
-                }
-                return "";
+            [](const Context& ctx, std::string& out)
+            {
+                auto geo = getGeo(ctx.bidrequest);
+                if (geo) out += geo->metro;
             }
         },
         {
             "bidrequest.geo.city",
-            [](const Context& ctx) -> std::string {
-                auto* geo = getGeo(ctx.bidrequest);
-                if (geo) {
-                    if (!geo->city.empty())
-                        return geo->city.rawString();
-                }
-                return "";
+            [](const Context& ctx, std::string& out)
+            {
+                auto geo = getGeo(ctx.bidrequest);
+                if (geo) out += geo->city.rawString();
             }
         },
         {
             "bidrequest.device.type",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 const auto& br = ctx.bidrequest;
                 if (br.device) {
                     auto type = static_cast<OpenRTB::DeviceType::Vals>(br.device->devicetype.val);
                     if (type !=  OpenRTB::DeviceType::Vals::UNSPECIFIED) {
-                        return std::to_string(br.device->devicetype.val);
+                        appendInt(out, br.device->devicetype.val);
                     }
                 }
-
-                return "";
             }
         },
         {
             "bidrequest.app.bundle",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 if (ctx.bidrequest.app)
-                    return ctx.bidrequest.app->bundle.rawString();
-
-                return "";
+                    out += ctx.bidrequest.app->bundle.rawString();
             }
         },
         {
             "bidrequest.app.name",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 if (ctx.bidrequest.app)
-                    return ctx.bidrequest.app->name.rawString();
-                return "";
+                    out += ctx.bidrequest.app->name.rawString();
             }
         },
         {
             "bidrequest.app.storeurl",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 if (ctx.bidrequest.app)
-                    return ctx.bidrequest.app->storeurl.toString();
-                return "";
+                    out.append(ctx.bidrequest.app->storeurl.c_str());
             }
         },
         {
             "bidrequest.video.linearity",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto& spot = ctx.bidrequest.imp[ctx.spotNum];
-                return std::to_string(spot.video->linearity.val);
+                if (spot.video)
+                    appendInt(out, spot.video->linearity.val);
             }
         },
         {
             "bidrequest.video.playbackmethod",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto& spot = ctx.bidrequest.imp[ctx.spotNum];
-                std::ostringstream oss;
-                size_t i = 0;
-                for (; i < spot.video->playbackmethod.size() - 1; ++i) {
-                    oss << spot.video->playbackmethod[i].val << ",";
-                }
-                oss << spot.video->playbackmethod[i].val;
-                return oss.str();
+                if (spot.video)
+                    appendList(out, spot.video->playbackmethod);
             }
         },
         {
             "bidrequest.video.api",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 auto& spot = ctx.bidrequest.imp[ctx.spotNum];
-                std::ostringstream oss;
-                size_t i = 0;
-                for (; i < spot.video->api.size() - 1; ++i) {
-                    oss << spot.video->api[i].val << ",";
-                }
-                oss << spot.video->api[i].val;
-                return oss.str();
+                if (spot.video)
+                    appendList(out, spot.video->api);
             }
         },
         {
             "bidrequest.site.ref",
-            [](const Context& ctx) -> std::string {
+            [](const Context& ctx, std::string& out)
+            {
                 if (ctx.bidrequest.site) {
-                    return ctx.bidrequest.site->ref.toString();
+                    out.append(ctx.bidrequest.site->ref.c_str());
                 }
-                return "";
             }
         },
 
         {
             "response.account",
-            [](const Context& ctx)
-            { return ctx.response.account.toString(); }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.response.account.toString(); }
         },
         {
             "imp.id",
-            [](const Context& context)
-            { return context.bidrequest.imp[context.spotNum].id.toString(); }
+            [](const Context& ctx, std::string& out)
+            { out += ctx.bidrequest.imp[ctx.spotNum].id.toString(); }
         },
         {
             "bid.price",
-            [](const Context& context) {
-                return to_string(static_cast<double>(USD_CPM(context.response.price.maxPrice)));
+            [](const Context& ctx, std::string& out)
+            {
+                appendDouble(out, static_cast<double>(USD_CPM(ctx.response.price.maxPrice)));
             }
         }
         };
@@ -427,11 +431,18 @@ public:
                 "urlencode",
                 [](std::string& value) -> std::string&
                 {
+                    static const char Hex[] = "0123456789ABCDEF";
+
                     std::string result;
-                    for (auto c: value) {
+                    result.reserve(value.size() * 3);
+                    for (unsigned char c: value) {
                         if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
                             result += c;
-                        else result += ML::format("%%%02X", c);
+                        else {
+                            result += '%';
+                            result += Hex[c >> 4];
+                            result += Hex[c & 0xF];
+                        }
                     }
 
                     value = std::move(result);
@@ -456,11 +467,18 @@ public:
     std::string expand(const std::string& templateString,
                        const Context& context) const;
 
+    /** Variables added here take precedence over the built-in ones */
     void addExpanderVariable(const std::string& key, ExpanderCallable value)
     {
         expanderDict_[key] = value;
     }
 
+    void addExpanderWriter(const std::string& key, ExpanderWriter value)
+    {
+        writerDict_[key] = value;
+        expanderDict_.erase(key);
+    }
+
     void addExpanderFilter(const std::string& filter,
                            ExpanderFilterCallable callable)
     {
@@ -472,12 +490,14 @@ private:
     extractVariables(const std::string& snippet) const;
 
     Expander
-    generateExpander(const std::vector<ExpandVariable>& variables) const;
+    generateExpander(const std::string& snippet,
+                     const std::vector<ExpandVariable>& variables) const;
 
-    ExpanderCallable getAssociatedCallable(ExpandVariable const& var) const;
-    std::string jsonValueToStr(Json::Value const& val) const;
+    ExpanderWriter getAssociatedWriter(ExpandVariable const& var) const;
+    void appendJsonValue(Json::Value const& val, std::string& out) const;
 
     ExpanderMap expanderDict_;
+    ExpanderWriterMap writerDict_;
     ExpanderFilterMap filters_;
 
     std::map<std::string, Field> fields_;
@@ -559,9 +579,9 @@ CreativeConfiguration<CreativeData>::handleCreativeCompatibility(
             if (field.isSnippet()) {
                 // assume string
                 auto const& snippet = value.asString();
-                auto expander = generateExpander(extractVariables(snippet));
+                auto expander = generateExpander(snippet, extractVariables(snippet));
                 boost::unique_lock<boost::shared_mutex> lock(mutex_);
-                expanders_[snippet] = expander;
+                expanders_[snippet] = std::move(expander);
             }
         }
     }
@@ -598,47 +618,70 @@ CreativeConfiguration<CreativeData>::extractVariables(
 }
 
 template <typename CreativeData>
-typename CreativeConfiguration<CreativeData>::ExpanderCallable
-CreativeConfiguration<CreativeData>::getAssociatedCallable(
+typename CreativeConfiguration<CreativeData>::ExpanderWriter
+CreativeConfiguration<CreativeData>::getAssociatedWriter(
     ExpandVariable const& var) const
 {
-    auto it = expanderDict_.find(var.getVariable());
-    if (it != expanderDict_.end()) {
-        return it->second;
+    {
+        auto it = expanderDict_.find(var.getVariable());
+        if (it != expanderDict_.end()) {
+            auto callable = it->second;
+            return [callable](const Context& context, std::string& out) {
+                out += callable(context);
+            };
+        }
+    }
+
+    {
+        auto it = writerDict_.find(var.getVariable());
+        if (it != writerDict_.end()) {
+            return it->second;
+        }
     }
 
     auto const& path = var.getPath();
     auto const& section = path[0];
 
-    auto getter = [this, var](Json::Value const & jsonVal,
-                              const Context & context)->std::string
+    /* Generic path: walk a json document without copying it. This is only
+       meant as a fallback for variables that do not have a typed accessor.
+    */
+    auto getter = [this](Json::Value const & jsonVal,
+                         std::vector<std::string>::const_iterator it,
+                         std::vector<std::string>::const_iterator end,
+                         std::string & out)
     {
-
-        auto const& path = var.getPath();
-        auto val = jsonVal;
-        for (auto it = std::begin(path) + 1, end = std::end(path);
-             val != Json::Value::null && it != end;
-             ++it) {
-            val = val[*it];
+        const Json::Value* val = &jsonVal;
+        for (; it != end; ++it) {
+            if (!val->isObject() || !val->isMember(*it))
+                return;
+            val = &(*val)[*it];
         }
 
-        if (val != Json::Value::null) {
-            return this->jsonValueToStr(val);
+        if (!val->isNull()) {
+            this->appendJsonValue(*val, out);
         }
-
-        return "";
     };
 
     if (section == "creative") {
-        return [getter](const Context & context) {
-            return getter(context.creative.toJson(), context);
+        return [getter, path](const Context & context, std::string & out) {
+            getter(context.creative.toJson(),
+                   path.begin() + 1, path.end(), out);
         };
     } else if (section == "bidrequest") {
-        return [getter](const Context & context) {
-            return getter(context.bidrequest.toJson(), context);
+        if (path.size() > 1 && path[1] == "ext") {
+            // Extensions are already stored as json on the request
+            return [getter, path](const Context & context, std::string & out) {
+                getter(context.bidrequest.ext,
+                       path.begin() + 2, path.end(), out);
+            };
+        }
+
+        return [getter, path](const Context & context, std::string & out) {
+            getter(context.bidrequest.toJson(),
+                   path.begin() + 1, path.end(), out);
         };
     } else if (section == "meta") {
-        return [this, getter](const Context & context) {
+        return [this, getter, path](const Context & context, std::string & out) {
             Json::Reader reader;
             Json::Value val;
             if (!reader.parse(context.response.meta.rawString(), val)) {
@@ -647,7 +690,7 @@ CreativeConfiguration<CreativeData>::getAssociatedCallable(
                           << ", meta: " << context.response.meta << std::endl;
             }
 
-            return getter(val, context);
+            getter(val, path.begin() + 1, path.end(), out);
         };
     }
 
@@ -658,11 +701,14 @@ CreativeConfiguration<CreativeData>::getAssociatedCallable(
 template <typename CreativeData>
 typename CreativeConfiguration<CreativeData>::Expander
 CreativeConfiguration<CreativeData>::generateExpander(
+    const std::string& snippet,
     const std::vector<ExpandVariable>& variables) const
 {
     Expander expander;
+    size_t literalBegin = 0;
+
     for (auto const& variable : variables) {
-        auto callable = getAssociatedCallable(variable);
+        auto writer = getAssociatedWriter(variable);
 
         ExpanderFilterCallable filterFn;
 
@@ -686,44 +732,48 @@ CreativeConfiguration<CreativeData>::generateExpander(
         }
 
         if (filterFn) {
-
-            expander.addFunctor(
-                    variable,
-                    [filterFn, callable](Context const & ctx) {
-                        std::string result = callable(ctx);
-                        filterFn(result);
-                        return result;
-            });
-        } else {
-            expander.addFunctor(variable, callable);
+            // Filters work in place so the value needs its own buffer
+            auto unfiltered = writer;
+            writer = [filterFn, unfiltered](Context const & ctx, std::string & out) {
+                std::string value;
+                unfiltered(ctx, value);
+                out += filterFn(value);
+            };
         }
+
+        auto location = variable.getReplaceLocation();
+        expander.addSegment(
+                snippet.substr(literalBegin, location.first - literalBegin),
+                std::move(writer));
+        literalBegin = location.second;
     }
 
-    expander.finalize();
+    expander.addSegment(snippet.substr(literalBegin), nullptr);
     return expander;
 }
 
 template <typename CreativeData>
-std::string CreativeConfiguration<CreativeData>::jsonValueToStr(
-    Json::Value const& val) const
+void CreativeConfiguration<CreativeData>::appendJsonValue(
+    Json::Value const& val, std::string& out) const
 {
     if (val.isUInt()) {
-        return std::to_string(val.asUInt());
+        appendInt(out, val.asUInt());
+        return;
     }
 
     if (val.isIntegral()) {
-        return std::to_string(val.asInt());
+        appendInt(out, val.asInt());
+        return;
     }
 
     if (val.isString()) {
-        return val.asString();
+        out += val.asString();
+        return;
     }
 
     std::cerr << exchange_ << ": Cannot convert json value : " << val.toString()
               << " to string. Actual type: " << val.type() << " not supported"
               << std::endl;
-
-    return "";
 }
 
 template <typename CreativeData>
@@ -732,42 +782,61 @@ CreativeConfiguration<CreativeData>::expand(const std::string& templateString,
                                             const Context& context) const
 {
     boost::shared_lock<boost::shared_mutex> lock(mutex_);
-    auto const& expander = expanders_[templateString];
-    return expander.expand(templateString, context);
+    auto it = expanders_.find(templateString);
+    if (it == expanders_.end())
+        return templateString;
+
+    return it->second.expand(context);
 }
 
+/** Compiled form of a snippet: the literal chunks of the template interleaved
+    with the writers of the variables that sit between them.  Expanding it is
+    a single pass that appends to one output buffer, reserved up front from
+    the largest expansion seen so far.
+*/
 template <typename CreativeData>
 struct CreativeConfiguration<CreativeData>::Expander
 {
-    typedef std::vector<std::pair<ExpandVariable, ExpanderCallable>> FunctorCollection;
+    struct Segment {
+        std::string literal;
+        ExpanderWriter writer; //< Null for the trailing literal
+    };
 
-    void addFunctor(const ExpandVariable& var, ExpanderCallable fn)
+    Expander()
+        : literalSize(0)
+        , sizeHint(std::make_shared<std::atomic<size_t>>(0))
     {
-        collection.push_back(std::make_pair(var, fn));
     }
 
-    void finalize()
+    void addSegment(std::string literal, ExpanderWriter writer)
     {
-        std::reverse(collection.begin(), collection.end());
+        literalSize += literal.size();
+        segments.push_back(Segment { std::move(literal), std::move(writer) });
     }
 
-    std::string expand(std::string toExpand, const Context& ctx) const
+    std::string expand(const Context& ctx) const
     {
-        for (auto& element : collection) {
-            auto const& var = element.first;
-            auto const& fn = element.second;
-
-            auto const& location = var.getReplaceLocation();
-
-            toExpand.replace(
-                location.first, location.second - location.first, fn(ctx));
+        std::string result;
+        result.reserve(std::max(literalSize + 32 * segments.size(),
+                                sizeHint->load(std::memory_order_relaxed)));
+
+        for (auto const& segment : segments) {
+            result += segment.literal;
+            if (segment.writer)
+                segment.writer(ctx, result);
         }
 
-        return toExpand;
+        if (result.size() > sizeHint->load(std::memory_order_relaxed))
+            sizeHint->store(result.size(), std::memory_order_relaxed);
+
+        return result;
     }
 
-    FunctorCollection collection;
+    std::vector<Segment> segments;
+    size_t literalSize;
 
+    /** Shared so that the expander stays copyable */
+    std::shared_ptr<std::atomic<size_t>> sizeHint;
 };
 
 } // namespace RTBKIT
@@ -54,6 +54,38 @@ struct ExchangeConnector: public ServiceBase {
     */
     OnAuction onNewAuction, onAuctionDone;
 
+    /** Function that tells whether any agent could bid on a request of
+        which only the given PreFilterFields were filled in.
+    */
+    typedef boost::function<bool (const BidRequest & request,
+                                  unsigned fields)> OnPreFilter;
+
+    /** Hooked up by the router like onNewAuction.  Unset, every request
+        goes through.
+    */
+    OnPreFilter onPreFilter;
+
+    /** Function that gives the value, between 0 and 1, of a request of
+        which at least the exchange, url and publisher were filled in.
+        Under load the least valuable requests are shed first.
+    */
+    typedef boost::function<double (const BidRequest & request)>
+        OnScoreRequest;
+
+    /** Hooked up by the router like onNewAuction.  Unset, requests are shed
+        uniformly.
+    */
+    OnScoreRequest onScoreRequest;
+
+    /** Function called with a scored request that was shed, so that the
+        value of the requests that never reach the router is still known.
+    */
+    typedef boost::function<void (const BidRequest & request)>
+        OnRequestShed;
+
+    /** Hooked up by the router like onScoreRequest. */
+    OnRequestShed onRequestShed;
+
     int numRequests;
     int numAuctions;
 
@@ -114,6 +146,14 @@ struct ExchangeConnector: public ServiceBase {
         return [] (double) { return 0.0; };
     }
 
+    /** Returns what the exchange connector shed under load, by request
+        value.  Empty when it doesn't shed by value.
+    */
+    virtual Json::Value getSheddingInfo() const
+    {
+        return Json::Value();
+    }
+
     /** Return the name of the exchange, as it would be written as an
         identifier.
     */
@@ -57,6 +57,48 @@ biddableSpots()
     return biddable;
 }
 
+const std::string&
+FilterState::
+domain() const
+{
+    if (domain_) return *domain_;
+
+    domain_.reset(new std::string());
+    std::string& domain = *domain_;
+
+    if (request.site) {
+        if (!request.site->domain.empty())
+            domain = request.site->domain.rawString();
+        else if (request.site->publisher && !request.site->publisher->domain.empty())
+            domain = request.site->publisher->domain.rawString();
+    }
+
+    // If the domain is not found, fallback on the page url
+    if (domain.empty())
+        domain = request.url.host();
+
+    size_t start = 0;
+
+    static const std::string http = "http://";
+    if (!domain.compare(0, http.size(), http))
+        start += http.size();
+
+    static const std::string www = "www.";
+    if (!domain.compare(start, www.size(), www))
+        start += www.size();
+
+    domain.erase(0, start);
+    return domain;
+}
+
+const std::string&
+FilterState::
+urlPath() const
+{
+    if (!urlPath_) urlPath_.reset(new std::string(request.url.path()));
+    return *urlPath_;
+}
+
 FilterState::FilterReasons&
 FilterState::getFilterReasons(){
     return this->filterReasons_;
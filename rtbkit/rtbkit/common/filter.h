@@ -385,6 +385,14 @@ struct FilterState
     const BidRequest& request;
     const ExchangeConnector * const exchange;
 
+    // Domain of the page: the site's domain, the publisher's domain or the
+    // host of the url, in that order, without any "http://" or "www."
+    // prefix. Computed on first use and shared by all the filters.
+    const std::string& domain() const;
+
+    // Path of the request's url, computed on first use.
+    const std::string& urlPath() const;
+
     // Current set of active configuration.
     const ConfigSet& configs() const { return configs_; }
 
@@ -446,6 +454,28 @@ private:
     ConfigSet configs_;
     ML::compact_vector<CreativeMatrix, 8> creatives_;
     FilterReasons filterReasons_;
+
+    mutable std::unique_ptr<std::string> domain_;
+    mutable std::unique_ptr<std::string> urlPath_;
+};
+
+
+/******************************************************************************/
+/* PRE FILTER FIELDS                                                          */
+/******************************************************************************/
+
+/** Parts of a bid request that an exchange connector can pick out of the raw
+    payload without parsing the rest of it.  Filters which look at nothing
+    else can turn away a request before it is parsed (FilterPool::preFilter).
+ */
+enum PreFilterFields {
+    PF_EXCHANGE    = 1 << 0,  ///< exchange
+    PF_DEVICE_TYPE = 1 << 1,  ///< device->devicetype
+    PF_LOCATION    = 1 << 2,  ///< location
+    PF_USER_GEO    = 1 << 3,  ///< user->geo->metro
+    PF_VIDEO       = 1 << 4,  ///< imp[].video->linearity, imp[0] being video
+    PF_URL         = 1 << 5,  ///< url, site->domain and site->publisher->domain
+    PF_PUBLISHER   = 1 << 6   ///< site->publisher->id and app->publisher->id
 };
 
 
@@ -475,6 +505,18 @@ struct FilterBase
      */
     virtual unsigned priority() const { return 0; }
 
+    /** When the filter pool orders the filters by their observed cost and
+        selectivity, pinned filters stay at the position that their priority
+        gives them.
+     */
+    virtual bool pinned() const { return false; }
+
+    /** The PreFilterFields which are all that the filter looks at, if it can
+        run on the partial request filled in before parsing.  The default of 0
+        keeps the filter for the parsed requests.
+     */
+    virtual unsigned preFilterFields() const { return 0; }
+
 
     /** Filters the given bid request such and a return the set of agent
         configuration that matches the given bid request. The filter should
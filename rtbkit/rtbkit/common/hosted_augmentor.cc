@@ -0,0 +1,31 @@
+/* hosted_augmentor.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Augmentor running inside the router.
+*/
+
+#include "hosted_augmentor.h"
+#include "jml/arch/exception.h"
+
+namespace RTBKIT {
+
+std::shared_ptr<HostedAugmentor>
+HostedAugmentor::create(
+        std::string serviceName,
+        std::shared_ptr<Datacratic::ServiceProxies> proxies,
+        const Json::Value & config)
+{
+    auto type = config.get("type", "").asString();
+    if (type.empty())
+        throw ML::Exception("hosted augmentor configuration has no type");
+
+    auto factory = PluginInterface<HostedAugmentor>::getPlugin(type);
+
+    if (serviceName.empty())
+        serviceName = config.get("serviceName", type + ".augmentor").asString();
+
+    return std::shared_ptr<HostedAugmentor>(
+            factory(std::move(serviceName), std::move(proxies), config));
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,74 @@
+/* hosted_augmentor.h                                               -*- C++ -*-
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Interface of an augmentor that runs inside the router's process.
+*/
+
+#pragma once
+
+#include "rtbkit/common/augmentation.h"
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/plugin_interface.h"
+#include "soa/service/service_base.h"
+#include "soa/jsoncpp/json.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* HOSTED AUGMENTOR                                                          */
+/*****************************************************************************/
+
+/** Augmentor loaded as a plugin into the router.  The augmentation loop hands
+    it the in-memory bid request directly instead of going through zmq and the
+    augmentor gives its answer back through a callback.
+
+    Plugins register a factory under their type which is then loaded from
+    lib<type>_augmentor.so.  The factory is given the json configuration of
+    the augmentor and must return it fully initialized but not started.
+*/
+struct HostedAugmentor {
+
+    typedef std::function<HostedAugmentor * (
+            std::string serviceName,
+            std::shared_ptr<Datacratic::ServiceProxies> proxies,
+            const Json::Value & config)> Factory;
+
+    static std::string libNameSufix() { return "augmentor"; }
+
+    /** Creates the augmentor whose type is given by the "type" field of the
+        configuration.
+    */
+    static std::shared_ptr<HostedAugmentor>
+    create(std::string serviceName,
+           std::shared_ptr<Datacratic::ServiceProxies> proxies,
+           const Json::Value & config);
+
+    virtual ~HostedAugmentor() {}
+
+    /** Called with the augmentations once the request is done.  Can be called
+        from any thread but must be called exactly once per request.
+    */
+    typedef std::function<void (const AugmentationList &)> OnResponse;
+
+    /** Name of the augmentation provided, as used in the agent configs. */
+    virtual std::string hostedName() const = 0;
+
+    virtual void startHosted() = 0;
+    virtual void shutdownHosted() = 0;
+
+    /** Augments the bid request for the given agents.  This is called from
+        the router's augmentation thread so it must not block.
+    */
+    virtual void augmentHosted(
+            const Id & auctionId,
+            const std::shared_ptr<BidRequest> & bidRequest,
+            std::vector<std::string> agents,
+            OnResponse onResponse) = 0;
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,111 @@
+/* auction_test.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Tests for the lazily encoded request string and agent augmentations of
+   the auction.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/auction.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+namespace {
+
+std::shared_ptr<BidRequest> makeRequest()
+{
+    auto br = std::make_shared<BidRequest>();
+    br->auctionId = Id("auction1");
+    br->exchange = "test";
+    br->imp.emplace_back();
+    return br;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE( test_lazy_request_str )
+{
+    auto br = makeRequest();
+    auto payload = std::make_shared<std::string>("{\"id\":\"auction1\"}");
+
+    long long before = Auction::requestStrEncoded;
+
+    Auction auction(nullptr, Auction::HandleAuction(), br, payload, "test",
+                    Date::now(), Date::now().plusSeconds(0.1));
+
+    BOOST_CHECK(!auction.hasRequestStr());
+    BOOST_CHECK_EQUAL(Auction::requestStrEncoded, before);
+
+    // The original payload is kept as is
+    BOOST_CHECK_EQUAL(auction.requestPayload().get(), payload.get());
+    BOOST_CHECK_EQUAL(auction.requestPayloadFormat(), "test");
+    BOOST_CHECK(!auction.hasRequestStr());
+
+    // The canonical encoding is done once and cached
+    BOOST_CHECK_EQUAL(auction.requestStr(), br->toJsonStr());
+    BOOST_CHECK_EQUAL(auction.requestStrFormat(), "datacratic");
+    BOOST_CHECK_EQUAL(auction.requestStr(), br->toJsonStr());
+    BOOST_CHECK_EQUAL(Auction::requestStrEncoded, before + 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_eager_request_str )
+{
+    auto br = makeRequest();
+    long long before = Auction::requestStrEncoded;
+
+    Auction auction(nullptr, Auction::HandleAuction(), br, std::string("{}"), "custom",
+                    Date::now(), Date::now().plusSeconds(0.1));
+
+    BOOST_CHECK(auction.hasRequestStr());
+    BOOST_CHECK_EQUAL(auction.requestStr(), "{}");
+    BOOST_CHECK_EQUAL(auction.requestStrFormat(), "custom");
+    BOOST_CHECK(!auction.requestPayload());
+    BOOST_CHECK_EQUAL(Auction::requestStrEncoded, before);
+}
+
+BOOST_AUTO_TEST_CASE( test_agent_augmentations )
+{
+    Auction auction(nullptr, Auction::HandleAuction(), makeRequest(),
+                    std::string("{}"), "custom",
+                    Date::now(), Date::now().plusSeconds(0.1));
+
+    auto & augs = auction.augmentations;
+    augs["aug1"].insertGlobal(Augmentation(std::set<std::string>{ "all" }));
+    augs["aug1"][AccountKey("a:b")].tags.insert("ab");
+    augs["aug2"][AccountKey("c")].tags.insert("c");
+
+    // What the router used to compute for every agent
+    auto expected = [&] (const AccountKey & account) {
+        Json::Value result;
+        for (const auto & aug : augs)
+            result[aug.first] = aug.second.filterForAccount(account).toJson();
+        std::string str = result.toString();
+        return str.substr(0, str.find_last_not_of('\n') + 1);
+    };
+
+    auto & agentAugs = auction.agentAugmentations;
+    BOOST_CHECK_EQUAL(agentAugs.add("agent1", AccountKey("a:b:x"), augs), 0);
+    BOOST_CHECK_EQUAL(agentAugs.add("agent2", AccountKey("a:b"), augs), 1);
+    BOOST_CHECK_EQUAL(agentAugs.add("agent3", AccountKey("a:c"), augs), 2);
+    BOOST_CHECK_EQUAL(agentAugs.add("agent4", AccountKey("c:d"), augs), 3);
+
+    BOOST_CHECK_EQUAL(agentAugs.size(), 4);
+    BOOST_CHECK_EQUAL(agentAugs.numEncodings(), 3);
+    BOOST_CHECK_EQUAL(agentAugs.slot("agent3"), 2);
+    BOOST_CHECK_EQUAL(agentAugs.slot("unknown"), -1);
+
+    BOOST_CHECK_EQUAL(agentAugs.get("agent1"), expected(AccountKey("a:b:x")));
+    BOOST_CHECK_EQUAL(agentAugs.get("agent2"), expected(AccountKey("a:b")));
+    BOOST_CHECK_EQUAL(agentAugs.get("agent3"), expected(AccountKey("a:c")));
+    BOOST_CHECK_EQUAL(agentAugs.get(3), expected(AccountKey("c:d")));
+    BOOST_CHECK_EQUAL(agentAugs.get("unknown"), "");
+
+    // Agents that see the same entries share the string
+    BOOST_CHECK_EQUAL(&agentAugs.get("agent1"), &agentAugs.get("agent2"));
+    BOOST_CHECK_NE(&agentAugs.get("agent1"), &agentAugs.get("agent3"));
+}
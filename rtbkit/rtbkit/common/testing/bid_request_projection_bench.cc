@@ -0,0 +1,210 @@
+/** bid_request_projection_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Wire size and augmentor side parse time of the full bid request versus the
+    field projections requested by the stock augmentors.
+
+*/
+
+#include "rtbkit/common/bid_request_projection.h"
+#include "soa/types/date.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <iostream>
+#include <fstream>
+#include <memory>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/******************************************************************************/
+/* CONFIG                                                                     */
+/******************************************************************************/
+
+struct Config
+{
+    Config() :
+        iterations(100000)
+    {}
+
+    size_t iterations;
+    string file;
+};
+
+Config getConfig(int argc, char** argv)
+{
+    using namespace boost::program_options;
+
+    Config config;
+
+    options_description opt("Bench options");
+    opt.add_options()
+        ("iterations,n", value<size_t>(&config.iterations),
+         "number of parses per format")
+        ("file,f", value<string>(&config.file),
+         "datacratic format bid request to use instead of the built-in one")
+        ("help,h","print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(opt).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << opt << endl;
+        exit(1);
+    }
+
+    return config;
+}
+
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+std::shared_ptr<BidRequest> makeRequest()
+{
+    auto br = std::make_shared<BidRequest>();
+    br->auctionId = Id("a8f72e0c-9f6c-4d1e-8a41-3c2bbd6e1f07");
+    br->exchange = "adaptv";
+    br->protocolVersion = "2.2";
+    br->url = Url("http://www.example.com/videos/some-article-about-something.html");
+    br->language = Utf8String("en");
+    br->userAgent = Utf8String(
+            "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 "
+            "(KHTML, like Gecko) Chrome/51.0.2704.103 Safari/537.36");
+    br->ipAddress = "172.16.254.1";
+    br->ext["inventoryType"] = "standard";
+
+    br->imp.emplace_back();
+    auto& imp = br->imp[0];
+    imp.id = Id("1");
+    imp.formats.push_back(Format(640, 480));
+    imp.video.reset(new OpenRTB::Video());
+    imp.video->mimes.push_back(OpenRTB::MimeType("video/mp4"));
+    imp.video->mimes.push_back(OpenRTB::MimeType("application/javascript"));
+    imp.video->minduration = 5;
+    imp.video->maxduration = 30;
+    imp.video->w = 640;
+    imp.video->h = 480;
+    imp.video->ext["viewability"] = 65;
+
+    br->site.reset(new OpenRTB::Site());
+    br->site->id = Id("site42");
+    br->site->domain = "www.example.com";
+    br->site->page = br->url;
+    br->site->publisher.reset(new OpenRTB::Publisher());
+    br->site->publisher->id = Id("pub1337");
+    br->site->publisher->name = Utf8String("Example Publisher");
+
+    br->device.reset(new OpenRTB::Device());
+    br->device->ua = br->userAgent;
+    br->device->ip = br->ipAddress;
+    br->device->language = Utf8String("en");
+    br->device->os = Utf8String("Windows");
+    br->device->geo.reset(new OpenRTB::Geo());
+    br->device->geo->country = "USA";
+    br->device->geo->region = "CA";
+    br->device->geo->city = Utf8String("San Francisco");
+
+    br->user.reset(new OpenRTB::User());
+    br->user->id = Id("5d8f3fda-d4f0-4a25-9b20-8f5c9bb8b1d1");
+    br->user->buyeruid = Id("buyer-0123456789");
+
+    br->userIds.add(br->user->id, ID_EXCHANGE);
+    br->segments.addStrings("iab", { "IAB1", "IAB12" });
+
+    return br;
+}
+
+template<typename Fn>
+double timeIt(size_t iterations, Fn&& fn)
+{
+    Date start = Date::now();
+    for (size_t i = 0; i < iterations; ++i) fn();
+    return Date::now().secondsSince(start) / iterations * 1e6;
+}
+
+void bench(const Config& config, const BidRequest& br)
+{
+    string full = br.toJsonStr();
+
+    double fullUs = timeIt(config.iterations, [&] {
+                std::unique_ptr<BidRequest> parsed(
+                        BidRequest::parse("datacratic", full));
+            });
+
+    cerr << "full bid request:  " << full.size() << " bytes, "
+         << fullUs << " us/parse" << endl;
+
+    struct Projection {
+        const char* name;
+        BidRequestFields fields;
+    };
+
+    Projection projections[] = {
+        { "viewability", { BRF_EXCHANGE, BRF_URL, BRF_EXT, BRF_IMP, BRF_SITE } },
+        { "forensiq", { BRF_EXCHANGE, BRF_USER_AGENT, BRF_DEVICE, BRF_APP, BRF_SITE, BRF_USER } },
+        { "exchange", { BRF_EXCHANGE, BRF_EXT } },
+    };
+
+    for (const auto& projection : projections) {
+        string encoded;
+        double encodeUs = timeIt(config.iterations, [&] {
+                    encoded = projectBidRequest(br, projection.fields);
+                });
+
+        /* Augmentors read each of their fields once. */
+        double decodeUs = timeIt(config.iterations, [&] {
+                    BidRequestView view(encoded);
+                    for (int field = 1; field < BRF_MAX_FIELD; ++field) {
+                        if (!projection.fields.has(BidRequestField(field))) continue;
+                        switch (field) {
+                        case BRF_EXCHANGE: view.exchange(); break;
+                        case BRF_URL: view.url(); break;
+                        case BRF_LANGUAGE: view.language(); break;
+                        case BRF_USER_AGENT: view.userAgent(); break;
+                        case BRF_IP_ADDRESS: view.ipAddress(); break;
+                        case BRF_EXT: view.ext(); break;
+                        case BRF_IMP: view.imp(); break;
+                        case BRF_SITE: view.site(); break;
+                        case BRF_APP: view.app(); break;
+                        case BRF_DEVICE: view.device(); break;
+                        case BRF_USER: view.user(); break;
+                        case BRF_LOCATION: view.location(); break;
+                        }
+                    }
+                });
+
+        cerr << projection.name << " projection: "
+             << encoded.size() << " bytes ("
+             << 100.0 * encoded.size() / full.size() << "%), "
+             << decodeUs << " us/parse (" << fullUs / decodeUs << "x), "
+             << encodeUs << " us/encode" << endl;
+    }
+}
+
+
+/******************************************************************************/
+/* MAIN                                                                       */
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    auto config = getConfig(argc, argv);
+
+    std::shared_ptr<BidRequest> br;
+    if (config.file.empty()) br = makeRequest();
+    else {
+        ifstream stream(config.file);
+        string str((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+        br.reset(BidRequest::parse("datacratic", str));
+    }
+
+    bench(config, *br);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/* bid_request_projection_test.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Tests for the bid request projection sent to augmentors.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/common/bid_request_projection.h"
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace RTBKIT;
+using namespace Datacratic;
+
+namespace {
+
+std::shared_ptr<BidRequest> makeRequest()
+{
+    auto br = std::make_shared<BidRequest>();
+    br->auctionId = Id("auction1");
+    br->exchange = "adaptv";
+    br->url = Url("http://www.example.com/page.html");
+    br->userAgent = Utf8String("Mozilla/5.0 (X11; Linux x86_64)");
+    br->ipAddress = "10.0.0.1";
+    br->ext["inventoryType"] = "highviewable";
+
+    br->imp.emplace_back();
+    br->imp[0].id = Id("imp1");
+    br->imp[0].formats.push_back(Format(300, 250));
+    br->imp[0].video.reset(new OpenRTB::Video());
+    br->imp[0].video->ext["viewability"] = 75;
+
+    br->site.reset(new OpenRTB::Site());
+    br->site->page = Url("http://www.example.com/page.html");
+    br->site->publisher.reset(new OpenRTB::Publisher());
+    br->site->publisher->id = Id("pub1");
+
+    br->device.reset(new OpenRTB::Device());
+    br->device->ip = "10.0.0.1";
+
+    return br;
+}
+
+} // namespace anonymous
+
+BOOST_AUTO_TEST_CASE( test_fields )
+{
+    BidRequestFields fields { BRF_EXCHANGE, BRF_IMP, BRF_USER_AGENT };
+    BOOST_CHECK(fields.has(BRF_IMP));
+    BOOST_CHECK(!fields.has(BRF_SITE));
+    BOOST_CHECK_EQUAL(fields.toString(), "exchange,userAgent,imp");
+    BOOST_CHECK(BidRequestFields::parse(fields.toString()) == fields);
+
+    BOOST_CHECK(BidRequestFields::parse("").empty());
+    BOOST_CHECK_THROW(BidRequestFields::parse("exchange,bogus"), ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_projection_round_trip )
+{
+    auto br = makeRequest();
+
+    BidRequestFields fields {
+        BRF_EXCHANGE, BRF_URL, BRF_EXT, BRF_IMP, BRF_SITE, BRF_USER_AGENT, BRF_USER
+    };
+    BidRequestView view(projectBidRequest(*br, fields));
+
+    BOOST_CHECK(!view.empty());
+    BOOST_CHECK_EQUAL(view.exchange(), "adaptv");
+    BOOST_CHECK_EQUAL(view.url().toString(), br->url.toString());
+    BOOST_CHECK_EQUAL(view.userAgent(), br->userAgent);
+    BOOST_CHECK_EQUAL(view.ext()["inventoryType"].asString(), "highviewable");
+
+    auto imp = view.imp();
+    BOOST_REQUIRE_EQUAL(imp.size(), 1);
+    BOOST_CHECK_EQUAL(imp[0].id, Id("imp1"));
+    BOOST_REQUIRE_EQUAL(imp[0].formats.size(), 1);
+    BOOST_CHECK_EQUAL(imp[0].formats[0].width, 300);
+    BOOST_REQUIRE(imp[0].video);
+    BOOST_CHECK_EQUAL(imp[0].video->ext["viewability"].asInt(), 75);
+
+    auto site = view.site();
+    BOOST_REQUIRE(site);
+    BOOST_REQUIRE(site->publisher);
+    BOOST_CHECK_EQUAL(site->publisher->id, Id("pub1"));
+
+    // Requested but absent from the bid request.
+    BOOST_CHECK(!view.has(BRF_USER));
+    BOOST_CHECK(!view.user());
+
+    // Not requested.
+    BOOST_CHECK(!view.has(BRF_DEVICE));
+    BOOST_CHECK(!view.device());
+    BOOST_CHECK_EQUAL(view.ipAddress(), "");
+
+    auto partial = view.toBidRequest();
+    BOOST_CHECK_EQUAL(partial->exchange, "adaptv");
+    BOOST_CHECK_EQUAL(partial->imp.size(), 1);
+    BOOST_CHECK(!partial->device);
+}
+
+BOOST_AUTO_TEST_CASE( test_projection_is_smaller )
+{
+    auto br = makeRequest();
+    string full = br->toJsonStr();
+    string projection = projectBidRequest(*br, { BRF_EXCHANGE, BRF_EXT });
+
+    BOOST_CHECK_LT(projection.size(), full.size() / 4);
+    BOOST_CHECK_EQUAL(BidRequestView(projection).exchange(), "adaptv");
+}
+
+BOOST_AUTO_TEST_CASE( test_full_view )
+{
+    std::shared_ptr<const BidRequest> br = makeRequest();
+    BidRequestView view(br);
+
+    BOOST_CHECK(view.has(BRF_DEVICE));
+    BOOST_CHECK_EQUAL(view.exchange(), "adaptv");
+    BOOST_CHECK_EQUAL(view.device()->ip, "10.0.0.1");
+    BOOST_CHECK_EQUAL(view.toBidRequest(), br);
+}
+
+BOOST_AUTO_TEST_CASE( test_malformed_projection )
+{
+    string projection = projectBidRequest(*makeRequest(), { BRF_EXCHANGE });
+
+    BOOST_CHECK_THROW(BidRequestView(projection.substr(0, projection.size() - 1)),
+                      ML::Exception);
+    BOOST_CHECK_THROW(BidRequestView(string("\x02", 1)), ML::Exception);
+
+    // Records with unknown tags are skipped.
+    string future = projection + string("\x3f\x01x", 3);
+    BOOST_CHECK_EQUAL(BidRequestView(future).exchange(), "adaptv");
+}
@@ -6,3 +6,7 @@ $(eval $(call test,currency_test,bid_request,boost))
 $(eval $(call test,filter_test,filter_registry,boost))
 $(eval $(call test,bids_test,rtb,boost))
 
+$(eval $(call test,auction_test,rtb,boost))
+
+$(eval $(call test,bid_request_projection_test,bid_request,boost))
+$(eval $(call program,bid_request_projection_bench,bid_request boost_program_options))
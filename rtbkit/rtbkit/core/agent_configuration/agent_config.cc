@@ -503,7 +503,8 @@ AgentConfig()
       bidControlType(BC_RELAY), fixedBidCpmInMicros(0),
       winFormat(BRF_FULL),
       lossFormat(BRF_LIGHTWEIGHT),
-      errorFormat(BRF_LIGHTWEIGHT)
+      errorFormat(BRF_LIGHTWEIGHT),
+      locationFilterCompiled(false)
 {
     addAugmentation("random");
 }
@@ -734,6 +735,8 @@ createFromJson(const Json::Value & json)
             newConfig.whiteBlackList.createFromJson(*it);
         else if (it.memberName() == "dmaFilter")
             newConfig.dmaFilter.fromJson(*it, "dmaFilter");
+        else if (it.memberName() == "geoFilter")
+            newConfig.geoFilter.fromJson(*it, "geoFilter");
         else if (it.memberName() == "videoLinearityFilter")
             newConfig.videoLinearityFilter.fromJson(*it, "videoLinearityFilter");
         else if (it.memberName() == "videoApiFilter")
@@ -861,6 +864,13 @@ createFromJson(const Json::Value & json)
     if (newConfig.creatives.empty())
         throw Exception("can't configure a agent with no creatives");
 
+    // Zip alternations are way cheaper to match as a set than as a regex.
+    // Both filters have to pass so they can only be merged if one is empty.
+    if (newConfig.geoFilter.empty()) {
+        newConfig.locationFilterCompiled = JamLoop::compileLocationFilter(
+                newConfig.locationFilter, newConfig.geoFilter);
+    }
+
     return newConfig;
 }
 
@@ -920,6 +930,8 @@ toJson(bool includeCreatives) const
         result["whiteBlackList"] = whiteBlackList.toJson();
     if (!dmaFilter.empty())
         result["dmaFilter"] = dmaFilter.toJson();
+    if (!geoFilter.empty() && !locationFilterCompiled)
+        result["geoFilter"] = geoFilter.toJson();
     if (!videoLinearityFilter.empty())
         result["videoLinearityFilter"] = videoLinearityFilter.toJson();
     if (!videoApiFilter.empty())
@@ -17,6 +17,7 @@
 #include "include_exclude.h"
 #include "fees.h"
 #include "white_black_list.h"
+#include "geo_targeting.h"
 #include "rtbkit/common/account_key.h"
 #include "rtbkit/core/agent_configuration/latlonrad.h"
 
@@ -340,6 +341,13 @@ struct AgentConfig {
     IncludeExclude<OpenRTB::DeviceType> deviceTypeFilter;
     JamLoop::WhiteBlackList whiteBlackList;
     JamLoop::DmaList dmaFilter;
+
+    /// Zip, metro, region and country sets matched by the Geo filter
+    JamLoop::GeoTargeting geoFilter;
+
+    /// The locationFilter was only made of zip alternations and was compiled
+    /// into geoFilter, which means the Location filter ignores it.
+    bool locationFilterCompiled;
     IncludeExclude<OpenRTB::VideoLinearity> videoLinearityFilter;
     IncludeExclude<
         OpenRTB::ApiFramework, Datacratic::List<OpenRTB::ApiFramework>
@@ -8,7 +8,8 @@ LIBAGENT_CONFIGURATION_SOURCES := \
 	agent_configuration_service.cc \
 	latlonrad.cc \
 	fees.cc \
-	white_black_list.cc
+	white_black_list.cc \
+	geo_targeting.cc
 
 LIBAGENT_CONFIGURATION_LINK := \
 	rtb zeromq boost_thread opstats gc services utils monitor
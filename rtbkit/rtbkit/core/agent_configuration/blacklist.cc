@@ -101,6 +101,8 @@ doExpiries()
 {
     Date start = Date::now();
 
+    std::lock_guard<ML::Spinlock> guard(lock);
+
     auto onBlacklistFinished = [&] (const Id & userId,
                                     BlacklistInfo & info)
         {
@@ -115,10 +117,11 @@ Blacklist::
 matches(const BidRequest & bidRequest, const std::string & agentName,
         const AgentConfig & config) const
 {  
+    std::lock_guard<ML::Spinlock> guard(lock);
+
     bool blocked = false;
     const Id & exchangeId = bidRequest.userIds.exchangeId;
     if (!blocked && exchangeId) {
-        // TODO: read lock
         auto bit = entries.find(exchangeId);
         if (bit != entries.end()) {
             const BlacklistInfo & binfo = bit->second;
@@ -128,7 +131,6 @@ matches(const BidRequest & bidRequest, const std::string & agentName,
     }
     const Id & providerId = bidRequest.userIds.providerId;
     if (!blocked && providerId) {
-        // TODO: read lock
         auto bit = entries.find(providerId);
         if (bit != entries.end()) {
             const BlacklistInfo & binfo = bit->second;
@@ -162,7 +164,8 @@ add(const BidRequest & bidRequest, const std::string & agent,
                 this->entries.insert(id, binfo, timeout);
             }
         };
-    
+
+    std::lock_guard<ML::Spinlock> guard(lock);
     addToBlacklist(bidRequest.userIds.exchangeId);
     addToBlacklist(bidRequest.userIds.providerId);
 }
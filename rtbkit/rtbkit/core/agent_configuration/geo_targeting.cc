@@ -0,0 +1,154 @@
+/* geo_targeting.cc
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Implementation of the structured geo targeting
+*/
+
+#include "geo_targeting.h"
+#include "jml/arch/exception.h"
+
+namespace JamLoop {
+
+    namespace {
+        void parseStrings(
+                const Json::Value& value, const std::string& name,
+                std::unordered_set<std::string>& set)
+        {
+            if (!value.isArray())
+                throw ML::Exception("%s must be an array", name.c_str());
+
+            for (const auto& elem: value)
+                set.insert(elem.asString());
+        }
+
+        template<typename T>
+        Json::Value toArray(const std::unordered_set<T>& set) {
+            Json::Value result(Json::arrayValue);
+            for (const auto& elem: set)
+                result.append(elem);
+            return result;
+        }
+    }
+
+    bool
+    GeoSets::empty() const {
+        return zips.empty() && metros.empty() && regions.empty() && countries.empty();
+    }
+
+    void
+    GeoSets::fromJson(const Json::Value& value, const std::string& name) {
+        if (!value.isObject())
+            throw ML::Exception("%s must be an object", name.c_str());
+
+        for (auto it = value.begin(), end = value.end(); it != end; ++it) {
+            auto key = it.memberName();
+            if (key == "zip")
+                parseStrings(*it, name + ".zip", zips);
+            else if (key == "region")
+                parseStrings(*it, name + ".region", regions);
+            else if (key == "country")
+                parseStrings(*it, name + ".country", countries);
+            else if (key == "metro") {
+                if (!it->isArray())
+                    throw ML::Exception("%s.metro must be an array", name.c_str());
+                /* DMA codes are usually written as strings */
+                for (const auto& elem: *it)
+                    metros.insert(elem.isString() ? std::stoi(elem.asString()) : elem.asInt());
+            }
+            else
+                throw ML::Exception("%s has invalid key: %s", name.c_str(), key.c_str());
+        }
+    }
+
+    Json::Value
+    GeoSets::toJson() const {
+        Json::Value result(Json::objectValue);
+        if (!zips.empty()) result["zip"] = toArray(zips);
+        if (!metros.empty()) result["metro"] = toArray(metros);
+        if (!regions.empty()) result["region"] = toArray(regions);
+        if (!countries.empty()) result["country"] = toArray(countries);
+        return result;
+    }
+
+    void
+    GeoTargeting::fromJson(const Json::Value& value, const std::string& name) {
+        for (auto it = value.begin(), end = value.end(); it != end; ++it) {
+            if (it.memberName() == "include")
+                include.fromJson(*it, name + ".include");
+            else if (it.memberName() == "exclude")
+                exclude.fromJson(*it, name + ".exclude");
+            else
+                throw ML::Exception("filter %s has invalid key: %s",
+                                    name.c_str(), it.memberName().c_str());
+        }
+    }
+
+    Json::Value
+    GeoTargeting::toJson() const {
+        Json::Value result(Json::objectValue);
+        if (!include.empty()) result["include"] = include.toJson();
+        if (!exclude.empty()) result["exclude"] = exclude.toJson();
+        return result;
+    }
+
+    bool
+    parseZipAlternation(const std::string& regex, std::vector<std::string>& zips) {
+        size_t begin = 0;
+        size_t end = regex.size();
+        if (end >= 2 && regex[0] == '(' && regex[end - 1] == ')') {
+            ++begin;
+            --end;
+        }
+
+        std::vector<std::string> result;
+        std::string current;
+
+        for (size_t i = begin; i <= end; ++i) {
+            if (i == end || regex[i] == '|') {
+                if (current.size() != 5) return false;
+                result.push_back(std::move(current));
+                current.clear();
+            }
+            else if (regex[i] >= '0' && regex[i] <= '9')
+                current.push_back(regex[i]);
+            else
+                return false;
+        }
+
+        zips.insert(zips.end(), result.begin(), result.end());
+        return true;
+    }
+
+    bool
+    compileLocationFilter(const LocationRegexes& filter, GeoTargeting& targeting) {
+        if (filter.empty()) return false;
+
+        auto compile = [](
+                const std::vector<LocationRegex>& regexes,
+                GeoSets& sets)
+        {
+            std::vector<std::string> zips;
+            for (const auto& regex: regexes) {
+                /* Only ASCII can make up a zip alternation */
+                std::string str;
+                for (auto c: regex.base.str()) {
+                    if (c > 0x7f) return false;
+                    str.push_back(static_cast<char>(c));
+                }
+
+                if (!parseZipAlternation(str, zips)) return false;
+            }
+
+            sets.zips.insert(zips.begin(), zips.end());
+            return true;
+        };
+
+        GeoTargeting result;
+        if (!compile(filter.include, result.include)) return false;
+        if (!compile(filter.exclude, result.exclude)) return false;
+
+        targeting = std::move(result);
+        return true;
+    }
+
+} // namespace JamLoop
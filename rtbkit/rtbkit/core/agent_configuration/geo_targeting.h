@@ -0,0 +1,62 @@
+/* geo_targeting.h
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Structured geo targeting by zip, metro, region and country sets
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <boost/regex/icu.hpp>
+#include "soa/jsoncpp/value.h"
+#include "soa/types/string.h"
+#include "include_exclude.h"
+
+namespace JamLoop {
+
+    /* A location is in the sets if any of its fields is in the corresponding
+     * set. The metro is the Nielsen DMA code.
+     */
+    struct GeoSets {
+        std::unordered_set<std::string> zips;
+        std::unordered_set<int> metros;
+        std::unordered_set<std::string> regions;
+        std::unordered_set<std::string> countries;
+
+        bool empty() const;
+
+        void fromJson(const Json::Value& value, const std::string& name);
+        Json::Value toJson() const;
+    };
+
+    struct GeoTargeting {
+        GeoSets include;
+        GeoSets exclude;
+
+        bool empty() const {
+            return include.empty() && exclude.empty();
+        }
+
+        void fromJson(const Json::Value& value, const std::string& name);
+        Json::Value toJson() const;
+    };
+
+    typedef RTBKIT::CachedRegex<boost::u32regex, Datacratic::UnicodeString> LocationRegex;
+    typedef RTBKIT::IncludeExclude<LocationRegex> LocationRegexes;
+
+    /* Returns whether the regex is nothing but an alternation of US zip codes
+     * like "(47201|47202|47203)", in which case the zips are appended.
+     *
+     * Since a location regex is searched in COUNTRY:REGION:CITY:POSTAL:DMA:METRO,
+     * a five digits literal can only ever match the postal code.
+     */
+    bool parseZipAlternation(const std::string& regex, std::vector<std::string>& zips);
+
+    /* Compiles a location filter made only of zip alternations into geo sets.
+     * Returns false, leaving targeting untouched, if any regex isn't one.
+     */
+    bool compileLocationFilter(const LocationRegexes& filter, GeoTargeting& targeting);
+
+} // namespace JamLoop
@@ -6,6 +6,9 @@
 */
 
 #include "white_black_list.h"
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
 
 namespace JamLoop {
 
@@ -28,10 +31,12 @@ namespace JamLoop {
 
     bool
     WhiteBlackList::Directory::matches(const Datacratic::Url& url) const {
-        auto p = url.path();
-        auto beg = std::begin(p);
-        if (*beg == '/')
-            ++beg;
+        return matches(url.path());
+    }
+
+    bool
+    WhiteBlackList::Directory::matches(const std::string& urlPath) const {
+        size_t start = !urlPath.empty() && urlPath[0] == '/';
 
         /*
          * domain = www.domain.com/section/subsection
@@ -43,23 +48,52 @@ namespace JamLoop {
          *    -> Unmatch
          */
 
-        return std::equal(std::begin(path), std::end(path), beg);
+        return urlPath.size() - start >= path.size()
+            && !urlPath.compare(start, path.size(), path);
     }
 
     void
     WhiteBlackList::addWhite(const std::string& val) {
-        addList(white, val);
+        addList(mutableLists().white, val);
     }
 
     void WhiteBlackList::addBlack(const std::string& val) {
-        addList(black, val);
+        addList(mutableLists().black, val);
+    }
+
+    const WhiteBlackList::List&
+    WhiteBlackList::whiteList() const {
+        static const List none;
+        return lists ? lists->white : none;
+    }
+
+    const WhiteBlackList::List&
+    WhiteBlackList::blackList() const {
+        static const List none;
+        return lists ? lists->black : none;
+    }
+
+    WhiteBlackList::Lists&
+    WhiteBlackList::mutableLists() {
+        // Held by lists and owned only: nobody else can see the changes.
+        if (owned && owned == lists && owned.use_count() == 2)
+            return *owned;
+
+        if (lists)
+            owned = std::make_shared<Lists>(*lists);
+        else
+            owned = std::make_shared<Lists>();
+
+        lists = owned;
+        return *owned;
     }
 
     WhiteBlackList::Result
     WhiteBlackList::filter(const Domain& domain, const Datacratic::Url& url) const {
 
-        auto tryMatch = [](
-            const List& list, const Domain& domain, const Datacratic::Url& url) {
+        const auto urlPath = url.path();
+
+        auto tryMatch = [&urlPath](const List& list, const Domain& domain) {
 
             auto it = list.find(domain);
             if (it != std::end(list)) {
@@ -69,8 +103,8 @@ namespace JamLoop {
                     return true;
                 }
 
-                auto matchesUrl = [&url](const Directory& dir) {
-                    return dir.matches(url);
+                auto matchesUrl = [&urlPath](const Directory& dir) {
+                    return dir.matches(urlPath);
                 };
 
                 if (std::any_of(std::begin(directories), std::end(directories), matchesUrl)) {
@@ -82,12 +116,12 @@ namespace JamLoop {
             return false;
         };
 
-        if (tryMatch(white, domain, url))
+        if (tryMatch(whiteList(), domain))
             return Result::Whitelisted;
-        else if (tryMatch(black, domain, url))
+        else if (tryMatch(blackList(), domain))
             return Result::Blacklisted;
 
-        if (white.empty())
+        if (whiteList().empty())
             return Result::Whitelisted;
 
         return Result::NotFound;
@@ -106,7 +140,8 @@ namespace JamLoop {
 
     void
     WhiteBlackList::createFromJson(const Json::Value& value) {
-        white.clear();
+        lists.reset();
+        owned.reset();
 
         if (value.isMember("whiteFile") && !value.isMember("blackFile")) {
             throw ML::Exception("Missing 'blackFile' parameter for WhiteBlackList");
@@ -137,6 +172,48 @@ namespace JamLoop {
 
     void
     WhiteBlackList::createFromFile(std::string whiteFile, std::string blackFile) {
+        lists = loadShared(whiteFile, blackFile);
+        owned.reset();
+
+        this->whiteFile = std::move(whiteFile);
+        this->blackFile = std::move(blackFile);
+    }
+
+    std::shared_ptr<const WhiteBlackList::Lists>
+    WhiteBlackList::loadShared(const std::string& whiteFile, const std::string& blackFile) {
+
+        /* The lists loaded from a pair of files are reused for as long as
+           one config still holds them and the files were not modified. */
+        struct Entry {
+            std::weak_ptr<const Lists> lists;
+            time_t whiteModified;
+            time_t blackModified;
+        };
+
+        static std::mutex lock;
+        static std::map<std::pair<std::string, std::string>, Entry> loaded;
+
+        auto modified = [](const std::string& file) -> time_t {
+            struct stat st;
+            if (stat(file.c_str(), &st) == -1)
+                return -1;
+            return st.st_mtime;
+        };
+
+        const auto key = std::make_pair(whiteFile, blackFile);
+        const time_t whiteModified = modified(whiteFile);
+        const time_t blackModified = modified(blackFile);
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto it = loaded.find(key);
+        if (it != loaded.end()
+            && it->second.whiteModified == whiteModified
+            && it->second.blackModified == blackModified) {
+            if (auto lists = it->second.lists.lock())
+                return lists;
+        }
+
         ML::filter_istream whiteIn(whiteFile);
         if (!whiteIn) {
             throw ML::Exception("Could not open whitelist file '%s'", whiteFile.c_str());
@@ -147,17 +224,29 @@ namespace JamLoop {
             throw ML::Exception("Could not open blacklist file '%s'", blackFile.c_str());
         }
 
+        auto lists = std::make_shared<Lists>();
 
         std::string elem;
         while (std::getline(whiteIn, elem)) {
-            addList(white, elem);
+            addList(lists->white, elem);
         }
         while (std::getline(blackIn, elem)) {
-            addList(black, elem);
+            addList(lists->black, elem);
         }
 
-        this->whiteFile = std::move(whiteFile);
-        this->blackFile = std::move(blackFile);
+        // Files that we can't stat (s3 for example) are always reloaded
+        if (whiteModified != -1 && blackModified != -1) {
+            for (auto entry = loaded.begin(); entry != loaded.end();) {
+                if (entry->second.lists.expired())
+                    entry = loaded.erase(entry);
+                else
+                    ++entry;
+            }
+
+            loaded[key] = Entry { lists, whiteModified, blackModified };
+        }
+
+        return lists;
     }
 
     void
@@ -173,7 +262,7 @@ namespace JamLoop {
     }
 
     std::pair<WhiteBlackList::Domain, std::string>
-    WhiteBlackList::splitDomain(std::string url) const {
+    WhiteBlackList::splitDomain(std::string url) {
         url.erase(std::remove(url.begin(), url.end(), '\r'), url.end());
         url.erase(std::remove(url.begin(), url.end(), '\n'), url.end());
 
@@ -10,6 +10,8 @@
 
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
 #include "jml/utils/filter_streams.h"
 #include "jml/arch/exception.h"
 #include "soa/jsoncpp/value.h"
@@ -41,6 +43,26 @@ namespace JamLoop {
             NotFound
         };
 
+        struct Directory {
+            Directory(std::string path);
+
+            bool matches(const Datacratic::Url& url) const;
+
+            /* urlPath is the path of the page url, as returned by Url::path() */
+            bool matches(const std::string& urlPath) const;
+
+            std::string path;
+        };
+
+#ifdef REDUCE_MEMORY_ALLOCS
+        typedef ML::compact_vector<Directory, 4> Directories;
+#else
+        typedef std::vector<Directory> Directories;
+#endif
+
+        /* A domain without any directory is listed as a whole */
+        typedef std::unordered_map<Domain, Directories> List;
+
         Json::Value toJson() const;
 
         void addWhite(const std::string& val);
@@ -51,35 +73,41 @@ namespace JamLoop {
 
         Result filter(const Domain& domain, const Datacratic::Url& url) const;
 
+        const List& whiteList() const;
+        const List& blackList() const;
+
         bool empty() const {
-            return white.empty() && black.empty();
+            return !lists || (lists->white.empty() && lists->black.empty());
         }
 
     private:
         std::string whiteFile;
         std::string blackFile;
 
-        struct Directory {
-            Directory(std::string path);
-
-            bool matches(const Datacratic::Url& url) const;
-        private:
-            std::string path;
+        struct Lists {
+            List white;
+            List black;
         };
 
-#ifdef REDUCE_MEMORY_ALLOCS
-        typedef ML::compact_vector<Directory, 4> Directories;
-#else
-        typedef std::vector<Directory> Directories;
-#endif
+        /* Our lists are big (tens of thousands of domains) and usually
+           referenced by many agents, so the lists loaded from the same files
+           are shared by all the configs that use them.  They are never
+           modified once shared: addWhite() and addBlack() work on a copy.
+        */
+        std::shared_ptr<const Lists> lists;
 
-        typedef std::unordered_map<Domain, Directories> List;
-        List white;
-        List black;
+        /* The copy made by mutableLists(), which further additions modify in
+           place for as long as no other list shares it. */
+        std::shared_ptr<Lists> owned;
+
+        Lists& mutableLists();
+
+        static std::shared_ptr<const Lists>
+        loadShared(const std::string& whiteFile, const std::string& blackFile);
 
-        void addList(List& list, const std::string& line);
+        static void addList(List& list, const std::string& line);
 
-        std::pair<Domain, std::string> splitDomain(std::string url) const;
+        static std::pair<Domain, std::string> splitDomain(std::string url);
     };
 
     const char* whiteBlackString(WhiteBlackList::Result result);
@@ -296,6 +296,29 @@ public:
                               const std::string & item,
                               Amount amount) = 0;
 
+    /*
+     * Resolve the account to a slot that can be handed back to authorizeBid
+     * in place of the account key, which lets bankers skip the account
+     * lookup on every bid. This is meant to be called at configuration time.
+     * Bankers that don't support it return -1.
+     */
+    virtual int accountSlot(const AccountKey & account)
+    {
+        return -1;
+    }
+
+    /*
+     * Same as authorizeBid above for an account previously resolved with
+     * accountSlot. A slot of -1 falls back to the account key.
+     */
+    virtual bool authorizeBid(int slot,
+                              const AccountKey & account,
+                              const std::string & item,
+                              Amount amount)
+    {
+        return authorizeBid(account, item, amount);
+    }
+
     /*
      * Cancel the bid that was previously authorized. If we fail to find the bid
      * we return false.Otherwise we return the bid amount to the available pool
@@ -77,20 +77,18 @@ GoAccount::toJson()
 // Router Account
 
 GoRouterAccount::GoRouterAccount(const AccountKey &key)
-    : GoBaseAccount(key)
+    : GoBaseAccount(key), balance(0), bidsLastPeriod(0)
 {
     rate = MicroUSD(0);
-    balance = MicroUSD(0);
 }
 
 GoRouterAccount::GoRouterAccount(Json::Value &json)
-    : GoBaseAccount(json)
+    : GoBaseAccount(json), balance(0), bidsLastPeriod(0)
 {
     if (json.isMember("rate")) rate = MicroUSD(json["rate"].asInt());
     else rate = MicroUSD(0);
 
-    if (json.isMember("balance")) balance = MicroUSD(json["balance"].asInt());
-    else balance = MicroUSD(0);
+    if (json.isMember("balance")) balance = json["balance"].asInt();
 }
 
 void
@@ -99,11 +97,16 @@ GoRouterAccount::setMaxBalance(const Amount & newMaxBalance)
     maxBalance = newMaxBalance;
 }
 
+/* The balance and spend updates are only ever done by the sync thread while
+ * the bidding threads keep decrementing the balance, so the previous balance
+ * is what the sync thread left behind and the difference is what was bid
+ * since.
+ */
 Amount
 GoRouterAccount::updateBalance(const Amount & newBalance)
 {
-    Amount spent = previousBalance - balance;
-    balance = newBalance;
+    int64_t current = balance.exchange(MicroUSD(newBalance).value);
+    Amount spent = previousBalance - MicroUSD(current);
     previousBalance = newBalance;
     return spent;
 }
@@ -111,65 +114,83 @@ GoRouterAccount::updateBalance(const Amount & newBalance)
 Amount
 GoRouterAccount::accumulateBalance(const Amount & newBalance)
 {
-    Amount spent = previousBalance - balance;
-    balance += newBalance;
-    if (balance > maxBalance) {
-        balance = maxBalance;
-    }
-    previousBalance = balance;
+    int64_t current = balance.load();
+    int64_t updated;
+    do {
+        Amount total = MicroUSD(current) + newBalance;
+        if (total > maxBalance) {
+            total = maxBalance;
+        }
+        updated = total.value;
+    } while (!balance.compare_exchange_weak(current, updated));
+
+    Amount spent = previousBalance - MicroUSD(current);
+    previousBalance = MicroUSD(updated);
     return spent;
 }
 
 bool
 GoRouterAccount::bid(Amount bidPrice)
 {
-    ++bidsLastPeriod;
-    if (balance >= bidPrice) {
-        balance -= bidPrice;
-        return true;
-    }
-    return false;
+    bidsLastPeriod.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t price = MicroUSD(bidPrice).value;
+    int64_t current = balance.load(std::memory_order_relaxed);
+    do {
+        if (current < price) return false;
+    } while (!balance.compare_exchange_weak(current, current - price));
+
+    return true;
 }
 
 void
 GoRouterAccount::toJson(Json::Value &account)
 {
     account["rate"] = rate.value;
-    account["balance"] = balance.value;
+    account["balance"] = int64_t(balance);
     GoBaseAccount::toJson(account);
 }
 
 // Post Auction Account
 GoPostAuctionAccount::GoPostAuctionAccount(const AccountKey &key)
-    : GoBaseAccount(key)
+    : GoBaseAccount(key), imp(0), spend(0)
 {
-    imp = 0;
-    spend = MicroUSD(0);
 }
 
 GoPostAuctionAccount::GoPostAuctionAccount(Json::Value &json)
-    : GoBaseAccount(json)
+    : GoBaseAccount(json), imp(0), spend(0)
 {
     if (json.isMember("imp")) imp = json["imp"].asInt();
-    else imp = 0;
-
-    if (json.isMember("spend")) spend = MicroUSD(json["spend"].asInt());
-    else spend = MicroUSD(0);
+    if (json.isMember("spend")) spend = json["spend"].asInt();
 }
 
 bool
 GoPostAuctionAccount::win(Amount winPrice)
 {
-    spend += winPrice;
-    imp += 1;
+    spend.fetch_add(MicroUSD(winPrice).value, std::memory_order_relaxed);
+    imp.fetch_add(1, std::memory_order_relaxed);
     return true;
 }
 
+/* Catches up with the banker's copy of the account when it's ahead of ours.
+ * Applied as deltas so that wins recorded concurrently aren't lost.
+ */
+void
+GoPostAuctionAccount::merge(const GoPostAuctionAccount &other)
+{
+    int64_t currentImp = imp;
+    int64_t currentSpend = spend;
+    if (other.imp > currentImp || other.spend > currentSpend) {
+        imp.fetch_add(other.imp - currentImp);
+        spend.fetch_add(other.spend - currentSpend);
+    }
+}
+
 void
 GoPostAuctionAccount::toJson(Json::Value &account)
 {
     account["imp"] = int64_t(imp);
-    account["spend"] = spend.value;
+    account["spend"] = int64_t(spend);
     GoBaseAccount::toJson(account);
 }
 
@@ -200,6 +221,14 @@ GoBaseAccount::toJson(Json::Value &account)
 
 GoAccounts::GoAccounts() : accounts{}
 {
+    for (auto & chunk : chunks)
+        chunk = nullptr;
+}
+
+GoAccounts::~GoAccounts()
+{
+    for (auto & chunk : chunks)
+        delete[] chunk.load();
 }
 
 void
@@ -214,9 +243,11 @@ GoAccounts::setMaxBalance(const AccountKey &key, const Amount & maxBalance)
 void
 GoAccounts::add(const AccountKey &key, GoAccountType type)
 {
-    if (exists(key)) return;
     std::lock_guard<std::mutex> guard(this->mutex);
-    accounts.insert( pair<AccountKey, GoAccount>(key, GoAccount(key, type)) );
+    if (accounts.count(key)) return;
+    GoAccount account(key, type);
+    accounts.insert( pair<AccountKey, GoAccount>(key, account) );
+    publishLocked(key, account);
 }
 
 bool
@@ -233,11 +264,13 @@ GoAccounts::addFromJsonString(std::string jsonAccount)
     if (json.isMember("type") && json.isMember("name")) {
         string name = json["name"].asString();
         const AccountKey key(name);
-        if (exists(key)) return true;
+        GoAccount account(json);
 
         std::lock_guard<std::mutex> guard(this->mutex);
-        GoAccount account(json);
-        accounts.insert( pair<AccountKey, GoAccount>(key, account) );
+        /* Only the first of concurrent adds gets published */
+        auto inserted = accounts.insert( pair<AccountKey, GoAccount>(key, account) );
+        if (inserted.second)
+            publishLocked(key, account);
         //cout << "account in map: " << accounts[key].toJson() << endl;
         return true;
     } else {
@@ -263,10 +296,17 @@ GoAccounts::replaceFromJsonString(std::string jsonAccount)
 
         std::lock_guard<std::mutex> guard(this->mutex);
         GoAccount account(json);
-        if (account.type == POST_AUCTION &&
-                (account.pal->imp > accounts[key].pal->imp ||
-                account.pal->spend > accounts[key].pal->spend)) {
-            accounts[key] = account;
+        if (account.type != POST_AUCTION) return true;
+
+        /* Bidders may hold on to the current account through its slot so it
+         * is updated in place rather than replaced. */
+        auto it = accounts.find(key);
+        if (it == accounts.end()) {
+            accounts.insert( pair<AccountKey, GoAccount>(key, account) );
+            publishLocked(key, account);
+        }
+        else if (it->second.pal) {
+            it->second.pal->merge(*account.pal);
         }
         return true;
     } else {
@@ -299,21 +339,14 @@ GoAccounts::getBalance(const AccountKey &key)
     if (!exists(key)) return MicroUSD(0);
     std::lock_guard<std::mutex> guard(this->mutex);
     auto account = get(key);
-    return account->router->balance;
+    return account->router->getBalance();
 }
 
 bool
 GoAccounts::bid(const AccountKey &key, Amount bidPrice)
 {
     if (!exists(key)) return false;
-
-    std::lock_guard<std::mutex> guard(this->mutex);
-    auto account = get(key);
-    if (account->type != ROUTER) {
-        throw ML::Exception("GoAccounts::bid: attempt bid on non ROUTER account");
-    }
-
-    return account->bid(bidPrice);
+    return bid(slot(key), bidPrice);
 }
 
 bool
@@ -324,16 +357,93 @@ GoAccounts::win(const AccountKey &key, Amount winPrice)
              << " " << winPrice.toString() << endl;
         return false;
     }
+    return win(slot(key), winPrice);
+}
 
+int
+GoAccounts::slot(const AccountKey &key)
+{
     std::lock_guard<std::mutex> guard(this->mutex);
-    auto account = get(key);
-    if (account->type != POST_AUCTION) {
-        throw ML::Exception("GoAccounts::win: attempt win on non POST_AUCTION account");
+    return slotLocked(key);
+}
+
+bool
+GoAccounts::bid(int slot, Amount bidPrice)
+{
+    Slot* entry = getSlot(slot);
+    if (!entry) return false;
+
+    GoRouterAccount* account = entry->router.load(std::memory_order_acquire);
+    if (!account) {
+        if (entry->pal.load(std::memory_order_relaxed))
+            throw ML::Exception("GoAccounts::bid: attempt bid on non ROUTER account");
+        return false;
+    }
+
+    return account->bid(bidPrice);
+}
+
+bool
+GoAccounts::win(int slot, Amount winPrice)
+{
+    Slot* entry = getSlot(slot);
+    if (!entry) return false;
+
+    GoPostAuctionAccount* account = entry->pal.load(std::memory_order_acquire);
+    if (!account) {
+        if (entry->router.load(std::memory_order_relaxed))
+            throw ML::Exception("GoAccounts::win: attempt win on non POST_AUCTION account");
+        return false;
     }
 
     return account->win(winPrice);
 }
 
+GoAccounts::Slot*
+GoAccounts::getSlot(int slot) const
+{
+    if (slot < 0) return nullptr;
+
+    Slot* chunk = chunks[slot / SlotsPerChunk].load(std::memory_order_acquire);
+    return chunk ? &chunk[slot % SlotsPerChunk] : nullptr;
+}
+
+int
+GoAccounts::slotLocked(const AccountKey &key)
+{
+    auto it = slots.find(key);
+    if (it != slots.end()) return it->second;
+
+    int slot = slots.size();
+    if (slot >= SlotsPerChunk * MaxChunks)
+        throw ML::Exception("GoAccounts::slot: too many accounts");
+
+    auto & chunk = chunks[slot / SlotsPerChunk];
+    if (!chunk.load()) chunk.store(new Slot[SlotsPerChunk], std::memory_order_release);
+
+    slots[key] = slot;
+    return slot;
+}
+
+void
+GoAccounts::publishLocked(const AccountKey &key, const GoAccount &account)
+{
+    /* Keeps the accounts alive for as long as bidders can reach them */
+    published.push_back(account);
+
+    Slot* entry = getSlot(slotLocked(key));
+    entry->router.store(account.router.get(), std::memory_order_release);
+    entry->pal.store(account.pal.get(), std::memory_order_release);
+}
+
+std::vector<std::pair<AccountKey, GoAccount> >
+GoAccounts::snapshot()
+{
+    std::lock_guard<std::mutex> guard(this->mutex);
+    return std::vector<std::pair<AccountKey, GoAccount> >(
+            accounts.begin(), accounts.end());
+}
+
 bool
 GoAccounts::exists(const AccountKey &key)
 {
@@ -11,6 +11,7 @@
 #include <atomic>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "soa/jsoncpp/json.h"
 #include "rtbkit/common/currency.h"
@@ -27,16 +28,27 @@ struct GoBaseAccount {
     virtual void toJson(Json::Value &account);
 };
 
+/* Bidding threads only touch the counters below, which are padded to their own
+ * cache lines so that threads bidding on different accounts don't contend.
+ */
+struct GoPadding {
+    char bytes[64];
+};
+
 struct GoRouterAccount : public GoBaseAccount {
     Amount rate;
-    Amount balance;
     Amount maxBalance;
     Amount previousBalance;
-    int bidsLastPeriod;
+
+    GoPadding padding0;
+    std::atomic<int64_t> balance; // micro USD
+    std::atomic<int> bidsLastPeriod;
+    GoPadding padding1;
 
     GoRouterAccount(const AccountKey &key);
     GoRouterAccount(Json::Value &json);
     void setMaxBalance(const Amount & newMaxBalance);
+    Amount getBalance() const { return MicroUSD(balance.load()); }
     Amount updateBalance(const Amount & newBalance);
     Amount accumulateBalance(const Amount & newBalance);
     bool bid(Amount bidPrice);
@@ -45,13 +57,16 @@ struct GoRouterAccount : public GoBaseAccount {
 };
 
 struct GoPostAuctionAccount : public GoBaseAccount {
+    GoPadding padding0;
     std::atomic<int64_t> imp;
-    Amount spend;
+    std::atomic<int64_t> spend; // micro USD
+    GoPadding padding1;
 
     GoPostAuctionAccount(const AccountKey &key);
     GoPostAuctionAccount(Json::Value &jsonAccount);
     bool bid(Amount bidPrice) { return false; }
     bool win(Amount winPrice);
+    void merge(const GoPostAuctionAccount &other);
     void toJson(Json::Value &account);
 };
 
@@ -73,11 +88,17 @@ struct GoAccount {
     Json::Value toJson();
 };
 
+/* Accounts are resolved once to a slot which stays valid for the life of the
+ * GoAccounts. The slot is filled when the account is added and from then on
+ * bid and win on a slot go straight to the account's atomic counters, without
+ * taking the mutex which only guards the account map.
+ */
 struct GoAccounts {
     std::mutex mutex;
     std::unordered_map<AccountKey, GoAccount> accounts;
 
     GoAccounts();
+    ~GoAccounts();
     void setMaxBalance(const AccountKey &key, const Amount & maxBalance);
     bool exists(const AccountKey& key);
     void add(const AccountKey&, GoAccountType type);
@@ -90,9 +111,39 @@ struct GoAccounts {
     bool win(const AccountKey &key, Amount winPrice);
     Json::Value toJson();
 
+    /* Copy of the accounts, so callers can walk them without holding the
+     * mutex.  The account objects themselves are shared.
+     */
+    std::vector<std::pair<AccountKey, GoAccount> > snapshot();
+
+    /* Returns the slot of the account, allocating an empty one if the account
+     * wasn't added yet. Slots are never released.
+     */
+    int slot(const AccountKey &key);
+    bool bid(int slot, Amount bidPrice);
+    bool win(int slot, Amount winPrice);
+
 private:
+    enum {
+        SlotsPerChunk = 1024,
+        MaxChunks = 1024
+    };
+
+    struct Slot {
+        Slot() : router(nullptr), pal(nullptr) {}
+        std::atomic<GoRouterAccount*> router;
+        std::atomic<GoPostAuctionAccount*> pal;
+    };
+
     Amount MaxBalance;
+    std::unordered_map<AccountKey, int> slots;
+    std::atomic<Slot*> chunks[MaxChunks];
+    std::vector<GoAccount> published;
+
     GoAccount* get(const AccountKey&);
+    Slot* getSlot(int slot) const;
+    int slotLocked(const AccountKey &key);
+    void publishLocked(const AccountKey &key, const GoAccount &account);
 };
 
 } // namespace RTBKIT
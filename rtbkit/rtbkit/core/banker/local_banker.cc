@@ -33,6 +33,13 @@ LocalBanker::LocalBanker(shared_ptr<ServiceProxies> services, GoAccountType type
           debug(false)
 {
     replace(accountSuffixNoDot.begin(), accountSuffixNoDot.end(), '.', '_');
+    slots.store(new SlotMap());
+}
+
+LocalBanker::~LocalBanker()
+{
+    gc.deferBarrier();
+    delete slots.load();
 }
 
 void
@@ -284,11 +291,8 @@ LocalBanker::spendUpdate()
     };
     auto const &cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
     Json::Value payload(Json::arrayValue);
-    {
-        std::lock_guard<std::mutex> guard(this->mutex);
-        for (auto it : accounts.accounts) {
-            payload.append(it.second.toJson());
-        }
+    for (auto & it : accounts.snapshot()) {
+        payload.append(it.second.toJson());
     }
     httpClient->post("/spendupdate", cbs, payload, {}, {}, 1);
 }
@@ -376,11 +380,8 @@ LocalBanker::reauthorize()
 
     auto const &cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
     Json::Value payload(Json::arrayValue);
-    {
-        std::lock_guard<std::mutex> guard(this->mutex);
-        for (auto it : accounts.accounts) {
-            payload.append(it.first.toString());
-        }
+    for (auto & it : accounts.snapshot()) {
+        payload.append(it.first.toString());
     }
     httpClient->post("/reauthorize/1", cbs, payload, {}, {}, 1.0);
 }
@@ -427,12 +428,8 @@ LocalBanker::sendBidCounts()
 
     auto const &cbs = make_shared<HttpClientSimpleCallbacks>(onResponse);
     Json::Value payload(Json::objectValue);
-    {
-        std::lock_guard<std::mutex> guard(this->mutex);
-        for (auto it : accounts.accounts) {
-            payload[it.first.toString()] = it.second.router->bidsLastPeriod;
-            it.second.router->bidsLastPeriod = 0;
-        }
+    for (auto & it : accounts.snapshot()) {
+        payload[it.first.toString()] = it.second.router->bidsLastPeriod.exchange(0);
     }
     httpClient->post("/bidCounts", cbs, payload, {}, {}, 1.0);
 }
@@ -469,10 +466,44 @@ LocalBanker::setRate(const AccountKey &key)
     httpClient->post("/accounts/" + key.toString() + "/rate", cbs, payload, {}, {}, 1.0);
 }
 
+int
+LocalBanker::accountSlot(const AccountKey &key)
+{
+    {
+        GcLockBase::SharedGuard guard(gc);
+        const SlotMap* current = slots.load();
+        auto it = current->find(key);
+        if (it != current->end()) return it->second;
+    }
+
+    /* First time we see this account: copy the map with the new slot in it.
+     * Only the writers serialize on the mutex. */
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    SlotMap* oldSlots = slots.load();
+    auto it = oldSlots->find(key);
+    if (it != oldSlots->end()) return it->second;
+
+    int slot = accounts.slot(key.toString() + ":" + accountSuffix);
+
+    unique_ptr<SlotMap> newSlots(new SlotMap(*oldSlots));
+    (*newSlots)[key] = slot;
+    slots.store(newSlots.release());
+    gc.defer([=] { delete oldSlots; });
+
+    return slot;
+}
+
 bool
 LocalBanker::bid(const AccountKey &key, Amount bidPrice)
 {
-    bool canBid = accounts.bid(key.toString() + ":" + accountSuffix, bidPrice);
+    return bid(accountSlot(key), key, bidPrice);
+}
+
+bool
+LocalBanker::bid(int slot, const AccountKey &key, Amount bidPrice)
+{
+    bool canBid = accounts.bid(slot, bidPrice);
 
     (canBid) ? recordHit("Bid") : recordHit("noBid");
 
@@ -488,7 +519,7 @@ LocalBanker::bid(const AccountKey &key, Amount bidPrice)
 bool
 LocalBanker::win(const AccountKey &key, Amount winPrice)
 {
-    bool winAccounted = accounts.win(key.toString() + ":" + accountSuffix, winPrice);
+    bool winAccounted = accounts.win(accountSlot(key), winPrice);
 
     (winAccounted) ? recordHit("Win") : recordHit("noWin");
 
@@ -10,11 +10,13 @@
 #include <string>
 #include <mutex>
 #include <unordered_set>
+#include <unordered_map>
 
 #include "banker.h"
 #include "soa/service/service_base.h"
 #include "soa/service/http_client.h"
 #include "soa/service/message_loop.h"
+#include "soa/gc/gc_lock.h"
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/account_key.h"
 
@@ -27,6 +29,8 @@ struct LocalBanker : public Banker, Datacratic::MessageLoop, Datacratic::Service
     LocalBanker(std::shared_ptr<Datacratic::ServiceProxies> services,
             GoAccountType type,
             const std::string & accountSuffix);
+
+    ~LocalBanker();
     
     void init(const std::string & bankerUrl, double timeout = 1.0, int numConnections = 128, bool tcpNoDelay = false);
 
@@ -52,6 +56,19 @@ struct LocalBanker : public Banker, Datacratic::MessageLoop, Datacratic::Service
         return bid(account, amount);
     }
 
+    virtual int
+    accountSlot(const AccountKey & account);
+
+    virtual bool
+    authorizeBid(int slot,
+                 const AccountKey & account,
+                 const std::string & item,
+                 Amount amount)
+    {
+        if (slot < 0) return bid(account, amount);
+        return bid(slot, account, amount);
+    }
+
     virtual void
     cancelBid(const AccountKey & account,
               const std::string & item)
@@ -117,6 +134,8 @@ private:
 
     bool bid(const AccountKey &key, Amount bidPrice);
 
+    bool bid(int slot, const AccountKey &key, Amount bidPrice);
+
     bool win(const AccountKey &key, Amount winPrice);
 
     GoAccountType type;
@@ -125,6 +144,12 @@ private:
     std::shared_ptr<Datacratic::HttpClient> httpClient;
     std::mutex mutex;
     std::unordered_set<AccountKey> uninitializedAccounts;
+
+    /* Slots keyed without the suffix.  Read under the gc lock and replaced
+     * under the mutex when an account is first seen. */
+    typedef std::unordered_map<AccountKey, int> SlotMap;
+    std::atomic<SlotMap*> slots;
+    Datacratic::GcLock gc;
     Amount spendRate;
     double syncRate;
     double reauthRate;
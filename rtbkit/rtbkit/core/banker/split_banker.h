@@ -58,6 +58,27 @@ struct SplitBanker : public Banker {
         }
     }
 
+    virtual int accountSlot(const AccountKey & account)
+    {
+        if (isLocal(account)) {
+            return localBanker->accountSlot(account);
+        } else {
+            return masterBanker->accountSlot(account);
+        }
+    }
+
+    virtual bool authorizeBid(int slot,
+                              const AccountKey & account,
+                              const std::string & item,
+                              Amount amount)
+    {
+        if (isLocal(account)) {
+            return localBanker->authorizeBid(slot, account, item, amount);
+        } else {
+            return masterBanker->authorizeBid(slot, account, item, amount);
+        }
+    }
+
     virtual void cancelBid(const AccountKey & account,
                            const std::string & item)
     {
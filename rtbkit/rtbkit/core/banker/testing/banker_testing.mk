@@ -32,5 +32,6 @@ $(eval $(call test,banker_account_test,banker,boost))
 $(eval $(call test,banker_behaviour_test,banker banker_temporary_server,boost manual))
 $(eval $(call test,redis_persistence_test,banker,boost))
 $(eval $(call test,local_banker_test,gobanker banker,boost manual))
+$(eval $(call program,go_accounts_bench,gobanker boost_program_options))
 
 banker_tests: master_banker_test slave_banker_test banker_account_test banker_behaviour_test redis_persistence_test
@@ -0,0 +1,156 @@
+/** go_accounts_bench.cc                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Contention bench of the go accounts bid path: threads bidding either on the
+    same account or on one account each, through the account key or through a
+    pre-resolved slot.
+
+*/
+
+#include "rtbkit/core/banker/go_account.h"
+#include "soa/types/date.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/******************************************************************************/
+/* CONFIG                                                                     */
+/******************************************************************************/
+
+struct Config
+{
+    Config() :
+        threads(8), bids(1000000)
+    {}
+
+    size_t threads;
+    size_t bids;
+};
+
+Config getConfig(int argc, char** argv)
+{
+    using namespace boost::program_options;
+
+    Config config;
+
+    options_description opt("Bench options");
+    opt.add_options()
+        ("threads,t", value<size_t>(&config.threads),
+         "number of bidding threads")
+        ("bids,b", value<size_t>(&config.bids),
+         "number of bids per thread")
+        ("help,h","print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(opt).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << opt << endl;
+        exit(1);
+    }
+
+    return config;
+}
+
+
+/******************************************************************************/
+/* BENCH                                                                      */
+/******************************************************************************/
+
+const string Suffix = "router";
+
+AccountKey accountOf(size_t thread, bool shared)
+{
+    return AccountKey("campaign:strategy" + to_string(shared ? 0 : thread));
+}
+
+void addAccounts(GoAccounts& accounts, const Config& config)
+{
+    for (size_t i = 0; i < config.threads; ++i) {
+        string name = accountOf(i, false).toString() + ":" + Suffix;
+        accounts.addFromJsonString(
+                "{\"name\":\"" + name + "\",\"type\":\"Router\","
+                "\"rate\":0,\"balance\":1000000000000000}");
+    }
+}
+
+template<typename Fn>
+double run(const Config& config, Fn&& bid)
+{
+    atomic<size_t> ready(0);
+    atomic<bool> go(false);
+    vector<thread> threads;
+
+    for (size_t i = 0; i < config.threads; ++i) {
+        threads.emplace_back([&, i] {
+                    ++ready;
+                    while (!go);
+                    for (size_t j = 0; j < config.bids; ++j)
+                        bid(i);
+                });
+    }
+
+    while (ready != config.threads);
+
+    Date start = Date::now();
+    go = true;
+    for (auto& th : threads) th.join();
+
+    double elapsed = Date::now().secondsSince(start);
+    return config.bids * config.threads / elapsed;
+}
+
+void bench(const Config& config, bool shared)
+{
+    GoAccounts accounts;
+    addAccounts(accounts, config);
+
+    Amount price = MicroUSD(1);
+
+    /* What LocalBanker used to do on every bid. */
+    double byKey = run(config, [&] (size_t thread) {
+                AccountKey key = accountOf(thread, shared);
+                accounts.bid(key.toString() + ":" + Suffix, price);
+            });
+
+    vector<int> slots;
+    for (size_t i = 0; i < config.threads; ++i)
+        slots.push_back(accounts.slot(accountOf(i, shared).toString() + ":" + Suffix));
+
+    double bySlot = run(config, [&] (size_t thread) {
+                accounts.bid(slots[thread], price);
+            });
+
+    cerr << (shared ? "same account:     " : "disjoint accounts:")
+         << " key " << byKey / 1e6 << " Mbids/s,"
+         << " slot " << bySlot / 1e6 << " Mbids/s,"
+         << " speedup " << bySlot / byKey << "x" << endl;
+}
+
+
+/******************************************************************************/
+/* MAIN                                                                       */
+/******************************************************************************/
+
+int main(int argc, char** argv)
+{
+    auto config = getConfig(argc, argv);
+
+    cerr << config.threads << " threads, "
+         << config.bids << " bids per thread" << endl;
+
+    bench(config, true);
+    bench(config, false);
+
+    return 0;
+}
@@ -9,6 +9,8 @@
 #define BOOST_TEST_DYN_LINK
 
 #include <memory>
+#include <thread>
+#include <atomic>
 #include <boost/test/unit_test.hpp>
 #include "rtbkit/common/account_key.h"
 #include "jml/arch/timers.h"
@@ -120,3 +122,58 @@ BOOST_AUTO_TEST_CASE( test_router_accumulate )
     ExcAssertEqual(rBanker.accounts.getBalance(key).value, 10000);
 
 }
+
+BOOST_AUTO_TEST_CASE( test_account_slots )
+{
+    GoAccounts accounts;
+    string key = "parent:child:router";
+
+    // The slot is resolved before the account is known and stays the same.
+    int slot = accounts.slot(key);
+    BOOST_CHECK(!accounts.bid(slot, MicroUSD(1)));
+
+    accounts.addFromJsonString("{\"name\":\"" + key + "\",\"type\":\"Router\","
+            "\"parent\":\"parent:child\",\"rate\":1000,\"balance\":1000}");
+    BOOST_CHECK_EQUAL(accounts.slot(key), slot);
+
+    // Concurrent bidders can never spend more than the balance.
+    atomic<int> accepted(0);
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+                    for (int j = 0; j < 1000; ++j)
+                        if (accounts.bid(slot, MicroUSD(1))) ++accepted;
+                });
+    }
+    for (auto & th : threads) th.join();
+
+    BOOST_CHECK_EQUAL(accepted, 1000);
+    BOOST_CHECK_EQUAL(accounts.getBalance(key).value, 0);
+    BOOST_CHECK_EQUAL(accounts.accounts[key].router->bidsLastPeriod, 8000);
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_account_add )
+{
+    GoAccounts accounts;
+    string key = "parent:child:router";
+    int slot = accounts.slot(key);
+
+    // Racing adds of the same account must keep the first one published,
+    // or bidders holding the slot would end up on an orphaned account.
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i] {
+                    accounts.addFromJsonString("{\"name\":\"" + key
+                            + "\",\"type\":\"Router\",\"parent\":\"parent:child\","
+                            "\"rate\":1000,\"balance\":" + to_string(1000 + i) + "}");
+                });
+    }
+    for (auto & th : threads) th.join();
+
+    int64_t balance = accounts.getBalance(key).value;
+    BOOST_CHECK(balance >= 1000 && balance < 1008);
+
+    BOOST_CHECK(accounts.bid(slot, MicroUSD(balance)));
+    BOOST_CHECK_EQUAL(accounts.getBalance(key).value, 0);
+    BOOST_CHECK_EQUAL(accounts.snapshot().size(), 1);
+}
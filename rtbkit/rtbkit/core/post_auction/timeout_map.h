@@ -7,14 +7,18 @@
    Simpler version of the soa TimeoutMap which doesn't require linear scans to
    expire elements. Should eventually replace the one in soa.
 
+   Backed by the soa HashedTimeoutMap, whose timing wheel makes expiring and
+   updating the timeout of an entry O(1).
+
 */
 
 #pragma once
 
 #include "soa/types/date.h"
+#include "soa/service/hashed_timeout_map.h"
+#include "jml/utils/exc_check.h"
 
-#include <set>
-#include <queue>
+#include <vector>
 
 namespace RTBKIT {
 
@@ -52,11 +56,9 @@ struct TimeoutMap
 
     bool emplace(Key key, Value value, Datacratic::Date timeout)
     {
-        auto ret = map.insert(std::make_pair(
-                        std::move(key), Entry(std::move(value), timeout)));
-        if (!ret.second) return false;
+        if (map.count(key)) return false;
 
-        queue.emplace(ret.first->first, timeout);
+        map.insert(key, Entry(std::move(value)), timeout);
         return true;
     }
 
@@ -65,8 +67,7 @@ struct TimeoutMap
         auto it = map.find(key);
         ExcCheck(it != map.end(), "key not present in the timeout map.");
 
-        it->second.timeout = timeout;
-        queue.emplace(key, timeout);
+        map.updateTimeout(it, timeout);
     }
 
     Value pop(const Key& key)
@@ -87,23 +88,16 @@ struct TimeoutMap
     template<typename Fn>
     size_t expire(const Fn& fn, Datacratic::Date now = Datacratic::Date::now())
     {
-        std::vector< std::pair<Key, Entry> > toExpire;
+        std::vector< std::pair<Key, Value> > toExpire;
         toExpire.reserve(1 << 4);
 
-        while (!queue.empty() && queue.top().timeout <= now) {
-            TimeoutEntry entry = std::move(queue.top());
-            queue.pop();
-
-            auto it = map.find(entry.key);
-            if (it == map.end()) continue;
-            if (it->second.timeout > now) continue;
-
-            toExpire.emplace_back(std::move(*it));
-            map.erase(it);
-        }
+        map.expire([&] (const Key& key, Entry& entry) {
+                    toExpire.emplace_back(key, std::move(entry.value));
+                    return Datacratic::Date();
+                }, now);
 
         for (auto& entry : toExpire)
-            fn(std::move(entry.first), std::move(entry.second.value));
+            fn(std::move(entry.first), std::move(entry.second));
 
         return toExpire.size();
     }
@@ -113,30 +107,12 @@ private:
     struct Entry
     {
         Value value;
-        Datacratic::Date timeout;
-
-        Entry(Value value, Datacratic::Date timeout) :
-            value(std::move(value)), timeout(timeout)
-        {}
-    };
-
-    struct TimeoutEntry
-    {
-        Key key;
-        Datacratic::Date timeout;
-
-        TimeoutEntry(Key key, Datacratic::Date timeout) :
-            key(std::move(key)), timeout(timeout)
-        {}
 
-        bool operator<(const TimeoutEntry& other) const
-        {
-            return timeout > other.timeout;
-        }
+        Entry() {}
+        Entry(Value value) : value(std::move(value)) {}
     };
 
-    std::unordered_map<Key, Entry> map;
-    std::priority_queue<TimeoutEntry> queue;
+    Datacratic::HashedTimeoutMap<Key, Entry> map;
 };
 
 } // namespace RTBKIT
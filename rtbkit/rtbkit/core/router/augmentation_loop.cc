@@ -24,6 +24,15 @@ using namespace ML;
 
 namespace RTBKIT {
 
+namespace {
+
+enum { DefaultMaxInFlight = 3000 };
+
+/** Prefix of the addresses of the hosted augmentor instances. */
+const std::string HostedAddr = "hosted";
+
+} // file scope
+
 
 /*****************************************************************************/
 /* AUGMENTATION LOOP                                                         */
@@ -37,6 +46,7 @@ AugmentationLoop(ServiceBase & parent,
       idle_(1),
       inbox(65536),
       disconnections(1024),
+      hostedResponses(65536),
       toAugmentors(getZmqContext())
 {
     updateAllAugmentors();
@@ -50,6 +60,7 @@ AugmentationLoop(std::shared_ptr<ServiceProxies> proxies,
       idle_(1),
       inbox(65536),
       disconnections(1024),
+      hostedResponses(65536),
       toAugmentors(getZmqContext())
 {
     updateAllAugmentors();
@@ -100,8 +111,16 @@ init()
             doAugmentation(std::move(entry));
         };
 
+    hostedResponses.onEvent = [&] (HostedResponse&& response)
+        {
+            finishResponse(response.addr, response.augmentor, response.id,
+                           response.startTime, response.augmentations,
+                           response.augmentations.empty());
+        };
+
     addSource("AugmentationLoop::inbox", inbox);
     addSource("AugmentationLoop::disconnections", disconnections);
+    addSource("AugmentationLoop::hostedResponses", hostedResponses);
     addSource("AugmentationLoop::toAugmentors", toAugmentors);
 
     addPeriodic("AugmentationLoop::checkExpiries", 0.001,
@@ -117,6 +136,9 @@ start()
 {
     //toAugmentors.start();
     MessageLoop::start();
+
+    for (auto & augmentor : hosted)
+        augmentor->startHosted();
 }
 
 void
@@ -131,6 +153,10 @@ void
 AugmentationLoop::
 shutdown()
 {
+    // Stopped first since their responses go through our message loop.
+    for (auto & augmentor : hosted)
+        augmentor->shutdownHosted();
+
     MessageLoop::shutdown();
     toAugmentors.shutdown();
 }
@@ -154,6 +180,35 @@ bindAugmentors(const std::string & uri)
     }
 }
 
+void
+AugmentationLoop::
+hostAugmentor(const std::shared_ptr<HostedAugmentor> & augmentor,
+              int maxInFlight)
+{
+    const std::string name = augmentor->hostedName();
+    ExcCheck(!name.empty(), "no augmentor name specified");
+
+    if (maxInFlight < 0) maxInFlight = DefaultMaxInFlight;
+
+    auto& info = augmentors[name];
+    if (!info) {
+        info = std::make_shared<AugmentorInfo>(name);
+        recordHit("augmentor.%s.configured", name);
+    }
+
+    // Each instance needs its own address for findInstance() to keep their
+    // in flight counts apart.
+    const std::string addr = HostedAddr + std::to_string(hosted.size());
+
+    auto instance = std::make_shared<AugmentorInstanceInfo>(addr, maxInFlight);
+    instance->hosted = augmentor;
+    info->instances.push_back(instance);
+    hosted.push_back(augmentor);
+    recordHit("augmentor.%s.instances.%s.configured", name, addr);
+
+    updateAllAugmentors();
+}
+
 void
 AugmentationLoop::
 handleAugmentorMessage(const std::vector<std::string> & message)
@@ -385,6 +440,10 @@ doAugmentation(std::shared_ptr<Entry>&& entry)
 
     bool sentToAugmentor = false;
 
+    // Augmentors asking for the same fields share a single projection.
+    std::map<BidRequestFields, std::string> projections;
+    const auto & auction = *entry->info->auction;
+
     for (auto it = entry->outstanding.begin(), end = entry->outstanding.end();
          it != end;  ++it)
     {
@@ -400,20 +459,60 @@ doAugmentation(std::shared_ptr<Entry>&& entry)
         set<string> agents = entry->augmentorAgents[*it];
 
         entry->instances[*it] = instance;
-        
+
+        if (instance->hosted) {
+            const std::string & name = *it;
+            const std::string & addr = instance->addr;
+            const Id & id = auction.id;
+            Date startTime = Date::now();
+
+            // Never block the augmentor's thread on a full sink: the
+            // response is dropped and the entry expires like a lost one.
+            instance->hosted->augmentHosted(
+                    id, auction.request,
+                    vector<string>(agents.begin(), agents.end()),
+                    [=] (const AugmentationList & augmentations)
+                    {
+                        HostedResponse response {
+                            addr, name, id, startTime, augmentations
+                        };
+                        if (!hostedResponses.tryPush(std::move(response)))
+                            recordHit("augmentor.%s.instances.%s.dropped",
+                                      name, addr);
+                    });
+
+            sentToAugmentor = true;
+            continue;
+        }
+
         std::ostringstream availableAgentsStr;
         ML::DB::Store_Writer writer(availableAgentsStr);
         writer.save(agents);
 
-        // Send the message to the augmentor
-        toAugmentors.sendMessage(
-                instance->addr,
-                "AUGMENT", "1.0", *it,
-                entry->info->auction->id.toString(),
-                entry->info->auction->requestStrFormat,
-                entry->info->auction->requestStr,
-                availableAgentsStr.str(),
-                Date::now());
+        if (instance->fields.empty()) {
+            toAugmentors.sendMessage(
+                    instance->addr,
+                    "AUGMENT", "1.0", *it,
+                    auction.id.toString(),
+                    auction.requestStrFormat(),
+                    auction.requestStr(),
+                    availableAgentsStr.str(),
+                    Date::now());
+        }
+        else {
+            auto & projection = projections[instance->fields];
+            if (projection.empty())
+                projection = projectBidRequest(*auction.request, instance->fields);
+
+            toAugmentors.sendMessage(
+                    instance->addr,
+                    "AUGMENT", "1.0", *it,
+                    auction.id.toString(),
+                    BidRequestProjectionFormat,
+                    projection,
+                    availableAgentsStr.str(),
+                    Date::now());
+        }
 
         sentToAugmentor = true;
     }
@@ -432,7 +531,7 @@ AugmentationLoop::
 doConfig(const std::vector<std::string> & message)
 {
     ExcCheckGreaterEqual(message.size(), 4, "config message has wrong size");
-    ExcCheckLessEqual(message.size(), 5, "config message has wrong size");
+    ExcCheckLessEqual(message.size(), 6, "config message has wrong size");
 
     const string & addr = message[0];
     const string & version = message[2];
@@ -441,7 +540,11 @@ doConfig(const std::vector<std::string> & message)
     int maxInFlight = -1;
     if (message.size() >= 5)
         maxInFlight = std::stoi(message[4]);
-    if (maxInFlight < 0) maxInFlight = 3000;
+    if (maxInFlight < 0) maxInFlight = DefaultMaxInFlight;
+
+    BidRequestFields fields;
+    if (message.size() >= 6)
+        fields = BidRequestFields::parse(message[5]);
 
     ExcCheckEqual(version, "1.0", "unknown version for config message");
     ExcCheck(!name.empty(), "no augmentor name specified");
@@ -457,7 +560,7 @@ doConfig(const std::vector<std::string> & message)
         recordHit("augmentor.%s.configured", name);
     }
 
-    info->instances.push_back(std::make_shared<AugmentorInstanceInfo>(addr, maxInFlight));
+    info->instances.push_back(std::make_shared<AugmentorInstanceInfo>(addr, maxInFlight, fields));
     recordHit("augmentor.%s.instances.%s.configured", name, addr);
 
 
@@ -515,7 +618,6 @@ void
 AugmentationLoop::
 doResponse(const std::vector<std::string> & message)
 {
-    recordEvent("augmentation.response");
     //cerr << "doResponse " << message << endl;
 
     ExcCheckEqual(message.size(), 7, "response message has wrong size");
@@ -548,18 +650,33 @@ doResponse(const std::vector<std::string> & message)
 
     recordLevel(timer.elapsed_wall(), "responseParseTimeMs");
 
-    {
-        double timeTakenMs = startTime.secondsUntil(Date::now()) * 1000.0;
-        string eventName = "augmentor." + augmentor + ".timeTakenMs";
-        recordEvent(eventName.c_str(), ET_OUTCOME, timeTakenMs);
-    }
-
     {
         double responseLength = augmentation.size();
         string eventName = "augmentor." + augmentor + ".responseLengthBytes";
         recordEvent(eventName.c_str(), ET_OUTCOME, responseLength);
     }
 
+    finishResponse(addr, augmentor, id, startTime, augmentationList,
+                   augmentation == "" || augmentation == "null");
+}
+
+void
+AugmentationLoop::
+finishResponse(const std::string & addr,
+               const std::string & augmentor,
+               const Id & id,
+               Date startTime,
+               const AugmentationList & augmentationList,
+               bool isNull)
+{
+    recordEvent("augmentation.response");
+
+    {
+        double timeTakenMs = startTime.secondsUntil(Date::now()) * 1000.0;
+        string eventName = "augmentor." + augmentor + ".timeTakenMs";
+        recordEvent(eventName.c_str(), ET_OUTCOME, timeTakenMs);
+    }
+
     auto augmentorIt = augmentors.find(augmentor);
     if (augmentorIt != augmentors.end()) {
         auto instance = augmentorIt->second->findInstance(addr);
@@ -576,9 +693,7 @@ doResponse(const std::vector<std::string> & message)
 
     auto& entry = *augmentingIt;
 
-    const char* eventType =
-        (augmentation == "" || augmentation == "null") ?
-        "nullResponse" : "validResponse";
+    const char* eventType = isNull ? "nullResponse" : "validResponse";
     recordHit("augmentor.%s.%s", augmentor, eventType);
     recordHit("augmentor.%s.instances.%s.%s", augmentor, addr, eventType);
 
@@ -9,6 +9,8 @@
 #define __rtb_router__augmentation_loop_h__
 
 #include "rtbkit/common/augmentation.h"
+#include "rtbkit/common/bid_request_projection.h"
+#include "rtbkit/common/hosted_augmentor.h"
 #include "soa/service/timeout_map.h"
 #include "soa/service/zmq_endpoint.h"
 #include "soa/service/typed_message_channel.h"
@@ -33,13 +35,20 @@ namespace RTBKIT {
 /** Information about a specific augmentor which belongs to an augmentor class.
  */
 struct AugmentorInstanceInfo {
-    AugmentorInstanceInfo(const std::string& addr = "", int maxInFlight = 0) :
-        addr(addr), numInFlight(0), maxInFlight(maxInFlight)
+    AugmentorInstanceInfo(const std::string& addr = "", int maxInFlight = 0,
+                          BidRequestFields fields = BidRequestFields()) :
+        addr(addr), numInFlight(0), maxInFlight(maxInFlight), fields(fields)
     {}
 
     std::string addr;
     int numInFlight;
     int maxInFlight;
+
+    /// Fields requested by the augmentor; empty means the full bid request.
+    BidRequestFields fields;
+
+    /// Set when the augmentor runs inside the router.
+    std::shared_ptr<HostedAugmentor> hosted;
 };
 
 /** Information about a given class of augmentor. */
@@ -103,6 +112,15 @@ struct AugmentationLoop : public ServiceBase, public MessageLoop {
 
     void bindAugmentors(const std::string & uri);
 
+    /** Runs the augmentor inside the router.  Its requests are handed over
+        directly, without serialization or zmq, but are otherwise timed out
+        and accounted for like those of a remote augmentor.
+
+        Must be called before start().
+    */
+    void hostAugmentor(const std::shared_ptr<HostedAugmentor> & augmentor,
+                       int maxInFlight = -1);
+
     /** Push an auction into the augmentor.  Can be called from any thread. */
     void augment(const std::shared_ptr<AugmentationInfo> & info,
                  Date timeout,
@@ -158,6 +176,18 @@ private:
     TypedMessageSink<std::shared_ptr<Entry> > inbox;
     TypedMessageSink<std::string> disconnections;
 
+    struct HostedResponse {
+        std::string addr;
+        std::string augmentor;
+        Id id;
+        Date startTime;
+        AugmentationList augmentations;
+    };
+
+    /// Responses of the hosted augmentors, which come from their threads
+    TypedMessageSink<HostedResponse> hostedResponses;
+    std::vector<std::shared_ptr<HostedAugmentor> > hosted;
+
     /// Connection to all of our augmentors
     ZmqNamedClientBus toAugmentors;
 
@@ -183,6 +213,14 @@ private:
     /** Handle a response from an augmentation. */
     void doResponse(const std::vector<std::string> & message);
 
+    /** Common part of the remote and hosted responses. */
+    void finishResponse(const std::string & addr,
+                        const std::string & augmentor,
+                        const Id & id,
+                        Date startTime,
+                        const AugmentationList & augmentationList,
+                        bool isNull);
+
     /** Handle a message asking for augmentation. */
     void doAugment(const std::vector<std::string> & message);
 
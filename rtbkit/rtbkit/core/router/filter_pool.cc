@@ -28,7 +28,7 @@ namespace RTBKIT {
 /******************************************************************************/
 
 FilterPool::
-FilterPool() : data(new Data()), events(nullptr) {}
+FilterPool() : data(new Data()), events(nullptr), adaptive(false) {}
 
 
 void
@@ -36,6 +36,17 @@ FilterPool::
 init(EventRecorder* events)
 {
     this->events = events;
+    if (!events) return;
+
+    // Filters might have been added before we had somewhere to record.
+    GcLockBase::SharedGuard guard(gc);
+
+    Data* oldData = data.load();
+    unique_ptr<Data> newData;
+
+    do {
+        newData.reset(new Data(*oldData));
+    } while (!setData(oldData, newData));
 }
 
 
@@ -43,6 +54,11 @@ bool
 FilterPool::
 setData(Data*& oldData, unique_ptr<Data>& newData)
 {
+    if (newData) {
+        bindCosts(*newData);
+        if (events) newData->registerStats(*events);
+    }
+
     if (!data.compare_exchange_strong(oldData, newData.get()))
         return false;
 
@@ -70,14 +86,10 @@ FilterPool::
 
 void
 FilterPool::
-recordDiff(const Data* data, const FilterBase* filter, const ConfigSet& diff)
+recordDiff(const Data* data, size_t filter, const ConfigSet& diff)
 {
-    for (size_t cfg = diff.next(); cfg < diff.size(); cfg = diff.next(cfg+1)) {
-        const AgentConfig& config = *data->configs[cfg].config;
-
-        events->recordHit("accounts.%s.filter.static.%s",
-                config.account.toString('.'), filter->name());
-    }
+    for (size_t cfg = diff.next(); cfg < diff.size(); cfg = diff.next(cfg+1))
+        data->filteredStats[cfg][filter].record();
 }
 
 void
@@ -102,16 +114,40 @@ recordReason(const Data* data, const FilterBase* f, FilterState & state){
 
 }
 
-uint64_t
+void
 FilterPool::
-recordTime(uint64_t start, const FilterBase* filter)
+recordTime(uint64_t elapsed, const Data* data, size_t filter)
 {
-    uint64_t now = ticks();
-    double us = ((now - start) / ticks_per_second) * 1000000.0;
+    double us = (elapsed / ticks_per_second) * 1000000.0;
+    data->timingStats[filter].record(us);
+}
 
-    events->recordLevel(us, "filters.timingUs.%s", filter->name());
+void
+FilterPool::
+recordCost(
+        const Data* data, size_t filter,
+        uint64_t elapsed, size_t configsIn, size_t configsOut)
+{
+    FilterCost& cost = *data->costs[filter];
+    cost.samples.fetch_add(1, std::memory_order_relaxed);
+    cost.ticks.fetch_add(elapsed, std::memory_order_relaxed);
+    cost.configsIn.fetch_add(configsIn, std::memory_order_relaxed);
+    cost.configsOut.fetch_add(configsOut, std::memory_order_relaxed);
+}
 
-    return now;
+void
+FilterPool::
+bindCosts(Data& data)
+{
+    lock_guard<mutex> guard(costsLock);
+
+    data.costs.clear();
+    data.costs.reserve(data.filters.size());
+    for (FilterBase* filter : data.filters) {
+        auto& cost = costs[filter->name()];
+        if (!cost) cost = make_shared<FilterCost>();
+        data.costs.push_back(cost);
+    }
 }
 
 
@@ -129,27 +165,36 @@ filter(const BidRequest& br, const ExchangeConnector* conn, const ConfigSet& mas
 
     ConfigSet configs = state.configs();
 
-    bool sampleStats = events && (random() % 10 == 0);
+    bool sampleStats = (events || adaptive) && (random() % 10 == 0);
     uint64_t ticksStart = sampleStats ? ticks() : 0;
 
-    for (FilterBase* filter : current->filters) {
+    for (size_t i = 0; i < current->filters.size(); ++i) {
+        FilterBase* filter = current->filters[i];
         filter->filter(state);
 
         const ConfigSet& filtered = state.configs();
 
         if (sampleStats) {
-            ticksStart = recordTime(ticksStart, filter);
-            recordDiff(current, filter, configs ^ filtered);
-            if (!state.getFilterReasons().empty()) {
-                recordReason(current, filter, state);
+            uint64_t now = ticks();
+            recordCost(current, i, now - ticksStart,
+                    configs.count(), filtered.count());
+
+            if (events) {
+                recordTime(now - ticksStart, current, i);
+                recordDiff(current, i, configs ^ filtered);
+                if (!state.getFilterReasons().empty()) {
+                    recordReason(current, filter, state);
+                }
             }
+
             configs = filtered;
+            ticksStart = now;
         }
         state.resetFilterReasons();
 
         if (filtered.empty()) {
-            if (sampleStats) 
-                events->recordHit("filters.breakLoop.%s", filter->name());
+            if (sampleStats && events)
+                current->breakLoopStats[i].record();
             break;
         }
     }
@@ -168,6 +213,29 @@ filter(const BidRequest& br, const ExchangeConnector* conn, const ConfigSet& mas
 }
 
 
+bool
+FilterPool::
+preFilter(const BidRequest& br, const ExchangeConnector* conn, unsigned fields)
+{
+    GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+
+    const Data* current = data.load();
+
+    FilterState state(br, conn, current->activeConfigs);
+    if (state.configs().empty()) return false;
+
+    for (FilterBase* filter : current->filters) {
+        unsigned needed = filter->preFilterFields();
+        if (!needed || (needed & fields) != needed) continue;
+
+        filter->filter(state);
+        if (state.configs().empty()) return false;
+    }
+
+    return true;
+}
+
+
 void
 FilterPool::
 addFilter(const string& name)
@@ -237,6 +305,18 @@ initWithFiltersFromJson(const Json::Value & json)
     if (!json.isArray())
         throw Exception("filter list must be an array");
 
+    // The Location filter leaves the configs whose location filter was
+    // compiled into a geo filter to the Geo filter; without it they would
+    // not be filtered on location at all.
+    bool hasLocation = false, hasGeo = false;
+    for (const auto & val : json) {
+        if (val.asString() == LocationFilter::name) hasLocation = true;
+        if (val.asString() == JamLoop::GeoFilter::name) hasGeo = true;
+    }
+    if (hasLocation && !hasGeo)
+        throw Exception("filter list has the %s filter but not the %s filter",
+                        LocationFilter::name, JamLoop::GeoFilter::name);
+
     do {
         newData.reset(new Data);
 
@@ -288,6 +368,135 @@ removeConfig(const string& name)
 }
 
 
+namespace {
+
+/** Below this many samples, the counters are left to accumulate until the
+    next reorder.
+*/
+enum { MinCostSamples = 100 };
+
+/** Weight of the latest period in the running estimates. */
+const double CostSmoothing = 0.3;
+
+} // namespace anonymous
+
+double
+FilterPool::FilterCost::
+rank() const
+{
+    // A filter which never eliminates anything goes last but stays ordered
+    // by cost with the other ones in the same situation.
+    return costUs / std::max(1.0 - passRate, 1e-6);
+}
+
+bool
+FilterPool::
+reorderFilters()
+{
+    {
+        lock_guard<mutex> guard(costsLock);
+
+        for (auto& entry : costs) {
+            FilterCost& cost = *entry.second;
+            if (cost.samples < MinCostSamples) continue;
+
+            uint64_t samples = cost.samples.exchange(0);
+            uint64_t elapsed = cost.ticks.exchange(0);
+            uint64_t in = cost.configsIn.exchange(0);
+            uint64_t out = cost.configsOut.exchange(0);
+
+            double us = (elapsed / ticks_per_second) * 1000000.0 / samples;
+            double pass = in ? double(out) / in : 1.0;
+
+            if (!cost.hasEstimate) {
+                cost.costUs = us;
+                cost.passRate = pass;
+                cost.hasEstimate = true;
+            }
+            else {
+                cost.costUs += CostSmoothing * (us - cost.costUs);
+                cost.passRate += CostSmoothing * (pass - cost.passRate);
+            }
+        }
+    }
+
+    GcLockBase::SharedGuard guard(gc);
+
+    Data* oldData = data.load();
+    unique_ptr<Data> newData;
+    bool changed;
+
+    do {
+        const vector<FilterBase*>& filters = oldData->filters;
+
+        // Until every movable filter has an estimate, their relative cost is
+        // meaningless so the priority order is kept.
+        vector<size_t> slots;
+        bool ready = true;
+        for (size_t i = 0; i < filters.size(); ++i) {
+            if (filters[i]->pinned()) continue;
+            slots.push_back(i);
+            ready = ready && oldData->costs[i]->hasEstimate;
+        }
+        if (!ready) return false;
+
+        vector<size_t> order = slots;
+        stable_sort(order.begin(), order.end(), [&] (size_t lhs, size_t rhs) {
+                    return oldData->costs[lhs]->rank()
+                        < oldData->costs[rhs]->rank();
+                });
+
+        changed = order != slots;
+        if (!changed) break;
+
+        newData.reset(new Data(*oldData));
+        vector<FilterBase*> clones = newData->filters;
+        for (size_t i = 0; i < slots.size(); ++i)
+            newData->filters[slots[i]] = clones[order[i]];
+
+    } while (!setData(oldData, newData));
+
+    if (changed && events) events->recordHit("filters.reorder");
+
+    return changed;
+}
+
+Json::Value
+FilterPool::
+getFilterInfo() const
+{
+    GcLockBase::SharedGuard guard(gc);
+    const Data* current = data.load();
+
+    Json::Value result;
+    result["adaptive"] = adaptiveOrder();
+
+    Json::Value& filters = result["filters"];
+    filters = Json::Value(Json::arrayValue);
+
+    lock_guard<mutex> lock(costsLock);
+
+    for (size_t i = 0; i < current->filters.size(); ++i) {
+        const FilterBase* filter = current->filters[i];
+        const FilterCost& cost = *current->costs[i];
+
+        Json::Value entry;
+        entry["name"] = filter->name();
+        entry["priority"] = filter->priority();
+        entry["pinned"] = filter->pinned();
+        if (cost.hasEstimate) {
+            entry["costUs"] = cost.costUs;
+            entry["passRate"] = cost.passRate;
+            entry["rank"] = cost.rank();
+        }
+        entry["pendingSamples"] = Json::UInt(cost.samples.load());
+        filters.append(entry);
+    }
+
+    return result;
+}
+
+
 /******************************************************************************/
 /* FILTER POOL - DATA                                                         */
 /******************************************************************************/
@@ -295,7 +504,12 @@ removeConfig(const string& name)
 FilterPool::Data::
 Data(const Data& other) :
     configs(other.configs),
-    activeConfigs(other.activeConfigs)
+    activeConfigs(other.activeConfigs),
+    timingStats(other.timingStats),
+    breakLoopStats(other.breakLoopStats),
+    filteredStats(other.filteredStats),
+    statsFilters(other.statsFilters),
+    statsConfigs(other.statsConfigs)
 {
     filters.reserve(other.filters.size());
     for (FilterBase* filter : other.filters)
@@ -402,4 +616,48 @@ removeFilter(const string& name)
     filters.pop_back();
 }
 
+void
+FilterPool::Data::
+registerStats(const EventRecorder& events)
+{
+    vector<string> names;
+    names.reserve(filters.size());
+    for (FilterBase* filter : filters) names.push_back(filter->name());
+
+    // The filters rarely change so when they do, start over.
+    if (names != statsFilters) {
+        timingStats.clear();
+        breakLoopStats.clear();
+        for (const string& name : names) {
+            timingStats.push_back(
+                    events.registerEvent("filters.timingUs." + name, ET_LEVEL));
+            breakLoopStats.push_back(
+                    events.registerEvent("filters.breakLoop." + name, ET_HIT));
+        }
+
+        filteredStats.clear();
+        statsConfigs.clear();
+        statsFilters = std::move(names);
+    }
+
+    // Removed configs leave an empty entry which can't be filtered anymore.
+    filteredStats.resize(configs.size());
+    statsConfigs.resize(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i) {
+        if (statsConfigs[i] == configs[i].config) continue;
+        statsConfigs[i] = configs[i].config;
+
+        filteredStats[i].clear();
+        if (!configs[i].config) continue;
+
+        string prefix = "accounts." + configs[i].config->account.toString('.')
+            + ".filter.static.";
+
+        filteredStats[i].reserve(statsFilters.size());
+        for (const string& name : statsFilters)
+            filteredStats[i].push_back(
+                    events.registerEvent(prefix + name, ET_HIT));
+    }
+}
+
 } // namepsace RTBKit
@@ -10,19 +10,16 @@
 
 #include "rtbkit/common/filter.h"
 #include "soa/gc/gc_lock.h"
+#include "soa/service/service_base.h"
 
 #include <atomic>
 #include <vector>
 #include <memory>
 #include <string>
+#include <map>
+#include <mutex>
 
 
-namespace Datacratic {
-
-struct EventRecorder;
-
-} // namespace Datacratic
-
 namespace RTBKIT {
 
 struct BidRequest;
@@ -31,6 +28,7 @@ struct AgentInfo;
 struct AgentStatus;
 struct AgentStats;
 struct AgentConfig;
+struct AgentFilterStats;
 
 
 /******************************************************************************/
@@ -50,7 +48,8 @@ struct FilterPool
             name(std::move(name)),
             config(info.config),
             status(info.status),
-            stats(info.stats)
+            stats(info.stats),
+            filterStats(info.filterStats)
         {}
 
         void reset()
@@ -64,6 +63,7 @@ struct FilterPool
         std::shared_ptr<AgentConfig> config;
         std::shared_ptr<AgentStatus> status;
         std::shared_ptr<AgentStats> stats;
+        std::shared_ptr<const AgentFilterStats> filterStats;
 
         // Only used in the instances returned from filter.
         BiddableSpots biddableSpots;
@@ -75,6 +75,15 @@ struct FilterPool
             const ExchangeConnector* conn,
             const ConfigSet& mask = ConfigSet(true));
 
+    /** Runs the filters which only look at the given PreFilterFields on a
+        request of which only those were filled in.  Returns false if no
+        config can be left for the request once it is fully parsed.
+    */
+    bool preFilter(
+            const BidRequest& br,
+            const ExchangeConnector* conn,
+            unsigned fields);
+
 
     // \todo Need batch interfaces of these to alleviate overhead.
     void addFilter(const std::string& name);
@@ -87,8 +96,50 @@ struct FilterPool
     unsigned addConfig(const std::string& name, const AgentInfo& info);
     void removeConfig(const std::string& name);
 
+
+    /** When enabled, the filter costs and selectivities are sampled even
+        without an EventRecorder so that reorderFilters() has something to
+        work with.
+    */
+    void setAdaptiveOrder(bool enabled) { adaptive = enabled; }
+    bool adaptiveOrder() const { return adaptive; }
+
+    /** Folds what was sampled since the last call into the running estimates
+        and republishes the filters sorted by increasing cost per config
+        eliminated.  Pinned filters keep their slot.  Returns whether the
+        order changed.
+    */
+    bool reorderFilters();
+
+    /** Current filter order along with the estimates of each filter. */
+    Json::Value getFilterInfo() const;
+
 private:
 
+    /** Shared by all the Data generations so that the estimates survive the
+        swaps.  The counters are accumulated by filter() and drained by
+        reorderFilters() which is the only one to touch the estimates.
+    */
+    struct FilterCost
+    {
+        FilterCost() :
+            samples(0), ticks(0), configsIn(0), configsOut(0),
+            costUs(0), passRate(1), hasEstimate(false)
+        {}
+
+        std::atomic<uint64_t> samples;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> configsIn;
+        std::atomic<uint64_t> configsOut;
+
+        double costUs;
+        double passRate;
+        bool hasEstimate;
+
+        /** Expected cost of running the filter per config it eliminates. */
+        double rank() const;
+    };
+
     struct Data
     {
         Data() {}
@@ -103,23 +154,49 @@ private:
         void addFilter(FilterBase* filter);
         void removeFilter(const std::string& name);
 
+        /** Registers the handles of the per-filter stats below.  Handles
+            copied from the previous Data are kept for the configs that
+            haven't changed so only new or changed configs get registered.
+        */
+        void registerStats(const EventRecorder& events);
+
         // \todo Use unique_ptr when moving to gcc 4.7
         std::vector<FilterBase*> filters;
 
         std::vector<ConfigEntry> configs;
         CreativeMatrix activeConfigs;
+
+        // Indexed like filters, and like configs then filters.
+        std::vector<EventHandle> timingStats;
+        std::vector<EventHandle> breakLoopStats;
+        std::vector< std::vector<EventHandle> > filteredStats;
+
+        // What the handles above were registered for.
+        std::vector<std::string> statsFilters;
+        std::vector< std::shared_ptr<const AgentConfig> > statsConfigs;
+
+        // Indexed like filters.
+        std::vector< std::shared_ptr<FilterCost> > costs;
     };
 
     bool setData(Data*&, std::unique_ptr<Data>&);
-    void recordDiff(const Data* data, const FilterBase* f, const ConfigSet& diff);
+    void bindCosts(Data& data);
+    void recordDiff(const Data* data, size_t filter, const ConfigSet& diff);
     void recordReason(const Data* data, const FilterBase* f, FilterState & state);
-    uint64_t recordTime(uint64_t ticks, const FilterBase* filter);
+    void recordTime(uint64_t elapsed, const Data* data, size_t filter);
+    void recordCost(
+            const Data* data, size_t filter,
+            uint64_t elapsed, size_t configsIn, size_t configsOut);
 
     std::atomic<Data*> data;
     std::vector< std::shared_ptr<AgentConfig> > configs;
-    Datacratic::GcLock gc;
+    mutable Datacratic::GcLock gc;
 
     EventRecorder* events;
+    std::atomic<bool> adaptive;
+
+    mutable std::mutex costsLock;
+    std::map<std::string, std::shared_ptr<FilterCost> > costs;
 };
 
 } // namespace RTBKIT
@@ -224,6 +224,7 @@ struct CreativeExchangeFilter : public IterativeFilter<CreativeExchangeFilter>
 {
     static constexpr const char* name = "CreativeExchange";
     unsigned priority() const { return Priority::CreativeExchange; }
+    bool pinned() const { return true; }
 
     void filter(FilterState& state) const
     {
@@ -11,10 +11,11 @@
 
 LIB_FILTERS_SOURCES := \
 	static_filters.cc \
+        regex_matcher.cc \
         creative_filters.cc
 
 LIB_FILTERS_LINK := \
-	arch utils filter_registry agent_configuration rtb
+	arch utils filter_registry agent_configuration rtb boost_thread
 
 $(eval $(call library,static_filters,$(LIB_FILTERS_SOURCES),$(LIB_FILTERS_LINK)))
 
@@ -25,6 +25,7 @@ namespace RTBKIT {
 template<typename Filter>
 struct CreativeFilter : public FilterBaseT<Filter>
 {
+    bool pinned() const { return true; }
 
     // Same semantics as addConfig but called for every creatives.
     virtual void addCreative(
@@ -77,6 +78,7 @@ struct CreativeFilter : public FilterBaseT<Filter>
 template<typename Filter>
 struct IterativeCreativeFilter : public IterativeFilter<Filter>
 {
+    bool pinned() const { return true; }
 
     virtual void filter(FilterState& state) const
     {
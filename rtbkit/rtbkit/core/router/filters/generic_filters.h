@@ -11,6 +11,10 @@
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "rtbkit/core/agent_configuration/include_exclude.h"
 #include "rtbkit/common/filter.h"
+#include "regex_matcher.h"
+
+#include <atomic>
+#include <mutex>
 
 
 namespace RTBKIT {
@@ -322,12 +326,30 @@ private:
 
 /** Generic include filter for regexes.
 
-    \todo We could add a TLS cache of all seen values such that we can avoid the
-    regex entirely.
+    All the regexes are compiled into a RegexMatcher.  Changing the configs
+    only marks it as stale and it is rebuilt once by the first filter pass
+    that needs it, so adding many configs in a row doesn't recompile every
+    regex for each of them.  Filters are modified on a copy of the
+    FilterPool data, so once a copy is published the matcher is only ever
+    built once for it; the filter threads that get to a stale matcher
+    together wait on the one that builds it.
  */
 template<typename Regex, typename Str>
 struct RegexFilter
 {
+    RegexFilter() : dirty(false) {}
+
+    /* The copy is made while the original can be filtered, and rebuilt,
+       from other threads: a stale matcher is left to the copy to rebuild.
+    */
+    RegexFilter(const RegexFilter& other) : data(other.data), dirty(true)
+    {
+        if (!other.dirty.load(std::memory_order_acquire)) {
+            matcher = other.matcher;
+            dirty.store(false, std::memory_order_relaxed);
+        }
+    }
+
     template<typename List>
     bool isEmpty(const List& list) const
     {
@@ -339,6 +361,7 @@ struct RegexFilter
     {
         for (const auto& value : list)
             addConfig(cfgIndex, value);
+        dirty.store(true, std::memory_order_relaxed);
     }
 
     template<typename List>
@@ -346,20 +369,35 @@ struct RegexFilter
     {
         for (const auto& value : list)
             removeConfig(cfgIndex, value);
+        dirty.store(true, std::memory_order_relaxed);
     }
 
     ConfigSet filter(const Str& str) const
     {
-        ConfigSet matches;
-
-        for (const auto& entry : data)
-            matches |= entry.second.filter(str);
-
-        return matches;
+        if (dirty.load(std::memory_order_acquire)) rebuild();
+        return matcher ? matcher->filter(str) : ConfigSet();
     }
 
 private:
 
+    void rebuild() const
+    {
+        std::lock_guard<std::mutex> guard(rebuildLock);
+        if (!dirty.load(std::memory_order_relaxed)) return;
+
+        if (data.empty()) matcher.reset();
+        else {
+            auto newMatcher = std::make_shared<RegexMatcher<Regex, Str> >();
+            for (const auto& entry : data)
+                newMatcher->add(entry.second.regex, entry.second.configs);
+            newMatcher->compile();
+
+            matcher = std::move(newMatcher);
+        }
+
+        dirty.store(false, std::memory_order_release);
+    }
+
     void addConfig(unsigned cfgIndex, const Regex& regex)
     {
         auto& entry = data[regex.str()];
@@ -391,11 +429,6 @@ private:
     {
         Regex regex;
         ConfigSet configs;
-
-        ConfigSet filter(const Str& str) const
-        {
-            return RTBKIT::matches(regex, str) ? configs : ConfigSet();
-        }
     };
 
     typedef std::basic_string<typename Regex::value_type> KeyT;
@@ -407,6 +440,13 @@ private:
        own because, you guessed it, gcc already defines it. Glorious is it not?
     */
     std::map<KeyT, RegexData> data;
+
+    /* Immutable once built so it's shared between the copies of the filter.
+       Only written by rebuild() while dirty is set.
+    */
+    mutable std::shared_ptr<const RegexMatcher<Regex, Str> > matcher;
+    mutable std::atomic<bool> dirty;
+    mutable std::mutex rebuildLock;
 };
 
 
@@ -23,6 +23,7 @@ struct Priority
         static constexpr unsigned WhiteBlackList   = 0x0300;
         static constexpr unsigned DeviceType       = 0x3600;
         static constexpr unsigned DMA              = 0x1400;
+        static constexpr unsigned Geo              = 0x0F00;
         static constexpr unsigned VideoLinearity   = 0x3700;
         static constexpr unsigned VideoApi         = 0x3800;
         static constexpr unsigned VideoPlayback    = 0x3900;
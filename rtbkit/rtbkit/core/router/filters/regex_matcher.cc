@@ -0,0 +1,382 @@
+/** regex_matcher.cc                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Implementation of the multi-pattern regex matcher.
+
+*/
+
+#include "regex_matcher.h"
+
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+namespace RTBKIT {
+
+
+/******************************************************************************/
+/* REGEX LITERALS                                                             */
+/******************************************************************************/
+
+namespace {
+
+bool isMeta(char c)
+{
+    return strchr(".^$|?*+()[]{}\\", c) != nullptr;
+}
+
+/** Escaped punctuation is a literal except for the perl word and buffer
+    boundaries.
+ */
+bool isLiteralEscape(char c)
+{
+    return ispunct(static_cast<uint8_t>(c)) && !strchr("<>`'", c);
+}
+
+bool isContinuation(char c)
+{
+    return (static_cast<uint8_t>(c) & 0xC0) == 0x80;
+}
+
+/** Index one past the ']' closing the class that opens at pos. */
+size_t skipClass(const string& pattern, size_t pos)
+{
+    size_t i = pos + 1;
+    if (i < pattern.size() && pattern[i] == '^') ++i;
+    if (i < pattern.size() && pattern[i] == ']') ++i;
+
+    for (; i < pattern.size(); ++i) {
+        if (pattern[i] == '\\') ++i;
+        else if (pattern[i] == ']') return i + 1;
+    }
+
+    return string::npos;
+}
+
+/** Returns whether pattern[begin, end) is nothing but literal characters and
+    escaped punctuation, appending the unescaped literal to out.
+ */
+bool parsePlainLiteral(const string& pattern, size_t begin, size_t end, string& out)
+{
+    for (size_t i = begin; i < end; ++i) {
+        char c = pattern[i];
+        if (c == '\\') {
+            if (++i == end || !isLiteralEscape(pattern[i]))
+                return false;
+            out += pattern[i];
+        }
+        else if (isMeta(c)) return false;
+        else out += c;
+    }
+    return true;
+}
+
+/** Exact when the pattern, optionally wrapped in a single group, is an
+    alternation of non-empty plain literals.
+ */
+bool parseExact(const string& pattern, vector<string>& literals)
+{
+    size_t begin = 0;
+    size_t end = pattern.size();
+    if (end >= 2 && pattern[0] == '(' && pattern[end - 1] == ')') {
+        ++begin;
+        --end;
+    }
+
+    vector<string> result;
+    size_t start = begin;
+
+    for (size_t i = begin; i <= end; ++i) {
+        if (i < end && pattern[i] == '\\') { ++i; continue; }
+        if (i < end && pattern[i] != '|') continue;
+
+        string literal;
+        if (!parsePlainLiteral(pattern, start, i, literal) || literal.empty())
+            return false;
+        result.push_back(std::move(literal));
+        start = i + 1;
+    }
+
+    literals = std::move(result);
+    return true;
+}
+
+/** Longest run of literals at the top level of the pattern that isn't made
+    optional by a quantifier. Returns false if the pattern contains a construct
+    which could invalidate the analysis.
+ */
+bool parseRequired(const string& pattern, string& best)
+{
+    string run;
+    size_t atom = 0; // start of the last literal atom within run
+    int depth = 0;
+
+    auto flush = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+
+        switch (c) {
+
+        case '\\': {
+            if (++i == pattern.size()) return false;
+            char e = pattern[i];
+
+            if (isLiteralEscape(e)) {
+                if (depth) break;
+                atom = run.size();
+                run += e;
+            }
+            else if (strchr("dDwWsSbBAzZntrfv<>`'", e)) flush();
+            else return false; // \x, \p, \1, \Q, ...
+            break;
+        }
+
+        case '[':
+            i = skipClass(pattern, i);
+            if (i == string::npos) return false;
+            --i;
+            flush();
+            break;
+
+        case '(':
+            ++depth;
+            flush();
+            break;
+
+        case ')':
+            if (--depth < 0) return false;
+            flush();
+            break;
+
+        case '|':
+            if (!depth) return false;
+            break;
+
+        case '?':
+        case '*':
+        case '{':
+            if (!depth) {
+                // The previous atom is optional so it can't be part of the run.
+                run.resize(min(atom, run.size()));
+                flush();
+            }
+            if (c == '{') {
+                i = pattern.find('}', i);
+                if (i == string::npos) return false;
+            }
+            break;
+
+        case '+':
+            flush();
+            break;
+
+        case '.':
+        case '^':
+        case '$':
+            flush();
+            break;
+
+        default:
+            if (depth) break;
+            if (!isContinuation(c)) atom = run.size();
+            run += c;
+        }
+
+        // Lazy and possessive quantifiers.
+        if ((c == '?' || c == '*' || c == '+' || c == '{')
+                && i + 1 < pattern.size()
+                && (pattern[i + 1] == '?' || pattern[i + 1] == '+'))
+            ++i;
+    }
+
+    flush();
+    return depth == 0;
+}
+
+} // namespace anonymous
+
+RegexLiterals
+analyzeRegex(const string& pattern)
+{
+    RegexLiterals result;
+
+    // Flags, lookarounds and the likes.
+    if (pattern.find("(?") != string::npos) return result;
+
+    if (parseExact(pattern, result.literals)) {
+        result.kind = RegexLiterals::Exact;
+        return result;
+    }
+
+    string literal;
+    if (parseRequired(pattern, literal) && !literal.empty()) {
+        result.kind = RegexLiterals::Required;
+        result.literals = { literal };
+    }
+    else result.literals.clear();
+
+    return result;
+}
+
+
+/******************************************************************************/
+/* LITERAL MATCHER                                                            */
+/******************************************************************************/
+
+LiteralMatcher::
+LiteralMatcher() :
+    nodes(1), rootNext(256, 0), literals(0)
+{}
+
+uint32_t
+LiteralMatcher::
+child(uint32_t node, uint8_t c) const
+{
+    const auto& next = nodes[node].next;
+    auto it = lower_bound(next.begin(), next.end(), make_pair(c, uint32_t(0)));
+    return it != next.end() && it->first == c ? it->second : 0;
+}
+
+uint32_t
+LiteralMatcher::
+add(const string& literal)
+{
+    uint32_t node = 0;
+
+    for (char ch : literal) {
+        uint8_t c = static_cast<uint8_t>(ch);
+
+        uint32_t next = child(node, c);
+        if (!next) {
+            next = nodes.size();
+            auto& edges = nodes[node].next;
+            edges.insert(
+                    lower_bound(edges.begin(), edges.end(), make_pair(c, uint32_t(0))),
+                    make_pair(c, next));
+            nodes.emplace_back();
+        }
+        node = next;
+    }
+
+    uint32_t id = literals++;
+    nodes[node].outputs.push_back(id);
+    return id;
+}
+
+void
+LiteralMatcher::
+compile()
+{
+    fill(rootNext.begin(), rootNext.end(), 0);
+    for (const auto& edge : nodes[0].next)
+        rootNext[edge.first] = edge.second;
+
+    // Breadth first so that the fail node of a node is always done before it.
+    deque<uint32_t> queue;
+    for (const auto& edge : nodes[0].next) {
+        nodes[edge.second].fail = 0;
+        queue.push_back(edge.second);
+    }
+
+    while (!queue.empty()) {
+        uint32_t node = queue.front();
+        queue.pop_front();
+
+        for (const auto& edge : nodes[node].next) {
+            uint32_t target = edge.second;
+            uint32_t fail = step(nodes[node].fail, edge.first);
+
+            nodes[target].fail = fail;
+            const auto& inherited = nodes[fail].outputs;
+            nodes[target].outputs.insert(
+                    nodes[target].outputs.end(), inherited.begin(), inherited.end());
+
+            queue.push_back(target);
+        }
+    }
+}
+
+
+/******************************************************************************/
+/* REGEX MATCH STATE                                                          */
+/******************************************************************************/
+
+RegexMatchState::
+RegexMatchState() :
+    slots(CacheSize)
+{}
+
+RegexMatchState&
+RegexMatchState::
+local()
+{
+    static boost::thread_specific_ptr<RegexMatchState> state;
+
+    RegexMatchState* result = state.get();
+    if (!result) state.reset(result = new RegexMatchState());
+    return *result;
+}
+
+uint64_t
+RegexMatchState::
+newGeneration()
+{
+    static atomic<uint64_t> generation(0);
+    return ++generation;
+}
+
+uint64_t
+RegexMatchState::
+hash(const char* str, size_t size)
+{
+    // FNV-1a
+    uint64_t result = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        result ^= static_cast<uint8_t>(str[i]);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+bool
+RegexMatchState::
+lookup(
+        uint64_t generation, uint64_t hash,
+        const char* str, size_t size,
+        ConfigSet& result)
+{
+    const Slot& slot = slots[hash % CacheSize];
+
+    if (slot.generation != generation || slot.hash != hash) return false;
+    if (slot.key.size() != size || memcmp(slot.key.data(), str, size)) return false;
+
+    result = slot.result;
+    return true;
+}
+
+void
+RegexMatchState::
+insert(
+        uint64_t generation, uint64_t hash,
+        const char* str, size_t size,
+        const ConfigSet& result)
+{
+    if (size > MaxKeySize) return;
+
+    Slot& slot = slots[hash % CacheSize];
+    slot.generation = generation;
+    slot.hash = hash;
+    slot.key.assign(str, size);
+    slot.result = result;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,306 @@
+/** regex_matcher.h                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Multi-pattern matcher used by the RegexFilter to evaluate all of its regexes
+    in a single pass over the string.
+
+*/
+
+#pragma once
+
+#include "rtbkit/core/agent_configuration/include_exclude.h"
+#include "rtbkit/common/filter.h"
+#include "soa/types/string.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+namespace RTBKIT {
+
+
+/******************************************************************************/
+/* REGEX LITERALS                                                             */
+/******************************************************************************/
+
+/** Literals extracted from a perl syntax regex.
+
+    - Exact: the regex is an alternation of plain literals (eg. "(foo|bar\.com)")
+      and it matches a string iff one of the literals is a substring of it.
+
+    - Required: every match of the regex contains the (single) literal so the
+      regex only needs to be run on strings containing it.
+
+    - Opaque: nothing could be extracted and the regex must always be run.
+
+    The analysis is conservative: anything it doesn't fully understand (flags,
+    lookarounds, back references, etc.) makes the regex Opaque.
+ */
+struct RegexLiterals
+{
+    enum Kind { Opaque, Required, Exact };
+
+    RegexLiterals() : kind(Opaque) {}
+
+    Kind kind;
+    std::vector<std::string> literals;
+};
+
+RegexLiterals analyzeRegex(const std::string& pattern);
+
+
+/******************************************************************************/
+/* LITERAL MATCHER                                                            */
+/******************************************************************************/
+
+/** Aho-Corasick automaton over bytes which reports every literal that occurs
+    in a string with a single pass over it.
+ */
+struct LiteralMatcher
+{
+    LiteralMatcher();
+
+    /** Adds a literal and returns its id. Ids are allocated sequentially. */
+    uint32_t add(const std::string& literal);
+
+    /** Must be called after all the literals were added and before scan. */
+    void compile();
+
+    size_t size() const { return literals; }
+
+    /** Calls onMatch(id) for every occurrence of every literal in the string.
+        A literal that occurs multiple times is reported multiple times.
+     */
+    template<typename Fn>
+    void scan(const char* str, size_t size, Fn&& onMatch) const
+    {
+        if (!literals) return;
+
+        uint32_t state = 0;
+        for (size_t i = 0; i < size; ++i) {
+            state = step(state, static_cast<uint8_t>(str[i]));
+            for (uint32_t id : nodes[state].outputs)
+                onMatch(id);
+        }
+    }
+
+private:
+
+    struct Node
+    {
+        Node() : fail(0) {}
+
+        std::vector<std::pair<uint8_t, uint32_t> > next;
+        uint32_t fail;
+        std::vector<uint32_t> outputs;
+    };
+
+    uint32_t child(uint32_t node, uint8_t c) const;
+
+    uint32_t step(uint32_t state, uint8_t c) const
+    {
+        while (state) {
+            uint32_t next = child(state, c);
+            if (next) return next;
+            state = nodes[state].fail;
+        }
+        return rootNext[c];
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> rootNext;
+    size_t literals;
+};
+
+
+/******************************************************************************/
+/* REGEX MATCH STATE                                                          */
+/******************************************************************************/
+
+/** Per thread scratch space and bounded result cache of the RegexMatcher.
+
+    Results are keyed on the generation of the matcher that produced them so a
+    rebuilt matcher never sees the results of its predecessor.
+ */
+struct RegexMatchState
+{
+    enum {
+        CacheSize = 1024,
+        MaxKeySize = 512
+    };
+
+    static RegexMatchState& local();
+
+    static uint64_t newGeneration();
+    static uint64_t hash(const char* str, size_t size);
+
+    bool lookup(
+            uint64_t generation, uint64_t hash,
+            const char* str, size_t size,
+            ConfigSet& result);
+
+    void insert(
+            uint64_t generation, uint64_t hash,
+            const char* str, size_t size,
+            const ConfigSet& result);
+
+    std::vector<uint8_t> marks;
+
+private:
+
+    RegexMatchState();
+
+    struct Slot
+    {
+        Slot() : generation(0), hash(0) {}
+
+        uint64_t generation;
+        uint64_t hash;
+        std::string key;
+        ConfigSet result;
+    };
+
+    std::vector<Slot> slots;
+};
+
+
+/******************************************************************************/
+/* REGEX MATCHER                                                              */
+/******************************************************************************/
+
+inline std::string regexPattern(const boost::regex& regex)
+{
+    return regex.str();
+}
+
+inline std::string regexPattern(const boost::u32regex& regex)
+{
+    std::string pattern;
+    auto str = regex.str();
+    utf8::utf32to8(str.begin(), str.end(), std::back_inserter(pattern));
+    return pattern;
+}
+
+inline void rawBytes(
+        const std::string& str, std::string&, const char*& data, size_t& size)
+{
+    data = str.data();
+    size = str.size();
+}
+
+inline void rawBytes(
+        const Datacratic::Utf8String& str,
+        std::string&, const char*& data, size_t& size)
+{
+    data = str.rawData();
+    size = str.rawLength();
+}
+
+inline void rawBytes(
+        const Datacratic::Utf32String& str,
+        std::string& storage, const char*& data, size_t& size)
+{
+    utf8::utf32to8(str.begin(), str.end(), std::back_inserter(storage));
+    data = storage.data();
+    size = storage.size();
+}
+
+
+/** Immutable set of regexes that returns the union of the configs of every
+    regex matching a string.
+
+    The literals of all the regexes go in a single LiteralMatcher: exact
+    regexes are decided by the scan alone, regexes with a required literal are
+    only run when their literal shows up and the opaque ones are always run.
+ */
+template<typename Regex, typename Str>
+struct RegexMatcher
+{
+    RegexMatcher() : generation(RegexMatchState::newGeneration()) {}
+
+    void add(const Regex& regex, const ConfigSet& configs)
+    {
+        RegexLiterals info;
+        if (regex.flags() == Regex::normal)
+            info = analyzeRegex(regexPattern(regex));
+
+        uint32_t index = entries.size();
+        entries.push_back(Entry(regex, configs, info.kind == RegexLiterals::Exact));
+
+        if (info.kind == RegexLiterals::Opaque) {
+            opaque.push_back(index);
+            return;
+        }
+
+        for (const auto& literal : info.literals) {
+            literals.add(literal);
+            owners.push_back(index);
+        }
+    }
+
+    void compile()
+    {
+        literals.compile();
+    }
+
+    size_t opaqueCount() const { return opaque.size(); }
+
+    ConfigSet filter(const Str& str) const
+    {
+        std::string storage;
+        const char* data;
+        size_t size;
+        rawBytes(str, storage, data, size);
+
+        RegexMatchState& state = RegexMatchState::local();
+        uint64_t hash = RegexMatchState::hash(data, size);
+
+        ConfigSet matches;
+        if (state.lookup(generation, hash, data, size, matches))
+            return matches;
+
+        state.marks.assign(entries.size(), 0);
+
+        literals.scan(data, size, [&] (uint32_t id) {
+                    uint32_t index = owners[id];
+                    if (state.marks[index]) return;
+                    state.marks[index] = 1;
+
+                    const Entry& entry = entries[index];
+                    if (entry.exact || RTBKIT::matches(entry.regex, str))
+                        matches |= entry.configs;
+                });
+
+        for (uint32_t index : opaque) {
+            const Entry& entry = entries[index];
+            if (RTBKIT::matches(entry.regex, str))
+                matches |= entry.configs;
+        }
+
+        state.insert(generation, hash, data, size, matches);
+        return matches;
+    }
+
+private:
+
+    struct Entry
+    {
+        Entry(const Regex& regex, const ConfigSet& configs, bool exact) :
+            regex(regex), configs(configs), exact(exact)
+        {}
+
+        Regex regex;
+        ConfigSet configs;
+        bool exact;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> owners; // literal id -> entry index
+    std::vector<uint32_t> opaque;
+    LiteralMatcher literals;
+    uint64_t generation;
+};
+
+} // namespace RTBKIT
@@ -263,7 +263,7 @@ void LatLongDevFilter::removeConfig(unsigned cfgIndex,
 
 void LatLongDevFilter::filter(RTBKIT::FilterState& state) const
  {
-    RTBKIT::ConfigSet matches = state.configs();
+    ConfigSet matches = state.configs();
 
     auto it = squares_by_confindx.begin();
     if ( ! checkLatLongPresent(state.request)){
@@ -310,6 +310,236 @@ LatLongDevFilter::pointInsideAnySquare(float lat, float lon,
 
 } // namespace RTBKIT
 
+namespace JamLoop {
+
+using RTBKIT::ConfigSet;
+
+/******************************************************************************/
+/* WHITE BLACK LIST INDEX                                                     */
+/******************************************************************************/
+
+WhiteBlackListIndex::
+WhiteBlackListIndex()
+{
+    // Id 0 is always the empty set.
+    intern(ConfigSet());
+}
+
+void
+WhiteBlackListIndex::
+setConfig(unsigned cfgIndex, const WhiteBlackList& list, bool value)
+{
+    if (list.empty()) return;
+
+    listed.set(cfgIndex, value);
+    noWhiteList.set(cfgIndex, value && list.whiteList().empty());
+
+    setList(cfgIndex, list.whiteList(), true, value);
+    setList(cfgIndex, list.blackList(), false, value);
+
+    if (!value) compact();
+}
+
+void
+WhiteBlackListIndex::
+setList(unsigned cfgIndex, const WhiteBlackList::List& list,
+        bool white, bool value)
+{
+    // Most domains share the same sets so each set is only updated once.
+    Updates updates;
+
+    for (const auto& item : list) {
+        auto it = entries.find(item.first);
+        if (it == entries.end()) {
+            if (!value) continue;
+            it = entries.insert(std::make_pair(item.first, Entry())).first;
+        }
+
+        Entry& entry = it->second;
+
+        // Like WhiteBlackList::filter(), a domain listed with directories
+        // only matches those directories.
+        if (item.second.empty()) {
+            SetId& id = white ? entry.white : entry.black;
+            id = update(id, cfgIndex, value, updates);
+            continue;
+        }
+
+        for (const auto& dir : item.second) {
+            auto matches = [&](const Directory& other) {
+                return other.path == dir.path;
+            };
+
+            auto& dirs = entry.directories;
+            auto dirIt = std::find_if(dirs.begin(), dirs.end(), matches);
+            if (dirIt == dirs.end()) {
+                if (!value) continue;
+                dirIt = dirs.insert(dirs.end(), Directory(dir.path));
+            }
+
+            SetId& id = white ? dirIt->white : dirIt->black;
+            id = update(id, cfgIndex, value, updates);
+        }
+    }
+}
+
+WhiteBlackListIndex::SetId
+WhiteBlackListIndex::
+update(SetId id, unsigned cfgIndex, bool value, Updates& updates)
+{
+    auto it = updates.find(id);
+    if (it != updates.end()) return it->second;
+
+    ConfigSet set = sets[id];
+    set.set(cfgIndex, value);
+
+    SetId result = intern(set);
+    updates[id] = result;
+    return result;
+}
+
+WhiteBlackListIndex::SetId
+WhiteBlackListIndex::
+intern(const ConfigSet& set)
+{
+    std::string key;
+    for (size_t i = set.next(); i < set.size(); i = set.next(i + 1)) {
+        uint32_t index = i;
+        key.append(reinterpret_cast<const char*>(&index), sizeof(index));
+    }
+
+    auto it = setIds.find(key);
+    if (it != setIds.end()) return it->second;
+
+    SetId id = sets.size();
+    sets.push_back(set);
+    setIds.insert(std::make_pair(std::move(key), id));
+    return id;
+}
+
+void
+WhiteBlackListIndex::
+compact()
+{
+    // Drop the entries and sets that no config references anymore.
+    auto oldSets = std::move(sets);
+    sets.clear();
+    setIds.clear();
+    intern(ConfigSet());
+
+    std::vector<SetId> remap(oldSets.size(), SetId(-1));
+    remap[0] = 0;
+
+    auto move = [&](SetId& id) {
+        if (remap[id] == SetId(-1)) remap[id] = intern(oldSets[id]);
+        id = remap[id];
+    };
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        Entry& entry = it->second;
+
+        auto unused = [](const Directory& dir) {
+            return !dir.white && !dir.black;
+        };
+
+        auto& dirs = entry.directories;
+        dirs.erase(std::remove_if(dirs.begin(), dirs.end(), unused), dirs.end());
+
+        if (!entry.white && !entry.black && dirs.empty()) {
+            it = entries.erase(it);
+            continue;
+        }
+
+        move(entry.white);
+        move(entry.black);
+        for (auto& dir : dirs) {
+            move(dir.white);
+            move(dir.black);
+        }
+
+        ++it;
+    }
+}
+
+WhiteBlackListIndex::Outcome
+WhiteBlackListIndex::
+filter(const std::string& domain, const std::string& urlPath,
+       const ConfigSet& configs) const
+{
+    ConfigSet active = configs;
+    active &= listed;
+
+    ConfigSet white;
+    ConfigSet black;
+
+    auto it = entries.find(domain);
+    if (it != entries.end()) {
+        const Entry& entry = it->second;
+
+        white = sets[entry.white];
+        black = sets[entry.black];
+
+        for (const auto& dir : entry.directories) {
+            if (!dir.matches(urlPath)) continue;
+            white |= sets[dir.white];
+            black |= sets[dir.black];
+        }
+    }
+
+    Outcome result;
+
+    result.whitelisted = white & active;
+    result.blacklisted = black & active;
+    result.blacklisted &= ConfigSet(result.whitelisted).negate();
+
+    // Configs without a white list accept everything that isn't blacklisted
+    result.whitelisted |= noWhiteList & active & ConfigSet(black).negate();
+
+    result.notFound = active;
+    result.notFound &= ConfigSet(result.whitelisted | result.blacklisted).negate();
+
+    return result;
+}
+
+
+/******************************************************************************/
+/* WHITE BLACK LIST FILTER                                                    */
+/******************************************************************************/
+
+void
+WhiteBlackListFilter::
+setConfig(unsigned cfgIndex, const RTBKIT::AgentConfig& config, bool value)
+{
+    if (config.whiteBlackList.empty()) return;
+
+    if (!index.unique())
+        index = std::make_shared<WhiteBlackListIndex>(*index);
+
+    index->setConfig(cfgIndex, config.whiteBlackList, value);
+}
+
+void
+WhiteBlackListFilter::
+filter(RTBKIT::FilterState& state) const
+{
+    auto outcome = index->filter(state.domain(), state.urlPath(), state.configs());
+
+    state.narrowConfigs((outcome.blacklisted | outcome.notFound).negate());
+
+    auto& reasons = state.getFilterReasons();
+    auto addReason = [&](WhiteBlackList::Result result, const ConfigSet& configs) {
+        if (configs.empty()) return;
+        reasons.insert(std::make_pair(whiteBlackString(result), configs));
+    };
+
+    addReason(WhiteBlackList::Result::Whitelisted, outcome.whitelisted);
+    addReason(WhiteBlackList::Result::Blacklisted, outcome.blacklisted);
+    addReason(WhiteBlackList::Result::NotFound, outcome.notFound);
+}
+
+} // namespace JamLoop
+
+
 
 /******************************************************************************/
 /* INIT FILTERS                                                               */
@@ -340,6 +570,7 @@ struct InitFilters
         RTBKIT::FilterRegistry::registerFilter<JamLoop::WhiteBlackListFilter>();
         RTBKIT::FilterRegistry::registerFilter<JamLoop::DeviceTypeFilter>();
         RTBKIT::FilterRegistry::registerFilter<JamLoop::DMAFilter>();
+        RTBKIT::FilterRegistry::registerFilter<JamLoop::GeoFilter>();
         RTBKIT::FilterRegistry::registerFilter<JamLoop::VideoLinearityFilter>();
         RTBKIT::FilterRegistry::registerFilter<JamLoop::VideoApiFilter>();
         RTBKIT::FilterRegistry::registerFilter<JamLoop::VideoPlaybackFilter>();
@@ -136,6 +136,7 @@ struct UrlFilter : public FilterBaseT<UrlFilter>
 {
     static constexpr const char* name = "Url";
     unsigned priority() const { return Priority::Url; }
+    unsigned preFilterFields() const { return PF_URL; }
 
     void setConfig(unsigned configIndex, const AgentConfig& config, bool value)
     {
@@ -161,6 +162,7 @@ struct HostFilter : public FilterBaseT<HostFilter>
 {
     static constexpr const char* name = "Host";
     unsigned priority() const { return Priority::Host; }
+    unsigned preFilterFields() const { return PF_URL; }
 
     void setConfig(unsigned configIndex, const AgentConfig& config, bool value)
     {
@@ -210,9 +212,13 @@ struct LocationFilter : public FilterBaseT<LocationFilter>
 {
     static constexpr const char* name = "Location";
     unsigned priority() const { return Priority::Location; }
+    unsigned preFilterFields() const { return PF_LOCATION; }
 
     void setConfig(unsigned configIndex, const AgentConfig& config, bool value)
     {
+        // Handled by the Geo filter.
+        if (config.locationFilterCompiled) return;
+
         impl.setIncludeExclude(configIndex, value, config.locationFilter);
     }
 
@@ -237,6 +243,7 @@ struct ExchangePreFilter : public IterativeFilter<ExchangePreFilter>
 {
     static constexpr const char* name = "ExchangePre";
     unsigned priority() const { return Priority::ExchangePre; }
+    bool pinned() const { return true; }
 
     bool filterConfig(FilterState& state, const AgentConfig& config) const
     {
@@ -254,6 +261,7 @@ struct ExchangePostFilter : public IterativeFilter<ExchangePostFilter>
 {
     static constexpr const char* name = "ExchangePost";
     unsigned priority() const { return Priority::ExchangePost; }
+    bool pinned() const { return true; }
 
     bool filterConfig(FilterState& state, const AgentConfig& config) const
     {
@@ -276,6 +284,7 @@ struct ExchangeNameFilter : public FilterBaseT<ExchangeNameFilter>
 {
     static constexpr const char* name = "ExchangeName";
     unsigned priority() const { return Priority::ExchangeName; }
+    unsigned preFilterFields() const { return PF_EXCHANGE; }
 
 
     void setConfig(unsigned configIndex, const AgentConfig& config, bool value)
@@ -449,97 +458,90 @@ struct LatLongDevFilter : public RTBKIT::FilterBaseT<LatLongDevFilter>
 
 namespace JamLoop {
 
-    class WhiteBlackListFilter : public RTBKIT::IterativeFilter<WhiteBlackListFilter>
-    {
+    /** Index of the white and black lists of all the configs.
+
+        Every domain listed by at least one config has a single entry that
+        holds the configs listing the whole domain and the directories listed
+        under it, so that a single lookup gives the outcome of every config.
+        Configs are kept as indexes into a table of distinct ConfigSets: most
+        domains come from the same few files and share the same sets.
+    */
+    class WhiteBlackListIndex {
     public:
-        static constexpr const char* name = "WhiteBlackList";
+        WhiteBlackListIndex();
 
-        unsigned priority() const { return RTBKIT::Priority::JamLoop::WhiteBlackList; }
+        void setConfig(unsigned cfgIndex, const WhiteBlackList& list, bool value);
 
-        void fillOutcome(std::unordered_map<int, RTBKIT::ConfigSet>& outcome, size_t cfgIndex,
-                        WhiteBlackList::Result result) const
-        {
-            auto key = static_cast<int>(result);
-            auto& configs = outcome[key];
-            configs.set(cfgIndex);
-        }
+        struct Outcome {
+            RTBKIT::ConfigSet whitelisted;
+            RTBKIT::ConfigSet blacklisted;
+            RTBKIT::ConfigSet notFound;
+        };
 
-        void filter(RTBKIT::FilterState& state) const {
-            std::unordered_map<int, RTBKIT::ConfigSet> filterOutcome;
+        /* Same as WhiteBlackList::filter() for each of the given configs that
+           has a white or black list. */
+        Outcome filter(const std::string& domain, const std::string& urlPath,
+                       const RTBKIT::ConfigSet& configs) const;
 
-            auto matches = state.configs();
-            for (size_t i = matches.next(); i < matches.size(); i = matches.next(i + 1)) {
-                const auto& config = configs[i];
-                ExcAssert(config);
+        size_t domains() const { return entries.size(); }
+        size_t distinctSets() const { return sets.size(); }
 
-                if (config->whiteBlackList.empty()) continue;
+    private:
+        typedef uint32_t SetId;
 
-                auto result = filterDomain(state, *config);
-                fillOutcome(filterOutcome, i, result);
+        struct Directory : public WhiteBlackList::Directory {
+            Directory(std::string path) :
+                WhiteBlackList::Directory(std::move(path)), white(0), black(0)
+            { }
 
-                switch (result) {
-                case WhiteBlackList::Result::Whitelisted:
-                    continue;
-                case WhiteBlackList::Result::Blacklisted:
-                case WhiteBlackList::Result::NotFound:
-                    matches.reset(i);
-                }
-            }
-            state.narrowConfigs(matches);
+            SetId white;
+            SetId black;
+        };
 
-            for (auto outcome: filterOutcome) {
-                const auto result = static_cast<WhiteBlackList::Result>(outcome.first);
-                const auto& configs = outcome.second;
-                auto& reasons = state.getFilterReasons();
-                reasons.insert(std::make_pair(whiteBlackString(result), configs));
-            }
-        }
+        struct Entry {
+            SetId white;
+            SetId black;
+            std::vector<Directory> directories;
+        };
 
-        WhiteBlackList::Result filterDomain(
-            RTBKIT::FilterState& state,
-            const RTBKIT::AgentConfig& config) const
-        {
-            const auto& br = state.request;
-            std::string domain;
-            if (br.site) {
-                // Try extracting the domain from the site
-                if (!br.site->domain.empty())
-                    domain = br.site->domain.rawString();
-                // Let's now try on the publisher
-                else if (br.site->publisher && !br.site->publisher->domain.empty())
-                    domain = br.site->publisher->domain.rawString();
-            }
+        std::unordered_map<std::string, Entry> entries;
 
-            const auto& url = br.url;
+        std::vector<RTBKIT::ConfigSet> sets;
+        std::unordered_map<std::string, SetId> setIds;
 
-            // If the domain is not found, fallback on the page url
-            if (domain.empty()) {
-                domain = url.host();
-            }
+        RTBKIT::ConfigSet listed;       // configs with a white or black list
+        RTBKIT::ConfigSet noWhiteList;  // configs with only a black list
 
-            // Removing the http:// part from the domain
-            {
-                static constexpr const char* Http = "http://";
-                static constexpr size_t Size = sizeof("http://") - 1;
+        typedef std::unordered_map<SetId, SetId> Updates;
 
-                if (!domain.compare(0, Size, Http)) {
-                    domain = domain.substr(Size);
-                }
-            }
+        void setList(unsigned cfgIndex, const WhiteBlackList::List& list,
+                     bool white, bool value);
+        SetId update(SetId id, unsigned cfgIndex, bool value, Updates& updates);
+        SetId intern(const RTBKIT::ConfigSet& set);
+        void compact();
+    };
 
-            // Removing the www part from the domain
-            {
-                static constexpr const char *WWW = "www.";
-                static constexpr size_t Size = 4;
+    class WhiteBlackListFilter : public RTBKIT::FilterBaseT<WhiteBlackListFilter>
+    {
+    public:
+        static constexpr const char* name = "WhiteBlackList";
 
-                if (!domain.compare(0, Size, WWW)) {
-                    domain = domain.substr(Size);
-                }
-            }
+        unsigned priority() const { return RTBKIT::Priority::JamLoop::WhiteBlackList; }
+        unsigned preFilterFields() const { return RTBKIT::PF_URL; }
 
-            return config.whiteBlackList.filter(domain, url);
-        }
+        WhiteBlackListFilter() :
+            index(std::make_shared<WhiteBlackListIndex>())
+        { }
+
+        void setConfig(unsigned cfgIndex, const RTBKIT::AgentConfig& config, bool value);
+        void filter(RTBKIT::FilterState& state) const;
+
+        const WhiteBlackListIndex& getIndex() const { return *index; }
 
+    private:
+        /* Filters are cloned on every config change, so the index is shared
+           between the clones and copied on the first change. */
+        std::shared_ptr<WhiteBlackListIndex> index;
     };
 
     class DeviceTypeFilter : public RTBKIT::FilterBaseT<DeviceTypeFilter> {
@@ -547,6 +549,7 @@ namespace JamLoop {
         static constexpr const char* name = "DeviceType";
 
         unsigned priority() const { return RTBKIT::Priority::JamLoop::DeviceType; }
+        unsigned preFilterFields() const { return RTBKIT::PF_DEVICE_TYPE; }
 
         void setConfig(unsigned configIndex, const RTBKIT::AgentConfig& config, bool value)
         {
@@ -569,6 +572,7 @@ namespace JamLoop {
         static constexpr const char* name = "DMA";
 
         unsigned priority() const { return RTBKIT::Priority::JamLoop::DMA; }
+        unsigned preFilterFields() const { return RTBKIT::PF_USER_GEO; }
 
 
         void setConfig(unsigned configIndex, const RTBKIT::AgentConfig& config, bool value)
@@ -595,11 +599,124 @@ namespace JamLoop {
         }
     };
 
+    /* Inverted index from each geo value to the configs that list it */
+    struct GeoIndex
+    {
+        bool isEmpty(const GeoSets& sets) const
+        {
+            return sets.empty();
+        }
+
+        void addConfig(unsigned cfgIndex, const GeoSets& sets)
+        {
+            setConfig(cfgIndex, sets, true);
+        }
+
+        void removeConfig(unsigned cfgIndex, const GeoSets& sets)
+        {
+            setConfig(cfgIndex, sets, false);
+        }
+
+        RTBKIT::ConfigSet filter(const RTBKIT::Location& location) const
+        {
+            RTBKIT::ConfigSet matches;
+
+            if (!zips.empty() && !location.postalCode.empty()) {
+                const std::string& zip = location.postalCode.rawString();
+                lookup(zips, zip, matches);
+
+                // ZIP+4 codes still match their zip like the regexes did.
+                if (zip.size() > 5 && zip[5] == '-')
+                    lookup(zips, zip.substr(0, 5), matches);
+            }
+
+            lookup(metros, location.dma, matches);
+            lookup(regions, location.regionCode, matches);
+            lookup(countries, location.countryCode, matches);
+
+            return matches;
+        }
+
+    private:
+        template<typename Key>
+        using Index = std::unordered_map<Key, RTBKIT::ConfigSet>;
+
+        Index<std::string> zips;
+        Index<int> metros;
+        Index<std::string> regions;
+        Index<std::string> countries;
+
+        template<typename Key>
+        static void lookup(
+                const Index<Key>& index, const Key& key, RTBKIT::ConfigSet& matches)
+        {
+            if (index.empty()) return;
+
+            auto it = index.find(key);
+            if (it != index.end()) matches |= it->second;
+        }
+
+        template<typename Key>
+        static void setIndex(
+                Index<Key>& index, const std::unordered_set<Key>& keys,
+                unsigned cfgIndex, bool value)
+        {
+            for (const auto& key: keys) {
+                if (value) {
+                    index[key].set(cfgIndex);
+                    continue;
+                }
+
+                auto it = index.find(key);
+                if (it == index.end()) continue;
+
+                it->second.reset(cfgIndex);
+                if (it->second.empty()) index.erase(it);
+            }
+        }
+
+        void setConfig(unsigned cfgIndex, const GeoSets& sets, bool value)
+        {
+            setIndex(zips, sets.zips, cfgIndex, value);
+            setIndex(metros, sets.metros, cfgIndex, value);
+            setIndex(regions, sets.regions, cfgIndex, value);
+            setIndex(countries, sets.countries, cfgIndex, value);
+        }
+    };
+
+    /* Matches the geoFilter of the configs, which also holds their
+       locationFilter when it was only made of zip alternations. Every field of
+       the request is hashed once per set instead of searching every distinct
+       regex in the full location string.
+    */
+    struct GeoFilter : public RTBKIT::FilterBaseT<GeoFilter>
+    {
+        static constexpr const char* name = "Geo";
+
+        unsigned priority() const { return RTBKIT::Priority::JamLoop::Geo; }
+        unsigned preFilterFields() const { return RTBKIT::PF_LOCATION; }
+
+        void setConfig(unsigned configIndex, const RTBKIT::AgentConfig& config, bool value)
+        {
+            impl.setInclude(configIndex, value, config.geoFilter.include);
+            impl.setExclude(configIndex, value, config.geoFilter.exclude);
+        }
+
+        void filter(RTBKIT::FilterState& state) const
+        {
+            state.narrowConfigs(impl.filter(state.request.location));
+        }
+
+    private:
+        RTBKIT::IncludeExcludeFilter<GeoIndex> impl;
+    };
+
     struct VideoLinearityFilter : public RTBKIT::FilterBaseT<VideoLinearityFilter>
     {
         static constexpr const char* name = "VideoLinearity";
 
         unsigned priority() const { return RTBKIT::Priority::JamLoop::VideoLinearity; }
+        unsigned preFilterFields() const { return RTBKIT::PF_VIDEO; }
 
         void setConfig(unsigned configIndex, const RTBKIT::AgentConfig& config, bool value)
         {
@@ -216,6 +216,93 @@ BOOST_AUTO_TEST_CASE(regexFilterTest)
     check(filter.filter("c"),   { 2 });
     check(filter.filter("abb"), { 2 });
     check(filter.filter("d"),   { });
+
+    title("regex-5");
+    // The matcher is only rebuilt when filtering; copies taken before and
+    // after a change each end up with their own.
+    auto before = filter;
+    filter.addConfig(4, makeList({ regex("b") }));
+    auto stale = filter;
+
+    check(filter.filter("b"),   { 4 });
+    check(before.filter("b"),   { });
+    check(stale.filter("b"),    { 4 });
+    check(stale.filter("a"),    { 2 });
+}
+
+BOOST_AUTO_TEST_CASE(regexLiteralsTest)
+{
+    auto checkKind = [] (
+            const string& pattern,
+            RegexLiterals::Kind kind,
+            const vector<string>& literals)
+    {
+        auto result = analyzeRegex(pattern);
+        BOOST_CHECK_MESSAGE(result.kind == kind, pattern);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+                result.literals.begin(), result.literals.end(),
+                literals.begin(), literals.end());
+    };
+
+    checkKind("a|b",                RegexLiterals::Exact, { "a", "b" });
+    checkKind("(foo\\.com|bar)",    RegexLiterals::Exact, { "foo.com", "bar" });
+    checkKind("^ab+",               RegexLiterals::Required, { "ab" });
+    checkKind("^http://[a-z]+\\.cnn\\.com/", RegexLiterals::Required, { ".cnn.com/" });
+    checkKind("abc?def",            RegexLiterals::Required, { "def" });
+    checkKind("x(abcdef)*y",        RegexLiterals::Required, { "x" });
+    checkKind("a|b+",               RegexLiterals::Opaque, {});
+    checkKind("(?i)abc",            RegexLiterals::Opaque, {});
+    checkKind("\\x41bcd",           RegexLiterals::Opaque, {});
+    checkKind("a|",                 RegexLiterals::Opaque, {});
+    checkKind(".*",                 RegexLiterals::Opaque, {});
+}
+
+BOOST_AUTO_TEST_CASE(literalMatcherTest)
+{
+    LiteralMatcher matcher;
+    matcher.add("he");
+    matcher.add("she");
+    matcher.add("his");
+    matcher.add("hers");
+    matcher.compile();
+
+    vector<uint32_t> found;
+    string str = "ushers";
+    matcher.scan(str.data(), str.size(), [&] (uint32_t id) { found.push_back(id); });
+
+    vector<uint32_t> expected = { 0, 1, 3 };
+    sort(found.begin(), found.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+            found.begin(), found.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(regexMatcherTest)
+{
+    using boost::regex;
+
+    vector<regex> regexes = {
+        regex("cnn\\.com"), regex("(espn|nfl)"), regex("^https://"),
+        regex("/news/[0-9]+"), regex("[a-z]+\\.org$"), regex("sports?\\b")
+    };
+
+    RegexFilter<regex, string> filter;
+    for (size_t i = 0; i < regexes.size(); ++i)
+        filter.addConfig(i, makeList({ regexes[i] }));
+
+    vector<string> urls = {
+        "http://cnn.com/news/123", "https://espn.go.com/nfl", "http://wiki.org",
+        "http://sport.example.com/", "http://nothing.net/news/", "",
+        "http://cnn.com/news/123" // cached
+    };
+
+    for (const auto& url : urls) {
+        ConfigSet expected;
+        for (size_t i = 0; i < regexes.size(); ++i)
+            if (boost::regex_search(url, regexes[i])) expected.set(i);
+
+        ConfigSet result = filter.filter(url);
+        BOOST_CHECK_MESSAGE((result ^ expected).empty(), url);
+    }
 }
 
 BOOST_AUTO_TEST_CASE(segmentListTest)
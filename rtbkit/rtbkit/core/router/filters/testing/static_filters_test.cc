@@ -755,3 +755,87 @@ BOOST_AUTO_TEST_CASE( LatLongDevFilterTest)
     doCheck(br9, { 2, 3});
 
 }
+
+
+/** Geo filter with both the structured sets and the locationFilter zip
+    alternations that get compiled into them.
+ */
+BOOST_AUTO_TEST_CASE( geoFilter )
+{
+    JamLoop::GeoFilter filter;
+    LocationFilter locationFilter;
+    ConfigSet mask;
+
+    auto doCheck = [&] (
+            BidRequest& request,
+            const initializer_list<size_t>& expected)
+    {
+        check(filter, request, "ex0", mask, expected);
+    };
+
+    auto makeConfig = [] (const string& filters) {
+        string json =
+            "{ \"account\": [\"geo\"],"
+            "  \"creatives\": [ { \"id\": 1, \"width\": 300, \"height\": 250 } ]"
+            + filters + "}";
+        return AgentConfig::createFromJson(Json::parse(json));
+    };
+
+    auto createBr = [] (const string& country, const string& region,
+                        const string& zip, int dma)
+    {
+        BidRequest br;
+        br.location.countryCode = country;
+        br.location.regionCode = region;
+        br.location.postalCode = Datacratic::UnicodeString(zip);
+        br.location.dma = dma;
+        return br;
+    };
+
+    AgentConfig c0 = makeConfig("");
+    AgentConfig c1 = makeConfig(
+            ", \"locationFilter\": { \"include\": [ \"(47201|47202)\" ] }");
+    AgentConfig c2 = makeConfig(
+            ", \"geoFilter\": { \"include\": { \"metro\": [ \"527\" ],"
+            "                                  \"region\": [ \"KY\" ] },"
+            "                   \"exclude\": { \"zip\": [ \"40143\" ] } }");
+    AgentConfig c3 = makeConfig(
+            ", \"locationFilter\": { \"include\": [ \"^US:IN\" ] }");
+
+    BOOST_CHECK(c1.locationFilterCompiled);
+    BOOST_CHECK_EQUAL(c1.geoFilter.include.zips.size(), 2);
+    BOOST_CHECK(c1.toJson().isMember("locationFilter"));
+    BOOST_CHECK(!c1.toJson().isMember("geoFilter"));
+    BOOST_CHECK(!c2.locationFilterCompiled);
+    BOOST_CHECK(c2.toJson().isMember("geoFilter"));
+    BOOST_CHECK(!c3.locationFilterCompiled);
+
+    addConfig(filter, 0, c0); mask.set(0);
+    addConfig(filter, 1, c1); mask.set(1);
+    addConfig(filter, 2, c2); mask.set(2);
+    addConfig(filter, 3, c3); mask.set(3);
+
+    title("geo-1");
+
+    BidRequest br0 = createBr("US", "IN", "47201", 527);
+    BidRequest br1 = createBr("US", "IN", "47202-1234", 0);
+    BidRequest br2 = createBr("US", "KY", "40143", 0);
+    BidRequest br3 = createBr("US", "KY", "40165", 0);
+    BidRequest br4 = createBr("US", "OH", "47203", 0);
+
+    doCheck(br0, { 0, 1, 2, 3 });
+    doCheck(br1, { 0, 1, 3 });
+    doCheck(br2, { 0, 3 });
+    doCheck(br3, { 0, 2, 3 });
+    doCheck(br4, { 0, 3 });
+
+    title("geo-2");
+
+    // The compiled config is left to the geo filter.
+    addConfig(locationFilter, 1, c1);
+    addConfig(locationFilter, 3, c3);
+    check(locationFilter, br4, "ex0", mask, { 0, 1, 2 });
+
+    removeConfig(filter, 1, c1);
+    doCheck(br4, { 0, 1, 3 });
+}
@@ -0,0 +1,270 @@
+/** request_value.cc                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Implementation of the request value table.
+
+*/
+
+#include "request_value.h"
+#include "rtbkit/common/bid_request.h"
+
+#include <mutex>
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+
+
+namespace RTBKIT {
+
+namespace {
+
+/** Weight kept by the counts at each update.  With the router calling
+    update() every second, the history has a half-life of about 15 seconds.
+*/
+const double Decay = 0.955;
+
+/** Below this many decayed requests a key doesn't say much and the request
+    is scored on a less specific key.
+*/
+const double MinRequests = 50.0;
+
+/** Below this many decayed requests a key is dropped from the table. */
+const double MinKeptRequests = 0.5;
+
+/** Score of a request with no history at all. */
+const double DefaultValue = 1.0;
+
+string exchangeKey(const RequestValueTable::Key& key)
+{
+    return "exchange:" + key.exchange;
+}
+
+string publisherKey(const RequestValueTable::Key& key)
+{
+    return "publisher:" + key.exchange + ":" + key.publisher;
+}
+
+string domainKey(const RequestValueTable::Key& key)
+{
+    return "domain:" + key.domain;
+}
+
+} // namespace anonymous
+
+
+/******************************************************************************/
+/* REQUEST VALUE TABLE                                                        */
+/******************************************************************************/
+
+RequestValueTable::Key::
+Key(const BidRequest& br) : exchange(br.exchange)
+{
+    const OpenRTB::Publisher* pub = nullptr;
+    if (br.site && br.site->publisher) pub = br.site->publisher.get();
+    else if (br.app && br.app->publisher) pub = br.app->publisher.get();
+
+    if (pub && pub->id) publisher = pub->id.toString();
+
+    // Same as FilterState::domain()
+    if (br.site) {
+        if (!br.site->domain.empty())
+            domain = br.site->domain.rawString();
+        else if (br.site->publisher && !br.site->publisher->domain.empty())
+            domain = br.site->publisher->domain.rawString();
+    }
+
+    if (domain.empty())
+        domain = br.url.host();
+
+    size_t start = 0;
+
+    static const string http = "http://";
+    if (!domain.compare(0, http.size(), http))
+        start += http.size();
+
+    static const string www = "www.";
+    if (!domain.compare(start, www.size(), www))
+        start += www.size();
+
+    domain.erase(0, start);
+}
+
+double
+RequestValueTable::Counts::
+value() const
+{
+    if (requests <= 0.0) return DefaultValue;
+
+    // A win is worth a bid on top of the bid that it is.
+    return std::min(1.0, (bids + wins) / (2 * requests));
+}
+
+RequestValueTable::
+RequestValueTable() : table(new Table())
+{}
+
+RequestValueTable::
+~RequestValueTable()
+{
+    {
+        GcLockBase::SharedGuard guard(gc);
+        Table* old = table.exchange(nullptr);
+        gc.defer([=] { delete old; });
+    }
+
+    gc.deferBarrier();
+}
+
+const RequestValueTable::Counts*
+RequestValueTable::
+find(const Table& table, const string& key) const
+{
+    auto it = table.find(key);
+    if (it == table.end() || it->second.requests < MinRequests)
+        return nullptr;
+    return &it->second;
+}
+
+const RequestValueTable::Counts*
+RequestValueTable::
+find(const Table& table, const Key& key) const
+{
+    const Counts* counts = nullptr;
+    if (!key.domain.empty())
+        counts = find(table, domainKey(key));
+    if (!counts && !key.publisher.empty())
+        counts = find(table, publisherKey(key));
+    if (!counts)
+        counts = find(table, exchangeKey(key));
+    return counts;
+}
+
+double
+RequestValueTable::
+score(const Key& key) const
+{
+    GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+    const Counts* counts = find(*table.load(), key);
+    return counts ? counts->value() : DefaultValue;
+}
+
+void
+RequestValueTable::
+record(const Key& key, bool bid, bool won)
+{
+    add(key, 1, bid ? 1 : 0, won ? 1 : 0);
+}
+
+void
+RequestValueTable::
+recordShed(const Key& key)
+{
+    double bidRate, winRate;
+    {
+        GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+        const Counts* counts = find(*table.load(), key);
+
+        // Without history there's no rate to credit the request with and
+        // making one up would inflate the key; it has to earn it from the
+        // requests that aren't shed.
+        if (!counts) return;
+
+        bidRate = counts->bids / counts->requests;
+        winRate = counts->wins / counts->requests;
+    }
+
+    add(key, 1, bidRate, winRate);
+}
+
+void
+RequestValueTable::
+add(const Key& key, double requests, double bids, double wins)
+{
+    auto add = [&] (Counts& counts) {
+        counts.requests += requests;
+        counts.bids += bids;
+        counts.wins += wins;
+    };
+
+    string exchange = exchangeKey(key);
+    string publisher = key.publisher.empty() ? "" : publisherKey(key);
+    string domain = key.domain.empty() ? "" : domainKey(key);
+
+    lock_guard<Spinlock> guard(pendingLock);
+
+    add(pending[exchange]);
+    if (!publisher.empty()) add(pending[publisher]);
+    if (!domain.empty()) add(pending[domain]);
+}
+
+void
+RequestValueTable::
+update()
+{
+    Table recorded;
+    {
+        lock_guard<Spinlock> guard(pendingLock);
+        recorded.swap(pending);
+    }
+
+    // Only update() replaces the table so the current one can be read
+    // without holding the lock.
+    unique_ptr<Table> next(new Table());
+    {
+        GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+        const Table& current = *table.load();
+
+        next->reserve(current.size() + recorded.size());
+        for (const auto& entry : current) {
+            Counts counts = entry.second;
+            counts.requests *= Decay;
+            counts.bids *= Decay;
+            counts.wins *= Decay;
+
+            if (counts.requests < MinKeptRequests
+                    && !recorded.count(entry.first))
+                continue;
+
+            next->insert(make_pair(entry.first, counts));
+        }
+    }
+
+    for (const auto& entry : recorded) {
+        Counts& counts = (*next)[entry.first];
+        counts.requests += entry.second.requests;
+        counts.bids += entry.second.bids;
+        counts.wins += entry.second.wins;
+    }
+
+    GcLockBase::SharedGuard guard(gc);
+    Table* old = table.exchange(next.release());
+    gc.defer([=] { delete old; });
+}
+
+Json::Value
+RequestValueTable::
+toJson() const
+{
+    GcLockBase::SharedGuard guard(gc, GcLockBase::RD_NO);
+    const Table& current = *table.load();
+
+    Json::Value result(Json::objectValue);
+    for (const auto& entry : current) {
+        const Counts& counts = entry.second;
+        auto rate = [&] (double count) {
+            return counts.requests > 0.0 ? count / counts.requests : 0.0;
+        };
+
+        Json::Value& json = result[entry.first];
+        json["requests"] = counts.requests;
+        json["bidRate"] = rate(counts.bids);
+        json["winRate"] = rate(counts.wins);
+        json["value"] = counts.value();
+    }
+
+    return result;
+}
+
+} // namespace RTBKIT
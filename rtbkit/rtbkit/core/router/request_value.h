@@ -0,0 +1,110 @@
+/** request_value.h                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Historical value of the requests of an exchange, publisher and domain,
+    used to shed the least valuable ones first under load.
+
+*/
+
+#pragma once
+
+#include "soa/gc/gc_lock.h"
+#include "soa/jsoncpp/value.h"
+#include "jml/arch/spinlock.h"
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+
+namespace RTBKIT {
+
+struct BidRequest;
+
+
+/******************************************************************************/
+/* REQUEST VALUE TABLE                                                        */
+/******************************************************************************/
+
+/** Keeps decayed counts of the requests, bids and wins that the router sees
+    for each exchange, publisher and domain.  A bid is a request on which at
+    least one agent bid and a win is one on which a bid was sent back to the
+    exchange; wins on the exchange itself are only known downstream of the
+    router.
+
+    A request is scored on the most specific of its keys that has enough
+    history: its domain, then its publisher, then its exchange.
+
+    record() and recordShed() can be called from any thread and update()
+    from one thread at a time; score() is lock-free.
+*/
+struct RequestValueTable
+{
+    RequestValueTable();
+    ~RequestValueTable();
+
+    /** Parts of a request that it is scored on.  Only the exchange, the url
+        and the site or app publisher are looked at.
+    */
+    struct Key
+    {
+        explicit Key(const BidRequest& br);
+
+        std::string exchange;
+        std::string publisher;
+        std::string domain;
+    };
+
+    /** Value of a request between 0 and 1. */
+    double score(const Key& key) const;
+    double score(const BidRequest& br) const { return score(Key(br)); }
+
+    /** Accounts for the outcome of a request. */
+    void record(const Key& key, bool bid, bool won);
+
+    /** Accounts for a request that was shed before it reached the router.
+        It counts as a request with the bid and win rates of the key that
+        it was scored on, so that a key that is being shed keeps its
+        history and the less specific keys aren't skewed towards the
+        requests that were kept.  Nothing is recorded for a request that
+        has no history to be scored on.
+    */
+    void recordShed(const Key& key);
+    void recordShed(const BidRequest& br) { recordShed(Key(br)); }
+
+    /** Decays the counts and folds in what was recorded since the last call.
+        Meant to be called periodically.
+    */
+    void update();
+
+    /** Current counts and values of each key. */
+    Json::Value toJson() const;
+
+private:
+
+    struct Counts
+    {
+        Counts() : requests(0), bids(0), wins(0) {}
+
+        double requests;
+        double bids;
+        double wins;
+
+        double value() const;
+    };
+
+    typedef std::unordered_map<std::string, Counts> Table;
+
+    const Counts* find(const Table& table, const std::string& key) const;
+    const Counts* find(const Table& table, const Key& key) const;
+
+    void add(const Key& key, double requests, double bids, double wins);
+
+    std::atomic<Table*> table;
+    mutable Datacratic::GcLock gc;
+
+    ML::Spinlock pendingLock;
+    Table pending;
+};
+
+} // namespace RTBKIT
@@ -13,6 +13,7 @@
 #include "jml/arch/exception_handler.h"
 #include "soa/jsoncpp/writer.h"
 #include <boost/foreach.hpp>
+#include <poll.h>
 #include "jml/arch/atomic_ops.h"
 #include "jml/utils/set_utils.h"
 #include "jml/utils/environment.h"
@@ -44,6 +45,39 @@ namespace RTBKIT {
 /* AGENT INFO                                                                */
 /*****************************************************************************/
 
+AgentFilterStats::
+AgentFilterStats(const EventRecorder & events, const AccountKey & account)
+{
+    string prefix = "accounts." + account.toString('.') + ".filter.";
+
+    auto hit = [&] (const char * reason)
+        {
+            return events.registerEvent(prefix + reason, ET_HIT);
+        };
+
+    auto outcome = [&] (const char * metric)
+        {
+            return events.registerEvent(prefix + metric, ET_OUTCOME);
+        };
+
+    intoStaticFilters = hit("intoStaticFilters");
+    agentAppearsDead = hit("static.agentAppearsDead");
+    earlyTooManyInFlight = hit("static.earlyTooManyInFlight");
+    staticNotEnoughTime = hit("static.notEnoughTime");
+    passedStaticFilters = hit("passedStaticFilters");
+
+    intoDynamicFilters = hit("intoDynamicFilters");
+    tooManyInFlight = hit("dynamic.tooManyInFlight");
+    notEnoughTime = hit("dynamic.notEnoughTime");
+    timeUsedBeforeDynamicFilter = outcome("metric.timeUsedBeforeDynamicFilter");
+    timeLeftBeforeDynamicFilter = outcome("metric.timeLeftBeforeDynamicFilter");
+    timeElapsedBeforePreproMs = outcome("metric.timeElapsedBeforePreproMs");
+    timeElapsedDuringPreproMs = outcome("metric.timeElapsedDuringPreproMs");
+    timeWindowMs = outcome("metric.timeWindowMs");
+    userBlacklisted = hit("dynamic.userBlacklisted");
+    passedDynamicFilters = hit("passedDynamicFilters");
+}
+
 Json::Value
 AgentInfoEntry::
 toJson() const
@@ -123,10 +157,8 @@ Router(ServiceBase & parent,
       postAuctionEndpoint(*this),
       configBuffer(1024),
       exchangeBuffer(64),
-      startBiddingBuffer(65536),
-      submittedBuffer(65536),
-      auctionGraveyard(65536),
-      doBidBuffer(65536),
+      bidderBuffer(65536),
+      queueBidderCalls(false),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
@@ -177,10 +209,8 @@ Router(std::shared_ptr<ServiceProxies> services,
       postAuctionEndpoint(*this),
       configBuffer(1024),
       exchangeBuffer(64),
-      startBiddingBuffer(65536),
-      submittedBuffer(65536),
-      auctionGraveyard(65536),
-      doBidBuffer(65536),
+      bidderBuffer(65536),
+      queueBidderCalls(false),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
@@ -275,12 +305,68 @@ initFilters(const Json::Value & config) {
     }
 }
 
+void
+Router::
+initAugmentors(const Json::Value & config)
+{
+    if (!config.isArray())
+        throw Exception("augmentor configuration must be an array");
+
+    for (const auto & json : config) {
+        auto augmentor = HostedAugmentor::create("", getServices(), json);
+        augmentationLoop.hostAugmentor(
+                augmentor, json.get("maxInFlight", -1).asInt());
+    }
+}
+
+Router::Shard::
+Shard(unsigned index)
+    : index(index),
+      startBiddingBuffer(65536),
+      submittedBuffer(65536),
+      doBidBuffer(65536),
+      agentBidBuffer(65536),
+      numInFlight(0),
+      totalActive(0.0)
+{
+}
+
+void
+Router::
+initShards(size_t numShards)
+{
+    ExcAssert(!runThread);
+
+    if (numShards == 0)
+        throw ML::Exception("router needs at least one shard");
+
+    shards.clear();
+    for (size_t i = 0;  i < numShards;  ++i)
+        shards.emplace_back(new Shard(i));
+
+    for (auto & agent : agents)
+        agent.second.setNumShards(numShards);
+}
+
+size_t
+Router::
+numInFlight() const
+{
+    size_t result = 0;
+    for (auto & shard : shards)
+        result += shard->numInFlight;
+    return result;
+}
+
 void
 Router::
 init()
 {
     ExcAssert(!initialized);
 
+    if (shards.empty())
+        initShards(1);
+
     registerServiceProvider(serviceName(), { "rtbRequestRouter" });
 
     filters.init(this);
@@ -454,6 +540,26 @@ start(boost::function<void ()> onStop)
     logger.start();
     analytics.start();
     augmentationLoop.start();
+
+    queueBidderCalls = shards.size() > 1 && !bidder->isThreadSafe();
+
+    if (shards.size() > 1) {
+        for (auto & shard : shards) {
+            Shard * s = shard.get();
+            double lastTotalActive = 0.0;
+            loopMonitor.addCallback(
+                    ML::format("routerLoop.shard%d", s->index),
+                    [=] (double elapsed) mutable {
+                        double totalActive = s->totalActive.load();
+                        double delta = totalActive - lastTotalActive;
+                        lastTotalActive = totalActive;
+                        return delta / elapsed;
+                    });
+
+            s->thread.reset(new boost::thread([=] () { this->runShard(*s); }));
+        }
+    }
+
     runThread.reset(new boost::thread(runfn));
 
     if (connectPostAuctionLoop) {
@@ -463,26 +569,6 @@ start(boost::function<void ()> onStop)
     configListener.init(getServices()->config);
     configListener.start();
 
-    /* This is an extra thread which sits there deleting auctions
-       to take this out of the hands of the main loop (it can easily use
-       up nearly 20% of the capacity of the main loop).
-    */
-    auto auctionDeleter = [=] ()
-        {
-            while (!this->shutdown_) {
-                std::shared_ptr<Auction> toDelete;
-                auctionGraveyard.tryPop(toDelete, 0.05);
-                int numDeleted = 1;
-                while (this->auctionGraveyard.tryPop(toDelete))
-                    ++numDeleted;
-                //cerr << "deleted " << numDeleted << " auctions"
-                //     << endl;
-                ML::sleep(0.001);
-            }
-        };
-
-    cleanupThread.reset(new boost::thread(auctionDeleter));
-
     monitorClient.start();
     monitorProviderClient.start();
 
@@ -496,7 +582,7 @@ numNonIdle() const
     size_t numInFlight, numAwaitingAugmentation;
     {
         Guard guard(lock);
-        numInFlight = inFlight.size();
+        numInFlight = this->numInFlight();
         numAwaitingAugmentation = augmentationLoop.numAugmenting();
     }
 
@@ -537,13 +623,18 @@ run()
 {
     using namespace std;
 
+    // With a single shard, the main loop processes its auctions
+    Shard * mainShard = shards.size() == 1 ? shards[0].get() : nullptr;
+
     zmq_pollitem_t items [] = {
         { bridge.agents.getSocketUnsafe(), 0, ZMQ_POLLIN, 0 },
-        { 0, wakeupMainLoop.fd(), ZMQ_POLLIN, 0 }
+        { 0, wakeupMainLoop.fd(), ZMQ_POLLIN, 0 },
+        { 0, mainShard ? mainShard->wakeup.fd() : -1, ZMQ_POLLIN, 0 }
     };
+    int numItems = mainShard ? 3 : 2;
 
     double last_check = ML::wall_time(), last_check_pace = last_check,
-        lastPings = last_check;
+        lastPings = last_check, lastRequestValues = last_check;
 
     //cerr << "server listening" << endl;
 
@@ -604,7 +695,7 @@ run()
             double atStart = getTime();
 
             for (unsigned i = 0;  i < 20 && rc == 0;  ++i)
-                rc = zmq_poll(items, 2, 0);
+                rc = zmq_poll(items, numItems, 0);
 
             recordTime("spinPoll", atStart);
         }
@@ -635,7 +726,7 @@ run()
             }
 
             double pollStart = getTime();
-            rc = zmq_poll(items, 2, 50 /* milliseconds */);
+            rc = zmq_poll(items, numItems, 50 /* milliseconds */);
             recordTime("sleepPoll", pollStart);
         }
 
@@ -648,25 +739,17 @@ run()
             cerr << "zeromq error: " << zmq_strerror(zmq_errno()) << endl;
         }
 
-        {
-            double atStart = getTime();
-            std::shared_ptr<AugmentationInfo> info;
-            while (startBiddingBuffer.tryPop(info)) {
-                doStartBidding(info);
-            }
-
-            recordTime("doStartBidding", atStart);
-        }
+        if (mainShard)
+            processShard(*mainShard, recordTime);
 
         {
             double atStart = getTime();
 
-            BidMessage message;
-            while (doBidBuffer.tryPop(message)) {
-                doBidImpl(message);
-            }
+            std::function<void ()> call;
+            while (bidderBuffer.tryPop(call))
+                call();
 
-            recordTime("doBid", atStart);
+            recordTime("bidder", atStart);
         }
 
         {
@@ -695,16 +778,6 @@ run()
             recordTime("doConfig", atStart);
         }
 
-        {
-            double atStart = getTime();
-
-            std::shared_ptr<Auction> auction;
-            while (submittedBuffer.tryPop(auction))
-                doSubmitted(auction);
-
-            recordTime("doSubmitted", atStart);
-        }
-
         if (items[0].revents & ZMQ_POLLIN) {
             double atStart = getTime();
             // Agent message
@@ -727,6 +800,10 @@ run()
             wakeupMainLoop.read();
         }
 
+        if (mainShard && (items[2].revents & ZMQ_POLLIN)) {
+            mainShard->wakeup.read();
+        }
+
         double now = ML::wall_time();
 
         if (now - lastPings > 1.0) {
@@ -740,6 +817,15 @@ run()
             recordTime("sendPings", atStart);
         }
 
+        if (now - lastRequestValues > 1.0) {
+            double atStart = getTime();
+
+            requestValues.update();
+            lastRequestValues = now;
+
+            recordTime("requestValues", atStart);
+        }
+
         double beforeChecks = getTime();
 
         if (now - last_check_pace > 10.0) {
@@ -759,7 +845,7 @@ run()
                        format("active: %zd augmenting, %zd inFlight, "
                               "%zd agents",
                               augmentationLoop.numAugmenting(),
-                              inFlight.size(),
+                              numInFlight(),
                               agents.size()));
 
             dutyCycleCurrent.ending = Date::now();
@@ -770,8 +856,13 @@ run()
                 dutyCycleHistory.erase(dutyCycleHistory.begin(),
                                        dutyCycleHistory.end() - 100);
 
+            if (mainShard)
+                checkLostBids(*mainShard);
             checkDeadAgents();
 
+            if (filters.adaptiveOrder())
+                filters.reorderFilters();
+
             double total = 0.0;
             for (auto it = times.begin(); it != times.end();  ++it)
                 total += it->second.time;
@@ -818,6 +909,112 @@ run()
     //cerr << "server shutdown" << endl;
 }
 
+void
+Router::
+processShard(Shard & shard, const RecordTime & recordTime)
+{
+    auto getTime = [&] () { return Date::now().secondsSinceEpoch(); };
+
+    boost::shared_lock<AgentsLock> guard(agentsLock);
+
+    {
+        double atStart = getTime();
+        std::shared_ptr<AugmentationInfo> info;
+        while (shard.startBiddingBuffer.tryPop(info)) {
+            doStartBidding(shard, info);
+        }
+
+        recordTime("doStartBidding", atStart);
+    }
+
+    {
+        double atStart = getTime();
+
+        std::vector<std::string> message;
+        while (shard.agentBidBuffer.tryPop(message)) {
+            try {
+                doBid(shard, message);
+            } catch (const std::exception & exc) {
+                returnErrorResponse(message,
+                                    "threw exception: " + string(exc.what()));
+            }
+        }
+
+        BidMessage bidMessage;
+        while (shard.doBidBuffer.tryPop(bidMessage)) {
+            doBidImpl(shard, bidMessage);
+        }
+
+        recordTime("doBid", atStart);
+    }
+
+    {
+        double atStart = getTime();
+
+        std::shared_ptr<Auction> auction;
+        while (shard.submittedBuffer.tryPop(auction))
+            doSubmitted(shard, auction);
+
+        recordTime("doSubmitted", atStart);
+    }
+
+    shard.numInFlight = shard.inFlight.size();
+}
+
+void
+Router::
+runShard(Shard & shard)
+{
+    auto getTime = [&] () { return Date::now().secondsSinceEpoch(); };
+
+    double lastCheck = getTime();
+    bool expired = false;
+
+    auto recordTime = [] (const char * name, double start) {};
+
+    while (!shutdown_) {
+        // Everything that gives the shard work signals its wakeup fd, so it
+        // only needs to wake up by itself for the next expiry that can be
+        // due and for the lost bids.
+        double nextExpiry = shard.inFlight.nextExpiry().secondsSinceEpoch();
+        double wakeAt = std::min(nextExpiry, lastCheck + 10.0);
+        double timeoutMs = ceil((wakeAt - getTime()) * 1000.0);
+
+        // What's left of a millisecond that was just expired
+        if (expired)
+            timeoutMs = std::max(timeoutMs, 1.0);
+
+        pollfd fd = { shard.wakeup.fd(), POLLIN, 0 };
+        int rc = ::poll(&fd, 1, std::max(0, int(timeoutMs)));
+
+        if (rc == -1 && errno != EINTR) {
+            cerr << "shard poll error: " << strerror(errno) << endl;
+        }
+
+        double atStart = getTime();
+
+        if (rc > 0)
+            shard.wakeup.read();
+
+        processShard(shard, recordTime);
+
+        expired = atStart >= nextExpiry;
+        if (expired) {
+            boost::shared_lock<AgentsLock> guard(agentsLock);
+            checkExpiredAuctions(shard);
+        }
+
+        if (atStart - lastCheck > 10.0) {
+            checkLostBids(shard);
+            lastCheck = atStart;
+        }
+
+        // Only this thread writes it
+        double active = getTime() - atStart;
+        shard.totalActive.store(shard.totalActive.load() + active);
+    }
+}
+
 void
 Router::
 shutdown()
@@ -829,15 +1026,19 @@ shutdown()
     shutdown_ = true;
     futex_wake(shutdown_);
     wakeupMainLoop.signal();
+    for (auto & shard : shards)
+        shard->wakeup.signal();
 
     augmentationLoop.shutdown();
 
     if (runThread)
         runThread->join();
     runThread.reset();
-    if (cleanupThread)
-        cleanupThread->join();
-    cleanupThread.reset();
+    for (auto & shard : shards) {
+        if (shard->thread)
+            shard->thread->join();
+        shard->thread.reset();
+    }
 
     logger.shutdown();
     banker.reset();
@@ -885,6 +1086,8 @@ injectAuction(Auction::HandleAuction onAuctionFinished,
               double expiryTime,
               double lossTime)
 {
+    // Not pooled: injected auctions don't come from an exchange thread, so
+    // they're destroyed wherever they're dropped, usually the router loop.
     auto auction = std::make_shared<Auction>(
         nullptr,
         onAuctionFinished,
@@ -958,7 +1161,20 @@ handleAgentMessage(const std::vector<std::string> & message)
         }
 
         if (request[0] == 'B' && request == "BID") {
-            doBid(message);
+            if (shards.size() == 1) {
+                doBid(*shards[0], message);
+                return;
+            }
+
+            // The shard that owns the auction parses the bid
+            if (message.size() < 3) {
+                returnErrorResponse(message, "BID message has 4-5 parts");
+                return;
+            }
+
+            Shard & shard = this->shard(Id(message[2]));
+            shard.agentBidBuffer.push(message);
+            shard.wakeup.signal();
             return;
         }
 
@@ -1083,47 +1299,9 @@ checkDeadAgents()
         const std::string & account = info.config->account.toString('.');
 
         Date now = Date::now();
-        double oldest = 0.0;
-        double total = 0.0;
-
-        vector<Id> toExpire;
-
-        // Check for in flight timeouts.  This shouldn't happen, but there
-        // appears to be a way in which we lose track of an inflight auction
-        auto onInFlight = [&] (const Id & id, const Date & date)
-            {
-                double secondsSince = now.secondsSince(date);
-
-                oldest = std::max(oldest, secondsSince);
-                total += secondsSince;
-
-                if (secondsSince > 30.0) {
-
-                    this->recordHit("accounts.%s.lostBids", account);
-
-                    bidder->sendBidLostMessage(info.config, it->first, inFlight[id].auction);
-
-                    toExpire.push_back(id);
-                }
-            };
-
-        info.forEachInFlight(onInFlight);
 
         this->recordLevel(info.numBidsInFlight(),
                           "accounts.%s.inFlight.numInFlight", account);
-        this->recordLevel(oldest,
-                          "accounts.%s.inFlight.oldestAgeSeconds", account);
-        double averageAge = 0.0;
-        if (info.numBidsInFlight() != 0)
-            averageAge = total / info.numBidsInFlight();
-
-        this->recordLevel(averageAge,
-                          "accounts.%s.inFlight.averageAgeSeconds", account);
-
-        for (auto jt = toExpire.begin(), jend = toExpire.end();  jt != jend;
-             ++jt) {
-            info.expireBidInFlight(*jt);
-        }
 
         double timeSinceHeartbeat
             = now.secondsSince(info.status->lastHeartbeat);
@@ -1136,16 +1314,7 @@ checkDeadAgents()
             if (it->second.numBidsInFlight() != 0) {
                 cerr << "agent " << it->first
                      << " has " << it->second.numBidsInFlight()
-                     << " undead auctions: " << endl;
-
-                auto onInFlight = [&] (const Id & id, Date date)
-                    {
-                        cerr << "  " << id << " --> "
-                        << date << " (" << now.secondsSince(date)
-                        << "s ago)" << endl;
-                    };
-
-                info.forEachInFlight(onInFlight);
+                     << " undead auctions" << endl;
             }
             else {
                 // agent is dead
@@ -1157,13 +1326,17 @@ checkDeadAgents()
         }
     }
 
-    for (auto it = deadAgents.begin(), end = deadAgents.end();
-         it != end;  ++it) {
-        cerr << "WARNING: dead agent doesn't clean up its state properly"
-             << endl;
-        // TODO: undo all bids in progress
-        filters.removeConfig((*it)->first);
-        agents.erase(*it);
+    if (!deadAgents.empty()) {
+        boost::unique_lock<AgentsLock> guard(agentsLock);
+
+        for (auto it = deadAgents.begin(), end = deadAgents.end();
+             it != end;  ++it) {
+            cerr << "WARNING: dead agent doesn't clean up its state properly"
+                 << endl;
+            // TODO: undo all bids in progress
+            filters.removeConfig((*it)->first);
+            agents.erase(*it);
+        }
     }
 
     if (!deadAgents.empty())
@@ -1176,67 +1349,92 @@ checkDeadAgents()
 
 void
 Router::
-checkExpiredAuctions()
+checkLostBids(Shard & shard)
 {
-    //recentlySubmitted.clear();
+    boost::shared_lock<AgentsLock> guard(agentsLock);
 
-    Date start = Date::now();
+    Date now = Date::now();
 
-    {
-        RouterProfiler profiler(dutyCycleCurrent.nsExpireInFlight);
+    for (auto it = agents.begin(), end = agents.end();  it != end;
+         ++it) {
+        auto & info = it->second;
+
+        const std::string & account = info.config->account.toString('.');
 
-        // Look for in flight timeout expiries
-        auto onExpiredInFlight = [&] (const Id & auctionId,
-                                      const AuctionInfo & auctionInfo)
+        double oldest = 0.0;
+        double total = 0.0;
+
+        vector<Id> toExpire;
+
+        // Check for in flight timeouts.  This shouldn't happen, but there
+        // appears to be a way in which we lose track of an inflight auction
+        auto onInFlight = [&] (const Id & id, const Date & date)
             {
-                this->debugAuction(auctionId, "EXPIRED", {});
+                double secondsSince = now.secondsSince(date);
+
+                oldest = std::max(oldest, secondsSince);
+                total += secondsSince;
 
-                // Tell any remaining bidders that it's too late...
-                for (auto it = auctionInfo.bidders.begin(),
-                         end = auctionInfo.bidders.end();
-                     it != end;  ++it) {
-                    string agent = it->first;
-                    if (!agents.count(agent)) continue;
+                if (secondsSince > 30.0) {
 
-                    if (agents[agent].expireBidInFlight(auctionId)) {
-                        AgentInfo & info = this->agents[agent];
-                        ++info.stats->tooLate;
+                    this->recordHit("accounts.%s.lostBids", account);
 
-                        this->recordHit("accounts.%s.droppedBids",
-                                        info.config->account.toString('.'));
+                    auto config = info.config;
+                    auto agent = it->first;
+                    auto auction = shard.inFlight[id].auction;
+                    callBidder([=] () {
+                            bidder->sendBidLostMessage(config, agent, auction);
+                        });
 
-                        bidder->sendBidDroppedMessage(info.config, agent, auctionInfo.auction);
-                    }
+                    toExpire.push_back(id);
                 }
+            };
 
-#if 0
-                string msg = ML::format("in flight auction expiry: id %s "
-                                        "status %s, %zd bidders:",
-                                        auctionId.toString().c_str(),
-                                        auctionInfo.auction->status().c_str(),
-                                        auctionInfo.bidders.size());
-                for (auto it = auctionInfo.bidders.begin(),
-                         end = auctionInfo.bidders.end();
-                     it != end;  ++it)
-                    msg += ' ' + it->first + "->" + it->second.bidTime.print(5);
-                cerr << Date::now().print(5) << " " << msg << endl;
-                dumpAuction(auctionId);
-                this->logRouterError("checkExpiredAuctions.inFlight",
-                                     msg);
+        info.forEachInFlight(shard.index, onInFlight);
 
-#endif
+        size_t numInFlight = info.numBidsInFlight(shard.index);
 
-                // end the auction when it expires in case we're waiting on dead agents
-        if(!auctionInfo.auction->getResponses().empty()) {
-                    if(!auctionInfo.auction->finish()) {
-                this->recordHit("tooLateToFinish");
-            }
+        this->recordLevel(oldest,
+                          "accounts.%s.inFlight.oldestAgeSeconds", account);
+        double averageAge = 0.0;
+        if (numInFlight != 0)
+            averageAge = total / numInFlight;
+
+        this->recordLevel(averageAge,
+                          "accounts.%s.inFlight.averageAgeSeconds", account);
+
+        // checkDeadAgents() only sees the total, so each shard lists its own
+        if (info.status->dead && numInFlight != 0) {
+            cerr << "agent " << it->first
+                 << " has " << numInFlight
+                 << " undead auctions in shard " << shard.index << ": " << endl;
+
+            auto onUndead = [&] (const Id & id, Date date)
+                {
+                    cerr << "  " << id << " --> "
+                    << date << " (" << now.secondsSince(date)
+                    << "s ago)" << endl;
+                };
+
+            info.forEachInFlight(shard.index, onUndead);
         }
 
-                return Date();
-            };
+        for (auto jt = toExpire.begin(), jend = toExpire.end();  jt != jend;
+             ++jt) {
+            info.expireBidInFlight(shard.index, *jt);
+        }
+    }
+}
 
-        inFlight.expire(onExpiredInFlight, start);
+void
+Router::
+checkExpiredAuctions()
+{
+    //recentlySubmitted.clear();
+
+    if (shards.size() == 1) {
+        boost::shared_lock<AgentsLock> guard(agentsLock);
+        checkExpiredAuctions(*shards[0]);
     }
 
     {
@@ -1250,6 +1448,74 @@ checkExpiredAuctions()
     }
 }
 
+void
+Router::
+checkExpiredAuctions(Shard & shard)
+{
+    Date start = Date::now();
+
+    RouterProfiler profiler(dutyCycleCurrent.nsExpireInFlight);
+
+    // Look for in flight timeout expiries
+    auto onExpiredInFlight = [&] (const Id & auctionId,
+                                  const AuctionInfo & auctionInfo)
+        {
+            this->debugAuction(auctionId, "EXPIRED", {});
+
+            // Tell any remaining bidders that it's too late...
+            for (auto it = auctionInfo.bidders.begin(),
+                     end = auctionInfo.bidders.end();
+                 it != end;  ++it) {
+                string agent = it->first;
+                auto agentIt = agents.find(agent);
+                if (agentIt == agents.end()) continue;
+
+                AgentInfo & info = agentIt->second;
+                if (info.expireBidInFlight(shard.index, auctionId)) {
+                    ML::atomic_inc(info.stats->tooLate);
+
+                    this->recordHit("accounts.%s.droppedBids",
+                                    info.config->account.toString('.'));
+
+                    auto config = info.config;
+                    auto auction = auctionInfo.auction;
+                    callBidder([=] () {
+                            bidder->sendBidDroppedMessage(config, agent, auction);
+                        });
+                }
+            }
+
+#if 0
+            string msg = ML::format("in flight auction expiry: id %s "
+                                    "status %s, %zd bidders:",
+                                    auctionId.toString().c_str(),
+                                    auctionInfo.auction->status().c_str(),
+                                    auctionInfo.bidders.size());
+            for (auto it = auctionInfo.bidders.begin(),
+                     end = auctionInfo.bidders.end();
+                 it != end;  ++it)
+                msg += ' ' + it->first + "->" + it->second.bidTime.print(5);
+            cerr << Date::now().print(5) << " " << msg << endl;
+            dumpAuction(auctionId);
+            this->logRouterError("checkExpiredAuctions.inFlight",
+                                 msg);
+
+#endif
+
+            // end the auction when it expires in case we're waiting on dead agents
+            if(!auctionInfo.auction->getResponses().empty()) {
+                if(!auctionInfo.auction->finish()) {
+                    this->recordHit("tooLateToFinish");
+                }
+            }
+
+            return Date();
+        };
+
+    shard.inFlight.expire(onExpiredInFlight, start);
+    shard.numInFlight = shard.inFlight.size();
+}
+
 void
 Router::
 returnErrorResponse(const std::vector<std::string> & message,
@@ -1260,8 +1526,11 @@ returnErrorResponse(const std::vector<std::string> & message,
     logMessage("ERROR", error, message);
     logMessageToAnalytics("ERROR", error, message);
     const auto& agent = message[0];
-    AgentInfo & info = this->agents[agent];
-    bidder->sendErrorMessage(info.config, agent, error, message);
+    auto it = agents.find(agent);
+    auto config = it == agents.end() ? nullptr : it->second.config;
+    callBidder([=] () {
+            bidder->sendErrorMessage(config, agent, error, message);
+        });
 }
 
 void
@@ -1271,8 +1540,10 @@ returnInvalidBid(
         const std::shared_ptr<Auction> &auction,
         const char *reason, const char *message, ...) {
 
-    auto& agentInfo = agents[agent];
-    const auto& agentConfig = agentInfo.config;
+    auto it = agents.find(agent);
+    if (it == agents.end()) return;
+    auto& agentInfo = it->second;
+    const auto agentConfig = agentInfo.config;
     this->recordHit("bidErrors.%s", reason);
     this->recordHit("accounts.%s.bidErrors.total",
                     agentConfig->account.toString('.'));
@@ -1280,7 +1551,7 @@ returnInvalidBid(
                     agentConfig->account.toString('.'),
                     reason);
 
-    ++agentInfo.stats->invalid;
+    ML::atomic_inc(agentInfo.stats->invalid);
 
     va_list ap;
     va_start(ap, message);
@@ -1298,7 +1569,9 @@ returnInvalidBid(
     cerr << bidData << endl;
 
     logMessageToAnalytics("INVALID", agentConfig, agent, formatted, auction);
-    bidder->sendBidInvalidMessage(agentConfig, agent, formatted, auction);
+    callBidder([=] () {
+            bidder->sendBidInvalidMessage(agentConfig, agent, formatted, auction);
+        });
 }
 
 void
@@ -1308,8 +1581,10 @@ returnInvalidBid(
         const std::shared_ptr<Auction> &auction,
         const std::string &reason, const char *message, ...) {
 
-    auto& agentInfo = agents[agent];
-    const auto& agentConfig = agentInfo.config;
+    auto it = agents.find(agent);
+    if (it == agents.end()) return;
+    auto& agentInfo = it->second;
+    const auto agentConfig = agentInfo.config;
     this->recordHit("bidErrors.%s", reason);
     this->recordHit("accounts.%s.bidErrors.total",
                     agentConfig->account.toString('.'));
@@ -1317,7 +1592,7 @@ returnInvalidBid(
                     agentConfig->account.toString('.'),
                     reason);
 
-    ++agentInfo.stats->invalid;
+    ML::atomic_inc(agentInfo.stats->invalid);
 
     va_list ap;
     va_start(ap, message);
@@ -1335,7 +1610,9 @@ returnInvalidBid(
     cerr << bidData << endl;
 
     logMessageToAnalytics("INVALID", agentConfig, agent, formatted, auction);
-    bidder->sendBidInvalidMessage(agentConfig, agent, formatted, auction);
+    callBidder([=] () {
+            bidder->sendBidInvalidMessage(agentConfig, agent, formatted, auction);
+        });
 }
 
 void
@@ -1345,7 +1622,7 @@ doStats(const std::vector<std::string> & message)
     Json::Value result(Json::objectValue);
 
     result["numAugmenting"] = augmentationLoop.numAugmenting();
-    result["numInFlight"] = inFlight.size();
+    result["numInFlight"] = numInFlight();
     result["blacklistUsers"] = blacklist.size();
 
     result["numAgents"] = agents.size();
@@ -1412,9 +1689,10 @@ augmentAuction(const std::shared_ptr<AugmentationInfo> & info)
                 return;
             }
 
-            // Send it off to be farmed out to the bidders
-            startBiddingBuffer.push(info);
-            wakeupMainLoop.signal();
+            // Send it off to be farmed out to the bidders by its shard
+            Shard & shard = this->shard(info->auction->id);
+            shard.startBiddingBuffer.push(info);
+            shard.wakeup.signal();
         };
 
     augmentationLoop.augment(info, Date::now().plusSeconds(augmentationWindow.count()),
@@ -1463,18 +1741,15 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     auto exchangeConnector = auction->exchangeConnector;
 
 
-    auto doFilterStat = [&] (const AgentConfig& config, const char * reason) {
+    auto doFilterStat = [&] (const EventHandle & stat) {
         if (!traceAuction) return;
-
-        this->recordHit("accounts.%s.filter.%s",
-                config.account.toString('.'),
-                reason);
+        stat.record();
     };
 
     if (traceAuction) {
         forEachAgent([&] (const AgentInfoEntry& info) {
                     ML::atomic_inc(info.stats->intoFilters);
-                    doFilterStat(*info.config, "intoStaticFilters");
+                    doFilterStat(info.filterStats->intoStaticFilters);
                 });
     }
 
@@ -1484,15 +1759,16 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     auto checkAgent = [&] (
             const AgentConfig & config,
             const AgentStatus & status,
-            AgentStats & stats)
+            AgentStats & stats,
+            const AgentFilterStats & filterStats)
         {
             if (status.dead || status.lastHeartbeat.secondsSince(now) > 2.0) {
-                doFilterStat(config, "static.agentAppearsDead");
+                doFilterStat(filterStats.agentAppearsDead);
                 return false;
             }
 
             if (status.numBidsInFlight >= config.maxInFlight) {
-                doFilterStat(config, "static.earlyTooManyInFlight");
+                doFilterStat(filterStats.earlyTooManyInFlight);
                 return false;
             }
 
@@ -1501,7 +1777,7 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
                 && timeLeftMs < config.minTimeAvailableMs)
             {
                 ML::atomic_inc(stats.notEnoughTime);
-                doFilterStat(config, "static.notEnoughTime");
+                doFilterStat(filterStats.staticNotEnoughTime);
                 return false;
             }
 
@@ -1510,10 +1786,12 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
     for (const auto& entry : biddableConfigs) {
         if (entry.biddableSpots.empty()) continue;
-        if (!checkAgent(*entry.config, *entry.status, *entry.stats)) continue;
+        if (!checkAgent(*entry.config, *entry.status, *entry.stats,
+                        *entry.filterStats))
+            continue;
 
         ML::atomic_inc(entry.stats->passedStaticFilters);
-        doFilterStat(*entry.config, "passedStaticFilters");
+        doFilterStat(entry.filterStats->passedStaticFilters);
 
         string rrGroup = entry.config->roundRobinGroup;
         if (rrGroup == "") rrGroup = entry.name;
@@ -1580,23 +1858,24 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
 void
 Router::
-doStartBidding(const std::vector<std::string> & message)
+doStartBidding(Shard & shard, const std::vector<std::string> & message)
 {
     std::shared_ptr<AugmentationInfo> augInfo
         = sharedPtrFromMessage<AugmentationInfo>(message.at(2));
-    doStartBidding(augInfo);
+    doStartBidding(shard, augInfo);
 }
 
 void
 Router::
-doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
+doStartBidding(Shard & shard,
+               const std::shared_ptr<AugmentationInfo> & augInfo)
 {
     //static const char *fName = "Router::doStartBidding:";
     RouterProfiler profiler(dutyCycleCurrent.nsStartBidding);
 
     try {
         Id auctionId = augInfo->auction->id;
-        if (inFlight.count(auctionId)) {
+        if (shard.inFlight.count(auctionId)) {
             throwException("doStartBidding.alreadyInFlight",
                            "auction with ID %s already in progress",
                            auctionId.toString().c_str());
@@ -1613,7 +1892,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
         auto groupAgents = augInfo->potentialGroups;
 
-        AuctionInfo & auctionInfo = addAuction(augInfo->auction,
+        AuctionInfo & auctionInfo = addAuction(shard, augInfo->auction,
                                                augInfo->lossTimeout);
         auto auction = augInfo->auction;
 
@@ -1637,36 +1916,43 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
             for (unsigned i = 0;  i < bidders.size();  ++i) {
                 PotentialBidder & bidder = bidders[i];
-                if (!agents.count(bidder.agent)) continue;
-                AgentInfo & info = agents[bidder.agent];
+                auto agentIt = agents.find(bidder.agent);
+                if (agentIt == agents.end()) continue;
+                AgentInfo & info = agentIt->second;
                 const AgentConfig & config = *bidder.config;
+                const AgentFilterStats & filterStats = *info.filterStats;
 
-                auto doFilterStat = [&] (const char * reason)
+                auto doFilterStat = [&] (const EventHandle & stat)
                     {
                         if (!traceAuction) return;
+                        stat.record();
+                    };
 
-                        this->recordHit("accounts.%s.filter.%s",
-                                        config.account.toString('.'),
-                                        reason);
+                auto doFilterMetric = [&] (const EventHandle & metric,
+                                           float val)
+                    {
+                        if (!traceAuction) return;
+                        metric.record(val);
                     };
 
-                auto doFilterMetric = [&] (const char * reason, float val)
+                // Depends on the augmentor so it can't be registered up front
+                auto doAugmentationFilterStat = [&] (const string & reason)
                     {
                         if (!traceAuction) return;
 
-                        this->recordOutcome(val, "accounts.%s.filter.%s",
-                                            config.account.toString('.'),
-                                            reason);
+                        this->recordHit("accounts.%s.filter.%s",
+                                        config.account.toString('.'),
+                                        reason);
                     };
 
 
-                doFilterStat("intoDynamicFilters");
+                doFilterStat(filterStats.intoDynamicFilters);
 
                 /* Check if we have too many in flight. */
                 if (info.numBidsInFlight() >= info.config->maxInFlight) {
-                    ++info.stats->tooManyInFlight;
+                    ML::atomic_inc(info.stats->tooManyInFlight);
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.tooManyInFlight");
+                    doFilterStat(filterStats.tooManyInFlight);
                     continue;
                 }
 
@@ -1709,16 +1995,16 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                     ML::atomic_inc(info.stats->notEnoughTime);
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.notEnoughTime");
-                    doFilterMetric("metric.timeUsedBeforeDynamicFilter",
+                    doFilterStat(filterStats.notEnoughTime);
+                    doFilterMetric(filterStats.timeUsedBeforeDynamicFilter,
                                    timeUsedMs);
-                    doFilterMetric("metric.timeLeftBeforeDynamicFilter",
+                    doFilterMetric(filterStats.timeLeftBeforeDynamicFilter,
                                    timeLeftMs);
-                    doFilterMetric("metric.timeElapsedBeforePreproMs",
+                    doFilterMetric(filterStats.timeElapsedBeforePreproMs,
                                    auction->start.secondsUntil(auction->inPrepro) * 1000.0);
-                    doFilterMetric("metric.timeElapsedDuringPreproMs",
+                    doFilterMetric(filterStats.timeElapsedDuringPreproMs,
                                    auction->inPrepro.secondsUntil(auction->outOfPrepro) * 1000.0);
-                    doFilterMetric("metric.timeWindowMs",
+                    doFilterMetric(filterStats.timeWindowMs,
                                    auction->expiry.secondsSince(auction->start) * 1000.0 - info.config->minTimeAvailableMs);
                     continue;
                 }
@@ -1733,8 +2019,8 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                     if (it == augList.end()) {
                         if (!augConfig.required) continue;
-                        string stat = "dynamic." + augConfig.name + ".missing";
-                        doFilterStat(stat.c_str());
+                        doAugmentationFilterStat(
+                                "dynamic." + augConfig.name + ".missing");
                         filteredByAugmentation = true;
                         break;
                     }
@@ -1743,8 +2029,8 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     if (augConfig.filters.anyIsIncluded(tags)) continue;
 
                     ML::atomic_inc(info.stats->augmentationTagsExcluded);
-                    string stat = "dynamic." + augConfig.name + ".tags";
-                    doFilterStat(stat.c_str());
+                    doAugmentationFilterStat(
+                            "dynamic." + augConfig.name + ".tags");
                     filteredByAugmentation = true;
                     break;
                 }
@@ -1756,7 +2042,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     && blacklist.matches(*auction->request, bidder.agent,
                                          config)) {
                     ML::atomic_inc(info.stats->userBlacklisted);
-                    doFilterStat("dynamic.userBlacklisted");
+                    doFilterStat(filterStats.userBlacklisted);
                     continue;
                 }
 
@@ -1764,7 +2050,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     = info.numBidsInFlight() / max(info.config->maxInFlight, 1);
 
                 ML::atomic_inc(info.stats->passedDynamicFilters);
-                doFilterStat("passedDynamicFilters");
+                doFilterStat(filterStats.passedDynamicFilters);
             }
 
             // Sort the roundrobin infos to find the best one
@@ -1792,20 +2078,19 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             PotentialBidder & winner = bidders[best];
             string agent = winner.agent;
 
-            if (!agents.count(agent)) {
+            auto agentIt = agents.find(agent);
+            if (agentIt == agents.end()) {
                 //cerr << "!!!AGENT IS GONE" << endl;
                 continue;  // agent is gone
             }
-            AgentInfo & info = agents[agent];
+            AgentInfo & info = agentIt->second;
 
-            ++info.stats->auctions;
+            ML::atomic_inc(info.stats->auctions);
 
-            Json::Value aggregatedAug;
-            for (const auto& aug : augList) {
-                aggregatedAug[aug.first] =
-                    aug.second.filterForAccount(winner.config->account).toJson();
-            }
-            auction->agentAugmentations[agent] = chomp(aggregatedAug.toString());
+            // Only stringified if a bidder interface or the post auction
+            // loop asks for it.
+            auction->agentAugmentations.add(agent, winner.config->account,
+                                            augList);
 
             //auctionInfo.activities.push_back("sent to " + agent);
 
@@ -1815,7 +2100,8 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             bidInfo.imp = winner.imp;
 
             auctionInfo.bidders.insert(make_pair(agent, std::move(bidInfo)));  // create empty bid response
-            if (!info.trackBidInFlight(auctionId, bidInfo.bidTime))
+            if (!info.trackBidInFlight(shard.index, auctionId,
+                                       bidInfo.bidTime))
                 throwException("doStartBidding.agentAlreadyBidding",
                                "agent %s is already processing auction %s",
                                agent.c_str(),
@@ -1835,13 +2121,21 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
         this->recordLevel(auctionInfo.bidders.size(), "bidRequestsSentToBiddersPerRequest");
 
         if (!auctionInfo.bidders.empty()) {
-            bidder->sendAuctionMessage(
-                    auctionInfo.auction, timeLeftMs, auctionInfo.bidders);
+            if (!queueBidderCalls) {
+                bidder->sendAuctionMessage(
+                        auctionInfo.auction, timeLeftMs, auctionInfo.bidders);
+            }
+            else {
+                auto bidders = auctionInfo.bidders;
+                callBidder([=] () {
+                        bidder->sendAuctionMessage(auction, timeLeftMs, bidders);
+                    });
+            }
         }
         else {
             /* No bidders; don't bother with the bid */
             ML::atomic_inc(numNoBidders);
-            inFlight.erase(auctionId);
+            shard.inFlight.erase(auctionId);
             //cerr << fName << "About to call finish " << endl;
             if (!auction->finish()) {
                 recordHit("tooLateToFinish");
@@ -1859,7 +2153,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
 AuctionInfo &
 Router::
-addAuction(std::shared_ptr<Auction> auction, Date lossTimeout)
+addAuction(Shard & shard, std::shared_ptr<Auction> auction, Date lossTimeout)
 {
     const Id & id = auction->id;
 
@@ -1867,7 +2161,7 @@ addAuction(std::shared_ptr<Auction> auction, Date lossTimeout)
 
     try {
         AuctionInfo & result
-            = inFlight.insert(id, AuctionInfo(auction, lossTimeout),
+            = shard.inFlight.insert(id, AuctionInfo(auction, lossTimeout),
                               getCurrentTime().plusSeconds(bidMemoryWindow));
         return result;
     } catch (const std::exception & exc) {
@@ -1890,7 +2184,7 @@ static bool failBid(double proportion)
 
 void
 Router::
-doBid(const std::vector<std::string> & message)
+doBid(Shard & shard, const std::vector<std::string> & message)
 {
     if (message.size() < 5 || message.size() > 6) {
         returnErrorResponse(message, "BID message has 4-5 parts");
@@ -1919,8 +2213,8 @@ doBid(const std::vector<std::string> & message)
         bids = Bids::fromJson(biddata);
     }
     catch (const std::exception & exc) {
-        auto it = inFlight.find(auctionId);
-        if (it == inFlight.end()) {
+        auto it = shard.inFlight.find(auctionId);
+        if (it == shard.inFlight.end()) {
             recordHit("bidError.unknownAuction");
             returnErrorResponse(message, "unknown auction");
             return;
@@ -1934,12 +2228,13 @@ doBid(const std::vector<std::string> & message)
     }
     bidMessage.bids = std::move(bids);
 
-    doBidImpl(bidMessage, message);
+    doBidImpl(shard, bidMessage, message);
 }
 
 void
 Router::
-doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMessage)
+doBidImpl(Shard & shard, const BidMessage &message,
+          const std::vector<std::string> &originalMessage)
 {
     Date dateGotBid = Date::now();
 
@@ -1951,8 +2246,8 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     ExcAssert(!message.agents.empty());
 
     const auto& auctionId = message.auctionId;
-    auto it = inFlight.find(auctionId);
-    if (it == inFlight.end()) {
+    auto it = shard.inFlight.find(auctionId);
+    if (it == shard.inFlight.end()) {
         recordHit("bidError.unknownAuction");
         returnErrorResponse(originalMessage, "unknown auction");
         return;
@@ -1961,7 +2256,8 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     AuctionInfo & auctionInfo = it->second;
 
     for (const auto &agent: message.agents) {
-        if (!agents.count(agent)) {
+        auto agentIt = agents.find(agent);
+        if (agentIt == agents.end()) {
             returnErrorResponse(originalMessage, "unknown agent");
             return;
         }
@@ -1974,9 +2270,9 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
             return;
         }
 
-        AgentInfo & info = agents[agent];
+        AgentInfo & info = agentIt->second;
         /* One less in flight. */
-        if (!info.expireBidInFlight(auctionId)) {
+        if (!info.expireBidInFlight(shard.index, auctionId)) {
             recordHit("bidError.agentNotBidding");
             returnErrorResponse(originalMessage, "agent wasn't bidding on this auction");
             return;
@@ -1998,11 +2294,17 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     const auto& agent = message.agents[0];
     auto biddersIt = auctionInfo.bidders.find(agent);
     auto & config = *biddersIt->second.agentConfig;
-    AgentInfo & info = agents[agent];
+    AgentInfo & info = agents.find(agent)->second;
     const auto& agentConfig = info.config;
 
     const auto& bids = message.bids;
-    auto bidsString = bids.toJson().toStringNoNewLine();
+    // Only formatted for invalid bids and when the bids are actually logged
+    std::string bidsStringStorage;
+    auto bidsString = [&] () -> const std::string & {
+        if (bidsStringStorage.empty())
+            bidsStringStorage = bids.toJson().toStringNoNewLine();
+        return bidsStringStorage;
+    };
 
     BidInfo bidInfo(std::move(biddersIt->second));
 
@@ -2031,21 +2333,21 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
         int spotIndex = bidInfo.imp[i].first;
 
         if (bid.creativeIndex == -1) {
-            returnInvalidBid(agent, bidsString, auctionInfo.auction,
+            returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                     "nullCreativeField",
                     "creative field is null in response %s",
-                    bidsString.c_str());
+                    bidsString().c_str());
             continue;
         }
 
         if (bid.creativeIndex < 0
                 || bid.creativeIndex >= config.creatives.size())
         {
-            returnInvalidBid(agent, bidsString, auctionInfo.auction,
+            returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                     "outOfRangeCreative",
                     "parsing field 'creative' of %s: creative "
                     "number %d out of range 0-%zd",
-                    bidsString.c_str(), bid.creativeIndex,
+                    bidsString().c_str(), bid.creativeIndex,
                     config.creatives.size());
             continue;
         }
@@ -2054,12 +2356,12 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
             if (slowModePeriodicSpentReached) {
                 bid.price = maxBidAmount;
             } else {
-                returnInvalidBid(agent, bidsString, auctionInfo.auction,
+                returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                     "invalidPrice",
                     "bid price of %s is outside range of $0-%s parsing bid %s",
                     bid.price.toString().c_str(),
                     maxBidAmount.toString().c_str(),
-                    bidsString.c_str());
+                    bidsString().c_str());
                 continue;
             }
         }
@@ -2067,7 +2369,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
         auto getbid = auctionInfo.auction->exchangeConnector->getBidValidity(bid, imp, spotIndex);
 
         if (!getbid.isValidbid) {
-            returnInvalidBid(agent, bidsString, auctionInfo.auction,
+            returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                 getbid.reason_,
                 "no bid");
             continue;
@@ -2076,16 +2378,16 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 #if 0
         if (!creative.compatible(imp[spotIndex])) {
             cerr << "creative not compatible with spot: " << endl;
-            cerr << "auction: " << auctionInfo.auction->requestStr
+            cerr << "auction: " << auctionInfo.auction->requestStr()
                 << endl;
             cerr << "config: " << config.toJson().toStringNoNewLine() << endl;
-            cerr << "bid: " << bidsString << endl;
+            cerr << "bid: " << bidsString() << endl;
             cerr << "spot: " << imp[i].toJson().toStringNoNewLine() << endl;
             cerr << "spot num: " << spotIndex << endl;
             cerr << "bid num: " << i << endl;
             cerr << "creative num: " << bid.creativeIndex << endl;
             cerr << "creative: " << creative.toJson().toStringNoNewLine() << endl;
-            returnInvalidBid(agent, bidsString, auctionInfo.auction,
+            returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                     "creativeNotCompatibleWithSpot",
                     "creative %s not compatible with spot %s",
                     creative.toJson().toString().c_str(),
@@ -2095,7 +2397,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 #endif
         if (!creative.biddable(auctionInfo.auction->request->exchange,
                         auctionInfo.auction->request->protocolVersion)) {
-            returnInvalidBid(agent, bidsString, auctionInfo.auction,
+            returnInvalidBid(agent, bidsString(), auctionInfo.auction,
                     "creativeNotBiddableOnExchange",
                     "creative not biddable on exchange/version");
             continue;
@@ -2110,30 +2412,42 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
         Amount price = message.wcm.evaluate(bid, bid.price);
 
         if (!monitorClient.getStatus(slowModeTolerance)) {
-            Date now = Date::now();
-            if ((uint32_t) slowModeLastAuction.secondsSinceEpoch()
-                    < (uint32_t) now.secondsSinceEpoch()) {
-                slowModeLastAuction = now;
-                slowModePeriodicSpentReached = false;
-                // TODO Insure in router.cc (not router_runner) that
-                // maxBidPrice <= slowModeAuthorizedMoneyLimit
-                // Here we're garanteed that price.value >= slowModeAuthorizedMoneyLimit
-                accumulatedBidMoneyInThisPeriod = price.value;
-
-                recordHit("monitor.systemInSlowMode"); 
+            bool dropBid = false;
+            {
+                std::lock_guard<ML::Spinlock> guard(slowModeLock);
+
+                Date now = Date::now();
+                if ((uint32_t) slowModeLastAuction.secondsSinceEpoch()
+                        < (uint32_t) now.secondsSinceEpoch()) {
+                    slowModeLastAuction = now;
+                    slowModePeriodicSpentReached = false;
+                    // TODO Insure in router.cc (not router_runner) that
+                    // maxBidPrice <= slowModeAuthorizedMoneyLimit
+                    // Here we're garanteed that price.value >= slowModeAuthorizedMoneyLimit
+                    accumulatedBidMoneyInThisPeriod = price.value;
+
+                    recordHit("monitor.systemInSlowMode"); 
+                }
+
+                else {
+                    accumulatedBidMoneyInThisPeriod += price.value;
+                    // Check if we're spending more in this period than what slowModeAuthorizedMoneyLimit
+                    // allows us to.
+                    if (accumulatedBidMoneyInThisPeriod > slowModeAuthorizedMoneyLimit.value) {
+                        slowModePeriodicSpentReached = true;
+                        dropBid = true;
+                    }
+                }
             }
 
-            else {
-                accumulatedBidMoneyInThisPeriod += price.value;
-                // Check if we're spending more in this period than what slowModeAuthorizedMoneyLimit
-                // allows us to.
-                if (accumulatedBidMoneyInThisPeriod > slowModeAuthorizedMoneyLimit.value) {
-                    slowModePeriodicSpentReached = true;
-                    bidder->sendBidDroppedMessage(agentConfig, agent, auctionInfo.auction);
-                    recordHit("slowMode.droppedBid");
-                    recordHit("accounts.%s.IGNORED", config.account.toString('.'));
+            if (dropBid) {
+                auto auction = auctionInfo.auction;
+                callBidder([=] () {
+                        bidder->sendBidDroppedMessage(agentConfig, agent, auction);
+                    });
+                recordHit("slowMode.droppedBid");
+                recordHit("accounts.%s.IGNORED", config.account.toString('.'));
                 continue;
-                }
             }
         } else {
             // Make sure slowModePeriodicSpentReached is false if monitor success is satisfied.
@@ -2141,14 +2455,22 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
             slowModePeriodicSpentReached = false;
         }
 
-        if (!banker->authorizeBid(config.account, auctionKey, price) || failBid(budgetErrorRate))
+        // The slot is only valid for the config the agent currently has.
+        int accountSlot = agentConfig.get() == &config ? info.accountSlot : -1;
+
+        if (!banker->authorizeBid(accountSlot, config.account, auctionKey, price)
+                || failBid(budgetErrorRate))
         {
-            ++info.stats->noBudget;
+            ML::atomic_inc(info.stats->noBudget);
 
-            bidder->sendNoBudgetMessage(agentConfig, agent, auctionInfo.auction);
+            auto auction = auctionInfo.auction;
+            callBidder([=] () {
+                    bidder->sendNoBudgetMessage(agentConfig, agent, auction);
+                });
 
-            this->logMessage("NOBUDGET", agent, auctionId,
-                    bidsString, message.meta);
+            if (isLogged("NOBUDGET"))
+                this->logMessage("NOBUDGET", agent, auctionId,
+                        bidsString(), message.meta);
             this->logMessageToAnalytics("NOBUDGET", agent, auctionId);
             recordHit("accounts.%s.NOBUDGET", config.account.toString('.'));
             continue;
@@ -2205,46 +2527,62 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
         switch (localResult.val) {
         case Auction::WinLoss::PENDING: {
-            ++info.stats->bids;
-            info.stats->totalBid += bid.price;
+            ML::atomic_inc(info.stats->bids);
+            {
+                std::lock_guard<ML::Spinlock> guard(statsLock);
+                info.stats->totalBid += bid.price;
+            }
             break; // response will be sent later once local winning bid known
         }
         case Auction::WinLoss::LOSS:
-            ++info.stats->bids;
-            info.stats->totalBid += bid.price;
+            ML::atomic_inc(info.stats->bids);
+            {
+                std::lock_guard<ML::Spinlock> guard(statsLock);
+                info.stats->totalBid += bid.price;
+            }
             // fall through
         case Auction::WinLoss::TOOLATE:
         case Auction::WinLoss::INVALID: {
             if (localResult.val == Auction::WinLoss::TOOLATE)
-                ++info.stats->tooLate;
+                ML::atomic_inc(info.stats->tooLate);
             else if (localResult.val == Auction::WinLoss::INVALID)
-                ++info.stats->invalid;
+                ML::atomic_inc(info.stats->invalid);
 
             banker->cancelBid(config.account, auctionKey);
 
+            auto auction = auctionInfo.auction;
+
             BidStatus status;
             switch (localResult.val) {
             case Auction::WinLoss::LOSS:
                 status = BS_LOSS;
-                bidder->sendLossMessage(agentConfig, agent, auctionId.toString ());
+                callBidder([=] () {
+                        bidder->sendLossMessage(agentConfig, agent, auctionId.toString ());
+                    });
                 recordHit("accounts.%s.LOCAL_LOSS", config.account.toString('.'));
                 break;
             case Auction::WinLoss::TOOLATE:
                 status = BS_TOOLATE;
-                bidder->sendTooLateMessage(agentConfig, agent, auctionInfo.auction);
+                callBidder([=] () {
+                        bidder->sendTooLateMessage(agentConfig, agent, auction);
+                    });
                 recordHit("accounts.%s.TOOLATE", config.account.toString('.'));
                 break;
             case Auction::WinLoss::INVALID:
                 status = BS_INVALID;
-                bidder->sendBidInvalidMessage(agentConfig, agent, msg, auctionInfo.auction);
+                callBidder([=] () {
+                        bidder->sendBidInvalidMessage(agentConfig, agent, msg, auction);
+                    });
                 recordHit("accounts.%s.INVALID", config.account.toString('.'));
                 break;
             default:
                 throw ML::Exception("logic error");
             }
 
-            this->logMessage(msg, agent, auctionId, bidsString, message.meta);
-            this->logMessageToAnalytics(msg, agent, auctionId, bidsString);
+            if (isLogged(msg))
+                this->logMessage(msg, agent, auctionId, bidsString(), message.meta);
+            if (isLoggedToAnalytics(msg))
+                this->logMessageToAnalytics(msg, agent, auctionId, bidsString());
             continue;
         }
         case Auction::WinLoss::WIN:
@@ -2259,10 +2597,11 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
     }
 
     if (numValidBids > 0) {
-        if (logBids)
+        if (logBids && isLogged("BID"))
             // Send BID to logger
-            logMessage("BID", agent, auctionId, bidsString, message.meta);
-        logMessageToAnalytics("BID", agent, auctionId, bidsString);
+            logMessage("BID", agent, auctionId, bidsString(), message.meta);
+        if (isLoggedToAnalytics("BID"))
+            logMessageToAnalytics("BID", agent, auctionId, bidsString());
         ML::atomic_add(numNonEmptyBids, 1);
     }
     else if (numPassedBids > 0) {
@@ -2294,7 +2633,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
         if (!auctionInfo.auction->finish()) {
             debugAuction(auctionId, "FINISH TOO LATE", originalMessage);
         }
-        inFlight.erase(auctionId);
+        shard.inFlight.erase(auctionId);
         //cerr << "couldn't finish auction " << auctionInfo.auction->id
         //<< " after bid " << message << endl;
     }
@@ -2304,7 +2643,7 @@ doBidImpl(const BidMessage &message, const std::vector<std::string> &originalMes
 
 void
 Router::
-doSubmitted(std::shared_ptr<Auction> auction)
+doSubmitted(Shard & shard, std::shared_ptr<Auction> auction)
 {
     // Auction was submitted
 
@@ -2338,6 +2677,7 @@ doSubmitted(std::shared_ptr<Auction> auction)
     //               auction->bidRequest->imp.size());
     //cerr << "got a win for auction id " << auctionId << " with num imp:" << allResponses.size() << endl;
     // Go through the imp one by one
+    bool anyBid = false, anySubmittedBid = false;
     for (unsigned spotNum = 0;  spotNum < allResponses.size();  ++spotNum) {
 
         bool hasSubmittedBid = false;
@@ -2345,6 +2685,7 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
         const std::vector<Auction::Response> & responses
             = allResponses[spotNum];
+        anyBid = anyBid || !responses.empty();
 
         if (doDebug)
             debugSpot(auctionId, spotId,
@@ -2367,10 +2708,12 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
             //cerr << "doing response " << i << endl;
 
-            if (!agents.count(response.agent)) continue;
+            auto agentIt = agents.find(response.agent);
+            if (agentIt == agents.end()) continue;
 
-            AgentInfo & info = agents[response.agent];
+            AgentInfo & info = agentIt->second;
             const auto& agentConfig = info.config;
+            const auto& agent = response.agent;
 
             Amount bid_price = response.price.maxPrice;
 
@@ -2408,15 +2751,19 @@ doSubmitted(std::shared_ptr<Auction> auction)
                                "auction should not be invalid");
             case Auction::WinLoss::LOSS:
                 bidStatus = BS_LOSS;
-                ++info.stats->losses;
+                ML::atomic_inc(info.stats->losses);
                 msg = "LOSS";
-                bidder->sendLossMessage(agentConfig, response.agent, auctionId.toString());
+                callBidder([=] () {
+                        bidder->sendLossMessage(agentConfig, agent, auctionId.toString());
+                    });
                 break;
             case Auction::WinLoss::TOOLATE:
                 bidStatus = BS_TOOLATE;
-                ++info.stats->tooLate;
+                ML::atomic_inc(info.stats->tooLate);
                 msg = "TOOLATE";
-                bidder->sendTooLateMessage(agentConfig, response.agent, auction);
+                callBidder([=] () {
+                        bidder->sendTooLateMessage(agentConfig, agent, auction);
+                    });
                 break;
             default:
                 throwException("doSubmitted.unknownStatus",
@@ -2432,20 +2779,24 @@ doSubmitted(std::shared_ptr<Auction> auction)
 
         // If we didn't actually submit a bid then nothing else to do
         if (!hasSubmittedBid) continue;
+        anySubmittedBid = true;
         this->recordHit("numRequestWithBid");
         ML::atomic_add(numAuctionsWithBid, 1);
         //cerr << fName << "injecting submitted auction " << endl;
 
-        logMessageToAnalytics("SUBMITTED", auction->id, responses[0].agent, responses[0].price.toJsonStr());
+        if (isLoggedToAnalytics("SUBMITTED"))
+            logMessageToAnalytics("SUBMITTED", auction->id, responses[0].agent, responses[0].price.toJsonStr());
         onSubmittedAuction(auction, spotId, responses[0]);
         //postAuctionLoop.injectSubmittedAuction(auction, spotId, responses[0]);
     }
 
+    requestValues.record(RequestValueTable::Key(*auction->request),
+                         anyBid, anySubmittedBid);
+
     //cerr << "auction.use_count() = " << auction.use_count() << endl;
 
-    if (auction.unique()) {
-        auctionGraveyard.tryPush(auction);
-    }
+    // Auctions from the exchange connectors are destroyed back on their
+    // exchange thread when the last reference to them goes away.
 }
 
 std::string
@@ -2490,9 +2841,10 @@ onNewAuction(std::shared_ptr<Auction> auction)
 
     //cerr << "AUCTION GOT THROUGH" << endl;
 
-    if (logAuctions)
-        // Send AUCTION to logger
-        logMessage("AUCTION", auction->id, auction->requestStr);
+    if (logAuctions && isLogged("AUCTION"))
+        // Send AUCTION to logger.  Checked first as requestStr() may have
+        // to encode the request.
+        logMessage("AUCTION", auction->id, auction->requestStr());
     logMessageToAnalytics("AUCTION", auction->id);
 
     const BidRequest & request = *auction->request;
@@ -2527,7 +2879,9 @@ onAuctionDone(std::shared_ptr<Auction> auction)
 #endif
 
     debugAuction(auction->id, "SENT SUBMITTED");
-    submittedBuffer.push(auction);
+    Shard & shard = this->shard(auction->id);
+    shard.submittedBuffer.push(auction);
+    shard.wakeup.signal();
 }
 
 void
@@ -2569,6 +2923,7 @@ updateAllAgents()
             entry.config = it->second.config;
             entry.stats = it->second.stats;
             entry.status = it->second.status;
+            entry.filterStats = it->second.filterStats;
             int i = newInfo->size();
             newInfo->push_back(entry);
 
@@ -2593,6 +2948,8 @@ doConfig(const std::string & agent,
 {
     RouterProfiler profiler(dutyCycleCurrent.nsConfig);
 
+    boost::unique_lock<AgentsLock> guard(agentsLock);
+
     if (!config) {
         auto it = agents.find(agent);
         // It might happen that we don't find the agent if for example we received
@@ -2605,6 +2962,7 @@ doConfig(const std::string & agent,
         }
     } else {
         AgentInfo & info = agents[agent];
+        info.setNumShards(shards.size());
         logMessage("CONFIG", agent, boost::trim_copy(config->toJson().toString()));
         logMessageToAnalytics("CONFIG", agent, boost::trim_copy(config->toJson().toString()));
 
@@ -2620,6 +2978,8 @@ doConfig(const std::string & agent,
         }
 
         info.config = newConfig;
+        info.filterStats
+            = std::make_shared<AgentFilterStats>(*this, newConfig->account);
         //cerr << "configured " << agent << " strategy : " << info.config->strategy << " campaign "
         //     <<  info.config->campaign << endl;
 
@@ -2627,12 +2987,15 @@ doConfig(const std::string & agent,
         info.setBidRequestFormat(bidRequestFormat);
 
         configure(agent, *newConfig);
+        info.accountSlot = banker->accountSlot(newConfig->account);
         info.configured = true;
         bidder->sendMessage(config, agent, "GOTCONFIG");
 
         info.filterIndex = filters.addConfig(agent, info);
     }
 
+    guard.unlock();
+
     // Broadcast that we have a new agent or it has a new configuration
     updateAllAgents();
 }
@@ -2710,6 +3073,28 @@ configure(const std::string & agent, AgentConfig & config)
     banker->addSpendAccount(config.account, Amount(), onDone);
 }
 
+Json::Value
+Router::
+getFilterInfo() const
+{
+    return filters.getFilterInfo();
+}
+
+Json::Value
+Router::
+getSheddingInfo() const
+{
+    Json::Value result;
+    result["values"] = requestValues.toJson();
+
+    Json::Value & exchangesInfo = result["exchanges"];
+    exchangesInfo = Json::Value(Json::objectValue);
+    for (auto & exchange : exchanges)
+        exchangesInfo[exchange->uniqueName()] = exchange->getSheddingInfo();
+
+    return result;
+}
+
 Json::Value
 Router::
 getStats() const
@@ -2879,18 +3264,14 @@ submitToPostAuctionService(std::shared_ptr<Auction> auction,
         event->auctionId = auction->id;
         event->adSpotId = adSpotId;
         event->lossTimeout = auction->lossAssumed;
-        event->augmentations = auction->agentAugmentations[bid.agent];
+        event->augmentations = auction->agentAugmentations.get(bid.agent);
         event->bidRequest(auction->request);
-        event->bidRequestStr = auction->requestStr;
-        event->bidRequestStrFormat = auction->requestStrFormat ;
+        event->bidRequestStr = auction->requestStr();
+        event->bidRequestStrFormat = auction->requestStrFormat();
         event->bidResponse = bid;
 
         postAuctionEndpoint.sendAuction(event);
     }
-
-    if (auction.unique()) {
-        auctionGraveyard.tryPush(auction);
-    }
 }
 
 void
@@ -10,16 +10,21 @@
 
 #include <atomic>
 #include "filter_pool.h"
+#include "request_value.h"
 #include "soa/service/zmq.hpp"
 #include <unordered_map>
 #include <boost/thread/thread.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include "jml/utils/filter_streams.h"
 #include "soa/service/zmq_named_pub_sub.h"
 #include "soa/service/socket_per_thread.h"
 #include "soa/service/timeout_map.h"
+#include "soa/service/hashed_timeout_map.h"
 #include "soa/service/pending_list.h"
 #include "soa/service/loop_monitor.h"
+#include "soa/service/service_base.h"
 #include "augmentation_loop.h"
 #include "router_types.h"
 #include "soa/gc/gc_lock.h"
@@ -48,6 +53,31 @@ struct BidderInterface;
 /* AGENT INFO                                                                */
 /*****************************************************************************/
 
+/** Handles on the per-account stats that doStartBidding() records while
+    filtering an agent.  Registered when the agent is configured so that
+    the auctions don't need to format their names.
+*/
+struct AgentFilterStats {
+    AgentFilterStats(const EventRecorder & events, const AccountKey & account);
+
+    EventHandle intoStaticFilters;
+    EventHandle agentAppearsDead;
+    EventHandle earlyTooManyInFlight;
+    EventHandle staticNotEnoughTime;
+    EventHandle passedStaticFilters;
+
+    EventHandle intoDynamicFilters;
+    EventHandle tooManyInFlight;
+    EventHandle notEnoughTime;
+    EventHandle timeUsedBeforeDynamicFilter;
+    EventHandle timeLeftBeforeDynamicFilter;
+    EventHandle timeElapsedBeforePreproMs;
+    EventHandle timeElapsedDuringPreproMs;
+    EventHandle timeWindowMs;
+    EventHandle userBlacklisted;
+    EventHandle passedDynamicFilters;
+};
+
 /** A single entry in the agent info structure. */
 struct AgentInfoEntry {
     std::string name;
@@ -55,6 +85,7 @@ struct AgentInfoEntry {
     std::shared_ptr<const AgentConfig> config;
     std::shared_ptr<const AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AgentFilterStats> filterStats;
 
     bool valid() const { return config && stats; }
 
@@ -153,6 +184,18 @@ struct Router : public ServiceBase,
     /** Initialize filters from json configuration. */
     void initFilters(const Json::Value & config = Json::Value::null);
 
+    /** Load the augmentors to run inside the router from an array of json
+        configurations, each with the "type" of the augmentor plugin, an
+        optional "maxInFlight" and its own settings.
+    */
+    void initAugmentors(const Json::Value & config);
+
+    /** Spread the auctions over the given number of shards, each with its
+        own thread.  Must be called before start(); init() sets up a single
+        shard, run by the main loop, if it wasn't called.
+    */
+    void initShards(size_t numShards);
+
     /** Initialize all of the internal data structures and configuration. */
     void init();
 
@@ -217,6 +260,10 @@ struct Router : public ServiceBase,
     {
         exchange.onNewAuction  = [=] (std::shared_ptr<Auction> a) { this->injectAuction(a, secondsUntilLossAssumed_); };
         exchange.onAuctionDone = [=] (std::shared_ptr<Auction> a) { this->onAuctionDone(a); };
+        ExchangeConnector * connector = &exchange;
+        exchange.onPreFilter = [=] (const BidRequest & br, unsigned fields) { return this->filters.preFilter(br, connector, fields); };
+        exchange.onScoreRequest = [=] (const BidRequest & br) { return this->requestValues.score(br); };
+        exchange.onRequestShed = [=] (const BidRequest & br) { this->requestValues.recordShed(br); };
         exchange.onAuctionError = [=] (const std::string & channel,
                                        std::shared_ptr<Auction> auction,
                                        const std::string message) { this->onAuctionError(channel, auction, message); };
@@ -354,6 +401,14 @@ struct Router : public ServiceBase,
     /** Return a stats object that tells us what's going on. */
     Json::Value getStats() const;
 
+    /** Return the current filter order and the cost estimates of each
+        filter. */
+    Json::Value getFilterInfo() const;
+
+    /** Return the historical value of the requests of each exchange,
+        publisher and domain, and what each exchange shed by value. */
+    Json::Value getSheddingInfo() const;
+
     /** Return information about a given agent. */
     Json::Value getAgentInfo(const std::string & agent) const;
 
@@ -405,11 +460,6 @@ protected:
     // This thread contains the main router loop
     boost::scoped_ptr<boost::thread> runThread;
 
-    // This thread wakes up every now and again to run the destructors
-    // on auction objects, which are expensive to destroy, so that they
-    // don't have to run in the main loop
-    boost::scoped_ptr<boost::thread> cleanupThread;
-
     typedef std::recursive_mutex Lock;
     typedef std::unique_lock<Lock> Guard;
 
@@ -421,20 +471,23 @@ public:
 
     void updateAllAgents();
 
-    /** Map from the configured name of the agent to the agent info. */
+    /** Map from the configured name of the agent to the agent info.  Only
+        the main loop modifies it, with agentsLock held exclusively; the
+        shards hold it shared while they look at the agents.
+    */
     typedef std::map<std::string, AgentInfo> Agents;
     Agents agents;
 
+    typedef boost::shared_mutex AgentsLock;
+    mutable AgentsLock agentsLock;
+
     ML::RingBufferSRMW<std::pair<std::string, std::shared_ptr<const AgentConfig> > > configBuffer;
     ML::RingBufferSRMW<std::shared_ptr<ExchangeConnector> > exchangeBuffer;
-    ML::RingBufferSRMW<std::shared_ptr<AugmentationInfo> > startBiddingBuffer;
-    ML::RingBufferSRMW<std::shared_ptr<Auction> > submittedBuffer;
-    ML::RingBufferSWMR<std::shared_ptr<Auction> > auctionGraveyard;
-    ML::RingBufferSRMW<BidMessage> doBidBuffer;
 
     ML::Wakeup_Fd wakeupMainLoop;
 
     FilterPool filters;
+    RequestValueTable requestValues;
 
     AugmentationLoop augmentationLoop;
     Blacklist blacklist;
@@ -442,13 +495,93 @@ public:
     LoopMonitor loopMonitor;
     LoadStabilizer loadStabilizer;
 
-    /** List of auctions we're currently tracking as active. */
-    typedef TimeoutMap<Id, AuctionInfo> InFlight;
-    InFlight inFlight;
+    /** List of auctions we're currently tracking as active.  Every auction
+        goes through it, so it's a hash table and timing wheel rather than
+        trees.
+    */
+    typedef HashedTimeoutMap<Id, AuctionInfo> InFlight;
+
+    /*************************************************************************/
+    /* SHARDS                                                                */
+    /*************************************************************************/
+
+    /** The auctions are spread over the shards by the hash of their id.  A
+        shard starts the bidding, takes the bids and handles the submission
+        of its auctions, which it alone keeps in its inFlight map, so that
+        nothing it does for one auction needs to be synchronized with the
+        other shards.
+
+        With a single shard the main loop does all of that itself, as it
+        always has; with more, each shard has its own thread.
+    */
+    struct Shard {
+        Shard(unsigned index);
+
+        unsigned index;
+
+        ML::RingBufferSRMW<std::shared_ptr<AugmentationInfo> > startBiddingBuffer;
+        ML::RingBufferSRMW<std::shared_ptr<Auction> > submittedBuffer;
+        ML::RingBufferSRMW<BidMessage> doBidBuffer;
+
+        /** BID messages from the agents, which are parsed by the shard. */
+        ML::RingBufferSRMW<std::vector<std::string> > agentBidBuffer;
+
+        ML::Wakeup_Fd wakeup;
+
+        InFlight inFlight;
+
+        /** Size of inFlight, for the other threads. */
+        std::atomic<size_t> numInFlight;
+
+        /** Time spent doing something.  Only written by the shard's thread
+            and read by the loop monitor's.
+        */
+        std::atomic<double> totalActive;
+
+        boost::scoped_ptr<boost::thread> thread;
+    };
+
+    std::vector<std::unique_ptr<Shard> > shards;
+
+    /** Shard that owns the given auction. */
+    Shard & shard(const Id & auctionId)
+    {
+        return *shards[auctionId.hash() % shards.size()];
+    }
+
+    /** Total number of auctions in flight over all of the shards. */
+    size_t numInFlight() const;
+
+    /** Loop run by the thread of each shard when there is more than one. */
+    void runShard(Shard & shard);
+
+    /** Empty the buffers of the shard. */
+    typedef std::function<void (const char * name, double start)> RecordTime;
+    void processShard(Shard & shard, const RecordTime & recordTime);
+
+    /** Calls to the bidder interface made while processing the auctions.
+        When there are several shards and the bidder interface can't be
+        called concurrently (the zeromq agents are served by the main
+        loop), the shards queue them here for the main loop to make.
+    */
+    ML::RingBufferSRMW<std::function<void ()> > bidderBuffer;
+    bool queueBidderCalls;
+
+    template<typename Fn>
+    void callBidder(Fn && fn)
+    {
+        if (JML_LIKELY(!queueBidderCalls)) {
+            fn();
+            return;
+        }
+
+        bidderBuffer.push(std::forward<Fn>(fn));
+        wakeupMainLoop.signal();
+    }
 
     /** Add the given auction to our data structures. */
     AuctionInfo &
-    addAuction(std::shared_ptr<Auction> auction, Date timeout);
+    addAuction(Shard & shard, std::shared_ptr<Auction> auction, Date timeout);
 
     DutyCycleEntry dutyCycleCurrent;
     std::vector<DutyCycleEntry> dutyCycleHistory;
@@ -459,8 +592,15 @@ public:
 
     void checkDeadAgents();
 
+    /** Tell the agents about the auctions of the shard that they've been
+        sitting on for far too long.
+    */
+    void checkLostBids(Shard & shard);
+
     void checkExpiredAuctions();
 
+    void checkExpiredAuctions(Shard & shard);
+
     void returnErrorResponse(const std::vector<std::string> & message,
                              const std::string & error);
 
@@ -489,21 +629,23 @@ public:
     /** We've finished augmenting our auctions.  Allow the agents to bid
         on them.
     */
-    void doStartBidding(const std::vector<std::string> & message);
+    void doStartBidding(Shard & shard,
+                        const std::vector<std::string> & message);
 
     /** Ditto but taking the augmented auction directly. */
-    void doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo);
+    void doStartBidding(Shard & shard,
+                        const std::shared_ptr<AugmentationInfo> & augInfo);
 
     /** Auction has been submitted.  Do the final cleanup here and send
         it off to the post auction loop. */
-    void doSubmitted(std::shared_ptr<Auction> auction);
+    void doSubmitted(Shard & shard, std::shared_ptr<Auction> auction);
 
     //std::unordered_set<Id> recentlySubmitted;  // DEBUG
 
     /** An agent bid on an auction.  Arrange for this bid to be recorded. */
-    void doBid(const std::vector<std::string> & message);
+    void doBid(Shard & shard, const std::vector<std::string> & message);
 
-    void doBidImpl(const BidMessage &message,
+    void doBidImpl(Shard & shard, const BidMessage &message,
                    const std::vector<std::string> &originalMessage = std::vector<std::string>());
 
     /** An agent responded to a ping message.  Arrange for the ping time
@@ -551,6 +693,9 @@ public:
 
     mutable Lock lock;
 
+    /** Protects the currency pools of the agent stats. */
+    ML::Spinlock statsLock;
+
     std::shared_ptr<Banker> banker;
 
     double secondsUntilLossAssumed_;
@@ -622,10 +767,11 @@ public:
                         const std::string & exception,
                         Args... args)
     {
-        logger.publish("ROUTERERROR", Date::now().print(5),
-                       function, exception, args...);
-        analytics.publish("ROUTERERROR", Date::now().print(5),
+        logger.publish("ROUTERERROR", BinaryTimestamp(),
                        function, exception, args...);
+        if (analytics.isChannelEnabled("ROUTERERROR"))
+            analytics.publish("ROUTERERROR", Date::now().print(5),
+                              function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -715,19 +861,35 @@ public:
     /** Log bids */
     bool logBids;
 
-    /** Log a given message to the given channel. */
+    /** Whether a message logged on the channel would go anywhere.  Messages
+        with arguments that are expensive to build should check this first.
+    */
+    bool isLogged(const std::string & channel) const
+    {
+        return logger.hasSubscriber(channel);
+    }
+
+    bool isLoggedToAnalytics(const std::string & channel) const
+    {
+        return analytics.isChannelEnabled(channel);
+    }
+
+    /** Log a given message to the given channel.  The timestamp is sent in
+        binary; see printTimestamp().
+    */
     template<typename... Args>
     void logMessage(const std::string & channel, Args... args)
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, Date::now().print(5), args...);
+        logger.publish(channel, BinaryTimestamp(), args...);
     }
 
     /** Log a given message to analytics endpoint on given channel. */
     template<typename... Args>
     void logMessageToAnalytics(const std::string & channel, Args... args)
     {
+        if (!analytics.isChannelEnabled(channel)) return;
         analytics.publish(channel, Date::now().print(5), args...);
     }
 
@@ -799,7 +961,7 @@ public:
     /* Client connection to the Monitor, determines if we can process bid
        requests */
     MonitorClient monitorClient;
-    // TODO Make this thread safe
+    ML::Spinlock slowModeLock;
     Date slowModeLastAuction;
     std::atomic<bool> slowModePeriodicSpentReached;    
     Amount slowModeAuthorizedMoneyLimit;
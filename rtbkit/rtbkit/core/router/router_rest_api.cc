@@ -34,6 +34,12 @@ doGet(const std::string& resource)
 {
     if (header.resource == "/stats")
         sendResponse(router->getStats());
+    else if (header.resource == "/filters") {
+        sendResponse(router->getFilterInfo());
+    }
+    else if (header.resource == "/shedding") {
+        sendResponse(router->getSheddingInfo());
+    }
     else if (header.resource == "/agents") {
         sendResponse(router->getAllAgentInfo());
     }
@@ -62,8 +62,10 @@ RouterRunner() :
     analyticsOn(false),
     analyticsConnections(1),
     augmentationWindowms(5),
+    numShards(1),
     dableSlowMode(false),
-    enableJsonFiltersFile("")
+    enableJsonFiltersFile(""),
+    adaptiveFilterOrder(false)
 {
 }
 
@@ -112,10 +114,16 @@ doOptions(int argc, char ** argv,
          "split or local banker can be chosen.")
          ("augmenter-timeout",value<int>(&augmentationWindowms),
          "configure the augmenter  timeout (in milliseconds)")
+        ("router-shards", value<int>(&numShards),
+         "number of threads over which the auctions are spread (default 1).")
         ("no slow mode", value<bool>(&dableSlowMode)->zero_tokens(),
          "disable the slow mode.")
         ("filters-configuration", value<string>(&enableJsonFiltersFile),
-          "configuration file with enabled filters data");
+          "configuration file with enabled filters data")
+        ("adaptive-filter-order", bool_switch(&adaptiveFilterOrder),
+         "periodically reorder the filters by measured cost and selectivity")
+        ("augmentor-configuration", value<string>(&augmentorConfigurationFile),
+         "configuration file with the augmentors to run inside the router");
 
     options_description all_opt = opts;
     all_opt
@@ -152,6 +160,9 @@ init()
     if (!enableJsonFiltersFile.empty())
         filtersConfig = loadJsonFromFile(enableJsonFiltersFile);
 
+    if (!augmentorConfigurationFile.empty())
+        augmentorConfig = loadJsonFromFile(augmentorConfigurationFile);
+
     const auto amountSlowModeMoneyLimit = Amount::parse(slowModeMoneyLimit);
     const auto maxBidPriceAmount = USD_CPM(maxBidPrice);
 
@@ -187,6 +198,8 @@ init()
         else
             LOG(print) << "analytics-uri is not in the config" << endl;
     }
+    router->initShards(numShards);
+    router->filters.setAdaptiveOrder(adaptiveFilterOrder);
     router->init();
 
     if (localBankerUri != "") {
@@ -219,6 +232,8 @@ init()
     router->setBanker(banker);
     router->initExchanges(exchangeConfig);
     router->initFilters(filtersConfig);
+    if (!augmentorConfig.isNull())
+        router->initAugmentors(augmentorConfig);
     router->bindTcp();
 }
 
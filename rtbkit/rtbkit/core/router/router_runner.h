@@ -53,8 +53,11 @@ struct RouterRunner {
     bool analyticsOn;
     int analyticsConnections;
     int augmentationWindowms;
+    int numShards;
     bool dableSlowMode;
     std::string enableJsonFiltersFile;
+    bool adaptiveFilterOrder;
+    std::string augmentorConfigurationFile;
 
     void doOptions(int argc, char ** argv,
                    const boost::program_options::options_description & opts
@@ -68,6 +71,7 @@ struct RouterRunner {
     Json::Value exchangeConfig;
     Json::Value bidderConfig;
     Json::Value filtersConfig;
+    Json::Value augmentorConfig;
 
     static Logging::Category print;
     static Logging::Category trace;
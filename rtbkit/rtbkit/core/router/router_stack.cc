@@ -87,12 +87,12 @@ submitAuction(const std::shared_ptr<Auction> & auction,
               const Id & adSpotId,
               const Auction::Response & response)
 {
-    const std::string& agentAugmentations = auction->agentAugmentations[response.agent];
+    const std::string& agentAugmentations = auction->agentAugmentations.get(response.agent);
     postAuctionLoop.injectSubmittedAuction(auction->id,
                                            adSpotId,
                                            auction->request,
-                                           auction->requestStr,
-                                           auction->requestStrFormat,
+                                           auction->requestStr(),
+                                           auction->requestStrFormat(),
                                            agentAugmentations,
                                            response,
                                            auction->lossAssumed);
@@ -135,7 +135,7 @@ numNonIdle() const
 {
     size_t numInFlight, numAwaitingAugmentation;
     {
-        numInFlight = router.inFlight.size();
+        numInFlight = router.numInFlight();
         numAwaitingAugmentation = router.augmentationLoop.numAugmenting();
     }
 
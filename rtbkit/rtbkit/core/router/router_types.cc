@@ -106,32 +106,32 @@ toJson(bool includeConfig, bool includeStats) const
     result["configured"] = configured;
     result["lastHeartbeat"]
         = status->lastHeartbeat.print(4);
-    result["numInFlight"] = status->numBidsInFlight;
+    result["numInFlight"] = status->numBidsInFlight.load();
     if (config && includeConfig) result["config"] = config->toJson(false);
     if (stats && includeStats) result["stats"] = stats->toJson();
     
     return result;
 }
 
-const std::string &
+std::string
 AgentInfo::
 encodeBidRequest(const BidRequest & br) const
 {
     throw ML::Exception("encodeBidRequest not there yet");
 }
 
-const std::string &
+std::string
 AgentInfo::
 encodeBidRequest(const Auction & auction) const
 {
-    return auction.requestStr;
+    return auction.requestStr();
 }
 
-const std::string &
+std::string
 AgentInfo::
 getBidRequestEncoding(const Auction & auction) const
 {
-    return auction.requestStrFormat;
+    return auction.requestStrFormat();
 }
 
 void
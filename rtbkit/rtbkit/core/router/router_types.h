@@ -12,6 +12,7 @@
 #include "rtbkit/common/auction.h"
 #include "jml/stats/distribution.h"
 #include <set>
+#include <atomic>
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/bids.h"
 
@@ -19,6 +20,7 @@
 namespace RTBKIT {
 
 struct AgentConfig;
+struct AgentFilterStats;
 
 
 /*****************************************************************************/
@@ -99,9 +101,11 @@ struct AgentStatus {
         lastHeartbeat = Date::now();
     }
 
-    bool dead;
+    std::atomic<bool> dead;    ///< Read by every router shard
     Date lastHeartbeat;
-    size_t numBidsInFlight;
+
+    /** Updated by every router shard; see AgentInfo::trackBidInFlight(). */
+    std::atomic<size_t> numBidsInFlight;
 };
 
 /// Information about a agent
@@ -111,7 +115,9 @@ struct AgentInfo {
           configured(false),
           status(new AgentStatus()),
           stats(new AgentStats()),
-          throttleProbability(1.0)
+          throttleProbability(1.0),
+          accountSlot(-1),
+          bidsInFlight(1)
     {
     }
 
@@ -126,18 +132,22 @@ struct AgentInfo {
     std::shared_ptr<AgentConfig> config;
     std::shared_ptr<AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AgentFilterStats> filterStats;
     double throttleProbability;
 
+    /** Slot of the config's account in the banker, or -1. */
+    int accountSlot;
+
     /** Address of the zeromq socket for this agent. */
     std::string address;
     
     /** Encode the given bid request ready to be sent to the given
         agent in its configured format.
     */
-    const std::string & encodeBidRequest(const BidRequest & br) const;
+    std::string encodeBidRequest(const BidRequest & br) const;
 
-    const std::string & encodeBidRequest(const Auction & auction) const;
-    const std::string & getBidRequestEncoding(const Auction & auction) const;
+    std::string encodeBidRequest(const Auction & auction) const;
+    std::string getBidRequestEncoding(const Auction & auction) const;
 
     /** Set the bid request format. */
     void setBidRequestFormat(const std::string & val);
@@ -195,10 +205,23 @@ struct AgentInfo {
         status->dead = false;
     }
 
+    /** Make room for the auctions of the given number of router shards.
+        Must not be called while the shards are running.
+    */
+    void setNumShards(size_t numShards)
+    {
+        bidsInFlight.resize(numShards);
+    }
+
+    /** Each router shard only ever touches its own auctions, so it can do
+        so without taking a lock.  Only the total, which is what the
+        dynamic filters look at, is shared between the shards.
+    */
     template<typename Fn>
-    void forEachInFlight(const Fn & fn) const
+    void forEachInFlight(unsigned shard, const Fn & fn) const
     {
-        for (auto it = bidsInFlight.begin(), end = bidsInFlight.end();
+        const auto & inFlight = bidsInFlight[shard];
+        for (auto it = inFlight.begin(), end = inFlight.end();
              it != end;  ++it) {
             fn(it->first, it->second);
         }
@@ -206,29 +229,47 @@ struct AgentInfo {
 
     size_t numBidsInFlight() const
     {
+        return status->numBidsInFlight;
+    }
+
+    /** Number of bids in flight in the given shard.  Must be called from
+        that shard.
+    */
+    size_t numBidsInFlight(unsigned shard) const
+    {
+        size_t result = bidsInFlight[shard].size();
+
         // DEBUG
-        if (status->numBidsInFlight != bidsInFlight.size())
+        // The total counts the bids of every shard, this one's included
+        size_t total = status->numBidsInFlight;
+        if (result > total || (bidsInFlight.size() == 1 && result != total))
             throw ML::Exception("numBidsInFlight is wrong");
-        return status->numBidsInFlight;
+
+        return result;
     }
     
-    bool expireBidInFlight(const Id & id)
+    bool expireBidInFlight(unsigned shard, const Id & id)
     {
-        bool result = bidsInFlight.erase(id);
-        status->numBidsInFlight = bidsInFlight.size();
+        bool result = bidsInFlight[shard].erase(id);
+        if (result)
+            --status->numBidsInFlight;
         return result;
     }
 
     // Returns true if it was successfully inserted
-    bool trackBidInFlight(const Id & id, Date date = Date::now())
+    bool trackBidInFlight(unsigned shard, const Id & id,
+                          Date date = Date::now())
     {
-        bool result = bidsInFlight.insert(std::make_pair(id, date)).second;
-        status->numBidsInFlight = bidsInFlight.size();
+        bool result
+            = bidsInFlight[shard].insert(std::make_pair(id, date)).second;
+        if (result)
+            ++status->numBidsInFlight;
         return result;
     }
 
 private:
-    std::map<Id, Date> bidsInFlight;  /// Auctions in which we're participating
+    /// Auctions in which we're participating, for each router shard
+    std::vector<std::map<Id, Date> > bidsInFlight;
     //std::set<std::pair<Id, Id> > awaitingResult;  ///< Auctions which are awaiting a win/loss result
 };
 
@@ -6,10 +6,11 @@
 
 LIB_FILTERS_SOURCES := \
 	filters/static_filters.cc \
+        filters/regex_matcher.cc \
         filters/creative_filters.cc
 
 LIB_FILTERS_LINK := \
-	arch utils filter_registry agent_configuration rtb
+	arch utils filter_registry agent_configuration rtb boost_thread
 
 $(eval $(call library,static_filters,$(LIB_FILTERS_SOURCES),$(LIB_FILTERS_LINK)))
 
@@ -18,7 +19,8 @@ LIBRTB_ROUTER_SOURCES := \
 	router.cc \
 	router_types.cc \
 	router_stack.cc \
-	filter_pool.cc
+	filter_pool.cc \
+	request_value.cc
 
 LIBRTB_ROUTER_LINK := \
 	rtb zeromq boost_thread logger opstats crypto++ leveldb gc services redis banker gobanker agent_configuration monitor monitor_service post_auction static_filters openrtb
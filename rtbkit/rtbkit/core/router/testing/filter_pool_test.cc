@@ -0,0 +1,135 @@
+/* filter_pool_test.cc
+   Copyright (c) 2014 Datacratic.  All rights reserved.
+
+   Tests for the adaptive ordering of the filter pool.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/filter_pool.h"
+#include "rtbkit/core/router/filters/generic_filters.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "rtbkit/common/bid_request.h"
+#include "jml/arch/timers.h"
+
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/** Runs first and is never moved. */
+struct PinnedTestFilter : public IterativeFilter<PinnedTestFilter>
+{
+    static constexpr const char* name = "PinnedTest";
+    unsigned priority() const { return 0; }
+    bool pinned() const { return true; }
+
+    bool filterConfig(FilterState&, const AgentConfig&) const
+    {
+        return true;
+    }
+};
+
+/** Expensive and lets everything through. */
+struct SlowTestFilter : public IterativeFilter<SlowTestFilter>
+{
+    static constexpr const char* name = "SlowTest";
+    unsigned priority() const { return 1; }
+
+    bool filterConfig(FilterState&, const AgentConfig&) const
+    {
+        double start = wall_time();
+        while (wall_time() - start < 0.00001);
+        return true;
+    }
+};
+
+/** Cheap and filters everything. */
+struct KillTestFilter : public IterativeFilter<KillTestFilter>
+{
+    static constexpr const char* name = "KillTest";
+    unsigned priority() const { return 2; }
+
+    bool filterConfig(FilterState&, const AgentConfig&) const
+    {
+        return false;
+    }
+};
+
+vector<string> filterOrder(const FilterPool& pool)
+{
+    vector<string> order;
+    Json::Value info = pool.getFilterInfo();
+    for (const auto& filter : info["filters"])
+        order.push_back(filter["name"].asString());
+    return order;
+}
+
+BOOST_AUTO_TEST_CASE( test_adaptive_filter_order )
+{
+    FilterRegistry::registerFilter<PinnedTestFilter>();
+    FilterRegistry::registerFilter<SlowTestFilter>();
+    FilterRegistry::registerFilter<KillTestFilter>();
+
+    FilterPool pool;
+    pool.setAdaptiveOrder(true);
+    pool.addFilter(SlowTestFilter::name);
+    pool.addFilter(KillTestFilter::name);
+    pool.addFilter(PinnedTestFilter::name);
+
+    for (size_t i = 0; i < 4; ++i) {
+        AgentInfo info;
+        info.config = make_shared<AgentConfig>();
+        info.config->creatives.emplace_back();
+        pool.addConfig("agent" + to_string(i), info);
+    }
+
+    const vector<string> priorityOrder =
+        { "PinnedTest", "SlowTest", "KillTest" };
+    BOOST_CHECK(filterOrder(pool) == priorityOrder);
+
+    BidRequest request;
+    request.imp.emplace_back();
+
+    // Nothing was sampled yet so the order can't change.
+    BOOST_CHECK(!pool.reorderFilters());
+
+    for (size_t i = 0; i < 5000; ++i)
+        BOOST_CHECK(pool.filter(request, nullptr).empty());
+
+    BOOST_CHECK(pool.reorderFilters());
+
+    const vector<string> adaptedOrder =
+        { "PinnedTest", "KillTest", "SlowTest" };
+    BOOST_CHECK(filterOrder(pool) == adaptedOrder);
+
+    Json::Value info = pool.getFilterInfo();
+    BOOST_CHECK(info["adaptive"].asBool());
+    BOOST_CHECK_EQUAL(info["filters"][1]["passRate"].asDouble(), 0.0);
+    BOOST_CHECK_EQUAL(info["filters"][2]["passRate"].asDouble(), 1.0);
+
+    // Stable once the order matches the estimates.
+    for (size_t i = 0; i < 5000; ++i)
+        pool.filter(request, nullptr);
+    BOOST_CHECK(!pool.reorderFilters());
+    BOOST_CHECK(filterOrder(pool) == adaptedOrder);
+}
+
+BOOST_AUTO_TEST_CASE( test_location_filter_needs_geo )
+{
+    FilterPool pool;
+
+    Json::Value locationOnly;
+    locationOnly.append("Location");
+    locationOnly.append("Segments");
+    BOOST_CHECK_THROW(pool.initWithFiltersFromJson(locationOnly),
+                      ML::Exception);
+
+    Json::Value withGeo = locationOnly;
+    withGeo.append("Geo");
+    pool.initWithFiltersFromJson(withGeo);
+}
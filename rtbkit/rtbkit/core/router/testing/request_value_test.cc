@@ -0,0 +1,175 @@
+/* request_value_test.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Tests for the request value table and the value based load shedding.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/request_value.h"
+#include "rtbkit/common/bid_request.h"
+#include "soa/service/loop_monitor.h"
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+BidRequest makeRequest(const string & exchange,
+                       const string & publisher,
+                       const string & domain)
+{
+    BidRequest br;
+    br.exchange = exchange;
+    br.site.reset(new OpenRTB::Site());
+    br.site->domain = Utf8String(domain);
+    if (!publisher.empty()) {
+        br.site->publisher.reset(new OpenRTB::Publisher());
+        br.site->publisher->id = Id(publisher);
+    }
+    return br;
+}
+
+void record(RequestValueTable & table, const BidRequest & br,
+            int requests, int bids, int wins)
+{
+    RequestValueTable::Key key(br);
+    for (int i = 0;  i < requests;  ++i)
+        table.record(key, i < bids, i < wins);
+}
+
+BOOST_AUTO_TEST_CASE( test_request_value_backoff )
+{
+    RequestValueTable table;
+
+    auto good = makeRequest("ex", "pub", "www.good.com");
+    auto bad = makeRequest("ex", "pub", "bad.com");
+
+    BOOST_CHECK_EQUAL(RequestValueTable::Key(good).domain, "good.com");
+    BOOST_CHECK_EQUAL(table.score(good), 1.0);
+
+    record(table, good, 100, 100, 100);
+    record(table, bad, 100, 0, 0);
+
+    // Nothing is visible until the table is updated
+    BOOST_CHECK_EQUAL(table.score(bad), 1.0);
+    table.update();
+
+    BOOST_CHECK_EQUAL(table.score(good), 1.0);
+    BOOST_CHECK_EQUAL(table.score(bad), 0.0);
+
+    // Unknown domains are scored on their publisher, then their exchange
+    BOOST_CHECK_CLOSE(table.score(makeRequest("ex", "pub", "new.com")),
+                      0.5, 1e-6);
+    BOOST_CHECK_CLOSE(table.score(makeRequest("ex", "", "new.com")),
+                      0.5, 1e-6);
+    BOOST_CHECK_EQUAL(table.score(makeRequest("other", "pub", "new.com")),
+                      1.0);
+
+    auto json = table.toJson();
+    BOOST_CHECK(json.isMember("domain:bad.com"));
+    BOOST_CHECK_EQUAL(json["domain:bad.com"]["bidRate"].asDouble(), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE( test_request_value_decay )
+{
+    RequestValueTable table;
+
+    auto rare = makeRequest("ex", "", "rare.com");
+    record(table, rare, 60, 0, 0);
+    record(table, makeRequest("ex", "", "common.com"), 1000, 1000, 0);
+    table.update();
+
+    BOOST_CHECK_EQUAL(table.score(rare), 0.0);
+
+    // Without new requests the rare domain's history fades and it falls
+    // back to its exchange, of which the value doesn't change.
+    for (unsigned i = 0;  i < 5;  ++i)
+        table.update();
+
+    BOOST_CHECK_CLOSE(table.score(rare), 1000.0 / 1060.0 / 2.0, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE( test_request_value_shedding )
+{
+    RequestValueTable table;
+
+    auto low = makeRequest("ex", "", "low.com");
+    auto high = makeRequest("ex", "", "high.com");
+    auto unknown = makeRequest("ex", "", "new.com");
+
+    // Every request on high.com gets a bid and none on low.com does, which
+    // puts the exchange at 0.25.
+    record(table, low, 100, 0, 0);
+    record(table, high, 100, 100, 0);
+    table.update();
+
+    // Shed whatever is scored under 0.2 for long enough that the history
+    // of low.com would have decayed to nothing if it only came from the
+    // requests that were kept.
+    RequestValueTable::Key lowKey(low);
+    for (unsigned period = 0;  period < 200;  ++period) {
+        for (unsigned i = 0;  i < 100;  ++i) {
+            if (table.score(low) < 0.2)
+                table.recordShed(lowKey);
+            else table.record(lowKey, false, false);
+        }
+        record(table, high, 100, 100, 0);
+        table.update();
+
+        BOOST_REQUIRE_EQUAL(table.score(low), 0.0);
+        BOOST_REQUIRE_CLOSE(table.score(unknown), 0.25, 1e-6);
+    }
+
+    auto json = table.toJson();
+    BOOST_CHECK_GT(json["domain:low.com"]["requests"].asDouble(), 1000.0);
+}
+
+BOOST_AUTO_TEST_CASE( test_request_value_shed_without_history )
+{
+    RequestValueTable table;
+
+    // Shedding requests that were never seen mustn't make up a history for
+    // them, let alone one where every request got a bid and a win.
+    auto unknown = makeRequest("ex", "pub", "new.com");
+    for (unsigned i = 0;  i < 1000;  ++i)
+        table.recordShed(RequestValueTable::Key(unknown));
+    table.update();
+
+    auto json = table.toJson();
+    BOOST_CHECK(!json.isMember("exchange:ex"));
+    BOOST_CHECK(!json.isMember("publisher:ex:pub"));
+    BOOST_CHECK(!json.isMember("domain:new.com"));
+}
+
+BOOST_AUTO_TEST_CASE( test_value_shedder )
+{
+    ValueShedder shedder;
+
+    auto value = [] (unsigned i) { return (i % 100) / 100.0; };
+
+    for (unsigned i = 0;  i < 10000;  ++i)
+        BOOST_CHECK(!shedder.shedMessage(value(i), 0.0));
+
+    for (unsigned i = 0;  i < 2048;  ++i)
+        shedder.shedMessage(value(i), 0.3);
+
+    unsigned dropped = 0;
+    double maxDropped = 0.0;
+    for (unsigned i = 0;  i < 10000;  ++i) {
+        if (!shedder.shedMessage(value(i), 0.3)) continue;
+        ++dropped;
+        maxDropped = std::max(maxDropped, value(i));
+    }
+
+    // The same proportion as a uniform drop, but only the lowest values
+    BOOST_CHECK_GT(dropped, 2500);
+    BOOST_CHECK_LT(dropped, 3500);
+    BOOST_CHECK_LT(maxDropped, 0.4);
+
+    auto json = shedder.getDistribution();
+    BOOST_CHECK_EQUAL(json["buckets"].size(), 32);
+    BOOST_CHECK_CLOSE(json["shedProbability"].asDouble(), 0.3, 1e-4);
+}
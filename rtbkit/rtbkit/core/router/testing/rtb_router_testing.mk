@@ -9,3 +9,6 @@ $(eval $(call nodejs_test,rtb_new_format_test,bid_request sync_utils))
 $(eval $(call test,pending_list_test,types,boost))
 #$(eval $(call test,router_banker_test,rtb_router dataflow bidding_agent,boost))
 #$(eval $(call test,augmentation_test,rtb_router bid_request augmentor_base,boost))
+$(eval $(call test,filter_pool_test,rtb_router,boost))
+$(eval $(call test,request_value_test,rtb_router,boost))
+$(eval $(call program,timeout_map_bench,types boost_program_options))
@@ -0,0 +1,214 @@
+/* timeout_map_bench.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Cost per auction of the timeout maps the router and the post auction
+   loop can keep their in flight auctions in, with a given number of live
+   entries.
+
+   Every auction is inserted with a 5 second timeout and looked up twice;
+   half of them are then erased before their timeout, as when all their
+   bids came back, and the other half expire.
+
+   Also times how long HashedTimeoutMap takes to expire a run of near
+   entries with and without a far off entry inserted first.
+*/
+
+#include "soa/service/timeout_map.h"
+#include "soa/service/hashed_timeout_map.h"
+#include "rtbkit/core/post_auction/timeout_map.h"
+#include "soa/types/id.h"
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <iostream>
+#include <random>
+#include <memory>
+#include <cmath>
+
+using namespace std;
+using namespace Datacratic;
+
+
+namespace {
+
+/* About the size of what the router keeps per auction. */
+struct Info {
+    std::shared_ptr<void> auction;
+    Date lossTimeout;
+    uint64_t bidders;
+};
+
+/* The three maps don't quite have the same interface. */
+
+template<typename Map>
+struct Ops {
+    static void insert(Map & map, const Id & id, Date timeout)
+    {
+        map.insert(id, Info(), timeout);
+    }
+
+    static bool find(Map & map, const Id & id)
+    {
+        return map.find(id) != map.end();
+    }
+
+    static size_t expire(Map & map, Date now)
+    {
+        size_t n = 0;
+        map.expire([&] (const Id &, const Info &) { ++n;  return Date(); },
+                   now);
+        return n;
+    }
+};
+
+template<>
+struct Ops<RTBKIT::TimeoutMap<Id, Info> > {
+    typedef RTBKIT::TimeoutMap<Id, Info> Map;
+
+    static void insert(Map & map, const Id & id, Date timeout)
+    {
+        map.emplace(id, Info(), timeout);
+    }
+
+    static bool find(Map & map, const Id & id)
+    {
+        return map.count(id) && map.get(id).bidders == 0;
+    }
+
+    static size_t expire(Map & map, Date now)
+    {
+        return map.expire([] (Id &&, Info &&) {}, now);
+    }
+};
+
+template<typename Map>
+void bench(const string & name, size_t live, size_t auctions,
+           const vector<Id> & ids)
+{
+    typedef Ops<Map> O;
+
+    // Half the auctions are erased after half the timeout, so there are
+    // three quarters of a timeout's worth of auctions live.
+    double timeout = 5.0;
+    size_t perTimeout = live * 4 / 3;
+    size_t eraseLag = perTimeout / 2;
+    double dt = timeout / perTimeout;
+
+    Map map;
+    Date now = Date::fromSecondsSinceEpoch(1000000);
+    size_t found = 0, expired = 0;
+    size_t n = ids.size();
+
+    auto step = [&] (size_t i)
+        {
+            now = now.plusSeconds(dt);
+            O::insert(map, ids[i % n], now.plusSeconds(timeout));
+            found += O::find(map, ids[i % n]);
+            if (i >= eraseLag && (i - eraseLag) % 2) {
+                found += O::find(map, ids[(i - eraseLag) % n]);
+                map.erase(ids[(i - eraseLag) % n]);
+            }
+            if (i % 64 == 0)
+                expired += O::expire(map, now);
+        };
+
+    // Get to the steady state
+    size_t warmup = perTimeout * 2;
+    for (size_t i = 0;  i < warmup;  ++i)
+        step(i);
+
+    size_t size = map.size();
+    Date start = Date::now();
+    for (size_t i = warmup;  i < warmup + auctions;  ++i)
+        step(i);
+    double elapsed = Date::now().secondsSince(start);
+
+    cout << name << ": " << size << " live, "
+         << elapsed / auctions * 1e9 << " ns/auction" << endl;
+}
+
+/* Time to expire numEntries entries 20 at a time, after an entry that
+   times out in farEntry seconds or with none if it's 0. */
+double expireNear(double farEntry, size_t numEntries)
+{
+    HashedTimeoutMap<Id, Info> map;
+    Date start = Date::now();
+
+    if (farEntry)
+        map.insert(Id(-1), Info(), start.plusSeconds(farEntry));
+    for (size_t i = 0;  i < numEntries;  ++i)
+        map.insert(Id(i), Info(), start.plusSeconds(i * 0.00005));
+
+    size_t expired = 0;
+    Date before = Date::now();
+    for (size_t ms = 1;  ms <= numEntries / 20;  ++ms)
+        expired += Ops<HashedTimeoutMap<Id, Info> >::expire(
+                map, start.plusSeconds(ms * 0.001));
+    double elapsed = Date::now().secondsSince(before);
+
+    if (expired != numEntries)
+        cerr << "expired " << expired << " of " << numEntries << endl;
+    return elapsed;
+}
+
+} // file scope
+
+int main(int argc, char ** argv)
+{
+    using namespace boost::program_options;
+
+    vector<size_t> sizes = { 50000, 500000 };
+    size_t auctions = 2000000;
+
+    options_description options("Options");
+    options.add_options()
+        ("live,l", value(&sizes)->multitoken(),
+         "number of live entries to test with")
+        ("auctions,n", value(&auctions),
+         "number of auctions to time")
+        ("help,h", "print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(options).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << options << endl;
+        return 1;
+    }
+
+    mt19937_64 rng(1);
+
+    for (size_t live: sizes) {
+        // Distinct ids for about 3 timeouts worth of auctions, like the
+        // 128 bit ids most exchanges use.
+        vector<Id> ids;
+        for (size_t i = 0;  i < live * 4;  ++i) {
+            Id id;
+            id.type = Id::UUID;
+            id.val1 = rng();
+            id.val2 = rng();
+            ids.push_back(id);
+        }
+
+        bench<TimeoutMap<Id, Info> >
+            ("TimeoutMap", live, auctions, ids);
+        bench<HashedTimeoutMap<Id, Info> >
+            ("HashedTimeoutMap", live, auctions, ids);
+        bench<RTBKIT::TimeoutMap<Id, Info> >
+            ("post auction TimeoutMap", live, auctions, ids);
+    }
+
+    size_t near = 50000;
+    double nearOnly = expireNear(0, near);
+
+    // The win timeout of the post auction loop, and no timeout at all
+    for (double farEntry: { 3600.0, double(INFINITY) }) {
+        cout << "HashedTimeoutMap expiry of " << near << " near entries: "
+             << nearOnly * 1e3 << " ms alone, "
+             << expireNear(farEntry, near) * 1e3 << " ms after an entry in "
+             << farEntry << "s" << endl;
+    }
+
+    return 0;
+}
@@ -110,7 +110,7 @@ struct AuctionJS
                 string s = cstr(value);
                 getShared(info.This())->request
                     .reset(BidRequest::parse("datacratic", s));
-                getShared(info.This())->requestStr = s;
+                getShared(info.This())->setRequestStr(s, "datacratic");
             }
             else {
                 Json::Value request = JS::fromJS(value);
@@ -118,7 +118,7 @@ struct AuctionJS
                 string s = request.toString();
                 getShared(info.This())->request
                     .reset(BidRequest::parse("datacratic", s));
-                getShared(info.This())->requestStr = s;
+                getShared(info.This())->setRequestStr(s, "datacratic");
 
             }
         } HANDLE_JS_EXCEPTIONS_SETTER;
@@ -129,7 +129,7 @@ struct AuctionJS
                   const v8::AccessorInfo & info)
     {
         try {
-            return JS::toJS(getShared(info.This())->requestStr);
+            return JS::toJS(getShared(info.This())->requestStr());
         } HANDLE_JS_EXCEPTIONS;
     }
 
@@ -143,7 +143,7 @@ struct AuctionJS
             string s = request.toString();
             getShared(info.This())->request
                 .reset(BidRequest::parse("datacratic", s));
-            getShared(info.This())->requestStr = s;
+            getShared(info.This())->setRequestStr(s, "datacratic");
 
         } HANDLE_JS_EXCEPTIONS_SETTER;
     }
@@ -188,7 +188,7 @@ struct AuctionJS
             std::shared_ptr<BidRequest> newRequest
                 (BidRequest::parse("datacratic", s));
             getShared(args)->request = newRequest;
-            getShared(args)->requestStr = s;
+            getShared(args)->setRequestStr(s, "datacratic");
             return args.This();
         } HANDLE_JS_EXCEPTIONS;
     }
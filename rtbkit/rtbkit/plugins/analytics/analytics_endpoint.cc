@@ -14,6 +14,11 @@
 #include "soa/service/rest_request_binding.h"
 #include "soa/jsoncpp/reader.h"
 #include "jml/arch/timers.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 using namespace std;
 using namespace Datacratic;
@@ -80,6 +85,24 @@ init()
                     JsonParam<string>("event", "event to publish")
             );
 
+    RestRequestRouter::OnProcessRequest eventsRoute
+        = [=] (const RestServiceEndpoint::ConnectionId & connection,
+                const RestRequest & request,
+                const RestRequestParsingContext & context) {
+            try {
+                size_t numEvents = addEvents(request);
+                connection.sendResponse(200, Json::Value(Json::UInt(numEvents)));
+            } catch (const std::exception & exc) {
+                connection.sendErrorResponse(400, exc.what());
+            }
+            return RestRequestRouter::MR_YES;
+        };
+
+    versionNode.addRoute("/events", "POST",
+                         "Add a batch of events to the logs, one per line as "
+                         "channel<TAB>event, optionally gzipped.",
+                         eventsRoute, Json::Value());
+
     addRouteSyncReturn(versionNode,
                     "/channels",
                     {"GET"},
@@ -165,6 +188,53 @@ addEvent(const string & channel, const string & event) const
     return print(channel, event);
 }
 
+size_t
+AnalyticsRestEndpoint::
+addEvents(const RestRequest & request) const
+{
+    string body;
+    if (request.header.tryGetHeader("content-encoding") == "gzip") {
+        namespace io = boost::iostreams;
+        io::filtering_istream stream;
+        stream.push(io::gzip_decompressor());
+        stream.push(io::array_source(request.payload.data(),
+                                     request.payload.size()));
+        io::copy(stream, io::back_inserter(body));
+    }
+    else body = request.payload;
+
+    size_t numEvents = 0;
+    string channel, event;
+
+    for (size_t pos = 0;  pos < body.size();) {
+        size_t eol = body.find('\n', pos);
+        if (eol == string::npos) eol = body.size();
+
+        size_t tab = body.find('\t', pos);
+        if (tab == string::npos || tab > eol)
+            throw ML::Exception("event without a channel");
+
+        channel.assign(body, pos, tab - pos);
+
+        // Undo the escaping of the newlines and backslashes
+        event.clear();
+        for (size_t i = tab + 1;  i < eol;  ++i) {
+            char c = body[i];
+            if (c == '\\' && i + 1 < eol) {
+                c = body[++i];
+                if (c == 'n') c = '\n';
+            }
+            event += c;
+        }
+
+        addEvent(channel, event);
+        ++numEvents;
+        pos = eol + 1;
+    }
+
+    return numEvents;
+}
+
 Json::Value
 AnalyticsRestEndpoint::
 listChannels() const
@@ -54,6 +54,11 @@ private:
     std::string addEvent(const std::string & channel,
                          const std::string & event) const;
 
+    /** Adds each event of a batch sent by an AnalyticsPublisher.  Returns
+        the number of events that were in the batch.
+    */
+    size_t addEvents(const Datacratic::RestRequest & request) const;
+
     std::string print(const std::string & channel,
                       const std::string & event) const;
 
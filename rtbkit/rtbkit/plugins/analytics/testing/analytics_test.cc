@@ -9,6 +9,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include "jml/arch/timers.h"
+#include <boost/thread/thread.hpp>
 
 #include "rtbkit/plugins/analytics/analytics_endpoint.h"
 #include "rtbkit/common/analytics_publisher.h"
@@ -17,19 +18,20 @@ using namespace std;
 using namespace ML;
 using namespace Datacratic;
 
-void setUpEndpoint(shared_ptr<AnalyticsRestEndpoint> & analyticsEndpoint)
+void setUpEndpoint(shared_ptr<AnalyticsRestEndpoint> & analyticsEndpoint,
+                   shared_ptr<ServiceProxies> proxies = make_shared<ServiceProxies>())
 {
-    auto proxies = std::make_shared<ServiceProxies> ();
     analyticsEndpoint = make_shared<AnalyticsRestEndpoint> (proxies, "analytics");
     analyticsEndpoint->init();
     analyticsEndpoint->bindTcp(40000);
     analyticsEndpoint->start();
 }
 
-void setUpClient(shared_ptr<AnalyticsPublisher> & analyticsClient)
+void setUpClient(shared_ptr<AnalyticsPublisher> & analyticsClient,
+                 bool compress = false)
 {
     analyticsClient = make_shared<AnalyticsPublisher> ();
-    analyticsClient->init("http://127.0.0.1:40000", 1);
+    analyticsClient->init("http://127.0.0.1:40000", 1, 0.1, compress);
     analyticsClient->start();
 }
 
@@ -109,3 +111,45 @@ BOOST_AUTO_TEST_CASE( analytics_filter_sync_test )
     analyticsEndpoint->shutdown();
 
 }
+
+BOOST_AUTO_TEST_CASE( analytics_batched_events_test )
+{
+    auto proxies = make_shared<ServiceProxies>();
+
+    shared_ptr<AnalyticsRestEndpoint> analyticsEndpoint;
+    setUpEndpoint(analyticsEndpoint, proxies);
+
+    shared_ptr<AnalyticsPublisher> analyticsClient;
+    setUpClient(analyticsClient, true /* compress */);
+
+    analyticsEndpoint->enableChannel("Test");
+
+    // wait for the heartbeat, then for the channels to be synced
+    ML::sleep(2.0);
+    analyticsClient->syncChannelFilters();
+    ML::sleep(0.5);
+
+    enum { THREADS = 4, EVENTS = 1000 };
+
+    boost::thread_group threads;
+    for (unsigned i = 0;  i < THREADS;  ++i) {
+        threads.create_thread([&] () {
+                for (unsigned j = 0;  j < EVENTS;  ++j) {
+                    analyticsClient->publish("Test", "event", j,
+                                             "multi\nline \\ event");
+                    analyticsClient->publish("Disabled", "event", j);
+                }
+            });
+    }
+    threads.join_all();
+
+    ML::sleep(1.0);
+
+    auto events = proxies->events->get(cerr);
+    BOOST_CHECK_EQUAL(events["analytics.channel.Test"], THREADS * EVENTS);
+    BOOST_CHECK_EQUAL(events.count("analytics.channel.Disabled"), 0);
+    BOOST_CHECK_EQUAL(analyticsClient->numDropped.load(), 0);
+
+    analyticsClient->shutdown();
+    analyticsEndpoint->shutdown();
+}
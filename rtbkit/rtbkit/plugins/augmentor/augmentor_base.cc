@@ -36,6 +36,9 @@ Augmentor(const std::string & augmentorName,
           std::shared_ptr<ServiceProxies> proxies)
     : ServiceBase(serviceName, proxies),
       augmentorName(augmentorName),
+      numThreads(1),
+      hosted(false),
+      connected(false),
       toRouters(getZmqContext()),
       responseQueue(QueueSize),
       requestQueue(QueueSize),
@@ -50,6 +53,9 @@ Augmentor(const std::string & augmentorName,
           ServiceBase& parent)
     : ServiceBase(serviceName, parent),
       augmentorName(augmentorName),
+      numThreads(1),
+      hosted(false),
+      connected(false),
       toRouters(getZmqContext()),
       responseQueue(QueueSize),
       requestQueue(QueueSize),
@@ -64,10 +70,19 @@ Augmentor::
     shutdown();
 }
 
+void
+Augmentor::
+setRequestFields(BidRequestFields fields)
+{
+    requestFields = fields;
+}
+
 void
 Augmentor::
 init(int numThreads)
 {
+    this->numThreads = numThreads;
+
     responseQueue.onEvent = [=] (const Response& resp)
         {
             const AugmentationRequest& request = resp.first;
@@ -87,11 +102,32 @@ init(int numThreads)
 
     addSource("Augmentor::responseQueue", responseQueue);
 
+    loopMonitor.init();
+    loopMonitor.addMessageLoop("augmentor", this);
+    loopMonitor.onLoadChange = [=] (double) {
+        recordLevel(this->loadStabilizer.shedProbability(), "shedProbability");
+    };
+    addSource("Augmentor::loopMonitor", loopMonitor);
+}
+
+/** Deferred until start so that a hosted augmentor never shows up in front
+    of the routers.
+*/
+void
+Augmentor::
+connectToRouters()
+{
     toRouters.init(getServices()->config, serviceName());
 
     toRouters.connectHandler = [=] (const std::string & newRouter)
         {
-            toRouters.sendMessage(newRouter, "CONFIG", "1.0", augmentorName);
+            if (requestFields.empty())
+                toRouters.sendMessage(newRouter, "CONFIG", "1.0", augmentorName);
+
+            // -1 leaves maxInFlight to the router's default.
+            else toRouters.sendMessage(
+                    newRouter, "CONFIG", "1.0", augmentorName,
+                    "-1", requestFields.toString());
             recordHit("messages.CONFIG");
         };
 
@@ -116,21 +152,25 @@ init(int numThreads)
     for (size_t i = 0; i < numThreads; ++i)
         workers.create_thread([=] { this->runWorker(); });
 
-    loopMonitor.init();
-    loopMonitor.addMessageLoop("augmentor", this);
-    loopMonitor.onLoadChange = [=] (double) {
-        recordLevel(this->loadStabilizer.shedProbability(), "shedProbability");
-    };
-    addSource("Augmentor::loopMonitor", loopMonitor);
+    connected = true;
 }
 
 void
 Augmentor::
 start()
 {
+    if (!hosted) connectToRouters();
     MessageLoop::start();
 }
 
+void
+Augmentor::
+startHosted()
+{
+    hosted = true;
+    start();
+}
+
 void
 Augmentor::
 shutdown()
@@ -138,13 +178,19 @@ shutdown()
     stopWorkers = true;
     workers.join_all();
     MessageLoop::shutdown();
-    toRouters.shutdown();
+    if (connected) toRouters.shutdown();
 }
 
 void
 Augmentor::
 respond(const AugmentationRequest & request, const AugmentationList & response)
 {
+    if (request.onHostedResponse) {
+        request.onHostedResponse(response);
+        recordHit("messages.RESPONSE");
+        return;
+    }
+
     if (responseQueue.tryPush(make_pair(request, response)))
         return;
 
@@ -163,9 +209,17 @@ parseMessage(AugmentationRequest& request, Message& message)
     request.augmentor = std::move(message.second.at(2));
     request.id = Id(std::move(message.second.at(3)));
 
-    const string & brSource = std::move(message.second.at(4));
-    const string & brStr = std::move(message.second.at(5));
-    request.bidRequest.reset(BidRequest::parse(brSource, brStr));
+    const string & brSource = message.second.at(4);
+    string & brStr = message.second.at(5);
+
+    if (brSource == BidRequestProjectionFormat) {
+        request.bidRequest.reset();
+        request.view = BidRequestView(std::move(brStr));
+    }
+    else {
+        request.bidRequest.reset(BidRequest::parse(brSource, brStr));
+        request.view = BidRequestView(request.bidRequest);
+    }
 
     istringstream agentsStr(message.second.at(6));
     ML::DB::Store_Reader reader(agentsStr);
@@ -175,6 +229,42 @@ parseMessage(AugmentationRequest& request, Message& message)
     request.startTime = Date::fromSecondsSinceEpoch(strtod(startTimeStr.c_str(), 0));
 }
 
+void
+Augmentor::
+augmentHosted(
+        const Id & auctionId,
+        const std::shared_ptr<BidRequest> & bidRequest,
+        std::vector<std::string> agents,
+        OnResponse onResponse)
+{
+    ExcCheck(handleRequest, "No request callback set");
+    recordHit("messages.AUGMENT");
+
+    AugmentationRequest request;
+    request.augmentor = augmentorName;
+    request.timeAvailableMs = 0.05;
+    request.id = auctionId;
+    request.bidRequest = bidRequest;
+    request.view = BidRequestView(bidRequest);
+    request.agents = std::move(agents);
+    request.startTime = Date::now();
+    request.onHostedResponse = std::move(onResponse);
+
+    if (loadStabilizer.shedMessage()) {
+        recordHit("shedMessages");
+        respond(request, AugmentationList());
+        return;
+    }
+
+    // The request is abandoned and will time out in the router.
+    try { handleRequest(request); }
+    catch (const std::exception& ex) {
+        cerr << "error while handling hosted request "
+            << auctionId << ": " << ex.what() << endl;
+        recordHit("hostedRequestErrors");
+    }
+}
+
 void
 Augmentor::
 handleRouterMessage(const std::string & router, std::vector<std::string> & message)
@@ -15,6 +15,8 @@
 #include "soa/types/id.h"
 #include "rtbkit/common/auction.h"
 #include "rtbkit/common/augmentation.h"
+#include "rtbkit/common/bid_request_projection.h"
+#include "rtbkit/common/hosted_augmentor.h"
 #include "soa/service/service_base.h"
 #include "soa/service/zmq_utils.h"
 #include "soa/service/socket_per_thread.h"
@@ -46,9 +48,13 @@ struct AugmentationRequest
     std::string router;                       // Router to respond to
     Id id;                                    // Auction id
     std::shared_ptr<BidRequest> bidRequest;   // Bid request to augment
+    BidRequestView view;                      // Fields of the bid request
     std::vector<std::string> agents;          // Agents availble to bid
     double timeAvailableMs;                   // Time to respond
     Date startTime;                           // Start of the latency timer
+
+    // Set when the augmentor is hosted in the router; answers the request.
+    HostedAugmentor::OnResponse onHostedResponse;
 };
 
 
@@ -58,9 +64,14 @@ struct AugmentationRequest
 
 /** Class that implements a bid request augmentor.  Real augmentors should
     build on top of this class.
+
+    The augmentor either runs as its own service, connecting to the routers
+    when started, or is hosted inside a router (see HostedAugmentor) in
+    which case requests are handled directly on the router's thread.
 */
 
-struct Augmentor : public ServiceBase, public MessageLoop {
+struct Augmentor :
+        public ServiceBase, public MessageLoop, public HostedAugmentor {
 
     Augmentor(const std::string & augmentorName,
                   const std::string & serviceName,
@@ -72,6 +83,15 @@ struct Augmentor : public ServiceBase, public MessageLoop {
 
     ~Augmentor();
 
+    /** Restricts the bid request sent by the routers to the given fields.
+        Must be called before init.
+
+        When set, requests carry a projection which is only readable through
+        AugmentationRequest::view and bidRequest is left null.  Augmentors
+        that don't call this get the full bid request in both.
+    */
+    void setRequestFields(BidRequestFields fields);
+
     void init(int numThreads = 1);
     void start();
     void shutdown();
@@ -80,6 +100,16 @@ struct Augmentor : public ServiceBase, public MessageLoop {
     void respond(const AugmentationRequest & request,
                  const AugmentationList & response);
 
+    /* HostedAugmentor */
+    virtual std::string hostedName() const { return augmentorName; }
+    virtual void startHosted();
+    virtual void shutdownHosted() { shutdown(); }
+    virtual void augmentHosted(
+            const Id & auctionId,
+            const std::shared_ptr<BidRequest> & bidRequest,
+            std::vector<std::string> agents,
+            OnResponse onResponse);
+
     double sampleLoad() { return loopMonitor.sampleLoad().load; }
     double shedProbability() { return loadStabilizer.shedProbability(); }
 
@@ -91,6 +121,10 @@ protected:
 
 private:
     std::string augmentorName; // This can differ from the servicenName!
+    BidRequestFields requestFields;
+    int numThreads;
+    bool hosted;
+    bool connected;
 
     ZmqMultipleNamedClientBusProxy toRouters;
 
@@ -106,6 +140,7 @@ private:
     LoopMonitor loopMonitor;
     LoadStabilizer loadStabilizer;
 
+    void connectToRouters();
     void runWorker();
     void handleRouterMessage(const std::string & router,
                              std::vector<std::string> & message);
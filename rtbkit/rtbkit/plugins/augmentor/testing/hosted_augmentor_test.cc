@@ -0,0 +1,101 @@
+/** hosted_augmentor_test.cc                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic.  All rights reserved.
+
+    Tests for augmentors hosted in the router's process.
+
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/plugins/augmentor/augmentor_base.h"
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+
+std::shared_ptr<BidRequest> makeRequest()
+{
+    auto br = std::make_shared<BidRequest>();
+    br->auctionId = Id("auction1");
+    br->exchange = "test";
+    return br;
+}
+
+BOOST_AUTO_TEST_CASE( test_sync_hosted )
+{
+    auto proxies = make_shared<ServiceProxies>();
+    auto br = makeRequest();
+
+    SyncAugmentor aug("test-aug", "test-aug", proxies);
+    aug.init();
+    aug.doRequest = [&] (const AugmentationRequest& req) {
+        BOOST_CHECK_EQUAL(req.augmentor, "test-aug");
+        BOOST_CHECK_EQUAL(req.id, Id("auction1"));
+        BOOST_CHECK_EQUAL(req.agents.size(), 2);
+
+        // No copy of the bid request was made.
+        BOOST_CHECK_EQUAL(req.bidRequest.get(), br.get());
+        BOOST_CHECK_EQUAL(req.view.exchange(), "test");
+
+        AugmentationList result;
+        result[AccountKey("a:b")].tags.insert("pass");
+        return result;
+    };
+    aug.startHosted();
+
+    BOOST_CHECK_EQUAL(aug.hostedName(), "test-aug");
+
+    int responses = 0;
+    aug.augmentHosted(Id("auction1"), br, { "agent1", "agent2" },
+            [&] (const AugmentationList& result) {
+                responses++;
+                BOOST_CHECK_EQUAL(result.size(), 1);
+            });
+
+    // Sync augmentors answer on the calling thread.
+    BOOST_CHECK_EQUAL(responses, 1);
+
+    aug.shutdownHosted();
+}
+
+BOOST_AUTO_TEST_CASE( test_async_hosted )
+{
+    auto proxies = make_shared<ServiceProxies>();
+
+    AsyncAugmentor aug("test-aug", "test-aug", proxies);
+    aug.init();
+
+    vector<thread> threads;
+    aug.doRequest = [&] (const AugmentationRequest& req,
+                         AsyncAugmentor::SendResponseCB sendResponse)
+    {
+        threads.emplace_back([=] {
+                    AugmentationList result;
+                    result[AccountKey("a:b")].tags.insert(req.agents.at(0));
+                    sendResponse(result);
+                });
+    };
+    aug.startHosted();
+
+    enum { Requests = 16 };
+    std::atomic<int> responses(0);
+
+    for (size_t i = 0; i < Requests; ++i) {
+        aug.augmentHosted(Id(i), makeRequest(), { "agent" },
+                [&] (const AugmentationList& result) {
+                    BOOST_CHECK_EQUAL(result.size(), 1);
+                    responses++;
+                });
+    }
+
+    for (auto& th : threads) th.join();
+    BOOST_CHECK_EQUAL(responses, Requests);
+
+    aug.shutdownHosted();
+}
@@ -0,0 +1,188 @@
+/* openrtb_bid_request_writer.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Prints a BidRequest as OpenRTB without converting it first.
+*/
+
+#include "openrtb_bid_request_writer.h"
+#include "openrtb_bid_request_parser.h"
+#include "rtbkit/openrtb/openrtb_parsing.h"
+#include "jml/utils/exc_assert.h"
+
+using namespace std;
+using namespace Datacratic;
+
+namespace RTBKIT {
+
+namespace {
+
+typedef ValueDescription::FieldDescription FieldDescription;
+
+const DefaultDescription<OpenRTB::BidRequest> & requestDescription()
+{
+    static const DefaultDescription<OpenRTB::BidRequest> desc;
+    return desc;
+}
+
+const DefaultDescription<OpenRTB::Impression> & impressionDescription()
+{
+    static const DefaultDescription<OpenRTB::Impression> desc;
+    return desc;
+}
+
+/** Same as what StructureDescription::printJson() does for each field. */
+void printField(const FieldDescription & field, const void * value,
+                JsonPrintingContext & context)
+{
+    if (field.description->isDefault(value))
+        return;
+
+    context.startMember(field.fieldName);
+    field.description->printJson(value, context);
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* OPENRTB BID REQUEST WRITER                                                */
+/*****************************************************************************/
+
+OpenRTB::BidRequest
+OpenRTBBidRequestWriter::
+shell(const BidRequest & br)
+{
+    OpenRTB::BidRequest result;
+
+    result.id = br.auctionId;
+    result.at = br.auctionType;
+    result.tmax = br.timeAvailableMs;
+
+    result.imp.reserve(br.imp.size());
+    for (const auto & spot : br.imp) {
+        if (spot.banner)
+            ExcAssertEqual(spot.banner->h.size(), spot.banner->w.size());
+
+        OpenRTB::Impression imp;
+        imp.id = spot.id;
+        imp.ext = spot.ext;
+        result.imp.push_back(std::move(imp));
+    }
+
+    if (br.site && br.app)
+        THROW(OpenRTBBidRequestLogs::error) << "OpenRTB::BidRequest cannot have site and app." << endl;
+
+    result.cur.reserve(br.bidCurrency.size());
+    for (const auto & cur : br.bidCurrency)
+        result.cur.push_back(toString(cur));
+
+    result.ext = br.ext;
+
+    return result;
+}
+
+void
+OpenRTBBidRequestWriter::
+print(const OpenRTB::BidRequest & shell,
+      const BidRequest & br,
+      JsonPrintingContext & context)
+{
+    const auto & desc = requestDescription();
+
+    static const FieldDescription & imp = desc.getField("imp");
+    static const FieldDescription & site = desc.getField("site");
+    static const FieldDescription & app = desc.getField("app");
+    static const FieldDescription & device = desc.getField("device");
+    static const FieldDescription & user = desc.getField("user");
+    static const FieldDescription & bcat = desc.getField("bcat");
+    static const FieldDescription & badv = desc.getField("badv");
+    static const FieldDescription & unparseable = desc.getField("unparseable");
+
+    ExcAssertEqual(shell.imp.size(), br.imp.size());
+
+    context.startObject();
+
+    for (const auto & it : desc.orderedFields) {
+        const FieldDescription & field = it->second;
+
+        if (&field == &imp) {
+            if (br.imp.empty())
+                continue;
+
+            context.startMember(field.fieldName);
+            context.startArray(br.imp.size());
+            for (size_t i = 0;  i < br.imp.size();  ++i) {
+                context.newArrayElement();
+                printImpression(shell.imp[i], br.imp[i], context);
+            }
+            context.endArray();
+        }
+        else if (&field == &site)
+            printField(field, &br.site, context);
+        else if (&field == &app)
+            printField(field, &br.app, context);
+        else if (&field == &device)
+            printField(field, &br.device, context);
+        else if (&field == &user)
+            printField(field, &br.user, context);
+        else if (&field == &bcat)
+            printField(field, &br.blockedCategories, context);
+        else if (&field == &badv)
+            printField(field, &br.badv, context);
+        else if (&field == &unparseable)
+            printField(field, &br.unparseable, context);
+        else
+            printField(field, addOffset(&shell, field.offset), context);
+    }
+
+    context.endObject();
+}
+
+void
+OpenRTBBidRequestWriter::
+printImpression(const OpenRTB::Impression & shell,
+                const AdSpot & spot,
+                JsonPrintingContext & context)
+{
+    const auto & desc = impressionDescription();
+
+    static const FieldDescription & id = desc.getField("id");
+    static const FieldDescription & banner = desc.getField("banner");
+    static const FieldDescription & pmp = desc.getField("pmp");
+    static const FieldDescription & ext = desc.getField("ext");
+
+    const OpenRTB::Impression & imp = spot;
+
+    context.startObject();
+
+    for (const auto & it : desc.orderedFields) {
+        const FieldDescription & field = it->second;
+
+        // toBidRequest() targets 2.1, which doesn't have private marketplaces
+        if (&field == &pmp)
+            continue;
+
+        if (&field == &id)
+            printField(field, &shell.id, context);
+        else if (&field == &ext)
+            printField(field, &shell.ext, context);
+        else if (&field == &banner && imp.banner && imp.banner->h.size() > 1) {
+            // openrtb only supports a single value in the h and w fields so
+            // any extra values are relocated to the ext field.
+            OpenRTB::Optional<OpenRTB::Banner> copy;
+            copy.reset(new OpenRTB::Banner(*imp.banner));
+            for (const auto & h : imp.banner->h) copy->ext["h"].append(h);
+            for (const auto & w : imp.banner->w) copy->ext["w"].append(w);
+            copy->h.resize(1);
+            copy->w.resize(1);
+
+            printField(field, &copy, context);
+        }
+        else
+            printField(field, addOffset(&imp, field.offset), context);
+    }
+
+    context.endObject();
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,57 @@
+/* openrtb_bid_request_writer.h                                -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Prints a BidRequest as OpenRTB without converting it first.
+*/
+
+#pragma once
+
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/openrtb/openrtb.h"
+#include "soa/types/json_printing.h"
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* OPENRTB BID REQUEST WRITER                                                */
+/*****************************************************************************/
+
+/** Writes a BidRequest as an OpenRTB 2.x document without going through
+    OpenRTBBidRequestParser::toBidRequest(), which deep copies the site, app,
+    device, user and every impression of the request.
+
+    shell() returns the small part of that conversion that senders usually
+    rewrite before printing (id, at, tmax, cur, ext and the id and ext of
+    each impression).  Everything else is read from the original request by
+    print(), so that
+
+        auto shell = OpenRTBBidRequestWriter::shell(br);
+        ... modify shell.tmax, shell.ext, shell.imp[i].ext ...
+        OpenRTBBidRequestWriter::print(shell, br, context);
+
+    gives the same document as toBidRequest(br) with the same modifications
+    printed through DefaultDescription<OpenRTB::BidRequest>.
+*/
+
+struct OpenRTBBidRequestWriter {
+
+    /** Build the shell of br.  Like toBidRequest(), throws if br has both
+        a site and an app.
+    */
+    static OpenRTB::BidRequest shell(const BidRequest & br);
+
+    /** Print the OpenRTB request made of br and its (modified) shell. */
+    static void print(const OpenRTB::BidRequest & shell,
+                      const BidRequest & br,
+                      Datacratic::JsonPrintingContext & context);
+
+    /** Print the OpenRTB impression made of spot and the matching
+        impression of the shell.
+    */
+    static void printImpression(const OpenRTB::Impression & shell,
+                                const AdSpot & spot,
+                                Datacratic::JsonPrintingContext & context);
+};
+
+} // namespace RTBKIT
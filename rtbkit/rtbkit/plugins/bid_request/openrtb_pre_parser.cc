@@ -0,0 +1,519 @@
+/* openrtb_pre_parser.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Scanner for the fields of an OpenRTB bid request that the pre-filters
+   look at.
+*/
+
+#include "openrtb_pre_parser.h"
+#include "rtbkit/openrtb/openrtb.h"
+#include <boost/lexical_cast.hpp>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace Datacratic;
+
+namespace RTBKIT {
+
+namespace {
+
+/** Walks through JSON text without building anything.  Every method
+    returns false on anything unexpected, after which the scan is given up.
+*/
+struct Scanner {
+    Scanner(const char * start, const char * end)
+        : p(start), end(end)
+    {
+    }
+
+    const char * p;
+    const char * end;
+
+    void skipWhitespace()
+    {
+        while (p != end && (*p == ' ' || *p == '\n' || *p == '\r'
+                            || *p == '\t'))
+            ++p;
+    }
+
+    bool match(char c)
+    {
+        skipWhitespace();
+        if (p == end || *p != c)
+            return false;
+        ++p;
+        return true;
+    }
+
+    bool skipString()
+    {
+        if (!match('"'))
+            return false;
+        for (; p != end;  ++p) {
+            if (*p == '\\') {
+                if (++p == end)
+                    return false;
+            }
+            else if (*p == '"') {
+                ++p;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Skips a value of any type.  Brackets aren't checked to match; the
+        full parser will find that out if the request goes through.
+    */
+    bool skipValue()
+    {
+        skipWhitespace();
+        if (p == end)
+            return false;
+
+        if (*p == '"')
+            return skipString();
+
+        if (*p == '{' || *p == '[') {
+            int depth = 0;
+            while (p != end) {
+                char c = *p;
+                if (c == '"') {
+                    if (!skipString())
+                        return false;
+                    continue;
+                }
+                ++p;
+                if (c == '{' || c == '[')
+                    ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        const char * start = p;
+        while (p != end && *p != ',' && *p != '}' && *p != ']'
+               && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+            ++p;
+        return p != start;
+    }
+
+    static void appendUtf8(string & out, unsigned code)
+    {
+        if (code < 0x80)
+            out += char(code);
+        else if (code < 0x800) {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000) {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    bool hex4(unsigned & code)
+    {
+        if (end - p < 4)
+            return false;
+        code = 0;
+        for (int i = 0;  i < 4;  ++i, ++p) {
+            char c = *p;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool expectString(string & out)
+    {
+        if (!match('"'))
+            return false;
+
+        out.clear();
+        const char * start = p;
+        while (p != end && *p != '"' && *p != '\\')
+            ++p;
+        out.append(start, p);
+
+        while (p != end) {
+            char c = *p++;
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (p == end)
+                return false;
+            switch (*p++) {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!hex4(code))
+                    return false;
+                if (code >= 0xd800 && code < 0xdc00) {
+                    unsigned low;
+                    if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                        return false;
+                    p += 2;
+                    if (!hex4(low) || low < 0xdc00 || low >= 0xe000)
+                        return false;
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    bool expectInt(int & out)
+    {
+        skipWhitespace();
+        const char * start = p;
+        if (p != end && *p == '-')
+            ++p;
+        while (p != end && *p >= '0' && *p <= '9')
+            ++p;
+        if (p == start || p - start > 9)
+            return false;
+        out = atoi(string(start, p).c_str());
+        return true;
+    }
+
+    /** Ids may be written as strings or as integers. */
+    bool expectId(Id & out)
+    {
+        skipWhitespace();
+        string str;
+        if (p != end && *p == '"') {
+            if (!expectString(str))
+                return false;
+        }
+        else {
+            const char * start = p;
+            while (p != end && *p >= '0' && *p <= '9')
+                ++p;
+            if (p == start)
+                return false;
+            str.assign(start, p);
+        }
+        out = Id(str);
+        return true;
+    }
+
+    /** Calls onKey(key, length) on each key of an object, which has to
+        consume the value.  Keys with escapes are given up on rather than
+        risking to miss one of the fields.
+    */
+    template<typename OnKey>
+    bool expectObject(const OnKey & onKey)
+    {
+        if (!match('{'))
+            return false;
+        if (match('}'))
+            return true;
+
+        for (;;) {
+            if (!match('"'))
+                return false;
+            const char * key = p;
+            while (p != end && *p != '"' && *p != '\\')
+                ++p;
+            if (p == end || *p != '"')
+                return false;
+            size_t length = p - key;
+            ++p;
+
+            if (!match(':') || !onKey(key, length))
+                return false;
+
+            if (match(','))
+                continue;
+            return match('}');
+        }
+    }
+
+    template<typename OnElement>
+    bool expectArray(const OnElement & onElement)
+    {
+        if (!match('['))
+            return false;
+        if (match(']'))
+            return true;
+
+        for (;;) {
+            if (!onElement())
+                return false;
+            if (match(','))
+                continue;
+            return match(']');
+        }
+    }
+};
+
+bool isKey(const char * key, size_t length, const char * name)
+{
+    return strlen(name) == length && memcmp(key, name, length) == 0;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* OPENRTB PRE PARSER                                                        */
+/*****************************************************************************/
+
+unsigned
+OpenRTBPreParser::
+parse(const std::string & payload,
+      const std::string & openRtbVersion,
+      const std::string & exchange,
+      BidRequest & request)
+{
+    // OpenRTBBidRequestParser2point1::onVideo() resets the out of range
+    // linearities but 2.2 keeps them.
+    bool clampLinearity;
+    if (openRtbVersion == "2.0" || openRtbVersion == "2.1")
+        clampLinearity = true;
+    else if (openRtbVersion == "2.2")
+        clampLinearity = false;
+    else return 0;
+
+    Scanner scanner(payload.data(), payload.data() + payload.size());
+    string value;
+
+    // Geo fields are only applied once the whole object was seen as they
+    // take precedence over each other regardless of their order.
+    string country, region, regionfips104, city, zip, metro;
+
+    auto onGeo = [&] (const char * key, size_t length) -> bool
+        {
+            string * field = 0;
+            if (isKey(key, length, "country")) field = &country;
+            else if (isKey(key, length, "region")) field = &region;
+            else if (isKey(key, length, "regionfips104")) field = &regionfips104;
+            else if (isKey(key, length, "city")) field = &city;
+            else if (isKey(key, length, "zip")) field = &zip;
+            else if (isKey(key, length, "metro")) field = &metro;
+            else return scanner.skipValue();
+            return scanner.expectString(*field);
+        };
+
+    auto onVideo = [&] (const char * key, size_t length) -> bool
+        {
+            if (!isKey(key, length, "linearity"))
+                return scanner.skipValue();
+            return scanner.expectInt(request.imp.back().video->linearity.val);
+        };
+
+    auto onImp = [&] (const char * key, size_t length) -> bool
+        {
+            if (!isKey(key, length, "video"))
+                return scanner.skipValue();
+            request.imp.back().video.reset(new OpenRTB::Video());
+            return scanner.expectObject(onVideo);
+        };
+
+    // Both the site and the app have one
+    OpenRTB::Publisher * publisher = 0;
+
+    auto onPublisher = [&] (const char * key, size_t length) -> bool
+        {
+            if (isKey(key, length, "id"))
+                return scanner.expectId(publisher->id);
+            if (!isKey(key, length, "domain"))
+                return scanner.skipValue();
+            if (!scanner.expectString(value))
+                return false;
+            publisher->domain = Utf8String(value);
+            return true;
+        };
+
+    auto onSite = [&] (const char * key, size_t length) -> bool
+        {
+            OpenRTB::Site & site = *request.site;
+            if (isKey(key, length, "id"))
+                return scanner.expectId(site.id);
+            if (isKey(key, length, "publisher")) {
+                site.publisher.reset(new OpenRTB::Publisher());
+                publisher = site.publisher.get();
+                return scanner.expectObject(onPublisher);
+            }
+            if (isKey(key, length, "domain")) {
+                if (!scanner.expectString(value))
+                    return false;
+                site.domain = Utf8String(value);
+                return true;
+            }
+            if (isKey(key, length, "page")) {
+                if (!scanner.expectString(value))
+                    return false;
+                site.page = Url(Utf8String(value));
+                return true;
+            }
+            return scanner.skipValue();
+        };
+
+    auto onApp = [&] (const char * key, size_t length) -> bool
+        {
+            OpenRTB::App & app = *request.app;
+            if (isKey(key, length, "id"))
+                return scanner.expectId(app.id);
+            if (isKey(key, length, "bundle")) {
+                if (!scanner.expectString(value))
+                    return false;
+                app.bundle = Utf8String(value);
+                return true;
+            }
+            if (isKey(key, length, "publisher")) {
+                app.publisher.reset(new OpenRTB::Publisher());
+                publisher = app.publisher.get();
+                return scanner.expectObject(onPublisher);
+            }
+            return scanner.skipValue();
+        };
+
+    auto onDevice = [&] (const char * key, size_t length) -> bool
+        {
+            if (isKey(key, length, "devicetype"))
+                return scanner.expectInt(request.device->devicetype.val);
+            if (isKey(key, length, "geo"))
+                return scanner.expectObject(onGeo);
+            return scanner.skipValue();
+        };
+
+    auto onUserGeo = [&] (const char * key, size_t length) -> bool
+        {
+            if (!isKey(key, length, "metro"))
+                return scanner.skipValue();
+            return scanner.expectString(request.user->geo->metro);
+        };
+
+    auto onUser = [&] (const char * key, size_t length) -> bool
+        {
+            if (!isKey(key, length, "geo"))
+                return scanner.skipValue();
+            request.user->geo.reset(new OpenRTB::Geo());
+            return scanner.expectObject(onUserGeo);
+        };
+
+    auto onBidRequest = [&] (const char * key, size_t length) -> bool
+        {
+            if (isKey(key, length, "imp")) {
+                request.imp.clear();
+                return scanner.expectArray([&] () -> bool
+                    {
+                        request.imp.emplace_back();
+                        return scanner.expectObject(onImp);
+                    });
+            }
+            if (isKey(key, length, "site")) {
+                request.site.reset(new OpenRTB::Site());
+                return scanner.expectObject(onSite);
+            }
+            if (isKey(key, length, "app")) {
+                request.app.reset(new OpenRTB::App());
+                return scanner.expectObject(onApp);
+            }
+            if (isKey(key, length, "device")) {
+                request.device.reset(new OpenRTB::Device());
+                return scanner.expectObject(onDevice);
+            }
+            if (isKey(key, length, "user")) {
+                request.user.reset(new OpenRTB::User());
+                return scanner.expectObject(onUser);
+            }
+            return scanner.skipValue();
+        };
+
+    try {
+        if (!scanner.expectObject(onBidRequest))
+            return 0;
+
+        // The parser refuses those
+        if (request.site && request.app)
+            return 0;
+
+        request.exchange = exchange;
+
+        if (clampLinearity) {
+            for (auto & spot: request.imp) {
+                if (!spot.video) continue;
+                int & linearity = spot.video->linearity.val;
+                if (linearity < 0 || linearity > 2)
+                    linearity = -1;
+            }
+        }
+
+        // As in OpenRTBBidRequestParser::onSite() and onApp()
+        if (request.site) {
+            if (!request.site->page.empty())
+                request.url = request.site->page;
+            else if (request.site->id)
+                request.url = Url("http://" + request.site->id.toString()
+                                  + ".siteid/");
+        }
+        else if (request.app) {
+            if (!request.app->bundle.empty())
+                request.url = Url(request.app->bundle);
+            else if (request.app->id)
+                request.url = Url("http://" + request.app->id.toString()
+                                  + ".appid/");
+        }
+
+        // As in OpenRTBBidRequestParser::onGeo(), for the device only
+        if (request.device) {
+            Location & location = request.location;
+            if (!country.empty())
+                location.countryCode = country;
+            if (!region.empty())
+                location.regionCode = region;
+            else if (!regionfips104.empty())
+                location.regionCode = regionfips104;
+            if (!city.empty())
+                location.cityName = Utf8String(city);
+            location.postalCode = Utf8String(zip);
+            if (!metro.empty())
+                location.metro = boost::lexical_cast<int>(metro);
+        }
+    } catch (const std::exception &) {
+        // Bad UTF-8 or metro; the parser will complain about it
+        return 0;
+    }
+
+    unsigned fields = PF_EXCHANGE | PF_DEVICE_TYPE | PF_LOCATION
+        | PF_USER_GEO | PF_URL | PF_PUBLISHER;
+
+    // The video filters expect the first spot to be a video one
+    if (!request.imp.empty() && request.imp[0].video)
+        fields |= PF_VIDEO;
+
+    return fields;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,36 @@
+/* openrtb_pre_parser.h                                            -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Picks the few fields that the pre-filters look at out of a raw OpenRTB
+   bid request, without parsing the rest of it.
+*/
+
+#pragma once
+
+#include <string>
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/filter.h"
+
+namespace RTBKIT {
+
+/*****************************************************************************/
+/* OPENRTB PRE PARSER                                                        */
+/*****************************************************************************/
+
+struct OpenRTBPreParser
+{
+    /** Fills the given empty bid request with the parts of the payload that
+        the PreFilterFields stand for, the way that the parser for the given
+        version of OpenRTB would.  Everything else is skipped over without
+        being decoded.
+
+        Returns the set of PreFilterFields filled in, or 0 if the payload
+        holds something that only the full parser can make sense of.
+    */
+    static unsigned parse(const std::string & payload,
+                          const std::string & openRtbVersion,
+                          const std::string & exchange,
+                          BidRequest & request);
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,230 @@
+/* openrtb_bid_request_writer_test.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Checks that OpenRTBBidRequestWriter prints exactly what printing the
+   converted request used to, and measures what it saves.
+*/
+
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/bid_request/openrtb_bid_request_parser.h"
+#include "rtbkit/plugins/bid_request/openrtb_bid_request_writer.h"
+#include "rtbkit/openrtb/openrtb_parsing.h"
+#include "soa/types/json_printing.h"
+#include "jml/utils/filter_streams.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/* Count the allocations made by the whole binary so that the benchmark can
+   report them per request. */
+
+namespace {
+std::atomic<size_t> allocations(0);
+}
+
+void * operator new(std::size_t size)
+{
+    ++allocations;
+    if (void * result = malloc(size ? size : 1))
+        return result;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+    free(ptr);
+}
+
+vector<pair<string, string> > samples = {
+    { "rtbkit/plugins/bid_request/testing/openrtb1_req.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb2_req.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb3_req.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb4_req.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_wseat_req.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_banner.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_expandable_creative.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_mobile.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_video.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner1.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner2.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner3.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner4.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_desktop.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_mobile_app.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_mobile_web.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/rubicon_test1.json", "2.1" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_2_2_req_imp.json", "2.2" },
+    { "rtbkit/plugins/bid_request/testing/openrtb_2_2_req_video.json", "2.2" }
+};
+
+std::unique_ptr<BidRequest>
+loadBidRequest(const std::string & filename, const std::string & version)
+{
+    ML::Parse_Context context(filename);
+    auto parser = OpenRTBBidRequestParser::openRTBBidRequestParserFactory(version);
+    return std::unique_ptr<BidRequest>(
+            parser->parseBidRequest(context, "openrtb", "openrtb"));
+}
+
+/** Does to the request what HttpBidderInterface::prepareRequest() does
+    before sending it to a standard OpenRTB bidder.
+*/
+void prepare(OpenRTB::BidRequest & request, const BidRequest & br)
+{
+    for (auto & imp : request.imp) {
+        imp.ext["external-ids"].append(1234);
+        imp.ext["creative-ids"]["1234"].append(1);
+        imp.ext["creative-ids"]["1234"].append(2);
+    }
+
+    request.ext["exchange"] = br.exchange;
+    request.ext["rtbkit"]["augmentationList"]["frequency-cap"]["tags"]
+        .append("pass-frequency-cap");
+    request.tmax.val = 42;
+}
+
+/** What HttpBidderInterface used to send. */
+std::string printConverted(const BidRequest & br)
+{
+    static DefaultDescription<OpenRTB::BidRequest> desc;
+
+    auto parser = OpenRTBBidRequestParser::openRTBBidRequestParserFactory("2.1");
+    OpenRTB::BidRequest request = parser->toBidRequest(br);
+    prepare(request, br);
+
+    StructuredJsonPrintingContext context;
+    desc.printJson(&request, context);
+    return context.output.toString();
+}
+
+/** What it sends now. */
+void printDirect(const BidRequest & br, StringJsonPrintingContext & context)
+{
+    OpenRTB::BidRequest shell = OpenRTBBidRequestWriter::shell(br);
+    prepare(shell, br);
+
+    context.clear();
+    OpenRTBBidRequestWriter::print(shell, br, context);
+    context.output += '\n';
+}
+
+BOOST_AUTO_TEST_CASE( test_writer_matches_converted_request )
+{
+    StringJsonPrintingContext context;
+
+    for (const auto & sample : samples) {
+        cerr << "checking " << sample.first << endl;
+        auto br = loadBidRequest(sample.first, sample.second);
+
+        printDirect(*br, context);
+        BOOST_CHECK_EQUAL(context.output, printConverted(*br));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_writer_impressions )
+{
+    // The datacratic format prints the impressions on their own
+    DefaultDescription<OpenRTB::Impression> impDesc;
+    auto parser = OpenRTBBidRequestParser::openRTBBidRequestParserFactory("2.1");
+
+    for (const auto & sample : samples) {
+        auto br = loadBidRequest(sample.first, sample.second);
+
+        OpenRTB::BidRequest request = parser->toBidRequest(*br);
+        OpenRTB::BidRequest shell = OpenRTBBidRequestWriter::shell(*br);
+        BOOST_REQUIRE_EQUAL(request.imp.size(), shell.imp.size());
+
+        for (size_t i = 0;  i < br->imp.size();  ++i) {
+            request.imp[i].ext["datacratic"]["allowed"]["bidder"].append(12);
+            shell.imp[i].ext["datacratic"]["allowed"]["bidder"].append(12);
+
+            StructuredJsonPrintingContext expected;
+            impDesc.printJson(&request.imp[i], expected);
+
+            StringJsonPrintingContext context;
+            OpenRTBBidRequestWriter::printImpression(shell.imp[i], br->imp[i],
+                                                     context);
+
+            BOOST_CHECK_EQUAL(context.output,
+                              expected.output.toStringNoNewLine());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_writer_banner_sizes )
+{
+    // Only one banner size fits in OpenRTB 2.1; the others go in the ext
+    auto br = loadBidRequest(samples[0].first, samples[0].second);
+
+    br->imp.resize(1);
+    br->imp[0].video.reset();
+    br->imp[0].banner.reset(new OpenRTB::Banner());
+    br->imp[0].banner->w.push_back(300);
+    br->imp[0].banner->h.push_back(250);
+    br->imp[0].banner->w.push_back(728);
+    br->imp[0].banner->h.push_back(90);
+
+    StringJsonPrintingContext context;
+    printDirect(*br, context);
+    BOOST_CHECK_EQUAL(context.output, printConverted(*br));
+    BOOST_CHECK_EQUAL(br->imp[0].banner->w.size(), 2);
+
+    br->site.reset(new OpenRTB::Site());
+    br->app.reset(new OpenRTB::App());
+    BOOST_CHECK_THROW(OpenRTBBidRequestWriter::shell(*br), ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE( benchmark_writer )
+{
+    vector<std::unique_ptr<BidRequest> > requests;
+    for (const auto & sample : samples)
+        requests.push_back(loadBidRequest(sample.first, sample.second));
+
+    enum { ITERATIONS = 1000 };
+    const size_t done = ITERATIONS * requests.size();
+
+    size_t bytes = 0;
+    size_t before = allocations;
+    Date start = Date::now();
+
+    for (unsigned i = 0;  i < ITERATIONS;  ++i)
+        for (const auto & br : requests)
+            bytes += printConverted(*br).size();
+
+    double convertedElapsed = Date::now().secondsSince(start);
+    size_t convertedAllocs = allocations - before;
+
+    StringJsonPrintingContext context;
+
+    before = allocations;
+    start = Date::now();
+
+    for (unsigned i = 0;  i < ITERATIONS;  ++i) {
+        for (const auto & br : requests) {
+            printDirect(*br, context);
+            bytes -= context.output.size();
+        }
+    }
+
+    double directElapsed = Date::now().secondsSince(start);
+    size_t directAllocs = allocations - before;
+
+    BOOST_CHECK_EQUAL(bytes, 0);
+
+    cerr << "converted: " << convertedElapsed / done * 1e6 << "us/req, "
+         << 1.0 * convertedAllocs / done << " allocs/req" << endl;
+    cerr << "direct:    " << directElapsed / done * 1e6 << "us/req, "
+         << 1.0 * directAllocs / done << " allocs/req" << endl;
+
+    BOOST_CHECK_LT(directAllocs, convertedAllocs);
+}
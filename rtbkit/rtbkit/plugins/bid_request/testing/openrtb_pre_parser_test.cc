@@ -0,0 +1,180 @@
+/* openrtb_pre_parser_test.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Test cases for the OpenRTB pre-parser.
+*/
+
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/bid_request/openrtb_pre_parser.h"
+#include "rtbkit/plugins/bid_request/openrtb_bid_request_parser.h"
+#include "jml/utils/filter_streams.h"
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+vector<string> samples = {
+    "rtbkit/plugins/bid_request/testing/openrtb1_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb2_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb3_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb4_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_wseat_req.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_banner.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_expandable_creative.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_mobile.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_video.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_2_2_req_imp.json",
+    "rtbkit/plugins/bid_request/testing/openrtb_2_2_req_video.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_banner1.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_desktop.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_mobile_app.json",
+    "rtbkit/plugins/bid_request/testing/rubicon_mobile_web.json"
+};
+
+std::string loadFile(const std::string & filename)
+{
+    ML::filter_istream stream(filename);
+
+    string result;
+
+    while (stream) {
+        string line;
+        getline(stream, line);
+        result += line + "\n";
+    }
+
+    return result;
+}
+
+void comparePreParse(const std::string & filename, const std::string & version)
+{
+    string payload = loadFile(filename);
+
+    std::unique_ptr<BidRequest> parsed;
+    try {
+        ML::Parse_Context context(filename, payload.c_str(), payload.size());
+        auto parser
+            = OpenRTBBidRequestParser::openRTBBidRequestParserFactory(version);
+        parsed.reset(parser->parseBidRequest(context, "test", "test"));
+    } catch (const std::exception & exc) {
+        cerr << filename << " isn't valid " << version << ": "
+             << exc.what() << endl;
+        return;
+    }
+
+    BidRequest pre;
+    unsigned fields = OpenRTBPreParser::parse(payload, version, "test", pre);
+    BOOST_REQUIRE_MESSAGE(fields, filename + " wasn't pre-parsed");
+
+    BOOST_CHECK_EQUAL(pre.exchange, parsed->exchange);
+    BOOST_CHECK_EQUAL(pre.url.toString(), parsed->url.toString());
+    BOOST_CHECK_EQUAL(pre.location.fullLocationString(),
+                      parsed->location.fullLocationString());
+
+    BOOST_CHECK_EQUAL(bool(pre.device), bool(parsed->device));
+    if (pre.device && parsed->device) {
+        BOOST_CHECK_EQUAL(pre.device->devicetype.val,
+                          parsed->device->devicetype.val);
+    }
+
+    BOOST_CHECK_EQUAL(bool(pre.site), bool(parsed->site));
+    if (pre.site && parsed->site) {
+        BOOST_CHECK_EQUAL(pre.site->domain, parsed->site->domain);
+        BOOST_CHECK_EQUAL(bool(pre.site->publisher),
+                          bool(parsed->site->publisher));
+        if (pre.site->publisher && parsed->site->publisher) {
+            BOOST_CHECK_EQUAL(pre.site->publisher->domain,
+                              parsed->site->publisher->domain);
+            BOOST_CHECK_EQUAL(pre.site->publisher->id,
+                              parsed->site->publisher->id);
+        }
+    }
+
+    BOOST_CHECK_EQUAL(bool(pre.app), bool(parsed->app));
+    if (pre.app && parsed->app) {
+        BOOST_CHECK_EQUAL(bool(pre.app->publisher),
+                          bool(parsed->app->publisher));
+        if (pre.app->publisher && parsed->app->publisher) {
+            BOOST_CHECK_EQUAL(pre.app->publisher->id,
+                              parsed->app->publisher->id);
+        }
+    }
+
+    string preMetro = pre.user && pre.user->geo ? pre.user->geo->metro : "";
+    string metro = parsed->user && parsed->user->geo
+        ? parsed->user->geo->metro : "";
+    BOOST_CHECK_EQUAL(preMetro, metro);
+
+    BOOST_REQUIRE_EQUAL(pre.imp.size(), parsed->imp.size());
+    for (size_t i = 0;  i < pre.imp.size();  ++i) {
+        BOOST_CHECK_EQUAL(bool(pre.imp[i].video), bool(parsed->imp[i].video));
+        if (pre.imp[i].video && parsed->imp[i].video) {
+            BOOST_CHECK_EQUAL(pre.imp[i].video->linearity.val,
+                              parsed->imp[i].video->linearity.val);
+        }
+    }
+
+    bool video = !parsed->imp.empty() && parsed->imp[0].video;
+    BOOST_CHECK_EQUAL(bool(fields & PF_VIDEO), video);
+}
+
+BOOST_AUTO_TEST_CASE( test_pre_parse_matches_parser )
+{
+    for (auto s: samples) {
+        comparePreParse(s, "2.1");
+        comparePreParse(s, "2.2");
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_pre_parse_escapes )
+{
+    string payload =
+        "{ \"id\": \"1\", \"imp\": [ { \"id\": \"1\", \"video\": "
+        "{ \"linearity\": 7, \"mimes\": [ \"video/mp4\" ] } } ],"
+        " \"site\": { \"domain\": \"caf\\u00e9.com\","
+        " \"page\": \"http:\\/\\/caf\\u00e9.com\\/a\","
+        " \"cat\": [ \"IAB1\", \"}\" ] },"
+        " \"device\": { \"devicetype\": 2, \"geo\": { \"country\": \"CAN\","
+        " \"metro\": \"501\" } } }";
+
+    BidRequest request;
+    unsigned fields = OpenRTBPreParser::parse(payload, "2.1", "test", request);
+    BOOST_REQUIRE(fields & PF_VIDEO);
+
+    BOOST_CHECK_EQUAL(request.site->domain.rawString(), "caf\xc3\xa9.com");
+    BOOST_CHECK_EQUAL(request.location.countryCode, "CAN");
+    BOOST_CHECK_EQUAL(request.location.metro, 501);
+    BOOST_CHECK_EQUAL(request.device->devicetype.val, 2);
+
+    // 2.1 resets the linearities it doesn't know about
+    BOOST_CHECK_EQUAL(request.imp[0].video->linearity.val, -1);
+
+    BidRequest request22;
+    OpenRTBPreParser::parse(payload, "2.2", "test", request22);
+    BOOST_CHECK_EQUAL(request22.imp[0].video->linearity.val, 7);
+}
+
+BOOST_AUTO_TEST_CASE( test_pre_parse_gives_up )
+{
+    auto preParse = [] (const string & payload, const string & version)
+        {
+            BidRequest request;
+            return OpenRTBPreParser::parse(payload, version, "test", request);
+        };
+
+    BOOST_CHECK_EQUAL(preParse("{ \"id\": \"1\" }", "2.5"), 0);
+    BOOST_CHECK_EQUAL(preParse("{ \"id\": \"1\"", "2.2"), 0);
+    BOOST_CHECK_EQUAL(preParse("[]", "2.2"), 0);
+    BOOST_CHECK_EQUAL(preParse("{ \"si\\u0074e\": {} }", "2.2"), 0);
+    BOOST_CHECK_EQUAL(preParse("{ \"site\": {}, \"app\": {} }", "2.2"), 0);
+    BOOST_CHECK_EQUAL(
+            preParse("{ \"device\": { \"geo\": { \"metro\": \"x\" } } }", "2.2"),
+            0);
+
+    BOOST_CHECK(preParse("{ \"id\": \"1\" }", "2.2"));
+}
@@ -38,7 +38,7 @@ void AgentsBidderInterface::sendAuctionMessage(std::shared_ptr<Auction> const &
                                  info.encodeBidRequest(*auction),
                                  spots.toJsonStr(),
                                  std::to_string(timeLeftMs),
-                                 auction->agentAugmentations[agent],
+                                 auction->agentAugmentations.get(agent),
                                  wcm.toJson());
     }
 }
@@ -9,6 +9,7 @@
 #include "soa/utils/generic_utils.h"
 #include "rtbkit/common/messages.h"
 #include "rtbkit/plugins/bid_request/openrtb_bid_request_parser.h"
+#include "rtbkit/plugins/bid_request/openrtb_bid_request_writer.h"
 #include "rtbkit/openrtb/openrtb_parsing.h"
 #include "rtbkit/core/router/router.h"
 
@@ -16,8 +17,6 @@ using namespace Datacratic;
 using namespace RTBKIT;
 
 namespace {
-    DefaultDescription<OpenRTB::BidRequest> desc;
-
     std::string httpErrorString(HttpClientError code)  {
         switch (code) {
             #define CASE(code) \
@@ -181,6 +180,7 @@ void HttpBidderInterface::sendAuctionMessage(std::shared_ptr<Auction> const & au
              * for a configuration that has been deleted will trigger a logging message.
              * We will return a 204 for these requests
              */
+            boost::shared_lock<Router::AgentsLock> guard(router->agentsLock);
             auto agentIt = router->agents.find(agent);
             if (agentIt == std::end(router->agents)) {
                 return false;
@@ -206,37 +206,52 @@ void HttpBidderInterface::sendAuctionMessage(std::shared_ptr<Auction> const & au
     else
         openRtbVersion = "2.1";
 
-    std::shared_ptr<OpenRTBBidRequestParser> parser = OpenRTBBidRequestParser::openRTBBidRequestParserFactory(openRtbVersion);
-
-
-    OpenRTB::BidRequest openRtbRequest = parser->toBidRequest(originalRequest);
+    /* Only the parts of the request that prepareRequest() rewrites are
+       converted; the rest is printed straight from the original request. */
+    OpenRTB::BidRequest openRtbRequest = OpenRTBBidRequestWriter::shell(originalRequest);
     bool ok = prepareRequest(openRtbRequest, originalRequest, auction, bidders);
     /* If we took too much time processing the request, then we don't send it.  */
     if (!ok) {
         return;
     }
 
-    string requestStr;
+    if (!requestPrinter.get())
+        requestPrinter.reset(new StringJsonPrintingContext());
+
+    StringJsonPrintingContext & printer = *requestPrinter;
+    printer.clear();
+
     if (routerFormat == FMT_DATACRATIC) {
-        Json::Value jReq(Json::objectValue);
-        jReq["id"] = openRtbRequest.id.toString();
-
-        DefaultDescription<OpenRTB::Impression> impDesc;
-        for (auto & imp : openRtbRequest.imp) {
-            StructuredJsonPrintingContext ctx;
-            impDesc.printJson(&imp, ctx);
-            jReq["imp"].append(ctx.output);
+        printer.startObject();
+        printer.startMember("id");
+        printer.writeString(openRtbRequest.id.toString());
+
+        if (!openRtbRequest.imp.empty()) {
+            printer.startMember("imp");
+            printer.startArray(openRtbRequest.imp.size());
+            for (size_t i = 0; i < openRtbRequest.imp.size(); ++i) {
+                printer.newArrayElement();
+                OpenRTBBidRequestWriter::printImpression(
+                        openRtbRequest.imp[i], originalRequest.imp[i], printer);
+            }
+            printer.endArray();
         }
 
-        jReq["ext"]["datacratic"] = openRtbRequest.ext["datacratic"];
-        jReq["ext"]["rtbkit"] = openRtbRequest.ext["rtbkit"];
-        requestStr = jReq.toString();
+        printer.startMember("ext");
+        printer.startObject();
+        printer.startMember("datacratic");
+        printer.writeJson(openRtbRequest.ext["datacratic"]);
+        printer.startMember("rtbkit");
+        printer.writeJson(openRtbRequest.ext["rtbkit"]);
+        printer.endObject();
+        printer.endObject();
     } else {
-        StructuredJsonPrintingContext context;
-        desc.printJson(&openRtbRequest, context);
-        requestStr = context.output.toString();
+        OpenRTBBidRequestWriter::print(openRtbRequest, originalRequest, printer);
     }
 
+    // Same terminating newline as Json::Value::toString()
+    printer.output += '\n';
+
     Date sentResponseTime = Date::now();
     /* We need to capture by copy inside the lambda otherwise we might get
        a dangling reference if we go out of scope before receiving the http response
@@ -395,7 +410,7 @@ void HttpBidderInterface::sendAuctionMessage(std::shared_ptr<Auction> const & au
             }
     );
 
-    HttpRequest::Content reqContent { requestStr, "application/json" };
+    HttpRequest::Content reqContent { printer.output, "application/json" };
 
     RestParams headers { { "x-openrtb-version", openRtbVersion } };
    // std::cerr << "Sending HTTP POST to: " << routerHost << " " << routerPath << std::endl;
@@ -782,8 +797,8 @@ bool HttpBidderInterface::prepareDatacraticRequest(OpenRTB::BidRequest &request,
     }
 
     auto& ext = request.ext["datacratic"];
-    ext["request"] = auction->requestStr;
-    ext["requestFormat"] = auction->requestStrFormat;
+    ext["request"] = auction->requestStr();
+    ext["requestFormat"] = auction->requestStrFormat();
 
     // We update the tmax value before sending the BidRequest to substract our
     // processing time
@@ -812,13 +827,14 @@ void HttpBidderInterface::injectBids(const std::string &agent, Id auctionId,
      // calling doBid from the context of an other thread (the MessageLoop worker thread).
      // Since the object that handles in flight BidRequests for an agent is not
      // thread-safe, we can not call the doBid function from an other thread.
-     // Instead, we use a queue to communicate with the router thread. We then avoid
-     // an evil race condition.
+     // Instead, we use a queue to communicate with the router shard that owns the
+     // auction. We then avoid an evil race condition.
 
-     if (!router->doBidBuffer.tryPush(std::move(message))) {
-         throw ML::Exception("Main router loop can not keep up with HttpBidderInterface");
+     auto & shard = router->shard(auctionId);
+     if (!shard.doBidBuffer.tryPush(std::move(message))) {
+         throw ML::Exception("Router shard can not keep up with HttpBidderInterface");
      }
-     router->wakeupMainLoop.signal();
+     shard.wakeup.signal();
 }
 
 void HttpBidderInterface::submitBids(AgentBids &info) {
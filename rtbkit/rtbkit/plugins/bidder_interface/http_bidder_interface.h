@@ -8,6 +8,8 @@
 #include "rtbkit/common/bidder_interface.h"
 #include "soa/service/http_client.h"
 #include "soa/service/logs.h"
+#include "soa/types/json_printing.h"
+#include <boost/thread/tss.hpp>
 
 namespace RTBKIT {
 
@@ -73,6 +75,8 @@ struct HttpBidderInterface : public BidderInterface
 
     void registerLoopMonitor(LoopMonitor *monitor) const;
 
+    bool isThreadSafe() const { return true; }
+
     virtual void tagRequest(OpenRTB::BidRequest &request,
                             const std::map<std::string, BidInfo> &bidders) const;
 
@@ -109,6 +113,9 @@ private:
     std::string routerPath;
     Format routerFormat;
 
+    /// Output buffer for the bid requests, reused from one auction to the next
+    boost::thread_specific_ptr<StringJsonPrintingContext> requestPrinter;
+
     std::string adserverHost;
 
     uint16_t adserverWinPort;
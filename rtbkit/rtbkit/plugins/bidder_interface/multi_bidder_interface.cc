@@ -38,6 +38,7 @@ MultiBidderInterface::MultiBidderInterface(
 
         bidderInterfaces.insert(
                 std::make_pair(name, bidder));
+        stats_.add(name);
     }
 }
 
@@ -195,6 +196,14 @@ void MultiBidderInterface::registerLoopMonitor(LoopMonitor *monitor) const {
     }
 }
 
+bool MultiBidderInterface::isThreadSafe() const {
+    for (const auto& iface: bidderInterfaces) {
+        if (!iface.second->isThreadSafe())
+            return false;
+    }
+    return true;
+}
+
 
 //
 // factory
@@ -66,7 +66,15 @@ struct MultiBidderInterface : public BidderInterface {
         {
             auto& stat = interfacesStats[interfaceName];
             auto& value = stat.*member;
-            return ++value;
+            return __sync_add_and_fetch(&value, 1);
+        }
+
+        /** Interfaces are added up front so that incr() never modifies the
+            map and can be called from several threads.
+        */
+        void add(const std::string &interfaceName)
+        {
+            interfacesStats[interfaceName] = InterfaceStats();
         }
 
         void dump(std::ostream &stream) const
@@ -149,6 +157,8 @@ struct MultiBidderInterface : public BidderInterface {
 
     void registerLoopMonitor(LoopMonitor *monitor) const;
 
+    bool isThreadSafe() const;
+
     Stats stats() const {
         return stats_;
     }
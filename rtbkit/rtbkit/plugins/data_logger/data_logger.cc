@@ -49,6 +49,9 @@ init()
         s.reserve(msg.size());
         for (auto & m: msg)
             s.push_back(m.toString());
+        // The router sends its timestamps in binary
+        if (s.size() > 1)
+            s[1] = printTimestamp(s[1]);
         this->logMessageNoTimestamp(s);
     };
     loopMonitor_.init();
@@ -39,6 +39,15 @@ struct BidSwitchExchangeConnector: public OpenRTBExchangeConnector {
                     const HttpHeader & header,
                     const std::string & payload);
 
+    /** The exchange is taken from the ext of the request. */
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request)
+    {
+        return 0;
+    }
+
     virtual double
     getTimeAvailableMs(HttpAuctionHandler & connection,
                        const HttpHeader & header,
@@ -144,11 +144,11 @@ CasaleExchangeConnector::parseBidRequest(
      * 2.1 should be backward-compatible, we "fake" the version and patch it to 2.1 so that
      * we do not throw
      */
+    if (header.findHeader(HttpHeader::OPENRTB_VERSION) != "2.0")
+        return OpenRTBExchangeConnector::parseBidRequest(handler, header, payload);
+
     HttpHeader patchedHeaders(header);
-    auto it = patchedHeaders.headers.find("x-openrtb-version");
-    if (it != std::end(patchedHeaders.headers) && it->second == "2.0") {
-        it->second = "2.1";
-    }
+    patchedHeaders.setHeader("x-openrtb-version", "2.1");
 
     auto request = OpenRTBExchangeConnector::parseBidRequest(handler, patchedHeaders, payload);
 
@@ -110,14 +110,15 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Check for the x-openrtb-version header
-    auto it = header.headers.find("x-openrtb-version");
-    if (it == header.headers.end()) {
+    boost::string_ref versionHeader
+        = header.findHeader(HttpHeader::OPENRTB_VERSION);
+    if (!versionHeader.data()) {
         connection.sendErrorResponse("no OpenRTB version header supplied");
         return res;
     }
 
     // Check it's version
-    string openRtbVersion = it->second;
+    string openRtbVersion = versionHeader.to_string();
     float version = atof(openRtbVersion.c_str());
     cerr << "version" << version << endl;
     if (openRtbVersion != "2.0" && version < 2.0 ) {
@@ -7,6 +7,7 @@
 
 #include "http_auction_handler.h"
 #include "http_exchange_connector.h"
+#include "rtbkit/common/filter.h"
 
 #include "jml/arch/exception.h"
 #include "jml/arch/format.h"
@@ -14,6 +15,7 @@
 #include "jml/utils/guard.h"
 #include "jml/utils/set_utils.h"
 #include "jml/utils/vector_utils.h"
+#include "jml/utils/rng.h"
 #include "jml/arch/timers.h"
 #include <set>
 
@@ -136,9 +138,11 @@ long HttpAuctionHandler::destroyed = 0;
 
 HttpAuctionHandler::
 HttpAuctionHandler()
-    : hasTimer(false), disconnected(false), servingRequest(false)
+    : hasTimer(false), disconnected(false), servingRequest(false),
+      preParsedFields(0), preParseUs(0.0)
 {
     atomic_add(created, 1);
+    inPlaceHeaders = true;
 }
 
 HttpAuctionHandler::
@@ -321,9 +325,18 @@ handleHttpPayload(const HttpHeader & header,
         return;
     }
     
+    preParsed.reset();
+
     double acceptProbability = endpoint->acceptAuctionProbability;
 
-    if (acceptProbability < 1.0
+    if (endpoint->valueShedding && endpoint->onScoreRequest) {
+        if (shedLowValueRequest(header, payload, 1.0 - acceptProbability)) {
+            doEvent("auctionEarlyDrop.lowValue");
+            dropAuction("low value early drop");
+            return;
+        }
+    }
+    else if (acceptProbability < 1.0
         && random() % 1000000 > 1000000 * acceptProbability) {
         // early drop...
         doEvent("auctionEarlyDrop.randomEarlyDrop");
@@ -394,7 +407,18 @@ handleHttpPayload(const HttpHeader & header,
              return;
         }
 
+        bool preFilter = endpoint->preFilter && endpoint->onPreFilter;
+        if (preFilter && !preFilterRequest(header, payload)) {
+            dropAuction("no agent passed the pre-filters");
+            return;
+        }
+
+        Date parseStart = preFilter ? Date::now() : Date();
         auto bidRequest = parseBidRequest(header, payload);
+        if (preFilter && bidRequest) {
+            endpoint->recordParseTime(
+                    Date::now().secondsSince(parseStart) * 1000000.0);
+        }
 
         if (!bidRequest) {
             endpoint->recordHit("error.noBidRequest");
@@ -403,11 +427,23 @@ handleHttpPayload(const HttpHeader & header,
             return;
         }
 
-        auction.reset(new Auction(endpoint,
-                                  handleAuction, bidRequest,
-                                  bidRequest->toJsonStr(),
-                                  "datacratic",
-                                  firstData, expiry));
+        /* The request is only stringified if something downstream asks
+           for it.  Keep a copy of the payload around instead; our own
+           buffer stays with the handler to be reused for the next request.
+        */
+        auto rawPayload = std::make_shared<std::string>(payload);
+
+        /* The parser allocated the request and its members on this thread;
+           moving it into the pool has them freed here too.
+        */
+        if (bidRequest.use_count() == 1)
+            bidRequest = bidRequestPool().make(std::move(*bidRequest));
+
+        auction = auctionPool().make(endpoint,
+                                     handleAuction, bidRequest,
+                                     std::move(rawPayload),
+                                     endpoint->exchangeName(),
+                                     firstData, expiry);
 
         endpoint->adjustAuction(auction);
 
@@ -421,14 +457,15 @@ handleHttpPayload(const HttpHeader & header,
 #if 0
         static std::mutex lock;
         std::unique_lock<std::mutex> guard(lock);
-        cerr << "bytes before = " << payload.size() << " after "
-             << auction->requestStr.size() << " ratio "
-             << 100.0 * auction->requestStr.size() / payload.size()
+        size_t payloadSize = auction->requestPayload()->size();
+        cerr << "bytes before = " << payloadSize << " after "
+             << auction->requestStr().size() << " ratio "
+             << 100.0 * auction->requestStr().size() / payloadSize
              << "%" << endl;
         string s = bidRequest->serializeToString();
-        cerr << "serialized bytes before = " << payload.size() << " after "
+        cerr << "serialized bytes before = " << payloadSize << " after "
              << s.size() << " ratio "
-             << 100.0 * s.size() / payload.size() << "%" << endl;
+             << 100.0 * s.size() / payloadSize << "%" << endl;
 #endif
 
     } catch (const std::exception & exc) {
@@ -557,8 +594,10 @@ sendResponse()
                 this->transport().closeWhenHandlerFinished();
             }
             else {
+                auto next = this->endpoint->makeNewHandlerShared();
+                next->takeBuffers(*this);
                 this->transport().associateWhenHandlerFinished
-                (this->makeNewHandlerShared(), "sendFinished");
+                (next, "sendFinished");
             }
         };
 
@@ -582,8 +621,10 @@ dropAuction(const std::string & reason)
                 this->transport().closeWhenHandlerFinished();
             }
             else {
+                auto next = this->endpoint->makeNewHandlerShared();
+                next->takeBuffers(*this);
                 this->transport().associateWhenHandlerFinished
-                (this->makeNewHandlerShared(), "sendFinished");
+                (next, "sendFinished");
             }
         };
 
@@ -630,6 +671,98 @@ parseBidRequest(const HttpHeader & header,
     return endpoint->parseBidRequest(*this, header, payload);
 }
 
+bool
+HttpAuctionHandler::
+preFilterRequest(const HttpHeader & header,
+                 const std::string & payload)
+{
+    unsigned fields = preParse(header, payload);
+    if (!fields) {
+        doEvent("auctionPreFilter.notPreParsed");
+        return true;
+    }
+
+    Date start = Date::now();
+    bool pass = endpoint->onPreFilter(*preParsed, fields);
+    double elapsedUs
+        = preParseUs + Date::now().secondsSince(start) * 1000000.0;
+    doEvent("auctionPreFilter.timeUs", ET_OUTCOME, elapsedUs, "us");
+
+    if (pass) {
+        doEvent("auctionPreFilter.passed");
+        return true;
+    }
+
+    doEvent("auctionPreFilter.rejected");
+
+    // What the request would have cost to parse, less what it cost here.
+    double savedUs = endpoint->parseTimeUs.load() - elapsedUs;
+    doEvent("auctionPreFilter.parseTimeSavedUs",
+            ET_OUTCOME, std::max(savedUs, 0.0), "us");
+    return false;
+}
+
+bool
+HttpAuctionHandler::
+shedLowValueRequest(const HttpHeader & header,
+                    const std::string & payload,
+                    double shedProb)
+{
+    // When there is no load only a sample of the requests is scored, which
+    // is enough to keep the distribution of values ready.  The pre-filters
+    // pre-parse every request anyway.
+    if (shedProb <= 0.0 && !endpoint->preFilter
+            && ML::RNG::defaultRNG().random(16) != 0)
+        return false;
+
+    const unsigned needed = PF_EXCHANGE | PF_URL | PF_PUBLISHER;
+    if ((preParse(header, payload) & needed) != needed) {
+        doEvent("auctionEarlyDrop.notScored");
+        return shedProb > 0.0 && ML::RNG::defaultRNG().random01() < shedProb;
+    }
+
+    double value = endpoint->onScoreRequest(*preParsed);
+    if (!endpoint->shedder.shedMessage(value, shedProb))
+        return false;
+
+    if (endpoint->onRequestShed)
+        endpoint->onRequestShed(*preParsed);
+    return true;
+}
+
+unsigned
+HttpAuctionHandler::
+preParse(const HttpHeader & header,
+         const std::string & payload)
+{
+    if (preParsed)
+        return preParsedFields;
+
+    Date start = Date::now();
+    preParsed.reset(new BidRequest());
+    preParsedFields = endpoint->preParseBidRequest(header, payload, *preParsed);
+    preParseUs = Date::now().secondsSince(start) * 1000000.0;
+
+    return preParsedFields;
+}
+
+ObjectPool<Auction> &
+HttpAuctionHandler::
+auctionPool()
+{
+    // Never destroyed, as auctions can outlive every exchange connector.
+    static ObjectPool<Auction> * pool = new ObjectPool<Auction>();
+    return *pool;
+}
+
+ObjectPool<BidRequest> &
+HttpAuctionHandler::
+bidRequestPool()
+{
+    static ObjectPool<BidRequest> * pool = new ObjectPool<BidRequest>();
+    return *pool;
+}
+
 double
 HttpAuctionHandler::
 getTimeAvailableMs(const HttpHeader & header,
@@ -10,6 +10,7 @@
 #include "jml/utils/filter_streams.h"
 #include "soa/service/http_endpoint.h"
 #include "soa/service/stats_events.h"
+#include "soa/service/object_pool.h"
 #include "rtbkit/common/auction.h"
 
 namespace RTBKIT {
@@ -130,6 +131,34 @@ struct HttpAuctionHandler
     parseBidRequest(const HttpHeader & header,
                     const std::string & payload);
 
+    /** Runs the pre-filters on the fields that the endpoint can pick out
+        of the payload.  Returns false if no agent can bid on the request,
+        which then doesn't need to be parsed.
+    */
+    bool preFilterRequest(const HttpHeader & header,
+                          const std::string & payload);
+
+    /** Returns true if the request is among the lowest valued ones that
+        have to go to shed the given proportion of the requests.  Requests
+        that the endpoint can't pre-parse are shed uniformly.
+    */
+    bool shedLowValueRequest(const HttpHeader & header,
+                             const std::string & payload,
+                             double shedProb);
+
+    /** Request as picked out of the payload by the endpoint, shared by the
+        value shedding and the pre-filters.  Reset for each request.
+    */
+    std::unique_ptr<BidRequest> preParsed;
+    unsigned preParsedFields;
+    double preParseUs;
+
+    /** Pre-parses the request the first time it's called for a payload and
+        returns the PreFilterFields that were filled in.
+    */
+    unsigned preParse(const HttpHeader & header,
+                      const std::string & payload);
+
 
     /** Return the available time for the bid request in milliseconds.  This
         method should not parse the bid request, as when shedding load
@@ -151,6 +180,16 @@ struct HttpAuctionHandler
     virtual double
     getRoundTripTimeMs(const HttpHeader & header);
 
+    /** Auctions are allocated on the thread that got their request and are
+        destroyed back there, wherever their last reference goes away.
+    */
+    static ObjectPool<Auction> & auctionPool();
+
+    /** Same for the bid requests, which the post auction loop holds on to
+        for longer than their auctions.
+    */
+    static ObjectPool<BidRequest> & bidRequestPool();
+
     static long created;
     static long destroyed;
 };
@@ -62,6 +62,9 @@ postConstructorInit()
     auctionVerb = "POST";
     auctionResource = "/";
     absoluteTimeMax = 50.0;
+    preFilter = false;
+    valueShedding = false;
+    parseTimeUs = 0.0;
 
     numServingRequest = 0;
 
@@ -78,6 +81,15 @@ postConstructorInit()
 
     handlerFactory = [=] () { return new HttpAuctionHandler(); };
 
+    // Auctions and bid requests are destroyed back on the thread that
+    // allocated them.  Allocations only destroy a couple each, so most of
+    // it happens here.
+    onEventThreadTick = [] ()
+        {
+            HttpAuctionHandler::auctionPool().collect();
+            HttpAuctionHandler::bidRequestPool().collect();
+        };
+
     addPeriodic(1.0,
                 [=] (uint64_t numWakeUps)
                 { this->periodicCallback(numWakeUps); });
@@ -106,9 +118,13 @@ configure(const Json::Value & parameters)
     getParam(parameters, pingTimesByHostMs, "pingTimesByHostMs");
     getParam(parameters, pingTimeUnknownHostsMs, "pingTimeUnknownHostsMs");
     getParam(parameters, absoluteTimeMax, "absoluteTimeMax");
+    getParam(parameters, preFilter, "preFilter");
+    getParam(parameters, valueShedding, "valueShedding");
 
     if (parameters.isMember("realTimePolling"))
         realTimePolling(parameters["realTimePolling"].asBool());
+    if (parameters.isMember("shardThreads"))
+        shardThreads(parameters["shardThreads"].asBool());
 
     uniqueName_ = parameters.get("uniqueName", exchangeName()).asString();
 
@@ -267,6 +283,27 @@ parseBidRequest(HttpAuctionHandler & connection,
     throw ML::Exception("need to override HttpExchangeConnector::parseBidRequest");
 }
 
+unsigned
+HttpExchangeConnector::
+preParseBidRequest(const HttpHeader & header,
+                   const std::string & payload,
+                   BidRequest & request)
+{
+    return 0;
+}
+
+void
+HttpExchangeConnector::
+recordParseTime(double us)
+{
+    // Updates racing each other may get lost, which doesn't matter much
+    // for an average.
+    double current = parseTimeUs.load(std::memory_order_relaxed);
+    if (current == 0.0) current = us;
+    else current += 0.01 * (us - current);
+    parseTimeUs.store(current, std::memory_order_relaxed);
+}
+
 void
 HttpExchangeConnector::
 adjustAuction(std::shared_ptr<Auction>& auction) const
@@ -359,6 +396,16 @@ HttpExchangeConnector::
 periodicCallback(uint64_t numWakeups) const
 {
     recordLevel(numConnections(), "httpConnections");
+
+    auto pool = HttpAuctionHandler::auctionPool().stats();
+    recordLevel(pool.live(), "auctionPool.live");
+    recordLevel(pool.free, "auctionPool.free");
+    recordLevel(pool.allocated ? 1.0 * pool.reused / pool.allocated : 0.0,
+                "auctionPool.reuseRatio");
+
+    auto requests = HttpAuctionHandler::bidRequestPool().stats();
+    recordLevel(requests.live(), "bidRequestPool.live");
+    recordLevel(requests.free, "bidRequestPool.free");
 }
 
 PipelineStatus
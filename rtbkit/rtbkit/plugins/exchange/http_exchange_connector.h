@@ -12,8 +12,10 @@
 #include "jml/arch/atomic_ops.h"
 #include "soa/service/json_endpoint.h"
 #include "soa/service/stats_events.h"
+#include "soa/service/loop_monitor.h"
 #include "rtbkit/common/auction.h"
 #include <limits>
+#include <atomic>
 #include "rtbkit/common/exchange_connector.h"
 #include "rtbkit/common/bid_request_pipeline.h"
 #include <boost/algorithm/string.hpp>
@@ -95,6 +97,15 @@ struct HttpExchangeConnector
         return now <= enabledUntil;
     }
 
+    /** Returns the distribution of request values and how many requests of
+        each value were shed, when shedding by value.
+    */
+    virtual Json::Value getSheddingInfo() const
+    {
+        if (!valueShedding) return Json::Value();
+        return shedder.getDistribution();
+    }
+
     /** Returns a function that can be used to sample the load of the exchange
         connector. See LoopMonitor documentation for more details.
      */
@@ -156,6 +167,20 @@ struct HttpExchangeConnector
                     const HttpHeader & header,
                     const std::string & payload);
 
+    /** Fills the given empty bid request with the fields which can be
+        picked out of the payload without parsing the rest of it, so that
+        the requests that no agent can bid on can be turned away early.
+        Anything parseBidRequest() does to those fields has to be done here
+        as well.
+
+        Returns the set of PreFilterFields filled in.  The default
+        implementation returns 0, meaning that every request gets parsed.
+    */
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request);
+
     /** This method is called right after the bid request has been parsed and
      *  the Auction object has been created. This method should be reimplemented
      *  if you want to modify the auction before it is injected into the router
@@ -312,6 +337,12 @@ protected:
     std::string auctionVerb;
     double absoluteTimeMax;
 
+    /// Run the pre-filters on the pre-parsed request before parsing it
+    bool preFilter;
+
+    /// Under load, drop the requests of lowest historical value first
+    bool valueShedding;
+
     std::string uniqueName_;
 
     /// The ping time to known hosts in milliseconds
@@ -326,6 +357,15 @@ private:
     std::shared_ptr<HttpAuctionLogger> logger;
     std::shared_ptr<BidRequestPipeline> pipeline;
 
+    /** Running average of how long parseBidRequest() takes, which is what
+        a request turned away by the pre-filters saves.
+    */
+    std::atomic<double> parseTimeUs;
+    void recordParseTime(double us);
+
+    /// Picks the requests to drop when shedding by value
+    ValueShedder shedder;
+
     Lock handlersLock;
     std::set<std::shared_ptr<HttpAuctionHandler> > handlers;
     void finishedWithHandler(std::shared_ptr<HttpAuctionHandler> handler);
@@ -37,6 +37,15 @@ struct MoPubExchangeConnector: public OpenRTBExchangeConnector {
                     const HttpHeader & header,
                     const std::string & payload);
 
+    /** The linearity may come from the ext of the spots. */
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request)
+    {
+        return 0;
+    }
+
 #if 0
     virtual HttpResponse
     getResponse(const HttpAuctionHandler & connection,
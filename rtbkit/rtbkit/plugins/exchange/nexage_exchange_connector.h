@@ -39,6 +39,15 @@ struct NexageExchangeConnector: public OpenRTBExchangeConnector {
                     const HttpHeader & header,
                     const std::string & payload);
 
+    /** Requests are parsed as 2.2 whatever their header says. */
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request)
+    {
+        return 0;
+    }
+
 #if 0
     virtual HttpResponse
     getResponse(const HttpAuctionHandler & connection,
@@ -8,6 +8,7 @@
 #include "rtbkit/common/testing/exchange_source.h"
 #include "rtbkit/plugins/bid_request/openrtb_bid_source.h"
 #include "rtbkit/plugins/bid_request/openrtb_bid_request_parser.h"
+#include "rtbkit/plugins/bid_request/openrtb_pre_parser.h"
 #include "rtbkit/plugins/exchange/http_auction_handler.h"
 #include "rtbkit/core/agent_configuration/agent_config.h"
 #include "rtbkit/openrtb/openrtb_parsing.h"
@@ -103,20 +104,11 @@ parseBidRequest(HttpAuctionHandler & connection,
     std::shared_ptr<BidRequest> none;
 
     // Check for JSON content-type
-    if (!header.contentType.empty()) {
-        static const std::string delimiter = ";";
-
-        std::string::size_type posDelim = header.contentType.find(delimiter);
-        std::string content;
-
-        if(posDelim == std::string::npos)
-            content = header.contentType;
-        else {
-            content = header.contentType.substr(0, posDelim);
-            #if 0
-            std::string charset = header.contentType.substr(posDelim, header.contentType.length());
-            #endif
-        }
+    boost::string_ref contentType
+        = header.findHeader(HttpHeader::CONTENT_TYPE);
+    if (!contentType.empty()) {
+        // Ignore the charset, if any
+        boost::string_ref content = contentType.substr(0, contentType.find(';'));
 
         if(content != "application/json") {
             connection.sendErrorResponse("UNSUPPORTED_CONTENT_TYPE", "The request is required to use the 'Content-Type: application/json' header");
@@ -129,14 +121,15 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Check for the x-openrtb-version header
-    auto it = header.headers.find("x-openrtb-version");
-    if (it == header.headers.end()) {
+    boost::string_ref version
+        = header.findHeader(HttpHeader::OPENRTB_VERSION);
+    if (!version.data()) {
         connection.sendErrorResponse("MISSING_OPENRTB_HEADER", "The request is missing the 'x-openrtb-version' header");
         return none;
     }
 
     // Check that it's version 2.1
-    std::string openRtbVersion = it->second;
+    std::string openRtbVersion = version.to_string();
     if (openRtbVersion != "2.1" && openRtbVersion != "2.2") {
         connection.sendErrorResponse("UNSUPPORTED_OPENRTB_VERSION", "The request is required to be using version 2.1 or 2.2 of the OpenRTB protocol but requested " + openRtbVersion);
         return none;
@@ -166,19 +159,37 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Check if we want some reporting
-    auto verbose = header.headers.find("x-openrtb-verbose");
-    if(header.headers.end() != verbose) {
-        if(verbose->second == "1") {
-            if(!result->auctionId.notNull()) {
-                connection.sendErrorResponse("MISSING_ID", "The bid request requires the 'id' field");
-                return none;
-            }
+    if(header.findHeader("x-openrtb-verbose") == "1") {
+        if(!result->auctionId.notNull()) {
+            connection.sendErrorResponse("MISSING_ID", "The bid request requires the 'id' field");
+            return none;
         }
     }
 
     return result;
 }
 
+unsigned
+OpenRTBExchangeConnector::
+preParseBidRequest(const HttpHeader & header,
+                   const std::string & payload,
+                   BidRequest & request)
+{
+    // Whatever parseBidRequest() would refuse is left for it to answer
+    boost::string_ref contentType
+        = header.findHeader(HttpHeader::CONTENT_TYPE);
+    if (contentType.substr(0, contentType.find(';')) != "application/json")
+        return 0;
+
+    std::string openRtbVersion
+        = header.findHeader(HttpHeader::OPENRTB_VERSION).to_string();
+    if (openRtbVersion != "2.1" && openRtbVersion != "2.2")
+        return 0;
+
+    return OpenRTBPreParser::parse(payload, openRtbVersion, exchangeName(),
+                                   request);
+}
+
 double
 OpenRTBExchangeConnector::
 getTimeAvailableMs(HttpAuctionHandler & connection,
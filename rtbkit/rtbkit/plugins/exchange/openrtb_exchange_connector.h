@@ -38,6 +38,11 @@ struct OpenRTBExchangeConnector : public HttpExchangeConnector {
                     const HttpHeader & header,
                     const std::string & payload);
 
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request);
+
     virtual double
     getTimeAvailableMs(HttpAuctionHandler & connection,
                        const HttpHeader & header,
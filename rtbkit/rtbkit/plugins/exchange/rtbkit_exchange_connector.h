@@ -172,6 +172,15 @@ struct RTBKitExchangeConnector : public OpenRTBExchangeConnector {
                     const HttpHeader &header,
                     const std::string &payload);
 
+    /** The exchange is taken from the ext of the request. */
+    virtual unsigned
+    preParseBidRequest(const HttpHeader & header,
+                       const std::string & payload,
+                       BidRequest & request)
+    {
+        return 0;
+    }
+
     virtual void
     adjustAuction(std::shared_ptr<Auction>& auction) const;
 protected:
@@ -62,20 +62,11 @@ parseBidRequest(HttpAuctionHandler & connection,
     }   
 
     // Check for JSON content-type
-    if (!header.contentType.empty()) {
-        static const std::string delimiter = ";";
-
-        std::string::size_type posDelim = header.contentType.find(delimiter);
-        std::string content;
-
-        if(posDelim == std::string::npos)
-            content = header.contentType;
-        else {
-            content = header.contentType.substr(0, posDelim);
-            #if 0
-            std::string charset = header.contentType.substr(posDelim, header.contentType.length());
-            #endif
-        }
+    boost::string_ref contentType
+        = header.findHeader(HttpHeader::CONTENT_TYPE);
+    if (!contentType.empty()) {
+        // Ignore the charset, if any
+        boost::string_ref content = contentType.substr(0, contentType.find(';'));
 
         if(content != "application/json") {
             connection.sendErrorResponse("UNSUPPORTED_CONTENT_TYPE", "The request is required to use the 'Content-Type: application/json' header");
@@ -88,14 +79,15 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Check for the x-openrtb-version header
-    auto it = header.headers.find("x-openrtb-version");
-    if (it == header.headers.end()) {
+    boost::string_ref version
+        = header.findHeader(HttpHeader::OPENRTB_VERSION);
+    if (!version.data()) {
         connection.sendErrorResponse("MISSING_OPENRTB_HEADER", "The request is missing the 'x-openrtb-version' header");
         return none;
     }
 
     // Check that it's version 2.0
-    std::string openRtbVersion = it->second;
+    std::string openRtbVersion = version.to_string();
     if (openRtbVersion != "2.0") {
         connection.sendErrorResponse("UNSUPPORTED_OPENRTB_VERSION", "The request is required to be using version 2.0 of the OpenRTB protocol but requested " + openRtbVersion);
         return none;
@@ -124,13 +116,10 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Check if we want some reporting
-    auto verbose = header.headers.find("x-openrtb-verbose");
-    if(header.headers.end() != verbose) {
-        if(verbose->second == "1") {
-            if(!result->auctionId.notNull()) {
-                connection.sendErrorResponse("MISSING_ID", "The bid request requires the 'id' field");
-                return none;
-            }
+    if(header.findHeader("x-openrtb-verbose") == "1") {
+        if(!result->auctionId.notNull()) {
+            connection.sendErrorResponse("MISSING_ID", "The bid request requires the 'id' field");
+            return none;
         }
     }
     
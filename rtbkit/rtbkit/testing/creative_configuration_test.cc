@@ -296,3 +296,56 @@ BOOST_AUTO_TEST_CASE(test_error)
     BOOST_CHECK_THROW(conf.handleCreativeCompatibility(example1, true),
                       std::runtime_error);
 }
+
+namespace {
+struct TemplateStruct {};
+
+const std::string providerConfigTemplate = R"FIXTURE(
+{
+    "test":  {
+        "snippet" : "id=%{bidrequest.id}&did=%{bidrequest.ext.deviceid}&vt=%{bidrequest.ext.video.type}&page=%{bidrequest.site.page#urlencode}&missing=%{bidrequest.ext.nope}&w=%{bidrequest.video.width}&end"
+    }
+}
+)FIXTURE";
+
+}
+
+typedef CreativeConfiguration<TemplateStruct> TemplateCreativeConfiguration;
+
+BOOST_AUTO_TEST_CASE(test_compiled_template)
+{
+    TemplateCreativeConfiguration conf("test");
+    example1.providerConfig = Json::parse(providerConfigTemplate);
+
+    std::string snippet;
+    conf.addField("snippet",
+                  [&](const Json::Value & value, TemplateStruct &)
+                  {
+                      snippet = value.asString();
+                      return true;
+                  }).snippet();
+
+    auto result = conf.handleCreativeCompatibility(example1, true);
+    BOOST_CHECK(result.isCompatible);
+
+    RTBKIT::BidRequest bidrequest;
+    bidrequest.auctionId = Datacratic::Id("auction1");
+    bidrequest.ext["deviceid"] = "abcd-1234";
+    bidrequest.ext["video"]["type"] = 3;
+    bidrequest.site.reset(new OpenRTB::Site());
+    bidrequest.site->page = Datacratic::Url("http://example.com/page?q=1");
+    bidrequest.imp.emplace_back();
+    bidrequest.imp[0].video.reset(new OpenRTB::Video());
+    bidrequest.imp[0].video->w = 640;
+
+    RTBKIT::Auction::Response response;
+    TemplateCreativeConfiguration::Context context{example1, response, bidrequest, 0};
+
+    BOOST_CHECK_EQUAL(
+        "id=auction1&did=abcd-1234&vt=3"
+        "&page=http%3A%2F%2Fexample.com%2Fpage%3F&missing=&w=640&end",
+        conf.expand(snippet, context));
+
+    // A template that was never compiled is returned untouched
+    BOOST_CHECK_EQUAL("%{bidrequest.id}", conf.expand("%{bidrequest.id}", context));
+}
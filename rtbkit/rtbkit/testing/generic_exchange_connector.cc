@@ -77,21 +77,21 @@ getTimeAvailableMs(HttpAuctionHandler & connection,
 {
     double timeAvailableMs = 35;
 
-    auto it = header.headers.find("x-timeleft");
-    if (it == header.headers.end())
-        it = header.headers.find("timeleft");
+    boost::string_ref timeLeft = header.findHeader("x-timeleft");
+    if (!timeLeft.data())
+        timeLeft = header.findHeader("timeleft");
 
-    if (it != header.headers.end()) {
-        //cerr << "got X-TimeLeft of " << it->second << endl;
+    if (timeLeft.data()) {
+        //cerr << "got X-TimeLeft of " << timeLeft << endl;
 
-        const char * start = it->second.c_str();
-        const char * end = start + it->second.length();
+        const char * start = timeLeft.data();
+        const char * end = start + timeLeft.length();
         char * end2;
 
         double tm = strtod(start, &end2);
         if (end2 == end)
             timeAvailableMs = tm;
-        else cerr << "couldn't parse time " << it->second;
+        else cerr << "couldn't parse time " << timeLeft;
     }
 
     return timeAvailableMs;
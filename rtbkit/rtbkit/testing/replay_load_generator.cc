@@ -0,0 +1,754 @@
+/* replay_load_generator.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Open loop load generator for exchange connectors.  Replays captured bid
+   requests at a fixed rate or at the pace they were recorded, over many
+   keep-alive connections, and reports the latency distribution of the
+   responses for each status code.
+
+   Requests go out when they are due whether or not the previous ones were
+   answered, and their latency is counted from the time they were due
+   rather than from the time a connection was free to send them.  A server
+   which falls behind thus can't hide the time requests spend queued in
+   front of it (coordinated omission).
+*/
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+#include "jml/utils/exc_check.h"
+#include "soa/service/stat_aggregator.h"
+#include "rtbkit/common/testing/exchange_source.h"
+#include "rtbkit/testing/replay_samples.h"
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+namespace {
+
+/* How long to wait before connecting again after a failure. */
+const double RetryDelay = 0.1;
+
+double monotonicSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* REPLAY LOAD GENERATOR                                                     */
+/*****************************************************************************/
+
+struct ReplayLoadGenerator {
+
+    ReplayLoadGenerator(const NetworkAddress & address,
+                        vector<ReplaySample> samples,
+                        int numConnections, double timeout)
+        : samples(std::move(samples)), timeout(timeout),
+          connections(numConnections),
+          seq(0), busy(0), scheduled(0), sent(0), answered(0),
+          timeouts(0), errors(0), connectErrors(0),
+          epollFd(-1), timerFd(-1)
+    {
+        if (this->samples.empty())
+            throw ML::Exception("no request to replay");
+
+        addrinfo hint = { 0, AF_INET, SOCK_STREAM, 0, 0, 0, 0, 0 };
+        addrinfo * info = 0;
+        int res = getaddrinfo(address.host.c_str(),
+                              std::to_string(address.port).c_str(),
+                              &hint, &info);
+        if (res != 0)
+            throw ML::Exception("getaddrinfo: %s", gai_strerror(res));
+        memcpy(&addr, info->ai_addr, sizeof(addr));
+        freeaddrinfo(info);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        ExcCheckErrno(epollFd != -1, "epoll_create1");
+
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        ExcCheckErrno(timerFd != -1, "timerfd_create");
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = 0;
+        res = epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+        ExcCheckErrno(res != -1, "epoll_ctl");
+    }
+
+    ~ReplayLoadGenerator()
+    {
+        for (auto & connection: connections)
+            if (connection.fd != -1)
+                ::close(connection.fd);
+        ::close(timerFd);
+        ::close(epollFd);
+    }
+
+    /** Send requests at `qps` requests per second, or at the pace they were
+        recorded sped up `speedup` times if `qps` is 0, for `duration`
+        seconds or until `maxRequests` were scheduled.  Returns once every
+        request was answered or timed out.
+    */
+    void run(double qps, double speedup, double duration,
+             uint64_t maxRequests, double reportInterval)
+    {
+        // When following the recorded pace, requests go in the order they
+        // were received and the whole capture repeats as many times as
+        // needed, as if the next one started right after.
+        vector<double> offsets(samples.size(), 0.0);
+        double period;
+
+        if (qps == 0.0) {
+            stable_sort(samples.begin(), samples.end(),
+                        [] (const ReplaySample & s1, const ReplaySample & s2)
+                        {
+                            return s1.timestamp < s2.timestamp;
+                        });
+
+            double first = samples.front().timestamp;
+            double last = samples.back().timestamp;
+            if (last <= first)
+                throw ML::Exception("requests have no recorded timestamps");
+
+            for (unsigned i = 0;  i < samples.size();  ++i)
+                offsets[i] = (samples[i].timestamp - first) / speedup;
+            period = (last - first) / speedup
+                * samples.size() / (samples.size() - 1);
+        }
+        else {
+            for (unsigned i = 0;  i < samples.size();  ++i)
+                offsets[i] = i / qps;
+            period = samples.size() / qps;
+        }
+
+        size_t n = samples.size();
+        auto dueAt = [&] (uint64_t i)
+            {
+                return start + (i / n) * period + offsets[i % n];
+            };
+
+        start = monotonicSeconds();
+        for (auto & connection: connections)
+            connect(connection, start);
+
+        uint64_t next = 0;
+        double nextDue = dueAt(0);
+        bool scheduling = maxRequests != 0;
+        double nextReport = start + reportInterval;
+        double lastReport = start;
+        uint64_t lastSent = 0, lastAnswered = 0;
+
+        while (scheduling || !pending.empty() || busy > 0) {
+            double now = monotonicSeconds();
+
+            while (scheduling && nextDue <= now) {
+                pending.push_back(Pending(next % n, nextDue));
+                ++scheduled;
+                nextDue = dueAt(++next);
+                if (next == maxRequests || nextDue - start > duration)
+                    scheduling = false;
+            }
+
+            expire(now);
+            retryConnections(now);
+            dispatch(now);
+
+            if (now >= nextReport) {
+                double elapsed = now - lastReport;
+                cerr << ML::format("%7.1fs: %8.0f sent/s %8.0f answered/s "
+                                   "%6d in flight %8zd queued "
+                                   "%8lld timeouts %6lld errors\n",
+                                   now - start,
+                                   (sent - lastSent) / elapsed,
+                                   (answered - lastAnswered) / elapsed,
+                                   busy, pending.size(),
+                                   (long long)timeouts, (long long)errors);
+                lastReport = now;
+                lastSent = sent;
+                lastAnswered = answered;
+                nextReport = now + reportInterval;
+            }
+
+            double wakeAt = nextReport;
+            if (scheduling)
+                wakeAt = std::min(wakeAt, nextDue);
+            if (!pending.empty())
+                wakeAt = std::min(wakeAt, pending.front().due + timeout);
+            if (!inFlight.empty())
+                wakeAt = std::min(wakeAt, inFlight.front().deadline);
+            if (!down.empty())
+                wakeAt = std::min(wakeAt, now + RetryDelay);
+            armTimer(wakeAt);
+
+            epoll_event events[256];
+            int res = epoll_wait(epollFd, events, 256, -1);
+            if (res == -1 && errno == EINTR)
+                continue;
+            ExcCheckErrno(res != -1, "epoll_wait");
+
+            now = monotonicSeconds();
+            for (int i = 0;  i < res;  ++i) {
+                if (!events[i].data.ptr) {
+                    uint64_t expirations;
+                    while (::read(timerFd, &expirations, 8) == 8) ;
+                    continue;
+                }
+
+                handleEvents(*(Connection *)events[i].data.ptr,
+                             events[i].events, now);
+            }
+        }
+
+        finish = monotonicSeconds();
+    }
+
+    /** Dump throughput and latency percentiles per response code. */
+    void report(ostream & stream, double targetQps)
+    {
+        double elapsed = finish - start;
+
+        stream << ML::format("%lld requests sent over %d connections "
+                             "in %.2fs, %lld connection failures\n",
+                             (long long)sent, (int)connections.size(),
+                             elapsed, (long long)connectErrors);
+        if (targetQps > 0.0)
+            stream << ML::format("target throughput:   %10.1f req/s\n",
+                                 targetQps);
+        stream << ML::format("offered throughput:  %10.1f req/s\n",
+                             scheduled / elapsed);
+        stream << ML::format("achieved throughput: %10.1f req/s\n",
+                             answered / elapsed);
+        stream << endl;
+
+        stream << ML::format("%-10s %10s %10s %10s %10s %10s %10s\n",
+                             "code", "count", "mean ms", "p50 ms",
+                             "p99 ms", "p99.9 ms", "max ms");
+
+        auto printRow = [&] (const string & name,
+                             HistogramAggregator & histogram)
+            {
+                auto values = histogram.reset();
+                if (!values.count)
+                    return;
+                stream << ML::format("%-10s %10lld %10.3f %10.3f %10.3f "
+                                     "%10.3f %10.3f\n",
+                                     name.c_str(), (long long)values.count,
+                                     values.sum / values.count,
+                                     values.percentile(50),
+                                     values.percentile(99),
+                                     values.percentile(99.9),
+                                     values.max);
+            };
+
+        for (auto & entry: latencies)
+            printRow(entry.first, *entry.second);
+        printRow("answered", allAnswered);
+    }
+
+
+private:
+    struct Connection {
+        Connection()
+            : fd(-1), state(DOWN), output(0), written(0),
+              headerLength(0), contentLength(0), code(0),
+              closeAfter(false), due(0.0), retryAt(0.0), seq(0)
+        {
+        }
+
+        enum State {
+            DOWN,        ///< Not connected; will retry at retryAt
+            CONNECTING,
+            IDLE,
+            BUSY         ///< Waiting on the response to a request
+        };
+
+        int fd;
+        State state;
+
+        const string * output;  ///< Request being sent
+        size_t written;
+
+        string input;           ///< Response received so far
+        size_t headerLength;    ///< 0 until the headers are complete
+        size_t contentLength;
+        int code;
+        bool closeAfter;
+
+        double due;             ///< When the current request was due
+        double retryAt;
+        uint64_t seq;           ///< Identifies the current request
+    };
+
+    /** Request due but waiting for an idle connection. */
+    struct Pending {
+        Pending(size_t sample, double due)
+            : sample(sample), due(due)
+        {
+        }
+
+        size_t sample;
+        double due;
+    };
+
+    /** Request sent and waiting for its response.  Requests are sent in the
+        order they were due, so their deadlines are in order too; entries
+        whose request was answered are skipped when they reach the front.
+    */
+    struct InFlight {
+        InFlight(Connection * connection, uint64_t seq, double deadline)
+            : connection(connection), seq(seq), deadline(deadline)
+        {
+        }
+
+        Connection * connection;
+        uint64_t seq;
+        double deadline;
+    };
+
+    void record(const string & code, double latency)
+    {
+        auto & histogram = latencies[code];
+        if (!histogram)
+            histogram.reset(new HistogramAggregator());
+        histogram->record(latency * 1000.0);
+    }
+
+    void armTimer(double when)
+    {
+        itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = when;
+        spec.it_value.tv_nsec = (when - spec.it_value.tv_sec) * 1e9;
+
+        int res = timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, 0);
+        ExcCheckErrno(res != -1, "timerfd_settime");
+    }
+
+    void connect(Connection & connection, double now)
+    {
+        connection.fd = socket(AF_INET,
+                               SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ExcCheckErrno(connection.fd != -1, "socket");
+
+        int flag = 1;
+        setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY,
+                   &flag, sizeof(flag));
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = &connection;
+        int res = epoll_ctl(epollFd, EPOLL_CTL_ADD, connection.fd, &event);
+        ExcCheckErrno(res != -1, "epoll_ctl");
+
+        res = ::connect(connection.fd, (sockaddr *)&addr, sizeof(addr));
+        if (res == 0) {
+            connection.state = Connection::IDLE;
+            idle.push_back(&connection);
+        }
+        else if (errno == EINPROGRESS)
+            connection.state = Connection::CONNECTING;
+        else {
+            ++connectErrors;
+            disconnect(connection, now + RetryDelay);
+        }
+    }
+
+    /** Close the connection and connect again at the given time.  The
+        request it was busy with, if any, was accounted for by the caller.
+    */
+    void disconnect(Connection & connection, double retryAt)
+    {
+        if (connection.state == Connection::BUSY)
+            --busy;
+        else if (connection.state == Connection::IDLE)
+            idle.erase(std::find(idle.begin(), idle.end(), &connection));
+
+        ::close(connection.fd);
+        connection.fd = -1;
+        connection.state = Connection::DOWN;
+        connection.retryAt = retryAt;
+        down.push_back(&connection);
+    }
+
+    void fail(Connection & connection, double now)
+    {
+        if (connection.state == Connection::BUSY) {
+            record("error", now - connection.due);
+            ++errors;
+        }
+        else if (connection.state == Connection::CONNECTING)
+            ++connectErrors;
+
+        disconnect(connection, now + RetryDelay);
+    }
+
+    void retryConnections(double now)
+    {
+        vector<Connection *> ready;
+        auto it = std::partition(down.begin(), down.end(),
+                                 [&] (Connection * connection)
+                                 {
+                                     return connection->retryAt > now;
+                                 });
+        ready.insert(ready.end(), it, down.end());
+        down.erase(it, down.end());
+
+        for (auto connection: ready)
+            connect(*connection, now);
+    }
+
+    void expire(double now)
+    {
+        while (!pending.empty() && pending.front().due + timeout <= now) {
+            record("timeout", now - pending.front().due);
+            ++timeouts;
+            pending.pop_front();
+        }
+
+        while (!inFlight.empty()) {
+            InFlight & front = inFlight.front();
+            Connection & connection = *front.connection;
+            bool answered = connection.state != Connection::BUSY
+                || connection.seq != front.seq;
+
+            if (!answered && front.deadline > now)
+                break;
+
+            if (!answered) {
+                // The response may still come; the connection can't be
+                // used for anything else until then.
+                record("timeout", now - connection.due);
+                ++timeouts;
+                disconnect(connection, now);
+            }
+
+            inFlight.pop_front();
+        }
+    }
+
+    void dispatch(double now)
+    {
+        while (!pending.empty() && !idle.empty()) {
+            Connection & connection = *idle.back();
+            idle.pop_back();
+
+            const Pending & request = pending.front();
+            connection.state = Connection::BUSY;
+            connection.output = &samples[request.sample].request;
+            connection.written = 0;
+            connection.input.clear();
+            connection.headerLength = 0;
+            connection.due = request.due;
+            connection.seq = ++seq;
+            inFlight.push_back(InFlight(&connection, connection.seq,
+                                        request.due + timeout));
+            pending.pop_front();
+            ++busy;
+            ++sent;
+
+            flush(connection, now);
+        }
+    }
+
+    void flush(Connection & connection, double now)
+    {
+        const string & output = *connection.output;
+
+        while (connection.written < output.size()) {
+            ssize_t res = ::send(connection.fd,
+                                 output.data() + connection.written,
+                                 output.size() - connection.written,
+                                 MSG_NOSIGNAL);
+            if (res > 0)
+                connection.written += res;
+            else if (res == -1 && errno == EAGAIN)
+                return;
+            else {
+                fail(connection, now);
+                return;
+            }
+        }
+    }
+
+    void handleEvents(Connection & connection, uint32_t events, double now)
+    {
+        if (connection.state == Connection::DOWN)
+            return;
+
+        if (connection.state == Connection::CONNECTING) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error)
+                fail(connection, now);
+            else if (events & EPOLLOUT) {
+                connection.state = Connection::IDLE;
+                idle.push_back(&connection);
+                dispatch(now);
+            }
+            return;
+        }
+
+        if ((events & EPOLLOUT) && connection.state == Connection::BUSY)
+            flush(connection, now);
+
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+            receive(connection, now);
+    }
+
+    void receive(Connection & connection, double now)
+    {
+        char buffer[65536];
+
+        while (connection.state == Connection::IDLE
+               || connection.state == Connection::BUSY) {
+            ssize_t res = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (res > 0) {
+                if (connection.state == Connection::IDLE) {
+                    // Nothing was asked
+                    fail(connection, now);
+                    return;
+                }
+                connection.input.append(buffer, res);
+                parseResponse(connection, now);
+            }
+            else if (res == -1 && errno == EAGAIN)
+                return;
+            else if (connection.state == Connection::IDLE) {
+                // Keep-alive connection closed by the server
+                disconnect(connection, now);
+                return;
+            }
+            else {
+                fail(connection, now);
+                return;
+            }
+        }
+    }
+
+    void parseResponse(Connection & connection, double now)
+    {
+        const string & input = connection.input;
+
+        if (!connection.headerLength) {
+            auto end = input.find("\r\n\r\n");
+            if (end == string::npos)
+                return;
+
+            if (input.compare(0, 5, "HTTP/") != 0 || end < 12) {
+                fail(connection, now);
+                return;
+            }
+
+            connection.headerLength = end + 4;
+            connection.code = atoi(input.c_str() + 9);
+            connection.contentLength = 0;
+            connection.closeAfter = false;
+
+            for (size_t pos = input.find("\r\n") + 2;  pos < end;) {
+                size_t eol = input.find("\r\n", pos);
+                const char * line = input.c_str() + pos;
+                if (strncasecmp(line, "Content-Length:", 15) == 0)
+                    connection.contentLength = strtoul(line + 15, 0, 10);
+                else if (strncasecmp(line, "Connection:", 11) == 0) {
+                    string value = input.substr(pos + 11, eol - pos - 11);
+                    connection.closeAfter
+                        = strcasestr(value.c_str(), "close") != 0;
+                }
+                pos = eol + 2;
+            }
+        }
+
+        if (input.size() < connection.headerLength + connection.contentLength)
+            return;
+
+        double latency = now - connection.due;
+        record(std::to_string(connection.code), latency);
+        allAnswered.record(latency * 1000.0);
+        ++answered;
+
+        // Whatever wasn't sent yet of the request would be taken as the
+        // start of the next one.
+        if (connection.closeAfter
+            || connection.written < connection.output->size()) {
+            disconnect(connection, now);
+            return;
+        }
+
+        --busy;
+        connection.state = Connection::IDLE;
+        idle.push_back(&connection);
+        dispatch(now);
+    }
+
+    vector<ReplaySample> samples;
+    double timeout;
+    sockaddr_in addr;
+
+    vector<Connection> connections;
+    vector<Connection *> idle;
+    vector<Connection *> down;
+    deque<Pending> pending;
+    deque<InFlight> inFlight;
+
+    uint64_t seq;
+    int busy;
+    uint64_t scheduled;
+    uint64_t sent;
+    uint64_t answered;
+    uint64_t timeouts;
+    uint64_t errors;
+    uint64_t connectErrors;
+
+    double start;
+    double finish;
+
+    map<string, std::unique_ptr<HistogramAggregator> > latencies;
+    HistogramAggregator allAnswered;
+
+    int epollFd;
+    int timerFd;
+};
+
+
+int main(int argc, char *argv[])
+{
+    string server;
+    string filename;
+    string format;
+    string exchange("openrtb");
+    vector<string> headers;
+    string path("/auctions");
+    double qps(1000.0);
+    bool recordedPace(false);
+    double speedup(1.0);
+    int numConnections(64);
+    double timeoutMs(100.0);
+    double duration(10.0);
+    uint64_t maxRequests(0);
+    double reportInterval(1.0);
+
+    {
+        using namespace boost::program_options;
+
+        options_description configuration_options("Configuration options");
+
+        configuration_options.add_options()
+            ("server,s", value(&server),
+             "host:port of the exchange connector to load")
+            ("filename,f", value(&filename),
+             "requests to replay: one per line (.jsonl, datacratic auction "
+             "logs), HttpAuctionLogger captures, length prefixed .dat or a "
+             "single binary request (BrightRoll .dat)")
+            ("format", value(&format),
+             "lines, capture, dat or raw (guessed from the file by default)")
+            ("exchange,e", value(&exchange),
+             "headers to send along: openrtb, adx, brightroll, json or none")
+            ("header,H", value(&headers),
+             "extra 'Name: value' header to send along")
+            ("path,p", value(&path),
+             "path to post the requests to")
+            ("qps,q", value(&qps),
+             "requests per second to send")
+            ("recorded-pace,r", value(&recordedPace)->zero_tokens(),
+             "send requests at the pace they were recorded instead")
+            ("speedup", value(&speedup),
+             "how much faster than recorded to send them")
+            ("connections,c", value(&numConnections),
+             "number of keep-alive connections to open")
+            ("timeout,t", value(&timeoutMs),
+             "time in ms after which a request counts as timed out")
+            ("duration,d", value(&duration),
+             "number of seconds to send requests for")
+            ("n-requests,n", value(&maxRequests),
+             "maximum number of requests to send")
+            ("report-interval", value(&reportInterval),
+             "seconds between progress reports");
+
+        options_description all_opt;
+        all_opt.add(configuration_options);
+        all_opt.add_options()
+            ("help,h", "print this message");
+
+        variables_map vm;
+        store(command_line_parser(argc, argv)
+              .options(all_opt)
+              .run(),
+              vm);
+        notify(vm);
+
+        if (vm.count("help")) {
+            cerr << all_opt << endl;
+            exit(1);
+        }
+
+        if (server.empty()) {
+            cerr << "'server' parameter is required" << endl;
+            exit(1);
+        }
+
+        if (filename.empty()) {
+            cerr << "'filename' parameter is required" << endl;
+            exit(1);
+        }
+
+        if (!recordedPace && qps <= 0.0) {
+            cerr << "'qps' must be positive" << endl;
+            exit(1);
+        }
+    }
+
+    NetworkAddress address(server);
+
+    if (format.empty())
+        format = guessReplayFormat(filename);
+
+    vector<string> allHeaders = exchangeHeaders(exchange);
+    allHeaders.insert(allHeaders.end(), headers.begin(), headers.end());
+    ReplayRequestBuilder builder(server, path, allHeaders);
+
+    vector<ReplaySample> samples
+        = loadReplaySamples(filename, format, builder);
+
+    cerr << "loaded " << samples.size() << " requests from "
+         << filename << endl;
+
+    ReplayLoadGenerator generator(address, std::move(samples),
+                                  numConnections, timeoutMs / 1000.0);
+    generator.run(recordedPace ? 0.0 : qps, speedup, duration,
+                  maxRequests ? maxRequests : uint64_t(-1), reportInterval);
+    generator.report(cout, recordedPace ? 0.0 : qps);
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+/* replay_samples.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Captured bid requests replayed by the replay load generator.
+*/
+
+#include "replay_samples.h"
+#include "jml/arch/exception.h"
+#include "jml/arch/format.h"
+#include "jml/utils/filter_streams.h"
+#include "rtbkit/plugins/exchange/http_auction_handler.h"
+#include <fstream>
+
+
+using namespace std;
+
+
+namespace RTBKIT {
+
+namespace {
+
+/* One bid request per line.  Requests in the datacratic format carry the
+   time at which they were received in their "timestamp" field.
+*/
+vector<ReplaySample> loadLines(const string & filename,
+                               const ReplayRequestBuilder & builder)
+{
+    vector<ReplaySample> result;
+
+    ML::filter_istream stream(filename);
+    string line;
+    while (getline(stream, line)) {
+        if (line.empty())
+            continue;
+
+        double timestamp = 0.0;
+        auto pos = line.find("\"timestamp\":");
+        if (pos != string::npos)
+            timestamp = strtod(line.c_str() + pos + 12, 0);
+
+        result.push_back(ReplaySample(builder(line), timestamp));
+    }
+
+    return result;
+}
+
+vector<ReplaySample> loadCapture(const string & filename)
+{
+    vector<ReplaySample> result;
+
+    HttpAuctionLogger::parse(filename, [&] (const string & request)
+                             {
+                                 result.push_back(ReplaySample(request));
+                             });
+
+    return result;
+}
+
+uint64_t fileSize(ifstream & stream)
+{
+    stream.seekg(0, ios::end);
+    uint64_t size = stream.tellg();
+    stream.seekg(0, ios::beg);
+    return size;
+}
+
+/* Whether the file is a sequence of length prefixed records that ends
+   exactly with the last one.
+*/
+bool isLengthPrefixed(const string & filename)
+{
+    ifstream stream(filename.c_str(), ios::in | ios::binary);
+    if (!stream)
+        throw ML::Exception("couldn't open " + filename);
+
+    uint64_t size = fileSize(stream);
+    uint64_t offset = 0;
+    while (offset + 4 <= size) {
+        uint32_t len = 0;
+        stream.seekg(offset);
+        if (!stream.read((char *)&len, 4))
+            return false;
+        offset += 4 + uint64_t(len);
+    }
+
+    return size > 0 && offset == size;
+}
+
+vector<ReplaySample> loadDat(const string & filename,
+                             const ReplayRequestBuilder & builder)
+{
+    vector<ReplaySample> result;
+
+    ifstream stream(filename.c_str(), ios::in | ios::binary);
+    if (!stream)
+        throw ML::Exception("couldn't open " + filename);
+
+    uint64_t left = fileSize(stream);
+    for (;;) {
+        uint32_t len = 0;
+        if (!stream.read((char *)&len, 4))
+            break;
+        left -= 4;
+        if (len > left)
+            throw ML::Exception("truncated request in " + filename);
+        string body(len, '\0');
+        if (!stream.read(&body[0], len))
+            throw ML::Exception("truncated request in " + filename);
+        left -= len;
+        result.push_back(ReplaySample(builder(body)));
+    }
+
+    return result;
+}
+
+vector<ReplaySample> loadRaw(const string & filename,
+                             const ReplayRequestBuilder & builder)
+{
+    ifstream stream(filename.c_str(), ios::in | ios::binary);
+    if (!stream)
+        throw ML::Exception("couldn't open " + filename);
+
+    string body((istreambuf_iterator<char>(stream)),
+                istreambuf_iterator<char>());
+    if (body.empty())
+        throw ML::Exception(filename + " is empty");
+
+    return { ReplaySample(builder(body)) };
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* REPLAY REQUEST BUILDER                                                    */
+/*****************************************************************************/
+
+ReplayRequestBuilder::
+ReplayRequestBuilder(const string & host, const string & path,
+                     const vector<string> & headers)
+{
+    prefix = "POST " + path + " HTTP/1.1\r\n"
+        "Host: " + host + "\r\n";
+    for (auto & header: headers)
+        prefix += header + "\r\n";
+}
+
+string
+ReplayRequestBuilder::
+operator () (const string & body) const
+{
+    return prefix
+        + ML::format("Content-Length: %zd\r\n\r\n", body.size())
+        + body;
+}
+
+vector<string> exchangeHeaders(const string & exchange)
+{
+    vector<string> result;
+
+    if (exchange == "openrtb") {
+        result.push_back("Content-Type: application/json");
+        result.push_back("x-openrtb-version: 2.1");
+    }
+    else if (exchange == "adx")
+        result.push_back("Content-Type: application/octet-stream");
+    else if (exchange == "brightroll") {
+        result.push_back("Content-Type: application/octet-stream");
+        result.push_back("x-openrtb-version: 2.2");
+    }
+    else if (exchange == "json")
+        result.push_back("Content-Type: application/json");
+    else if (exchange != "none")
+        throw ML::Exception("unknown exchange '%s'", exchange.c_str());
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* LOADING                                                                   */
+/*****************************************************************************/
+
+string guessReplayFormat(const string & filename)
+{
+    if (filename.size() > 4
+        && filename.compare(filename.size() - 4, 4, ".dat") == 0)
+        return isLengthPrefixed(filename) ? "dat" : "raw";
+
+    ML::filter_istream stream(filename);
+    string line;
+    getline(stream, line);
+    if (line.compare(0, 5, "POST ") == 0)
+        return "capture";
+
+    return "lines";
+}
+
+vector<ReplaySample>
+loadReplaySamples(const string & filename, const string & format,
+                  const ReplayRequestBuilder & builder)
+{
+    if (format == "lines")
+        return loadLines(filename, builder);
+    if (format == "capture")
+        return loadCapture(filename);
+    if (format == "dat")
+        return loadDat(filename, builder);
+    if (format == "raw")
+        return loadRaw(filename, builder);
+
+    throw ML::Exception("unknown format '%s'", format.c_str());
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,73 @@
+/* replay_samples.h                                                -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Captured bid requests replayed by the replay load generator, and the
+   headers that the exchange connectors look for along with them.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* REPLAY SAMPLE                                                             */
+/*****************************************************************************/
+
+struct ReplaySample {
+    ReplaySample(std::string request = "", double timestamp = 0.0)
+        : request(std::move(request)), timestamp(timestamp)
+    {
+    }
+
+    std::string request;   ///< Complete HTTP request, ready to be sent
+    double timestamp;      ///< When it was recorded, or 0 if unknown
+};
+
+
+/*****************************************************************************/
+/* REPLAY REQUEST BUILDER                                                    */
+/*****************************************************************************/
+
+/** Wraps a bid request in a POST with the given headers. */
+struct ReplayRequestBuilder {
+    ReplayRequestBuilder(const std::string & host, const std::string & path,
+                         const std::vector<std::string> & headers);
+
+    std::string operator () (const std::string & body) const;
+
+    std::string prefix;
+};
+
+/** Headers the given exchange connector checks before it parses a body:
+    openrtb, adx, brightroll, json or none.
+*/
+std::vector<std::string> exchangeHeaders(const std::string & exchange);
+
+
+/*****************************************************************************/
+/* LOADING                                                                   */
+/*****************************************************************************/
+
+/** Format of a file of captured requests, from its contents:
+
+    - lines: one bid request per line, as in requests.jsonl or the
+      datacratic auction logs, compressed or not;
+    - capture: requests recorded by HttpAuctionLogger, headers included;
+    - dat: binary requests, each preceded by its length on 4 bytes;
+    - raw: the whole file is a single binary request, as in
+      brightroll-bidrequest.dat.
+*/
+std::string guessReplayFormat(const std::string & filename);
+
+/** Requests of the file in the given format.  Captures are sent as they
+    were received; the other formats are wrapped by the builder.
+*/
+std::vector<ReplaySample>
+loadReplaySamples(const std::string & filename, const std::string & format,
+                  const ReplayRequestBuilder & builder);
+
+} // namespace RTBKIT
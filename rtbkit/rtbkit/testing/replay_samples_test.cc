@@ -0,0 +1,102 @@
+/* replay_samples_test.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Tests for the loading of the requests replayed by the replay load
+   generator.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/testing/replay_samples.h"
+#include "jml/arch/exception.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std;
+using namespace RTBKIT;
+
+
+namespace {
+
+const string brightrollRequest("../plugins/testing/brightroll-bidrequest.dat");
+
+string readFile(const string & filename)
+{
+    ifstream stream(filename.c_str(), ios::in | ios::binary);
+    return string((istreambuf_iterator<char>(stream)),
+                  istreambuf_iterator<char>());
+}
+
+void writeFile(const string & filename, const string & contents)
+{
+    ofstream stream(filename.c_str(), ios::out | ios::binary);
+    stream.write(contents.data(), contents.size());
+}
+
+string lengthPrefixed(const vector<string> & bodies)
+{
+    string result;
+    for (auto & body: bodies) {
+        uint32_t len = body.size();
+        result.append((const char *)&len, 4);
+        result += body;
+    }
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_replay_brightroll_dat )
+{
+    ReplayRequestBuilder builder("localhost:12339", "/auctions",
+                                 exchangeHeaders("brightroll"));
+
+    // A single protobuf message, of which the first bytes would read as a
+    // length of 1.6GB
+    BOOST_CHECK_EQUAL(guessReplayFormat(brightrollRequest), "raw");
+    BOOST_CHECK_THROW(loadReplaySamples(brightrollRequest, "dat", builder),
+                      ML::Exception);
+
+    auto samples = loadReplaySamples(brightrollRequest, "raw", builder);
+    BOOST_REQUIRE_EQUAL(samples.size(), 1);
+
+    string body = readFile(brightrollRequest);
+    BOOST_REQUIRE_EQUAL(body.size(), 373);
+
+    const string & request = samples[0].request;
+    BOOST_CHECK_EQUAL(request.compare(0, 24, "POST /auctions HTTP/1.1\r"), 0);
+    BOOST_CHECK(request.find("Content-Type: application/octet-stream\r\n")
+                != string::npos);
+    BOOST_CHECK(request.find("Content-Length: 373\r\n\r\n") != string::npos);
+    BOOST_CHECK_EQUAL(request.substr(request.size() - body.size()), body);
+}
+
+BOOST_AUTO_TEST_CASE( test_replay_length_prefixed_dat )
+{
+    ReplayRequestBuilder builder("localhost:12339", "/auctions",
+                                 exchangeHeaders("adx"));
+
+    string path("./build/x86_64/tmp");
+    boost::filesystem::create_directories(path);
+    string filename = path + "/replay_samples_test.dat";
+    writeFile(filename, lengthPrefixed({ "first", "second request" }));
+
+    BOOST_CHECK_EQUAL(guessReplayFormat(filename), "dat");
+    auto samples = loadReplaySamples(filename, "dat", builder);
+    BOOST_REQUIRE_EQUAL(samples.size(), 2);
+    BOOST_CHECK_EQUAL(samples[0].request, builder("first"));
+    BOOST_CHECK_EQUAL(samples[1].request, builder("second request"));
+
+    // Cut in the middle of the second request
+    string truncated = lengthPrefixed({ "first", "second request" });
+    writeFile(filename, truncated.substr(0, truncated.size() - 3));
+
+    BOOST_CHECK_EQUAL(guessReplayFormat(filename), "raw");
+    BOOST_CHECK_THROW(loadReplaySamples(filename, "dat", builder),
+                      ML::Exception);
+
+    unlink(filename.c_str());
+}
@@ -0,0 +1,123 @@
+/* router_shards_test.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Runs the same load from the mock exchange through a router with a single
+   shard and through one with several, and compares their throughput.
+
+   The sharded router bids through the http bidder interface, which is
+   thread safe and so called from every shard at once; the agents bidder
+   would funnel every shard through the main loop.  It forwards the bid
+   requests to a second, single shard router in which the agents run.
+*/
+
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include "jml/utils/testing/watchdog.h"
+#include "rtbkit/plugins/exchange/openrtb_exchange_connector.h"
+#include "rtbkit/plugins/exchange/rtbkit_exchange_connector.h"
+#include "rtbkit/testing/bid_stack.h"
+
+using namespace Datacratic;
+using namespace RTBKIT;
+using namespace std;
+
+namespace {
+
+enum {
+    WORKERS = 8,              ///< mock exchange threads
+    REQUESTS = 2000,          ///< bid requests sent by each of them
+    SHARDS = 4
+};
+
+struct Result {
+    double elapsed;
+    int bids;
+};
+
+Result runStack(int numShards)
+{
+    Json::Value upstreamRouterConfig;
+    upstreamRouterConfig[0]["exchangeType"] = "openrtb";
+
+    Json::Value downstreamRouterConfig;
+    downstreamRouterConfig[0]["exchangeType"] = "rtbkit";
+
+    Json::Value upstreamBidderConfig;
+    upstreamBidderConfig["type"] = "http";
+    upstreamBidderConfig["adserver"]["winPort"] = 18143;
+    upstreamBidderConfig["adserver"]["eventPort"] = 18144;
+
+    Json::Value downstreamBidderConfig;
+    downstreamBidderConfig["type"] = "agents";
+
+    BidStack upstreamStack;
+    upstreamStack.routerShards = numShards;
+    BidStack downstreamStack;
+
+    Result result;
+
+    downstreamStack.runThen(
+        downstreamRouterConfig, downstreamBidderConfig, USD_CPM(10), 0,
+        [&] (Json::Value const & downstream) {
+
+            const auto & bids = downstream["workers"][0]["bids"];
+            upstreamBidderConfig["router"]["host"]
+                = "http://" + bids["url"].asString();
+            upstreamBidderConfig["router"]["path"]
+                = bids.get("resource", "/").asString();
+            upstreamBidderConfig["adserver"]["host"]
+                = "http://invalid-url-but-its-intended.com";
+
+            upstreamStack.runThen(
+                upstreamRouterConfig, upstreamBidderConfig, USD_CPM(20),
+                REQUESTS,
+                [&] (Json::Value const & config) {
+
+                    // See bidder_test: the filter registry is shared by
+                    // both routers.
+                    upstreamStack.services.router->filters.removeFilter(
+                        CreativeIdsExchangeFilter::name);
+
+                    Json::Value json = config;
+                    json["workers"][0]["threads"] = int(WORKERS);
+
+                    Date start = Date::now();
+                    {
+                        auto proxies = std::make_shared<ServiceProxies>();
+                        MockExchange mockExchange(proxies);
+                        mockExchange.start(json);
+                        // the destructor waits for the workers to be done
+                    }
+                    result.elapsed = Date::now().secondsSince(start);
+                });
+        });
+
+    auto events = upstreamStack.proxies->events->get(std::cerr);
+    result.bids = events["router.bid"];
+
+    return result;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_router_shards_throughput )
+{
+    ML::Watchdog watchdog(300.0);
+
+    const double requests = WORKERS * REQUESTS;
+
+    Result single = runStack(1);
+    Result sharded = runStack(SHARDS);
+
+    cerr << "1 shard:  " << single.bids << " bids, "
+         << requests / single.elapsed << " requests/s" << endl;
+    cerr << SHARDS << " shards: " << sharded.bids << " bids, "
+         << requests / sharded.elapsed << " requests/s" << endl;
+
+    BOOST_CHECK_GT(single.bids, 0);
+    BOOST_CHECK_GT(sharded.bids, 0);
+}
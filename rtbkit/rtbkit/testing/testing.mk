@@ -16,10 +16,14 @@ $(eval $(call library,integration_test_utils,generic_exchange_connector.cc mock_
 
 $(eval $(call test,win_cost_model_test,openrtb_exchange bidding_agent integration_test_utils,boost))
 $(eval $(call test,bidder_test,openrtb_exchange bidding_agent integration_test_utils,boost))
+$(eval $(call test,router_shards_test,openrtb_exchange bidding_agent integration_test_utils,boost manual))
 
 $(eval $(call program,mock_exchange_runner,integration_test_utils boost_program_options utils))
 $(eval $(call program,json_feeder,curlpp boost_program_options utils))
 $(eval $(call program,json_listener,boost_program_options services utils))
+$(eval $(call library,replay_samples,replay_samples.cc,exchange utils))
+$(eval $(call program,replay_load_generator,replay_samples exchange opstats boost_program_options utils))
+$(eval $(call test,replay_samples_test,replay_samples boost_filesystem boost_system,boost))
 
 $(eval $(call test,creative_configuration_test,rtb_router, boost))
 
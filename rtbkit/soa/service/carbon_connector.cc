@@ -118,7 +118,7 @@ StatAggregator * createNewLevel()
 
 StatAggregator * createNewOutcome(std::vector<int> percentiles)
 {
-    return new GaugeAggregator(GaugeAggregator::Outcome, std::move(percentiles));
+    return new HistogramAggregator(std::move(percentiles));
 }
 
 void
@@ -153,28 +153,28 @@ void
 MultiAggregator::
 recordHit(const std::string & stat)
 {
-    getAggregator(stat, createNewCounter).record(1.0);
+    getAggregator(stat, createNewCounter)->record(1.0);
 }
 
 void
 MultiAggregator::
 recordCount(const std::string & stat, float quantity)
 {
-    getAggregator(stat, createNewCounter).record(quantity);
+    getAggregator(stat, createNewCounter)->record(quantity);
 }
 
 void
 MultiAggregator::
 recordStableLevel(const std::string & stat, float value)
 {
-    getAggregator(stat, createNewStableLevel).record(value);
+    getAggregator(stat, createNewStableLevel)->record(value);
 }
 
 void
 MultiAggregator::
 recordLevel(const std::string & stat, float value)
 {
-    getAggregator(stat, createNewLevel).record(value);
+    getAggregator(stat, createNewLevel)->record(value);
 }
     
 void
@@ -182,9 +182,29 @@ MultiAggregator::
 recordOutcome(const std::string & stat, float value,
               std::vector<int> percentiles)
 {
-    getAggregator(stat, createNewOutcome, std::move(percentiles)).record(value);
+    getAggregator(stat, createNewOutcome, std::move(percentiles))->record(value);
 }
 
+std::shared_ptr<StatAggregator>
+MultiAggregator::
+registerStat(const std::string & stat,
+             StatEventType type,
+             std::vector<int> percentiles)
+{
+    switch (type) {
+    case ET_HIT:
+    case ET_COUNT:
+        return getAggregator(stat, createNewCounter);
+    case ET_STABLE_LEVEL:
+        return getAggregator(stat, createNewStableLevel);
+    case ET_LEVEL:
+        return getAggregator(stat, createNewLevel);
+    case ET_OUTCOME:
+        return getAggregator(stat, createNewOutcome, std::move(percentiles));
+    default:
+        throw ML::Exception("unknown stat type");
+    }
+}
 
 void
 MultiAggregator::
@@ -101,6 +101,19 @@ struct MultiAggregator {
     void recordOutcome(const std::string & stat, float value,
             std::vector<int> percentiles = DefaultOutcomePercentiles);
 
+    /** Register a stat up front and return its aggregator, which can be
+        kept around and recorded into directly.  That skips formatting the
+        name and looking it up for each event.  The aggregator is owned by
+        this object and stays registered until it is destroyed.
+
+        Recording into a handle is lock-free and uses per-thread slots, so it
+        doesn't contend with other threads recording into the same stat.
+    */
+    std::shared_ptr<StatAggregator>
+    registerStat(const std::string & stat,
+                 StatEventType type,
+                 std::vector<int> percentiles = DefaultOutcomePercentiles);
+
     /** Dump synchronously (taking the lock).  This should only be used in
         testing or debugging, not when connected to Carbon.
     */
@@ -150,16 +163,17 @@ private:
         then initialize it from the given function.
     */
     template<typename... Args>
-    StatAggregator & getAggregator(const std::string & stat,
-                                   StatAggregator * (*createFn) (Args...),
-                                   Args&&... args)
+    const std::shared_ptr<StatAggregator> &
+    getAggregator(const std::string & stat,
+                  StatAggregator * (*createFn) (Args...),
+                  Args&&... args)
     {
         if (!lookupCache.get())
             lookupCache.reset(new LookupCache());
 
         auto found = lookupCache->find(stat);
         if (found != lookupCache->end())
-            return *found->second->second;
+            return found->second->second;
 
         // Get the read lock to look for the aggregator
         std::unique_lock<Lock> guard(lock);
@@ -171,7 +185,7 @@ private:
 
             (*lookupCache)[stat] = found2;
 
-            return *found2->second;
+            return found2->second;
         }
 
         guard.unlock();
@@ -185,7 +199,7 @@ private:
 
         guard2.unlock();
         (*lookupCache)[stat] = found2;
-        return *found2->second;
+        return found2->second;
     }
     
     std::unique_ptr<std::thread> dumpingThread;
@@ -34,6 +34,15 @@ using namespace ML;
 
 namespace Datacratic {
 
+namespace {
+
+/* Shard serviced by the current event thread, if it belongs to a sharded
+   endpoint.  Transports opened from that thread are owned by its shard. */
+__thread const EndpointBase * currentEndpoint = 0;
+__thread int currentShard = -1;
+
+} // file scope
+
 /*****************************************************************************/
 /* ENDPOINT BASE                                                             */
 /*****************************************************************************/
@@ -43,7 +52,8 @@ EndpointBase(const std::string & name)
     : idle(1), modifyIdle(true),
       name_(name),
       threadsActive_(0),
-      numTransports(0), shutdown_(false), disallowTimers_(false),
+      numTransports(0), shutdown_(false), shardThreads_(false),
+      disallowTimers_(false),
       pollingMode_(MIN_CONTEXT_SWITCH_POLLING)
 {
     Epoller::init(16384);
@@ -70,6 +80,17 @@ setPollingMode(enum PollingMode mode)
 
     int timeout = modePollTimeout(mode);
     setPollTimeout(timeout);
+    for (auto & shard: shards)
+        shard->setPollTimeout(timeout);
+}
+
+void
+EndpointBase::
+shardThreads(bool value)
+{
+    if (eventThreads)
+        throw Exception("shardThreads must be called before spinup");
+    shardThreads_ = value;
 }
 
 void
@@ -119,6 +140,32 @@ spinup(int num_threads, bool synchronous)
 
     resourceUsage.resize(num_threads);
 
+    if (shardThreads_) {
+        if (num_threads < 1)
+            throw Exception("sharded endpoints need at least one thread");
+
+        auto wakeupData = make_shared<EpollData>(EpollData::WAKEUP,
+                                                 wakeup.fd());
+        auto nestedData = make_shared<EpollData>(EpollData::EPOLLER,
+                                                 selectFd());
+        {
+            MutexGuard guard(dataSetLock);
+            epollDataSet.insert(wakeupData);
+            epollDataSet.insert(nestedData);
+        }
+
+        shards.clear();
+        for (unsigned i = 0;  i < num_threads;  ++i) {
+            std::unique_ptr<Shard> shard(new Shard());
+            shard->init(16384, modePollTimeout(pollingMode_));
+            shard->addFd(wakeupData->fd, wakeupData.get());
+            shards.push_back(std::move(shard));
+        }
+
+        // The first thread also services our own epoll set
+        shards[0]->addFd(nestedData->fd, nestedData.get());
+    }
+
     for (unsigned i = 0;  i < num_threads;  ++i) {
         boost::thread * thread
             = eventThreads->create_thread
@@ -176,6 +223,12 @@ shutdown()
         }
     }
 
+    for (auto & shard: shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        for (const auto & it: shard->transportMapping)
+            it.first->closeAsync();
+    }
+
     disallowTimers_ = true;
     ML::memory_barrier();
     {
@@ -231,6 +284,7 @@ shutdown()
         eventThreads.reset();
     }
     eventThreadList.clear();
+    shards.clear();
 
     // Now undo the signal
     wakeup.read();
@@ -241,6 +295,8 @@ void
 EndpointBase::
 useThisThread()
 {
+    if (shardThreads_)
+        throw Exception("sharded endpoints can't use external threads");
     runEventThread(-1, -1);
 }
 
@@ -248,6 +304,11 @@ void
 EndpointBase::
 notifyNewTransport(const std::shared_ptr<TransportBase> & transport)
 {
+    if (shardThreads_ && currentEndpoint == this) {
+        notifyNewShardTransport(transport, currentShard);
+        return;
+    }
+
     Guard guard(lock);
 
     //cerr << "new transport " << transport << endl;
@@ -267,7 +328,7 @@ notifyNewTransport(const std::shared_ptr<TransportBase> & transport)
     startPolling(epollData);
 
     ML::atomic_inc(numTransports);
-    if (numTransports == 1 && modifyIdle)
+    if (numTransports == 1 && modifyIdle && !shardThreads_)
         idle.acquire();
     futex_wake(numTransports);
 
@@ -282,10 +343,47 @@ notifyNewTransport(const std::shared_ptr<TransportBase> & transport)
         onTransportOpen(transport.get());
 }
 
+void
+EndpointBase::
+notifyNewShardTransport(const std::shared_ptr<TransportBase> & transport,
+                        int shardNum)
+{
+    Shard & shard = *shards[shardNum];
+
+    auto epollData
+        = make_shared<EpollData>(EpollData::EpollDataType::TRANSPORT,
+                                 transport->epollFd_, shardNum);
+    epollData->transport = transport;
+    transport->shard_ = shardNum;
+
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (!shard.transportMapping.insert({transport, epollData}).second)
+            throw ML::Exception("active set already contains connection");
+        ++shard.numTransportsByHost[transport->getPeerName()];
+    }
+
+    startPolling(epollData);
+
+    // The idle semaphore would need a lock shared by all the threads to
+    // stay consistent; sleepUntilIdle() watches numTransports instead.
+    ML::atomic_inc(numTransports);
+    futex_wake(numTransports);
+
+    if (onTransportOpen)
+        onTransportOpen(transport.get());
+}
+
 void
 EndpointBase::
 startPolling(const shared_ptr<EpollData> & epollData)
 {
+    if (epollData->shard >= 0) {
+        // Kept alive by the shard's transport mapping or the acceptor
+        epollerFor(*epollData).addFdOneShot(epollData->fd, epollData.get());
+        return;
+    }
+
     MutexGuard guard(dataSetLock);
     auto inserted = epollDataSet.insert(epollData);
     if (!inserted.second)
@@ -297,6 +395,11 @@ void
 EndpointBase::
 stopPolling(const shared_ptr<EpollData> & epollData)
 { 
+    if (epollData->shard >= 0) {
+        epollerFor(*epollData).removeFd(epollData->fd);
+        return;
+    }
+
     removeFd(epollData->fd);
     MutexGuard guard(dataSetLock);
     epollDataSet.erase(epollData);
@@ -306,7 +409,17 @@ void
 EndpointBase::
 restartPolling(EpollData * epollDataPtr)
 {
-    restartFdOneShot(epollDataPtr->fd, epollDataPtr);
+    epollerFor(*epollDataPtr).restartFdOneShot(epollDataPtr->fd, epollDataPtr);
+}
+
+void
+EndpointBase::
+startAccepting(const std::shared_ptr<EpollData> & acceptData)
+{
+    if (acceptData->fdType != EpollData::ACCEPT
+        || acceptData->shard < 0 || acceptData->shard >= shards.size())
+        throw Exception("startAccepting needs a sharded accept fd");
+    startPolling(acceptData);
 }
 
 void
@@ -323,6 +436,11 @@ notifyCloseTransport(const std::shared_ptr<TransportBase> & transport)
     if (onTransportClose)
         onTransportClose(transport.get());
 
+    if (transport->shard_ >= 0) {
+        notifyCloseShardTransport(transport);
+        return;
+    }
+
     Guard guard(lock);
     if (!transportMapping.count(transport)) {
         cerr << "closed transport " << transport << " with fd "
@@ -349,10 +467,39 @@ notifyCloseTransport(const std::shared_ptr<TransportBase> & transport)
     --ntr;
     if (ntr <= 0)
         numTransportsByHost.erase(transport->getPeerName());
-    if (numTransports == 0 && modifyIdle)
+    if (numTransports == 0 && modifyIdle && !shardThreads_)
         idle.release();
 }
 
+void
+EndpointBase::
+notifyCloseShardTransport(const std::shared_ptr<TransportBase> & transport)
+{
+    Shard & shard = *shards[transport->shard_];
+
+    std::shared_ptr<EpollData> epollData;
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.transportMapping.find(transport);
+        if (it == shard.transportMapping.end())
+            throw ML::Exception("transportMapping didn't contain connection");
+        epollData = it->second;
+        shard.transportMapping.erase(it);
+
+        auto & ntr = shard.numTransportsByHost[transport->getPeerName()];
+        if (--ntr <= 0)
+            shard.numTransportsByHost.erase(transport->getPeerName());
+    }
+
+    stopPolling(epollData);
+
+    transport->zombie_ = true;
+    transport->closePeer();
+
+    ML::atomic_dec(numTransports);
+    futex_wake(numTransports);
+}
+
 void
 EndpointBase::
 notifyRecycleTransport(const std::shared_ptr<TransportBase> & transport)
@@ -364,6 +511,14 @@ void
 EndpointBase::
 sleepUntilIdle() const
 {
+    if (shardThreads_) {
+        while (numTransports != 0) {
+            int oldValue = numTransports;
+            ML::futex_wait(numTransports, oldValue, 0.1);
+        }
+        return;
+    }
+
     for (;;) {
         //cerr << "sleepUntilIdle " << this << ": numTransports = "
         //     << numTransports << endl;
@@ -412,8 +567,19 @@ std::map<std::string, int>
 EndpointBase::
 numConnectionsByHost() const
 {
-    Guard guard(lock);
-    return numTransportsByHost;
+    std::map<std::string, int> result;
+    {
+        Guard guard(lock);
+        result = numTransportsByHost;
+    }
+
+    for (auto & shard: shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        for (auto & entry: shard->numTransportsByHost)
+            result[entry.first] += entry.second;
+    }
+
+    return result;
 }
 
 Epoller::HandleEventResult
@@ -454,6 +620,15 @@ handleEpollEvent(epoll_event & event)
         }
         break;
     }
+    case EpollData::EpollDataType::ACCEPT:
+        epollDataPtr->onAccept();
+        break;
+    case EpollData::EpollDataType::EPOLLER: {
+        // Our own epoll set, nested in the first shard's
+        if (Epoller::handleEvents(0, 4, handleEvent) == -1)
+            return Epoller::SHUTDOWN;
+        break;
+    }
     case EpollData::EpollDataType::WAKEUP:
         // wakeup for shutdown
         return Epoller::SHUTDOWN;
@@ -508,6 +683,13 @@ runEventThread(int threadNum, int numThreads)
 {
     prctl(PR_SET_NAME,"EptCtrl",0,0,0);
 
+    Epoller * epoller = this;
+    if (shardThreads_) {
+        epoller = shards.at(threadNum).get();
+        currentEndpoint = this;
+        currentShard = threadNum;
+    }
+
     ML::atomic_inc(threadsActive_);
     futex_wake(threadsActive_);
     //cerr << "threadsActive_ " << threadsActive_ << endl;
@@ -515,13 +697,13 @@ runEventThread(int threadNum, int numThreads)
     while (!shutdown_) {
         switch (pollingMode_) {
         case MIN_CONTEXT_SWITCH_POLLING:
-            doMinCtxSwitchPolling(threadNum, numThreads);
+            doMinCtxSwitchPolling(*epoller, threadNum, numThreads);
             break;
         case MIN_LATENCY_POLLING:
-            doMinLatencyPolling(threadNum, numThreads);
+            doMinLatencyPolling(*epoller, threadNum, numThreads);
             break;
         case MIN_CPU_POLLING:
-            doMinCpuPolling(threadNum, numThreads);
+            doMinCpuPolling(*epoller, threadNum, numThreads);
             break;
         default:
             throw ML::Exception("unhandled polling mode");
@@ -530,13 +712,16 @@ runEventThread(int threadNum, int numThreads)
 
     // cerr << "thread shutting down" << endl;
 
+    currentEndpoint = 0;
+    currentShard = -1;
+
     ML::atomic_dec(threadsActive_);
     futex_wake(threadsActive_);
 }
 
 void
 EndpointBase::
-doMinCtxSwitchPolling(int threadNum, int numThreads)
+doMinCtxSwitchPolling(Epoller & epoller, int threadNum, int numThreads)
 {
     bool debug = false;
     int epoch = 0;
@@ -555,10 +740,13 @@ doMinCtxSwitchPolling(int threadNum, int numThreads)
             duty.notifyAfterSleep();
         };
 
-    // Where does my timeslice start?
-    double timesliceUs = 1000.0 / numThreads;
-    int myStartUs = timesliceUs * threadNum;
-    int myEndUs   = timesliceUs * (threadNum + 1);
+    // Where does my timeslice start?  Threads with their own epoll set
+    // don't need to take turns.
+    int numSlices = shardThreads_ ? 1 : numThreads;
+    int slice = shardThreads_ ? 0 : threadNum;
+    double timesliceUs = 1000.0 / numSlices;
+    int myStartUs = timesliceUs * slice;
+    int myEndUs   = timesliceUs * (slice + 1);
 
     if (debug) {
         static ML::Spinlock lock;
@@ -572,9 +760,12 @@ doMinCtxSwitchPolling(int threadNum, int numThreads)
     }
 
     Date lastCheck = Date::now();
+    Date lastTick = lastCheck;
     // bool forceInSlice = false;
 
     while (!shutdown_) {
+        checkEventThreadTick(lastTick);
+
         Date now = Date::now();
         
         if (now.secondsSince(lastCheck) > 1.0 && debug) {
@@ -627,8 +818,8 @@ doMinCtxSwitchPolling(int threadNum, int numThreads)
             if (usToWait < 0 || usToWait > timesliceUs)
                 usToWait = timesliceUs;
 
-            int numHandled = handleEvents(usToWait, 4, handleEvent,
-                                          beforeSleep, afterSleep);
+            int numHandled = epoller.handleEvents(usToWait, 4, handleEvent,
+                                                  beforeSleep, afterSleep);
             if (debug && false)
                 cerr << "  in slice: handled " << numHandled << " events "
                      << "for " << usToWait << " microseconds "
@@ -640,8 +831,8 @@ doMinCtxSwitchPolling(int threadNum, int numThreads)
         else {
             // No... try to handle something and then sleep if we don't
             // find anything to do
-            int numHandled = handleEvents(0, 1, handleEvent,
-                                          beforeSleep, afterSleep);
+            int numHandled = epoller.handleEvents(0, 1, handleEvent,
+                                                  beforeSleep, afterSleep);
             if (debug && false)
                 cerr << "  out of slice: handled " << numHandled << " events"
                      << endl;
@@ -674,11 +865,14 @@ doMinCtxSwitchPolling(int threadNum, int numThreads)
 
 void
 EndpointBase::
-doMinLatencyPolling(int threadNum, int numThreads)
+doMinLatencyPolling(Epoller & epoller, int threadNum, int numThreads)
 {
     int epoch = 0;
+    Date lastTick = Date::now();
 
     while (!shutdown_) {
+        checkEventThreadTick(lastTick);
+
         // sync with the loop monitor request
         int i = resourceEpoch;
         if(i != epoch) {
@@ -696,13 +890,13 @@ doMinLatencyPolling(int threadNum, int numThreads)
             epoch = i;
         }
 
-        handleEvents(0, 1, handleEvent);
+        epoller.handleEvents(0, 1, handleEvent);
     }
 }
 
 void
 EndpointBase::
-doMinCpuPolling(int threadNum, int numThreads)
+doMinCpuPolling(Epoller & epoller, int threadNum, int numThreads)
 {
     bool debug = false;
 
@@ -724,9 +918,12 @@ doMinCpuPolling(int threadNum, int numThreads)
     }
 
     Date lastCheck = Date::now();
+    Date lastTick = lastCheck;
 
+    // The poll timeout of a second wakes up an idle thread for its tick.
     while (!shutdown_) {
-        handleEvents(0, -1, handleEvent, beforeSleep, afterSleep);
+        epoller.handleEvents(0, -1, handleEvent, beforeSleep, afterSleep);
+        checkEventThreadTick(lastTick);
 
         Date now = Date::now();
         if (now.secondsSince(lastCheck) > 1.0 && debug) {
@@ -746,6 +943,21 @@ doMinCpuPolling(int threadNum, int numThreads)
     }
 }
 
+void
+EndpointBase::
+checkEventThreadTick(Date & lastTick)
+{
+    if (!onEventThreadTick)
+        return;
+
+    Date now = Date::now();
+    if (now.secondsSince(lastTick) < 1.0)
+        return;
+
+    lastTick = now;
+    onEventThreadTick();
+}
+
 int
 EndpointBase::
 modePollTimeout(enum PollingMode mode)
@@ -90,6 +90,13 @@ struct EndpointBase : public Epoller {
     /** Function that will be called to know if we're finished. */
     boost::function<bool ()> onCheckFinished;
 
+    /** Function called about once a second by each event thread, on the
+        thread itself, whether it has handled any events or not.  Meant for
+        state that only the thread that owns it can clean up.  Must be set
+        before spinup.
+    */
+    boost::function<void ()> onEventThreadTick;
+
     /** Sleep until there are no active connections. */
     void sleepUntilIdle() const;
 
@@ -143,19 +150,41 @@ struct EndpointBase : public Epoller {
     */
     virtual void spinup(int num_threads, bool synchronous);
 
+    /** Give each event thread its own epoll set, and connection table,
+        instead of having all of them share the endpoint's.  A passive
+        endpoint then also gives each thread its own listening socket bound
+        to the same port with SO_REUSEPORT, so that the kernel spreads the
+        connections between the threads.  A connection is only ever handled
+        by the thread that accepted it.
+
+        Timers and connections that weren't accepted by one of the threads
+        stay in the endpoint's epoll set, which the first thread services.
+
+        Must be called before spinup().
+    */
+    void shardThreads(bool value);
+
+    bool threadsSharded() const { return shardThreads_; }
+
+    /** Number of threads with their own epoll set; 0 unless sharded. */
+    int numShards() const { return shards.size(); }
+
     /* internal storage */
     struct EpollData {
         enum EpollDataType {
             INVALID,
             TRANSPORT,
             TIMER,
-            WAKEUP
+            WAKEUP,
+            ACCEPT,
+            EPOLLER
         };
 
-        EpollData(EpollData::EpollDataType fdType, int fd)
-            : fdType(fdType), fd(fd), transport(nullptr)
+        EpollData(EpollData::EpollDataType fdType, int fd, int shard = -1)
+            : fdType(fdType), fd(fd), shard(shard), transport(nullptr)
         {
-            if (fdType != TRANSPORT && fdType != TIMER && fdType != WAKEUP) {
+            if (fdType != TRANSPORT && fdType != TIMER && fdType != WAKEUP
+                && fdType != ACCEPT && fdType != EPOLLER) {
                 throw ML::Exception("no such fd type");
             }
         }
@@ -163,8 +192,16 @@ struct EndpointBase : public Epoller {
         EpollDataType fdType;
         int fd;
 
+        /* Thread whose epoll set holds the fd, or -1 for the endpoint's */
+        int shard;
+
         std::shared_ptr<TransportBase> transport; /* TRANSPORT */
         OnTimer onTimer;                          /* TIMER */
+
+        /* ACCEPT: called by the owning thread when the listening socket is
+           readable.  It must restart the polling itself unless the socket
+           is being closed. */
+        std::function<void ()> onAccept;
     };
 
     // Get the polling start time for auction handler
@@ -222,6 +259,13 @@ protected:
     virtual void
     notifyCloseTransport(const std::shared_ptr<TransportBase> & transport);
 
+    /** Same as above for a connection owned by one of the threads of a
+        sharded endpoint.  Only the thread's own table is locked.
+    */
+    void notifyNewShardTransport(const std::shared_ptr<TransportBase> & transport,
+                                 int shardNum);
+    void notifyCloseShardTransport(const std::shared_ptr<TransportBase> & transport);
+
     /** Tell the endpoint that a connection has been recycled.   Default
         simply forwards to notifyCloseTransport.
     */
@@ -239,6 +283,11 @@ protected:
     /** Remove the transport from the set of events to be polled. */
     virtual void stopPolling(const std::shared_ptr<EpollData> & epollData);
 
+    /** Sharded endpoints only: poll the listening socket of acceptData in
+        the epoll set of the thread given by its shard.
+    */
+    void startAccepting(const std::shared_ptr<EpollData> & acceptData);
+
     /** Perform the given callback asynchronously (in a worker thread) in the
         context of the given transport.
     */
@@ -277,6 +326,20 @@ private:
 
     /* Are we shutting down? */
     bool shutdown_;
+
+    /* Does each event thread have its own epoll set? */
+    bool shardThreads_;
+
+    /** State owned by one event thread of a sharded endpoint.  The lock is
+        only ever contended by shutdown and the connection statistics.
+    */
+    struct Shard : public Epoller {
+        mutable std::mutex lock;
+        TransportMapping transportMapping;
+        std::map<std::string, int> numTransportsByHost;
+    };
+
+    std::vector<std::unique_ptr<Shard> > shards;
     bool disallowTimers_;
 
    //Poll start time
@@ -296,9 +359,21 @@ private:
     void runEventThread(int threadNum, int numThreads);
 
     /** Mode-specific polling loops. */
-    void doMinCpuPolling(int threadNum, int numThreads);
-    void doMinCtxSwitchPolling(int threadNum, int numThreads);
-    void doMinLatencyPolling(int threadNum, int numThreads);
+    void doMinCpuPolling(Epoller & epoller, int threadNum, int numThreads);
+    void doMinCtxSwitchPolling(Epoller & epoller,
+                               int threadNum, int numThreads);
+    void doMinLatencyPolling(Epoller & epoller, int threadNum, int numThreads);
+
+    /** Call onEventThreadTick if a second went by since lastTick. */
+    void checkEventThreadTick(Date & lastTick);
+
+    /** Epoll set that holds the given fd. */
+    Epoller & epollerFor(const EpollData & epollData)
+    {
+        return epollData.shard < 0
+            ? static_cast<Epoller &>(*this)
+            : static_cast<Epoller &>(*shards[epollData.shard]);
+    }
 
     /** Return the timeout value to use when polling, depending on the given
         mode. */
@@ -0,0 +1,779 @@
+/* hashed_timeout_map.h                                            -*- C++ -*-
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Map from key -> value with inbuilt timeouts.  Same interface as
+   TimeoutMap, but backed by an open addressing hash table and a hierarchical
+   timing wheel with millisecond slots instead of two trees, so that
+   inserting, erasing and expiring an entry are O(1) and don't allocate once
+   the map has grown to its working size.
+*/
+
+#ifndef __service__hashed_timeout_map_h__
+#define __service__hashed_timeout_map_h__
+
+#include "soa/types/date.h"
+#include "jml/arch/exception.h"
+#include <boost/function.hpp>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <math.h>
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* HASHED TIMEOUT MAP                                                        */
+/*****************************************************************************/
+
+/** Entries live in chunks that never move, so that references and
+    iterators to an entry stay valid until it's erased.  The hash table only
+    holds entry numbers and uses linear probing with backward shift deletion.
+
+    The timing wheel has 256 slots of 1ms, then four levels of 64 slots
+    covering 256ms, 16s, 17 minutes and 18 hours each; entries further away
+    than that sit in the last slot until they get close enough.  An entry in
+    a higher level is moved down ("cascaded") when the wheel reaches the
+    start of its slot, so each entry is moved at most four times.
+
+    Expiring the map advances the wheel one millisecond at a time, skipping
+    over stretches of the wheel that are known to be empty.
+*/
+
+template<typename Key, class Value, class Hash = std::hash<Key> >
+struct HashedTimeoutMap {
+
+    HashedTimeoutMap(double defaultTimeout = -INFINITY)
+        : defaultTimeout(defaultTimeout),
+          numEntries(0), numAllocated(0), freeList(NONE),
+          wheelTick(tickOf(Date::now())), wheelSize(0),
+          slots(NUM_SLOTS, uint32_t(NONE)), mask(0)
+    {
+        for (unsigned i = 0;  i < NUM_LEVELS;  ++i)
+            levelSize[i] = 0;
+    }
+
+    ~HashedTimeoutMap()
+    {
+        clear();
+    }
+
+    double defaultTimeout;
+
+    boost::function<void (const std::string & reason)> throwException;
+
+    void doThrowException(const std::string & reason) const
+    {
+        if (throwException) throwException(reason);
+        else throw ML::Exception(reason);
+        std::cerr << "HashedTimeoutMap exception thrower returned" << std::endl;
+        abort();
+    }
+
+    struct Node : public Value {
+        Node() {}
+        Node(const Value & val, Date timeout)
+            : Value(val), timeout(timeout)
+        {
+        }
+
+        Node(Value && val, Date timeout)
+            : Value(std::move(val)), timeout(timeout)
+        {
+        }
+
+        Date timeout;
+    };
+
+    typedef std::pair<const Key, Node> value_type;
+
+private:
+    struct Entry;
+
+    template<typename Map, typename Ref>
+    struct IteratorT
+        : public std::iterator<std::forward_iterator_tag,
+                               typename std::remove_reference<Ref>::type> {
+        IteratorT(Map * map = 0, uint32_t index = 0)
+            : map(map), index(index)
+        {
+        }
+
+        template<typename Map2, typename Ref2>
+        IteratorT(const IteratorT<Map2, Ref2> & other)
+            : map(other.map), index(other.index)
+        {
+        }
+
+        Ref operator * () const { return map->entry(index).kv(); }
+        typename std::remove_reference<Ref>::type * operator -> () const
+        {
+            return &map->entry(index).kv();
+        }
+
+        IteratorT & operator ++ ()
+        {
+            index = map->nextLive(index + 1);
+            return *this;
+        }
+
+        IteratorT operator ++ (int)
+        {
+            IteratorT result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator == (const IteratorT & other) const
+        {
+            return index == other.index;
+        }
+
+        bool operator != (const IteratorT & other) const
+        {
+            return index != other.index;
+        }
+
+        Map * map;
+        uint32_t index;
+    };
+
+public:
+    typedef IteratorT<HashedTimeoutMap, value_type &> iterator;
+    typedef IteratorT<const HashedTimeoutMap, const value_type &> const_iterator;
+
+    /** Returns true if the key is in the map. */
+    bool count(const Key & key) const
+    {
+        return findIndex(key, hashOf(key)) != NONE;
+    }
+
+    /** Access the entry for the given node.  If it already exists then
+        return the existing entry; otherwise insert it with the default
+        timeout.
+    */
+    Node & operator [] (const Key & key)
+    {
+        uint64_t hash = hashOf(key);
+        uint32_t index = findIndex(key, hash);
+        if (index != NONE)
+            return entry(index).kv().second;
+
+        if (!std::isnormal(defaultTimeout) || defaultTimeout < 0.0)
+            doThrowException("no default timeout specified and insert "
+                             "not used");
+        Date timeout = Date::now().plusSeconds(defaultTimeout);
+        return entry(add(key, hash, Node(Value(), timeout))).kv().second;
+    }
+
+    /** Return the given key or insert a default value if it doesn't exist.
+        Updates the timeout to the given value.
+    */
+    Node & access(const Key & key, Date timeout)
+    {
+        uint64_t hash = hashOf(key);
+        uint32_t index = findIndex(key, hash);
+        if (index == NONE)
+            return entry(add(key, hash, Node(Value(), timeout))).kv().second;
+
+        reschedule(index, timeout);
+        return entry(index).kv().second;
+    }
+
+    /** Insert the given key, value pair with the given timeout.  Throws an
+        exception if the key already exists.
+    */
+    Node & insert(const Key & key, const Value & value, Date timeout)
+    {
+        uint64_t hash = hashOf(key);
+        if (findIndex(key, hash) != NONE)
+            doThrowException("HashedTimeoutMap: "
+                             "attempt to re-insert existing key");
+        return entry(add(key, hash, Node(value, timeout))).kv().second;
+    }
+
+    /** Insert the given key, value pair with the given timeout.  Throws an
+        exception if the key already exists.
+    */
+    Node & insert(const Key & key, Value && value, Date timeout)
+    {
+        uint64_t hash = hashOf(key);
+        if (findIndex(key, hash) != NONE)
+            doThrowException("HashedTimeoutMap: "
+                             "attempt to re-insert existing key");
+        return entry(add(key, hash, Node(std::move(value), timeout)))
+            .kv().second;
+    }
+
+    /** Update the given key which must already exist. */
+    Node & update(const Key & key, Value && value)
+    {
+        auto it = find(key);
+        if (it == end())
+            doThrowException("HashedTimeoutMap: "
+                             "attempt to update nonexistant key");
+        Value & v = it->second;
+        v = std::move(value);
+        return it->second;
+    }
+
+    /** Update the given key which must already exist. */
+    Node & update(const Key & key, const Value & value)
+    {
+        auto it = find(key);
+        if (it == end())
+            doThrowException("HashedTimeoutMap: "
+                             "attempt to update nonexistant key");
+        Value & v = it->second;
+        v = value;
+        return it->second;
+    }
+
+    void updateTimeout(const Key & key, Date timeout)
+    {
+        auto it = find(key);
+        if (it == end())
+            doThrowException("HashedTimeoutMap: "
+                             "attempt to update nonexistant key");
+        updateTimeout(it, timeout);
+    }
+
+    void updateTimeout(const iterator & it, Date timeout)
+    {
+        if (it == end())
+            throw ML::Exception("attempt to update wrong timeout");
+        reschedule(it.index, timeout);
+    }
+
+    /** Call the callback on any which have expired, removing them from
+        the map unless the callback returns a new expiry date.  The entries
+        are still in the map while the callbacks run.
+    */
+    template<typename Callback>
+    void expire(const Callback & callback, Date now = Date::now())
+    {
+        collectExpired(now);
+
+        for (auto & e : expiring) {
+            Entry & en = entry(e.first);
+            if (en.generation != e.second || en.slot != EXPIRING)
+                continue;  // erased or rescheduled by an earlier callback
+
+            value_type & kv = en.kv();
+            Date newExpiry = callback(kv.first, kv.second);
+            if (newExpiry != Date())
+                reschedule(e.first, newExpiry);
+            else erase(e.first);
+        }
+        expiring.clear();
+    }
+
+    /** Remove any which have expired. */
+    void expire(Date now = Date::now())
+    {
+        collectExpired(now);
+
+        for (auto & e : expiring)
+            erase(e.first);
+        expiring.clear();
+    }
+
+    /** Earliest time at which expire() can have something to do: never
+        later than the first timeout in the map, and infinity when it's
+        empty.  Entries in the higher levels of the wheel are only counted
+        from the time that they can be cascaded down.
+    */
+    Date nextExpiry() const
+    {
+        const int64_t none = std::numeric_limits<int64_t>::max();
+        int64_t next = none;
+
+        if (levelSize[0] != 0) {
+            for (int64_t tick = wheelTick;
+                 tick < wheelTick + LEVEL0_SLOTS;  ++tick) {
+                if (slots[slotOf(0, tick)] != NONE) {
+                    next = tick;
+                    break;
+                }
+            }
+        }
+
+        for (unsigned level = 1;  level < NUM_LEVELS;  ++level) {
+            if (levelSize[level] == 0) continue;
+            int64_t width = int64_t(1) << shiftOf(level);
+            next = std::min(next, (wheelTick / width + 1) * width);
+        }
+
+        if (next == none)
+            return Date::positiveInfinity();
+        return Date::fromSecondsSinceEpoch(next / 1000.0);
+    }
+
+    Value get(const Key & key) const
+    {
+        auto it = find(key);
+        if (it == end()) return Value();
+        return it->second;
+    }
+
+    iterator find(const Key & key)
+    {
+        uint32_t index = findIndex(key, hashOf(key));
+        return iterator(this, index == NONE ? numAllocated : index);
+    }
+
+    const_iterator find(const Key & key) const
+    {
+        uint32_t index = findIndex(key, hashOf(key));
+        return const_iterator(this, index == NONE ? numAllocated : index);
+    }
+
+    iterator begin()
+    {
+        return iterator(this, nextLive(0));
+    }
+
+    iterator end()
+    {
+        return iterator(this, numAllocated);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, nextLive(0));
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, numAllocated);
+    }
+
+    /** Remove the entry for the given key.  Returns true if it was erased
+        or false otherwise.
+    */
+    bool erase(const Key & key)
+    {
+        uint32_t index = findIndex(key, hashOf(key));
+        if (index == NONE) return false;
+        erase(index);
+        return true;
+    }
+
+    void erase(const iterator & it)
+    {
+        if (it == end())
+            doThrowException("erasing with invalid iterator");
+        erase(it.index);
+    }
+
+    size_t size() const
+    {
+        return numEntries;
+    }
+
+    bool empty() const
+    {
+        return numEntries == 0;
+    }
+
+    void clear()
+    {
+        for (uint32_t i = 0;  i < numAllocated;  ++i) {
+            Entry & en = entry(i);
+            if (en.slot != FREE)
+                en.kv().~value_type();
+        }
+        chunks.clear();
+        buckets.clear();
+        expiring.clear();
+        mask = 0;
+        numEntries = numAllocated = 0;
+        freeList = NONE;
+        std::fill(slots.begin(), slots.end(), uint32_t(NONE));
+        for (unsigned i = 0;  i < NUM_LEVELS;  ++i)
+            levelSize[i] = 0;
+        wheelSize = 0;
+    }
+
+private:
+    HashedTimeoutMap(const HashedTimeoutMap &) = delete;
+    void operator = (const HashedTimeoutMap &) = delete;
+
+    enum {
+        NONE = 0xffffffff,
+
+        /* Value of Entry::slot when it's not in the wheel */
+        FREE = 0xffffffff,     ///< on the free list
+        EXPIRING = 0xfffffffe, ///< expired, waiting for its callback
+
+        LEVEL0_BITS = 8,
+        LEVEL_BITS = 6,
+        NUM_LEVELS = 5,
+        LEVEL0_SLOTS = 1 << LEVEL0_BITS,
+        LEVEL_SLOTS = 1 << LEVEL_BITS,
+        NUM_SLOTS = LEVEL0_SLOTS + (NUM_LEVELS - 1) * LEVEL_SLOTS,
+
+        CHUNK_BITS = 8,
+        CHUNK_SIZE = 1 << CHUNK_BITS
+    };
+
+    struct Entry {
+        typename std::aligned_storage<
+            sizeof(value_type),
+            std::alignment_of<value_type>::value>::type storage;
+
+        value_type & kv()
+        {
+            return *reinterpret_cast<value_type *>(&storage);
+        }
+
+        const value_type & kv() const
+        {
+            return *reinterpret_cast<const value_type *>(&storage);
+        }
+
+        uint64_t hash;
+        int64_t tick;         ///< millisecond of the timeout
+        uint32_t slot;        ///< wheel slot, FREE or EXPIRING
+        uint32_t prev, next;  ///< links in the wheel slot or the free list
+        uint32_t generation;  ///< incremented whenever the entry is freed
+    };
+
+    size_t numEntries;
+    uint32_t numAllocated;
+    uint32_t freeList;
+    std::vector<std::unique_ptr<Entry[]> > chunks;
+
+    /** Next millisecond the wheel will expire; everything before it has
+        already been expired.
+    */
+    int64_t wheelTick;
+    size_t wheelSize;
+    size_t levelSize[NUM_LEVELS];
+    std::vector<uint32_t> slots;
+
+    std::vector<uint32_t> buckets;
+    size_t mask;
+
+    /** Entries collected by expire(), with their generation. */
+    std::vector<std::pair<uint32_t, uint32_t> > expiring;
+
+    Entry & entry(uint32_t index)
+    {
+        return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+    }
+
+    const Entry & entry(uint32_t index) const
+    {
+        return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+    }
+
+    uint32_t nextLive(uint32_t index) const
+    {
+        while (index < numAllocated && entry(index).slot == FREE)
+            ++index;
+        return index;
+    }
+
+    static uint64_t hashOf(const Key & key)
+    {
+        // Spread the bits since the table is indexed by the low ones
+        uint64_t h = Hash()(key);
+        h *= 0x9e3779b97f4a7c15ULL;
+        return h ^ (h >> 29);
+    }
+
+    static int64_t tickOf(Date date)
+    {
+        double ms = date.secondsSinceEpoch() * 1000.0;
+        if (!(ms < 1e15)) return 1000000000000000LL;  // includes NaN
+        if (ms < -1e15) return -1000000000000000LL;
+        return (int64_t)floor(ms);
+    }
+
+    /*************************************************************************/
+    /* HASH TABLE                                                            */
+    /*************************************************************************/
+
+    uint32_t findIndex(const Key & key, uint64_t hash) const
+    {
+        if (buckets.empty()) return NONE;
+        for (size_t i = hash & mask;;  i = (i + 1) & mask) {
+            uint32_t index = buckets[i];
+            if (index == NONE) return NONE;
+            const Entry & en = entry(index);
+            if (en.hash == hash && en.kv().first == key)
+                return index;
+        }
+    }
+
+    void insertBucket(uint32_t index, uint64_t hash)
+    {
+        size_t i = hash & mask;
+        while (buckets[i] != NONE)
+            i = (i + 1) & mask;
+        buckets[i] = index;
+    }
+
+    void removeBucket(uint32_t index, uint64_t hash)
+    {
+        size_t i = hash & mask;
+        while (buckets[i] != index)
+            i = (i + 1) & mask;
+
+        // Shift back the entries of the cluster that would no longer be
+        // reachable from their home bucket.
+        for (size_t j = (i + 1) & mask;  buckets[j] != NONE;
+             j = (j + 1) & mask) {
+            size_t home = entry(buckets[j]).hash & mask;
+            bool reachable = i <= j
+                ? (i < home && home <= j)
+                : (i < home || home <= j);
+            if (reachable) continue;
+            buckets[i] = buckets[j];
+            i = j;
+        }
+        buckets[i] = NONE;
+    }
+
+    void growBuckets()
+    {
+        size_t newSize = buckets.empty() ? 64 : buckets.size() * 2;
+        buckets.assign(newSize, uint32_t(NONE));
+        mask = newSize - 1;
+        for (uint32_t i = 0;  i < numAllocated;  ++i) {
+            const Entry & en = entry(i);
+            if (en.slot != FREE)
+                insertBucket(i, en.hash);
+        }
+    }
+
+    /*************************************************************************/
+    /* ENTRIES                                                               */
+    /*************************************************************************/
+
+    uint32_t allocate()
+    {
+        if (freeList != NONE) {
+            uint32_t index = freeList;
+            freeList = entry(index).next;
+            return index;
+        }
+
+        if ((numAllocated & (CHUNK_SIZE - 1)) == 0) {
+            chunks.emplace_back(new Entry[CHUNK_SIZE]);
+            Entry * chunk = chunks.back().get();
+            for (unsigned i = 0;  i < CHUNK_SIZE;  ++i) {
+                chunk[i].slot = FREE;
+                chunk[i].generation = 0;
+            }
+        }
+        return numAllocated++;
+    }
+
+    uint32_t add(const Key & key, uint64_t hash, Node && node)
+    {
+        if ((numEntries + 1) * 2 > buckets.size())
+            growBuckets();
+
+        uint32_t index = allocate();
+        Entry & en = entry(index);
+        int64_t tick = tickOf(node.timeout);
+        new (&en.storage) value_type(key, std::move(node));
+        en.hash = hash;
+        en.tick = tick;
+        insertBucket(index, hash);
+        ++numEntries;
+
+        schedule(index);
+        return index;
+    }
+
+    void erase(uint32_t index)
+    {
+        Entry & en = entry(index);
+        if (en.slot != EXPIRING)
+            unschedule(index);
+        removeBucket(index, en.hash);
+        en.kv().~value_type();
+        en.slot = FREE;
+        ++en.generation;
+        en.next = freeList;
+        freeList = index;
+        --numEntries;
+    }
+
+    /*************************************************************************/
+    /* TIMING WHEEL                                                          */
+    /*************************************************************************/
+
+    static unsigned levelOf(uint32_t slot)
+    {
+        return slot < LEVEL0_SLOTS
+            ? 0 : 1 + (slot - LEVEL0_SLOTS) / LEVEL_SLOTS;
+    }
+
+    static unsigned shiftOf(unsigned level)
+    {
+        return LEVEL0_BITS + (level - 1) * LEVEL_BITS;
+    }
+
+    /** Slot of the given level that holds the given millisecond. */
+    static uint32_t slotOf(unsigned level, int64_t tick)
+    {
+        if (level == 0)
+            return tick & (LEVEL0_SLOTS - 1);
+        return LEVEL0_SLOTS + (level - 1) * LEVEL_SLOTS
+            + ((tick >> shiftOf(level)) & (LEVEL_SLOTS - 1));
+    }
+
+    void link(uint32_t index, uint32_t slot)
+    {
+        Entry & en = entry(index);
+        en.slot = slot;
+        en.prev = NONE;
+        en.next = slots[slot];
+        if (en.next != NONE)
+            entry(en.next).prev = index;
+        slots[slot] = index;
+        ++levelSize[levelOf(slot)];
+        ++wheelSize;
+    }
+
+    void unschedule(uint32_t index)
+    {
+        Entry & en = entry(index);
+        if (en.prev != NONE)
+            entry(en.prev).next = en.next;
+        else slots[en.slot] = en.next;
+        if (en.next != NONE)
+            entry(en.next).prev = en.prev;
+        --levelSize[levelOf(en.slot)];
+        --wheelSize;
+    }
+
+    void schedule(uint32_t index)
+    {
+        Entry & en = entry(index);
+
+        // Nothing to expire in between, but the wheel mustn't go past the
+        // current time: a far off entry would otherwise put every nearer
+        // one scheduled after it in the slot of past timeouts.
+        if (wheelSize == 0 && en.tick > wheelTick)
+            wheelTick = std::max(wheelTick,
+                                 std::min(en.tick, tickOf(Date::now())));
+
+        int64_t tick = en.tick;
+        int64_t delta = tick - wheelTick;
+
+        if (delta < LEVEL0_SLOTS) {
+            // Past timeouts go in the slot that's expired next
+            link(index, slotOf(0, delta < 0 ? wheelTick : tick));
+            return;
+        }
+
+        unsigned level = 1;
+        for (;  level < NUM_LEVELS - 1;  ++level)
+            if (delta < (int64_t(1) << shiftOf(level + 1)))
+                break;
+
+        int64_t maxDelta = (int64_t(1) << shiftOf(NUM_LEVELS)) - 1;
+        if (delta > maxDelta)
+            tick = wheelTick + maxDelta;
+
+        link(index, slotOf(level, tick));
+    }
+
+    void reschedule(uint32_t index, Date timeout)
+    {
+        Entry & en = entry(index);
+        if (en.slot != EXPIRING)
+            unschedule(index);
+        en.kv().second.timeout = timeout;
+        en.tick = tickOf(timeout);
+        schedule(index);
+    }
+
+    /** Move the entries of the given slot down to the lower levels. */
+    void cascade(uint32_t slot)
+    {
+        uint32_t index = slots[slot];
+        while (index != NONE) {
+            uint32_t next = entry(index).next;
+            unschedule(index);
+            schedule(index);
+            index = next;
+        }
+    }
+
+    /** Called when the wheel gets to a new millisecond. */
+    void cascadeAt(int64_t tick)
+    {
+        for (unsigned level = 1;  level < NUM_LEVELS;  ++level) {
+            if (tick & ((int64_t(1) << shiftOf(level)) - 1))
+                break;
+            cascade(slotOf(level, tick));
+        }
+    }
+
+    void collect(uint32_t slot, Date now, bool all)
+    {
+        uint32_t index = slots[slot];
+        while (index != NONE) {
+            Entry & en = entry(index);
+            uint32_t next = en.next;
+            if (all || en.kv().second.timeout <= now) {
+                unschedule(index);
+                en.slot = EXPIRING;
+                expiring.push_back(std::make_pair(index, en.generation));
+            }
+            index = next;
+        }
+    }
+
+    void collectExpired(Date now)
+    {
+        int64_t nowTick = tickOf(now);
+
+        while (wheelTick < nowTick) {
+            if (wheelSize == 0) {
+                wheelTick = nowTick;
+                break;
+            }
+
+            // Everything in this millisecond has expired
+            collect(slotOf(0, wheelTick), now, true);
+
+            // Skip over the empty levels up to the next cascade that
+            // could bring something down.
+            int64_t next = wheelTick + 1;
+            if (levelSize[0] == 0) {
+                for (unsigned level = 1;  level < NUM_LEVELS;  ++level) {
+                    int64_t width = int64_t(1) << shiftOf(level);
+                    next = (wheelTick / width + 1) * width;
+                    if (levelSize[level] != 0) break;
+                }
+            }
+
+            if (next > nowTick) {
+                wheelTick = nowTick;
+                break;
+            }
+
+            wheelTick = next;
+            cascadeAt(wheelTick);
+        }
+
+        // The current millisecond has only partly expired
+        collect(slotOf(0, wheelTick), now, false);
+    }
+};
+
+} // namespace Datacratic
+
+#endif /* __service__hashed_timeout_map_h__ */
@@ -27,7 +27,7 @@ namespace Datacratic {
 
 HttpConnectionHandler::
 HttpConnectionHandler()
-    : readState(INVALID), httpEndpoint(0)
+    : readState(INVALID), inPlaceHeaders(false), httpEndpoint(0)
 {
 }
 
@@ -51,6 +51,15 @@ makeNewHandlerShared()
     return httpEndpoint->makeNewHandler();
 }
 
+void
+HttpConnectionHandler::
+takeBuffers(HttpConnectionHandler & previous)
+{
+    header.swap(previous.header);
+    headerText.swap(previous.headerText);
+    headerText.clear();
+}
+
 void
 HttpConnectionHandler::
 handleData(const std::string & data)
@@ -106,7 +115,9 @@ handleData(const std::string & data)
     }
     // We got a header
     try {
-        header.parse(headerText);
+        if (inPlaceHeaders)
+            header.parseInPlace(headerText);
+        else header.parse(headerText);
     } catch (...) {
         cerr << "problem parsing in state: " << status() << endl;
         throw;
@@ -138,9 +149,9 @@ HttpConnectionHandler::
 handleHttpHeader(const HttpHeader & header)
 {
     // If the client expects a 100 continue, then oblige
-    std::string expect = header.tryGetHeader("expect");
-    if (!expect.empty()) {
-        expect = lowercase(expect);
+    boost::string_ref expectRef = header.findHeader(HttpHeader::EXPECT);
+    if (!expectRef.empty()) {
+        string expect = lowercase(expectRef.to_string());
 
         if (expect == "100-continue") {
 
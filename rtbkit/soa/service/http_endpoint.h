@@ -109,6 +109,12 @@ struct HttpConnectionHandler : public PassiveConnectionHandler {
     /** The actual header */
     HttpHeader header;
 
+    /** Parse the header with HttpHeader::parseInPlace() instead of
+        HttpHeader::parse(), which leaves the headers map empty.  For
+        handlers that only look headers up through findHeader().
+    */
+    bool inPlaceHeaders;
+
     /** The payload we're accumulating. */
     std::string payload;
 
@@ -130,6 +136,13 @@ struct HttpConnectionHandler : public PassiveConnectionHandler {
     */
     std::shared_ptr<ConnectionHandler> makeNewHandlerShared();
 
+    /** Take over the header and receive buffer of the handler that served
+        the previous request on the same connection, so that they don't
+        need to be allocated again for each request on a keep-alive
+        connection.
+    */
+    void takeBuffers(HttpConnectionHandler & previous);
+
     //virtual void handleNewConnection();
     virtual void handleData(const std::string & data);
     virtual void handleError(const std::string & message);
@@ -10,6 +10,7 @@
 #include "jml/db/persistent.h"
 #include "jml/utils/vector_utils.h"
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace ML;
@@ -121,6 +122,11 @@ swap(HttpHeader & other)
     knownData.swap(other.knownData);
     std::swap(isChunked, other.isChunked);
     std::swap(version, other.version);
+    queryParams.swap(other.queryParams);
+    text.swap(other.text);
+    fields.swap(other.fields);
+    std::swap_ranges(knownFields, knownFields + NUM_KNOWN_HEADERS,
+                     other.knownFields);
 }
 
 namespace {
@@ -171,96 +177,271 @@ expectUrlEncodedString(ML::Parse_Context & context,
     return result;
 }
 
+void parseQueryParams(ML::Parse_Context & context, RestParams & params)
+{
+    do {
+        string key = expectUrlEncodedString(context, "=& ");
+        if (context.match_literal('=')) {
+            string value = expectUrlEncodedString(context, "& ");
+            params.push_back(make_pair(key, value));
+        } else {
+            params.push_back(make_pair(key, ""));
+        }
+    } while (context.match_literal('&'));
+}
+
+/** Names of the known headers, in the order of HttpHeader::KnownHeader. */
+const char * const knownHeaderNames[HttpHeader::NUM_KNOWN_HEADERS] = {
+    "content-length",
+    "content-type",
+    "transfer-encoding",
+    "connection",
+    "expect",
+    "x-openrtb-version"
+};
+
+bool equalsIgnoreCase(boost::string_ref str1, boost::string_ref str2)
+{
+    if (str1.size() != str2.size())
+        return false;
+    for (size_t i = 0;  i < str1.size();  ++i)
+        if (tolower(str1[i]) != tolower(str2[i]))
+            return false;
+    return true;
+}
+
 } // file scope
 
 void
 HttpHeader::
 parse(const std::string & headerAndData, bool checkBodyLength)
 {
+    HttpHeader parsed;
+    std::string buffer(headerAndData);
+    parsed.parseInPlace(buffer, checkBodyLength);
+
+    for (const Field & field: parsed.fields) {
+        string name = lowercase(parsed.fieldName(field).to_string());
+        if (name == "content-length" || name == "content-type"
+            || name == "transfer-encoding")
+            continue;
+        parsed.headers[name] = parsed.fieldValue(field).to_string();
+    }
+
+    swap(parsed);
+}
+
+void
+HttpHeader::
+parseInPlace(std::string & buffer, bool checkBodyLength)
+{
+    text.swap(buffer);
+    buffer.clear();
+
+    clearFields();
+    headers.clear();
+    queryParams.clear();
+    contentType.clear();
+    contentLength = -1;
+    isChunked = false;
+
+    const char * start = text.c_str();
+    const char * end = start + text.length();
+    const char * p = start;
+
+    auto fail = [&] (const char * message)
+        {
+            throw ML::Exception("request header:%d: %s",
+                                (int)(p - start), message);
+        };
+
+    // Position of the first of the delimiters at or after p
+    auto find = [&] (char d1, char d2, char d3) -> const char *
+        {
+            const char * q = p;
+            while (q != end && *q != d1 && *q != d2 && *q != d3)
+                ++q;
+            return q;
+        };
+
+    auto expectEol = [&] ()
+        {
+            if (p != end && *p == '\r')
+                ++p;
+            if (p == end || *p != '\n')
+                fail("expected eol");
+            ++p;
+        };
+
     try {
-        HttpHeader parsed;
-
-        // Parse http
-        ML::Parse_Context context("request header",
-                                  headerAndData.c_str(),
-                                  headerAndData.c_str()
-                                      + headerAndData.length());
-
-        parsed.verb = context.expect_text(" \n");
-        context.expect_literal(' ');
-        parsed.resource = context.expect_text(" ?");
-        if (context.match_literal('?')) {
-            do {
-                string key = expectUrlEncodedString(context, "=& ");
-                if (context.match_literal('=')) {
-                    string value = expectUrlEncodedString(context, "& ");
-                    queryParams.push_back(make_pair(key, value));
-                } else {
-                    queryParams.push_back(make_pair(key, ""));
-                }
-            } while (context.match_literal('&'));
+        const char * q = find(' ', '\n', '\n');
+        verb.assign(p, q);
+        p = q;
+        if (p == end || *p != ' ')
+            fail("expected ' '");
+        ++p;
+
+        q = find(' ', '?', '?');
+        resource.assign(p, q);
+        p = q;
+        if (p != end && *p == '?') {
+            ++p;
+            ML::Parse_Context context("request header", p, end);
+            parseQueryParams(context, queryParams);
+            p += context.get_offset();
         }
-        context.expect_literal(' ');
-        parsed.version = context.expect_text('\r');
-        context.expect_eol();
-
-        while (!context.match_literal("\r\n")) {
-            string name = lowercase(context.expect_text("\r\n:"));
-            //cerr << "name = " << name << endl;
-            context.expect_literal(':');
-            context.match_whitespace();
-            if (name == "content-length") {
-                parsed.contentLength = context.expect_long_long();
-                //cerr << "******* set cntentLength " << parsed.contentLength
-                //     << endl;
-            }
-            else if (name == "content-type")
-                parsed.contentType = context.expect_text('\r');
-            else if (name == "transfer-encoding") {
-                string transferEncoding = lowercase(context.expect_text('\r'));
-                
-                if (transferEncoding != "chunked")
-                    throw ML::Exception("unknown transfer-encoding");
-                parsed.isChunked = true;
-            }
-            else {
-                string value = context.expect_text('\r');
-                parsed.headers[name] = value;
-            }
-            context.expect_eol();
+        if (p == end || *p != ' ')
+            fail("expected ' '");
+        ++p;
+
+        q = find('\r', '\n', '\n');
+        version.assign(p, q);
+        p = q;
+        expectEol();
+
+        while (p == end || *p != '\r' || p + 1 == end || p[1] != '\n') {
+            const char * name = p;
+            p = find('\r', '\n', ':');
+            const char * nameEnd = p;
+            if (p == end || *p != ':')
+                fail("expected ':'");
+            ++p;
+            while (p != end && isblank(*p))
+                ++p;
+            const char * value = p;
+            p = find('\r', '\n', '\n');
+            addField(name - start, nameEnd - name, value - start, p - value);
+            expectEol();
+        }
+        p += 2;
+
+        boost::string_ref length = findHeader(CONTENT_LENGTH);
+        if (length.data()) {
+            char * lengthEnd;
+            contentLength = strtoll(length.data(), &lengthEnd, 10);
+            if (length.empty() || lengthEnd != length.end())
+                fail("expected content length");
+        }
+
+        boost::string_ref type = findHeader(CONTENT_TYPE);
+        contentType.assign(type.data(), type.size());
+
+        boost::string_ref transferEncoding = findHeader(TRANSFER_ENCODING);
+        if (transferEncoding.data()) {
+            if (!equalsIgnoreCase(transferEncoding, "chunked"))
+                throw ML::Exception("unknown transfer-encoding");
+            isChunked = true;
         }
 
         // The rest of the data is the body
-        const char * content_start
-            = headerAndData.c_str() + context.get_offset();
-
-        parsed.knownData
-            = string(content_start,
-                     headerAndData.c_str() + headerAndData.length());
-
-        if (checkBodyLength && (parsed.contentLength != -1)
-            && ((int)parsed.knownData.length() > (int)parsed.contentLength)) {
-            cerr << "got double packet: got content length " << parsed.knownData.length()
-                 << " wanted " << parsed.contentLength << endl;
-#if 1            
-            context.exception(format("too much data for content length: "
-                                     "%d > %d for data \"%s\"",
-                                     (int)parsed.knownData.length(),
-                                     (int)parsed.contentLength,
-                                     headerAndData.c_str()));
-#endif
-            parsed.knownData.resize(parsed.contentLength);
+        knownData.assign(p, end);
+
+        if (checkBodyLength && (contentLength != -1)
+            && ((int)knownData.length() > (int)contentLength)) {
+            cerr << "got double packet: got content length " << knownData.length()
+                 << " wanted " << contentLength << endl;
+            fail(format("too much data for content length: "
+                        "%d > %d for data \"%s\"",
+                        (int)knownData.length(),
+                        (int)contentLength,
+                        text.c_str()).c_str());
         }
-        
-        swap(parsed);
     }
     catch (const std::exception & exc) {
         cerr << "error parsing http header: " << exc.what() << endl;
-        cerr << headerAndData << endl;
+        cerr << text << endl;
         throw;
     }
 }
 
+void
+HttpHeader::
+clearFields()
+{
+    fields.clear();
+    std::fill(knownFields, knownFields + NUM_KNOWN_HEADERS, -1);
+}
+
+void
+HttpHeader::
+addField(uint32_t name, uint32_t nameLength,
+         uint32_t value, uint32_t valueLength)
+{
+    Field field = { name, nameLength, value, valueLength };
+    fields.push_back(field);
+
+    // A repeated header replaces the earlier one
+    boost::string_ref fieldName = this->fieldName(field);
+    for (unsigned i = 0;  i < NUM_KNOWN_HEADERS;  ++i) {
+        if (equalsIgnoreCase(fieldName, knownHeaderNames[i])) {
+            knownFields[i] = fields.size() - 1;
+            break;
+        }
+    }
+}
+
+boost::string_ref
+HttpHeader::
+findHeader(boost::string_ref name) const
+{
+    if (text.empty()) {
+        // Not parsed; may have been filled in by hand
+        auto it = headers.find(lowercase(name.to_string()));
+        if (it == headers.end())
+            return boost::string_ref();
+        return it->second;
+    }
+
+    // Backwards, as a repeated header replaces the earlier one
+    for (auto it = fields.rbegin(), end = fields.rend();  it != end;  ++it) {
+        if (equalsIgnoreCase(fieldName(*it), name))
+            return fieldValue(*it);
+    }
+    return boost::string_ref();
+}
+
+boost::string_ref
+HttpHeader::
+findHeader(KnownHeader header) const
+{
+    if (text.empty())
+        return findHeader(knownHeaderNames[header]);
+    int index = knownFields[header];
+    if (index == -1)
+        return boost::string_ref();
+    return fieldValue(fields[index]);
+}
+
+void
+HttpHeader::
+setHeader(const std::string & name, const std::string & value)
+{
+    string lowerName = lowercase(name);
+    if (lowerName == "content-type")
+        contentType = value;
+    else if (lowerName != "content-length" && lowerName != "transfer-encoding")
+        headers[lowerName] = value;
+
+    // Not parsed, so there are no fields to keep up to date
+    if (text.empty())
+        return;
+
+    Field field;
+    field.name = text.length();
+    field.nameLength = name.length();
+    text.append(name);
+    field.value = text.length();
+    field.valueLength = value.length();
+    text.append(value);
+
+    auto it = fields.rbegin(), end = fields.rend();
+    while (it != end && !equalsIgnoreCase(fieldName(*it), name))
+        ++it;
+    if (it != end)
+        *it = field;
+    else addField(field.name, field.nameLength, field.value, field.valueLength);
+}
+
 int HttpHeader::responseCode() const
 {
     return boost::lexical_cast<int>(resource);
@@ -276,9 +457,20 @@ std::ostream & operator << (std::ostream & stream, const HttpHeader & header)
         stream << "Transfer-Encoding: chunked\r\n";
     else if (header.contentLength != -1)
         stream << "Content-Length: " << header.contentLength << "\r\n";
-    for (auto it = header.headers.begin(), end = header.headers.end();
-         it != end;  ++it) {
-        stream << it->first << ": " << it->second << "\r\n";
+    if (header.text.empty()) {
+        for (auto it = header.headers.begin(), end = header.headers.end();
+             it != end;  ++it) {
+            stream << it->first << ": " << it->second << "\r\n";
+        }
+    }
+    else {
+        for (const HttpHeader::Field & field: header.fields) {
+            std::string name = lowercase(header.fieldName(field).to_string());
+            if (name == "content-length" || name == "content-type"
+                || name == "transfer-encoding")
+                continue;
+            stream << name << ": " << header.fieldValue(field) << "\r\n";
+        }
     }
     stream << "\r\n";
     return stream;
@@ -11,6 +11,7 @@
 #include <map>
 #include <iostream>
 #include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "jml/arch/exception.h"
 
 
@@ -55,12 +56,25 @@ struct HttpHeader {
     HttpHeader()
         : contentLength(-1), isChunked(false)
     {
+        clearFields();
     }
 
     void swap(HttpHeader & other);
 
     void parse(const std::string & headerAndData, bool checkBodyLength = true);
 
+    /** Parse the header at the start of the given buffer without copying
+        it: the buffer is swapped with text, and the header fields are
+        recorded as offsets into it.  The buffer is left empty but with the
+        memory of the previous text, so that a header and buffer that are
+        used for request after request on a connection don't need to
+        allocate.
+
+        Unlike parse(), the headers map is not filled in; the fields are
+        only available through findHeader() and the functions built on it.
+    */
+    void parseInPlace(std::string & buffer, bool checkBodyLength = true);
+
     std::string verb;       // GET, PUT, etc
     std::string resource;   // after the get
     std::string version;    // after the get
@@ -74,27 +88,90 @@ struct HttpHeader {
     int64_t contentLength;
     bool isChunked;
 
-    // The rest of the headers are here
+    // The rest of the headers are here.  Not filled in by parseInPlace().
     std::map<std::string, std::string> headers;
 
+    /** Headers that are indexed by the parser, so that looking them up
+        doesn't need to go through the fields.
+    */
+    enum KnownHeader {
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        TRANSFER_ENCODING,
+        CONNECTION,
+        EXPECT,
+        OPENRTB_VERSION,    ///< x-openrtb-version
+        NUM_KNOWN_HEADERS
+    };
+
+    /** A header field, as offsets into text. */
+    struct Field {
+        uint32_t name;
+        uint32_t nameLength;
+        uint32_t value;
+        uint32_t valueLength;
+    };
+
+    /** Text of the header that the fields point into. */
+    std::string text;
+
+    /** All of the header fields, in the order they were received. */
+    std::vector<Field> fields;
+
+    boost::string_ref fieldName(const Field & field) const
+    {
+        return boost::string_ref(text.data() + field.name, field.nameLength);
+    }
+
+    boost::string_ref fieldValue(const Field & field) const
+    {
+        return boost::string_ref(text.data() + field.value,
+                                 field.valueLength);
+    }
+
+    /** Return the value of the given header, whose name is matched without
+        regard to case, or an empty reference with a null data() if it
+        isn't there.  The reference is valid until the header is next
+        modified.  A header that wasn't parsed is looked up in the headers
+        map.
+    */
+    boost::string_ref findHeader(boost::string_ref name) const;
+    boost::string_ref findHeader(KnownHeader header) const;
+
+    bool hasHeader(boost::string_ref name) const
+    {
+        return findHeader(name).data() != nullptr;
+    }
+
     std::string getHeader(const std::string & key) const
     {
-        auto it = headers.find(key);
-        if (it == headers.end())
+        boost::string_ref value = findHeader(key);
+        if (!value.data())
             throw ML::Exception("couldn't find header " + key);
-        return it->second;
+        return std::string(value.data(), value.size());
     }
 
     std::string tryGetHeader(const std::string & key) const
     {
-        auto it = headers.find(key);
-        if (it == headers.end())
-            return "";
-        return it->second;
+        boost::string_ref value = findHeader(key);
+        return std::string(value.data(), value.size());
     }
 
+    /** Set the given header, replacing any value it already had, in both
+        the fields and the headers map.  A header that wasn't parsed only
+        has the map.
+    */
+    void setHeader(const std::string & name, const std::string & value);
+
     // If some portion of the data is known, it's put in here
     std::string knownData;
+
+private:
+    int16_t knownFields[NUM_KNOWN_HEADERS];  ///< Index in fields or -1
+
+    void clearFields();
+    void addField(uint32_t name, uint32_t nameLength,
+                  uint32_t value, uint32_t valueLength);
 };
 
 std::ostream & operator << (std::ostream & stream, const HttpHeader & header);
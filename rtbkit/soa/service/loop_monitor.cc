@@ -10,6 +10,8 @@
 #include "jml/arch/cmp_xchg.h"
 
 #include <mutex>
+#include <cmath>
+#include <cstdlib>
 #include <functional>
 
 using namespace std;
@@ -107,6 +109,124 @@ remove(const string& name)
 }
 
 
+/******************************************************************************/
+/* VALUE SHEDDER                                                              */
+/******************************************************************************/
+
+ValueShedder::
+ValueShedder() :
+    messages(0),
+    cutoff(Cutoff().packed),
+    cutoffShedProb(0.0)
+{
+    for (unsigned i = 0; i < Buckets; ++i) {
+        seen[i] = 0;
+        shed[i] = 0;
+    }
+}
+
+unsigned
+ValueShedder::
+bucketOf(double value)
+{
+    if (!(value > 0.0)) return 0;
+    if (value >= 1.0) return Buckets - 1;
+    return std::sqrt(value) * Buckets;
+}
+
+bool
+ValueShedder::
+shedMessage(double value, double shedProb)
+{
+    unsigned bucket = bucketOf(value);
+    seen[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t count = messages.fetch_add(1, std::memory_order_relaxed) + 1;
+    bool stale = std::abs(cutoffShedProb.load() - shedProb) > 0.005;
+
+    if ((stale || count % UpdateInterval == 0) && updateLock.try_lock()) {
+        updateCutoff(shedProb);
+        updateLock.unlock();
+    }
+
+    if (shedProb <= 0.0) return false;
+
+    Cutoff current(cutoff.load());
+    bool drop = bucket < current.bucket
+        || (bucket == current.bucket
+                && RNG::defaultRNG().random01() < current.dropProb);
+
+    if (drop) shed[bucket].fetch_add(1, std::memory_order_relaxed);
+    return drop;
+}
+
+void
+ValueShedder::
+updateCutoff(double shedProb)
+{
+    uint64_t counts[Buckets];
+    uint64_t total = 0;
+
+    // Halving the counts as we go keeps the histogram to the last few
+    // intervals.  Increments racing with this only get lost.
+    for (unsigned i = 0; i < Buckets; ++i) {
+        counts[i] = seen[i].load(std::memory_order_relaxed);
+        seen[i].store(counts[i] / 2, std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    double target = shedProb * total;
+    double below = 0.0;
+
+    Cutoff result;
+    result.bucket = Buckets;
+    result.dropProb = 0.0;
+
+    for (unsigned i = 0; i < Buckets; ++i) {
+        if (below + counts[i] >= target) {
+            result.bucket = i;
+            result.dropProb = counts[i] ? (target - below) / counts[i] : 0.0;
+            break;
+        }
+        below += counts[i];
+    }
+
+    cutoff.store(result.packed);
+    cutoffShedProb.store(shedProb);
+}
+
+Json::Value
+ValueShedder::
+getDistribution() const
+{
+    Cutoff current(cutoff.load());
+
+    auto lowerBound = [] (unsigned bucket) {
+        double root = double(bucket) / Buckets;
+        return root * root;
+    };
+
+    Json::Value result;
+    result["shedProbability"] = cutoffShedProb.load();
+    result["cutoff"]["value"] = lowerBound(current.bucket);
+    result["cutoff"]["dropProbability"] = current.dropProb;
+
+    Json::Value& buckets = result["buckets"];
+    buckets = Json::Value(Json::arrayValue);
+
+    for (unsigned i = 0; i < Buckets; ++i) {
+        Json::Value entry;
+        entry["from"] = lowerBound(i);
+        entry["to"] = lowerBound(i + 1);
+        entry["seen"] = Json::UInt(seen[i].load());
+        entry["shed"] = Json::UInt(shed[i].load());
+        buckets.append(entry);
+    }
+
+    return result;
+}
+
+
 /******************************************************************************/
 /* LOAD STABILIZER                                                            */
 /******************************************************************************/
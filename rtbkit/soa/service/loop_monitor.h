@@ -13,6 +13,7 @@
 #include "jml/arch/spinlock.h"
 #include "jml/utils/rng.h"
 
+#include <atomic>
 #include <map>
 
 namespace Datacratic {
@@ -98,6 +99,78 @@ private:
 };
 
 
+/******************************************************************************/
+/* VALUE SHEDDER                                                              */
+/******************************************************************************/
+
+/** Picks the messages to drop when a given proportion of them has to be shed,
+    starting with the ones of lowest value.  Each message comes with a value
+    between 0 and 1, and a histogram of the recent values tells how low the
+    cutoff has to be for the proportion of messages below it to match the
+    shed probability.  Messages right at the cutoff are dropped at random so
+    that, on average, the same number of messages is shed as when dropping
+    them uniformly.
+
+    Thread-safe and lock-free, except for the periodic recomputation of the
+    cutoff which is done by whichever thread gets to it first.  The random
+    draws come from each thread's own RNG rather than random(), which locks.
+ */
+struct ValueShedder
+{
+    ValueShedder();
+
+    /** Returns true if a message of the given value should be dropped to shed
+        shedProb of the messages.  Values are also recorded when shedProb is 0
+        so that the histogram is ready when the load goes up.
+     */
+    bool shedMessage(double value, double shedProb);
+
+    /** Values and shed messages per bucket along with the current cutoff. */
+    Json::Value getDistribution() const;
+
+private:
+
+    /** Buckets are on a square root scale, as most values tend to be small
+        rates which would all end up in the first few linear buckets.
+     */
+    enum { Buckets = 32 };
+
+    /** The cutoff is recomputed every that many messages, which is also when
+        the histogram is decayed.
+     */
+    enum { UpdateInterval = 1024 };
+
+    static unsigned bucketOf(double value);
+    void updateCutoff(double shedProb);
+
+    std::atomic<uint64_t> seen[Buckets];
+    std::atomic<uint64_t> shed[Buckets];
+    std::atomic<uint64_t> messages;
+
+    /** Bucket at which to start dropping and the probability of dropping a
+        message that falls in it; packed together to be read atomically.
+     */
+    struct Cutoff
+    {
+        Cutoff() : packed(0) {}
+        explicit Cutoff(uint64_t packed) : packed(packed) {}
+
+        union {
+            struct {
+                float dropProb;
+                uint32_t bucket;
+            };
+
+            uint64_t packed;
+        };
+    };
+
+    std::atomic<uint64_t> cutoff;
+    std::atomic<float> cutoffShedProb;
+    ML::Spinlock updateLock;
+};
+
+
 /******************************************************************************/
 /* LOAD STABILIZER                                                            */
 /******************************************************************************/
@@ -123,6 +196,17 @@ struct LoadStabilizer
         return prob == 0.0 ? false : rng.random01() < shedProb;
     }
 
+    /** Same as shedMessage() but drops the messages with the lowest value,
+        between 0 and 1, first.  The proportion of messages dropped follows
+        the same load feedback loop.
+
+        Thread-safe and lock-free.
+     */
+    bool shedMessage(double value)
+    {
+        return shedder.shedMessage(value, shedProbability());
+    }
+
     /** Returns the probability at which a message should be dropped to help the
         system deal with excessive load.
 
@@ -146,6 +230,7 @@ private:
     double loadThreshold;
     double shedProb;
     ML::RNG rng;
+    ValueShedder shedder;
 
     LoopMonitor::LoadSample lastSample;
 };
@@ -0,0 +1,254 @@
+/* object_pool.h                                                   -*- C++ -*-
+   Copyright (c) 2016 Datacratic.  All rights reserved.
+
+   Pool of objects handed out as shared pointers, which are destroyed and
+   recycled by the thread that allocated them rather than by whichever
+   thread happens to drop the last reference.
+*/
+
+#ifndef __service__object_pool_h__
+#define __service__object_pool_h__
+
+#include <boost/thread/tss.hpp>
+#include <type_traits>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* OBJECT POOL                                                               */
+/*****************************************************************************/
+
+/** Each thread that allocates from the pool gets its own cache: a free list
+    of blocks that it can construct objects in, and a lock-free stack on which
+    the objects it allocated are pushed back when their last reference goes
+    away, from any thread.  Releasing an object is a single compare and swap;
+    the object is only destroyed by its thread, and its block goes back onto
+    that thread's free list.  Each allocation destroys a couple of them, just
+    enough to keep up with the releases, and collect() takes care of the
+    rest outside of the allocations.
+
+    This takes the cost of tearing down big objects out of the thread that
+    consumes them, and whatever memory their members hold is freed on the
+    thread that allocated it, where the allocator's thread cache can reuse
+    it straight away.
+
+    The caches of threads that exit are adopted by the next threads to use
+    the pool, so objects released after their thread is gone are still
+    destroyed.  A pool must outlive every object it handed out, which in
+    practice means never destroying pools that objects can escape from.
+*/
+
+template<typename T>
+struct ObjectPool {
+
+    /** maxFree is the most blocks each thread keeps for reuse, and
+        maxDestroyed the most released objects it destroys per allocation.
+        Destructors run by make() add to its latency, so the backlog of a
+        burst of releases is left to collect().
+    */
+    ObjectPool(size_t maxFree = 4096, size_t maxDestroyed = 2)
+        : maxFree(maxFree), maxDestroyed(maxDestroyed),
+          current(&ObjectPool::orphan)
+    {
+    }
+
+    ~ObjectPool()
+    {
+        current.release();
+        for (auto & cache: caches) {
+            reclaim(*cache, -1);
+            for (Block * block: cache->free)
+                delete block;
+        }
+    }
+
+    /** Construct an object in a block of the calling thread's cache. */
+    template<typename... Args>
+    std::shared_ptr<T> make(Args &&... args)
+    {
+        Cache & cache = localCache();
+        reclaim(cache, maxDestroyed);
+
+        Block * block;
+        if (!cache.free.empty()) {
+            block = cache.free.back();
+            cache.free.pop_back();
+            cache.reused.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            block = new Block();
+            block->owner = &cache;
+        }
+
+        try {
+            new (&block->storage) T(std::forward<Args>(args)...);
+        } catch (...) {
+            cache.free.push_back(block);
+            throw;
+        }
+
+        cache.allocated.fetch_add(1, std::memory_order_relaxed);
+        return std::shared_ptr<T>(block->object(), Release(block));
+    }
+
+    /** Destroy everything that was released back to the calling thread,
+        for threads that stop allocating for a while.  Meant to be called
+        periodically by each allocating thread; threads that never
+        allocated have nothing to collect.
+    */
+    void collect()
+    {
+        Cache * cache = current.get();
+        if (cache) reclaim(*cache, -1);
+    }
+
+    struct Stats {
+        Stats() : allocated(0), reused(0), destroyed(0), free(0) {}
+
+        uint64_t allocated;   ///< Objects constructed
+        uint64_t reused;      ///< Of which in a recycled block
+        uint64_t destroyed;   ///< Objects destroyed
+        uint64_t free;        ///< Blocks waiting to be reused
+
+        /** Objects in use or released but not destroyed yet. */
+        uint64_t live() const { return allocated - destroyed; }
+    };
+
+    /** Totals over all the threads. */
+    Stats stats() const
+    {
+        Stats result;
+        std::lock_guard<std::mutex> guard(cachesLock);
+        for (auto & cache: caches) {
+            result.allocated += cache->allocated.load();
+            result.reused += cache->reused.load();
+            result.destroyed += cache->destroyed.load();
+            result.free += cache->numFree.load();
+        }
+        return result;
+    }
+
+private:
+    struct Cache;
+
+    struct Block {
+        Cache * owner;
+        Block * next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T * object()
+        {
+            return reinterpret_cast<T *>(&storage);
+        }
+    };
+
+    struct Cache {
+        Cache()
+            : released(nullptr), pending(nullptr), orphaned(false),
+              allocated(0), reused(0), destroyed(0), numFree(0)
+        {
+        }
+
+        /// Pushed onto by any thread, taken all at once by the owner
+        std::atomic<Block *> released;
+
+        /// Owner only: released objects left to destroy, and free blocks
+        Block * pending;
+        std::vector<Block *> free;
+
+        std::atomic<bool> orphaned;
+
+        /// Only written by the owner; read for the stats
+        std::atomic<uint64_t> allocated, reused, destroyed, numFree;
+    };
+
+    /** Deleter of the shared pointers that the pool hands out. */
+    struct Release {
+        Release(Block * block) : block(block) {}
+
+        void operator () (T *) const
+        {
+            Cache * owner = block->owner;
+            Block * head = owner->released.load(std::memory_order_relaxed);
+            do {
+                block->next = head;
+            } while (!owner->released
+                     .compare_exchange_weak(head, block,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+        }
+
+        Block * block;
+    };
+
+    void reclaim(Cache & cache, size_t limit)
+    {
+        for (size_t n = 0;  n < limit;  ++n) {
+            if (!cache.pending) {
+                cache.pending = cache.released.exchange
+                    (nullptr, std::memory_order_acquire);
+                if (!cache.pending) break;
+            }
+
+            Block * block = cache.pending;
+            cache.pending = block->next;
+
+            block->object()->~T();
+            cache.destroyed.fetch_add(1, std::memory_order_relaxed);
+
+            if (cache.free.size() < maxFree)
+                cache.free.push_back(block);
+            else delete block;
+        }
+
+        cache.numFree.store(cache.free.size(), std::memory_order_relaxed);
+    }
+
+    Cache & localCache()
+    {
+        Cache * cache = current.get();
+        if (cache) return *cache;
+
+        std::lock_guard<std::mutex> guard(cachesLock);
+        for (auto & orphan: caches) {
+            bool expected = true;
+            if (orphan->orphaned.compare_exchange_strong(expected, false)) {
+                cache = orphan.get();
+                break;
+            }
+        }
+
+        if (!cache) {
+            caches.emplace_back(new Cache());
+            cache = caches.back().get();
+        }
+
+        current.reset(cache);
+        return *cache;
+    }
+
+    /** A thread's pointer doesn't own its cache: the pool does, so that
+        its objects can still be released once the thread is gone.
+    */
+    static void orphan(Cache * cache)
+    {
+        cache->orphaned = true;
+    }
+
+    size_t maxFree;
+    size_t maxDestroyed;
+
+    boost::thread_specific_ptr<Cache> current;
+
+    mutable std::mutex cachesLock;
+    std::vector<std::unique_ptr<Cache> > caches;
+};
+
+} // namespace Datacratic
+
+#endif /* __service__object_pool_h__ */
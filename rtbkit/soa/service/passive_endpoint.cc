@@ -76,10 +76,15 @@ listen(PortRange const & portRange,
        int backlog)
 {
     closePeer();
+    shardSockets.clear();
     
     this->endpoint = endpoint;
     this->nameLookup = nameLookup;
 
+    bool sharded = endpoint->threadsSharded();
+    if (sharded && endpoint->numShards() == 0)
+        throw Exception("sharded endpoints must be spun up before listening");
+
     fd = socket(AF_INET, SOCK_STREAM, 0);
 
     // Avoid already bound messages for the minute after a server has exited
@@ -92,6 +97,17 @@ listen(PortRange const & portRange,
         throw Exception("error setsockopt SO_REUSEADDR: %s", strerror(errno));
     }
 
+    // Each thread of a sharded endpoint listens on the same port
+    if (sharded) {
+        res = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &tr, sizeof(int));
+        if (res == -1) {
+            close(fd);
+            fd = -1;
+            throw Exception("error setsockopt SO_REUSEPORT: %s",
+                            strerror(errno));
+        }
+    }
+
     const char * hostNameToUse
         = (hostname == "*" ? "0.0.0.0" : hostname.c_str());
 
@@ -144,19 +160,100 @@ listen(PortRange const & portRange,
         addr.set(&inAddr, inAddrLen);
     }
 
+    shutdown = false;
+
+    if (sharded) {
+        listenShards(backlog);
+        listening_ = true;
+        ML::futex_wake(listening_);
+        return port;
+    }
+
     listening_ = true;
     ML::futex_wake(listening_);
 
-    shutdown = false;
-
     acceptThread.reset(new boost::thread([=] () { this->runAcceptThread(); }));
     return port;
 }
 
+void
+AcceptorT<SocketTransport>::
+listenShards(int backlog)
+{
+    int numShards = endpoint->numShards();
+
+    for (int i = 0;  i < numShards;  ++i) {
+        shardSockets.emplace_back(new ShardSocket());
+        ShardSocket & shard = *shardSockets.back();
+
+        // The first thread takes the socket that was bound to find the port
+        if (i == 0) {
+            shard.fd = fd;
+        }
+        else {
+            shard.fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (shard.fd == -1)
+                throw Exception(errno, "socket");
+
+            int tr = 1;
+            int res = setsockopt(shard.fd, SOL_SOCKET, SO_REUSEADDR,
+                                 &tr, sizeof(int));
+            if (res != -1)
+                res = setsockopt(shard.fd, SOL_SOCKET, SO_REUSEPORT,
+                                 &tr, sizeof(int));
+            if (res == -1)
+                throw Exception(errno, "setsockopt");
+
+            res = ::bind(shard.fd,
+                         reinterpret_cast<sockaddr *>(addr.get_addr()),
+                         addr.get_addr_size());
+            if (res == -1)
+                throw Exception(errno, "bind");
+
+            res = ::listen(shard.fd, backlog);
+            if (res == -1)
+                throw Exception(errno, "listen");
+        }
+
+        int res = fcntl(shard.fd, F_SETFL, O_NONBLOCK);
+        if (res != 0)
+            throw Exception(errno, "fcntl");
+    }
+
+    for (int i = 0;  i < numShards;  ++i) {
+        ShardSocket & shard = *shardSockets[i];
+        shard.acceptData = std::make_shared<EndpointBase::EpollData>
+            (EndpointBase::EpollData::ACCEPT, shard.fd, i);
+        shard.acceptData->onAccept = [=] () { this->acceptShard(i); };
+        endpoint->startAccepting(shard.acceptData);
+    }
+}
+
 void
 AcceptorT<SocketTransport>::
 closePeer()
 {
+    if (!shardSockets.empty()) {
+        shutdown = true;
+        ML::memory_barrier();
+
+        // Once a thread holds the lock it either sees that we're shutting
+        // down or has restarted polling, so that the removal sticks.  The
+        // accept data stays alive until the next listen() in case a thread
+        // was about to handle an event for it.
+        for (auto & shard: shardSockets) {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            if (shard->fd == -1) continue;
+            if (shard->acceptData)
+                endpoint->stopPolling(shard->acceptData);
+            close(shard->fd);
+            shard->fd = -1;
+        }
+
+        fd = -1;
+        return;
+    }
+
     if (!acceptThread) return;
     shutdown = true;
 
@@ -189,21 +286,12 @@ port() const
     return addr.get_port_number();
 }
 
-struct NameEntry {
-    NameEntry(const string & name)
-        : name_(name), date_(Date::now())
-        {}
-
-    string name_;
-    Date date_;
-};
-
 void
 AcceptorT<SocketTransport>::
 runAcceptThread()
 {
     //static const char *fName = "AcceptorT<SocketTransport>::runAcceptThread:";
-    unordered_map<string,NameEntry> addr2Name;
+    NameCache addr2Name;
 
     int res = fcntl(fd, F_SETFL, O_NONBLOCK);
     if (res != 0) {
@@ -254,58 +342,97 @@ runAcceptThread()
         if (res == -1)
             endpoint->acceptError(format("accept: %s", strerror(errno)));
 
+        newConnection(res, addr, addr_len, addr2Name);
+    }
+}
+
+void
+AcceptorT<SocketTransport>::
+acceptShard(int shardNum)
+{
+    ShardSocket & shard = *shardSockets[shardNum];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (shutdown || shard.fd == -1)
+        return;
+
+    // Bounded so that a burst of connections can't hold up the requests
+    // on the connections this thread already has.
+    for (unsigned i = 0;  i < 64;  ++i) {
+        sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+
+        int res = accept(shard.fd, (sockaddr *)&addr, &addr_len);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                endpoint->acceptError(format("accept: %s", strerror(errno)));
+            break;
+        }
+
+        newConnection(res, addr, addr_len, shard.addr2Name);
+    }
+
+    endpoint->restartPolling(shard.acceptData.get());
+}
+
+void
+AcceptorT<SocketTransport>::
+newConnection(int res, const sockaddr_in & addr, socklen_t addr_len,
+              NameCache & addr2Name)
+{
 #if 0
-        union {
-            char octets[4];
-            uint32_t addr;
-        } a;
-        a.addr = addr.sin_addr;
+    union {
+        char octets[4];
+        uint32_t addr;
+    } a;
+    a.addr = addr.sin_addr;
 #endif
 
-        ACE_INET_Addr addr2(&addr, addr_len);
+    ACE_INET_Addr addr2(&addr, addr_len);
 
 #if 0
-        ptime now = second_clock::universal_time();
+    ptime now = second_clock::universal_time();
 
-        cerr << boost::this_thread::get_id() << ":"<<to_iso_extended_string(now) << ":accept succeeded from "
-             << addr2.get_host_addr() << ":" << addr2.get_port_number()
-             << " (" << addr2.get_host_name() << ")"
-             << " for endpoint " << endpoint->name() << " res = " << res
-             << " pointer " << endpoint << endl;
+    cerr << boost::this_thread::get_id() << ":"<<to_iso_extended_string(now) << ":accept succeeded from "
+         << addr2.get_host_addr() << ":" << addr2.get_port_number()
+         << " (" << addr2.get_host_name() << ")"
+         << " for endpoint " << endpoint->name() << " res = " << res
+         << " pointer " << endpoint << endl;
 #endif
-        std::shared_ptr<SocketTransport> newTransport
-            (new SocketTransport(this->endpoint));
-
-        newTransport->peer_ = ACE_SOCK_Stream(res);
-        string peerName = addr2.get_host_addr();
-        if (nameLookup) {
-            auto it = addr2Name.find(peerName);
-            if (it == addr2Name.end()) {
-                string addr = peerName;
-                peerName = addr2.get_host_name();
-                addr2Name.insert({addr, NameEntry(peerName)});
-            }
-            else {
-                peerName = it->second.name_;
-            }
+    std::shared_ptr<SocketTransport> newTransport
+        (new SocketTransport(this->endpoint));
+
+    newTransport->peer_ = ACE_SOCK_Stream(res);
+    string peerName = addr2.get_host_addr();
+    if (nameLookup) {
+        auto it = addr2Name.find(peerName);
+        if (it == addr2Name.end()) {
+            string addr = peerName;
+            peerName = addr2.get_host_name();
+            addr2Name.insert({addr, NameEntry(peerName)});
         }
+        else {
+            peerName = it->second.name_;
+        }
+    }
 
-        if (peerName == "<unknown>")
-            peerName = addr2.get_host_addr();
-        newTransport->peerName_ = peerName;
-        endpoint->associateHandler(newTransport);
-
-        /* cleanup name entries older than 5 seconds */
-        Date now = Date::now();
-        auto it = addr2Name.begin();
-        while (it != addr2Name.end()) {
-            const NameEntry & entry = it->second;
-            if (entry.date_.plusSeconds(5) < now) {
-                it = addr2Name.erase(it);
-            }
-            else {
-                it++;
-            }
+    if (peerName == "<unknown>")
+        peerName = addr2.get_host_addr();
+    newTransport->peerName_ = peerName;
+    endpoint->associateHandler(newTransport);
+
+    /* cleanup name entries older than 5 seconds */
+    Date now = Date::now();
+    auto it = addr2Name.begin();
+    while (it != addr2Name.end()) {
+        const NameEntry & entry = it->second;
+        if (entry.date_.plusSeconds(5) < now) {
+            it = addr2Name.erase(it);
+        }
+        else {
+            it++;
         }
     }
 }
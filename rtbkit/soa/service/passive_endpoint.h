@@ -10,6 +10,8 @@
 #include "soa/service/endpoint.h"
 #include "soa/service/port_range_service.h"
 #include "jml/arch/wakeup_fd.h"
+#include <unordered_map>
+#include <mutex>
 
 namespace Datacratic {
 
@@ -210,10 +212,49 @@ struct AcceptorT<SocketTransport> : public Acceptor {
     */
     void runAcceptThread();
 
+    /** Accept the connections waiting on the listening socket of the given
+        thread of a sharded endpoint.  Called by that thread.
+    */
+    void acceptShard(int shard);
+
     /** Wait until we are ready to accept connections */
     void waitListening() const;
 
 protected:
+    struct NameEntry {
+        NameEntry(const std::string & name)
+            : name_(name), date_(Date::now())
+        {}
+
+        std::string name_;
+        Date date_;
+    };
+
+    typedef std::unordered_map<std::string, NameEntry> NameCache;
+
+    /** Opens the listening sockets of the threads of a sharded endpoint.
+        The first one reuses the socket that was already bound.
+    */
+    void listenShards(int backlog);
+
+    /** Hands an accepted connection over to the endpoint. */
+    void newConnection(int socket, const sockaddr_in & addr,
+                       socklen_t addrLen, NameCache & addr2Name);
+
+    /** Listening sockets of a sharded endpoint, one per event thread, all
+        bound to the same port with SO_REUSEPORT.  The locks are only
+        contended when the sockets are closed.
+    */
+    struct ShardSocket {
+        ShardSocket() : fd(-1) {}
+
+        int fd;
+        std::shared_ptr<EndpointBase::EpollData> acceptData;
+        std::mutex lock;
+        NameCache addr2Name;
+    };
+    std::vector<std::unique_ptr<ShardSocket> > shardSockets;
+
     std::shared_ptr<boost::thread> acceptThread;
     ML::Wakeup_Fd wakeup;
     ACE_INET_Addr addr;
@@ -28,10 +28,51 @@ extern const char * __progname;
 
 namespace Datacratic {
 
+/*****************************************************************************/
+/* EVENT HANDLE                                                              */
+/*****************************************************************************/
+
+EventHandle::
+EventHandle(std::shared_ptr<StatAggregator> aggregator)
+    : aggregator(std::move(aggregator)), service(0), type(ET_COUNT)
+{
+}
+
+EventHandle::
+EventHandle(EventService * service,
+            std::string name, std::string event,
+            StatEventType type)
+    : service(service),
+      name(std::move(name)), event(std::move(event)),
+      type(type)
+{
+}
+
+void
+EventHandle::
+record(float value) const
+{
+    if (aggregator)
+        aggregator->record(value);
+    else if (service)
+        service->onEvent(name, event.c_str(), type, value);
+}
+
+
 /*****************************************************************************/
 /* EVENT SERVICE                                                             */
 /*****************************************************************************/
 
+EventHandle
+EventService::
+registerEvent(const std::string & name,
+              const std::string & event,
+              StatEventType type,
+              std::vector<int> percentiles)
+{
+    return EventHandle(this, name, event, type);
+}
+
 std::map<std::string, double>
 EventService::
 get(std::ostream & output) const {
@@ -86,6 +127,17 @@ onEvent(const std::string & name,
     stats->record(name + "." + event, type, value);
 }
 
+EventHandle
+NullEventService::
+registerEvent(const std::string & name,
+              const std::string & event,
+              StatEventType type,
+              std::vector<int> percentiles)
+{
+    return EventHandle(stats->registerStat(name + "." + event, type,
+                                           std::move(percentiles)));
+}
+
 void
 NullEventService::
 dump(std::ostream & stream) const
@@ -142,6 +194,18 @@ onEvent(const std::string & name,
     connector->record(stat, type, value, extra);
 }
 
+EventHandle
+CarbonEventService::
+registerEvent(const std::string & name,
+              const std::string & event,
+              StatEventType type,
+              std::vector<int> percentiles)
+{
+    std::string stat = name.empty() ? event : name + "." + event;
+    return EventHandle(connector->registerStat(stat, type,
+                                               std::move(percentiles)));
+}
+
 
 /*****************************************************************************/
 /* CONFIGURATION SERVICE                                                     */
@@ -681,6 +745,24 @@ EventRecorder(const std::string & eventPrefix,
 {
 }
 
+EventHandle
+EventRecorder::
+registerEvent(const std::string & eventName,
+              StatEventType type,
+              std::vector<int> percentiles) const
+{
+    EventService * es = 0;
+    if (events_)
+        es = events_.get();
+    if (!es && services_)
+        es = services_->events.get();
+    if (!es)
+        return EventHandle();
+
+    return es->registerEvent(eventPrefix_, eventName, type,
+                             std::move(percentiles));
+}
+
 void
 EventRecorder::
 recordEventFmt(StatEventType type,
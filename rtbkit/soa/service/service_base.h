@@ -36,6 +36,49 @@ namespace Datacratic {
 
 class MultiAggregator;
 class CarbonConnector;
+struct StatAggregator;
+struct EventService;
+
+
+/*****************************************************************************/
+/* EVENT HANDLE                                                              */
+/*****************************************************************************/
+
+/** An event that was registered once with the event service so that it can
+    be recorded over and over without formatting or looking up its name.
+    A default constructed handle doesn't record anything.
+*/
+
+struct EventHandle {
+    EventHandle()
+        : service(0), type(ET_COUNT)
+    {
+    }
+
+    /** Handle that records straight into the aggregator of the stat. */
+    EventHandle(std::shared_ptr<StatAggregator> aggregator);
+
+    /** Handle that forwards each event to the onEvent() method of an event
+        service that doesn't aggregate the stats itself.
+    */
+    EventHandle(EventService * service,
+                std::string name, std::string event,
+                StatEventType type);
+
+    /** Record a value (or a hit) of the event. */
+    void record(float value = 1.0) const;
+
+    JML_IMPLEMENT_OPERATOR_BOOL(aggregator || service);
+
+private:
+    std::shared_ptr<StatAggregator> aggregator;
+
+    EventService * service;
+    std::string name;
+    std::string event;
+    StatEventType type;
+};
+
 
 /*****************************************************************************/
 /* EVENT SERVICE                                                             */
@@ -52,6 +95,16 @@ struct EventService {
                          float value,
                          std::initializer_list<int> extra = DefaultOutcomePercentiles) = 0;
 
+    /** Register an event up front and return a handle to record it.  The
+        default forwards to onEvent(), which only supports the default
+        percentiles.
+    */
+    virtual EventHandle registerEvent(const std::string & name,
+                                      const std::string & event,
+                                      StatEventType type,
+                                      std::vector<int> percentiles
+                                          = DefaultOutcomePercentiles);
+
     virtual void dump(std::ostream & stream) const
     {
     }
@@ -76,6 +129,12 @@ struct NullEventService : public EventService {
                          float value,
                          std::initializer_list<int> extra = DefaultOutcomePercentiles);
 
+    virtual EventHandle registerEvent(const std::string & name,
+                                      const std::string & event,
+                                      StatEventType type,
+                                      std::vector<int> percentiles
+                                          = DefaultOutcomePercentiles);
+
     virtual void dump(std::ostream & stream) const;
 
     std::unique_ptr<MultiAggregator> stats;
@@ -102,6 +161,12 @@ struct CarbonEventService : public EventService {
                          float value,
                          std::initializer_list<int> extra = std::initializer_list<int>());
 
+    virtual EventHandle registerEvent(const std::string & name,
+                                      const std::string & event,
+                                      StatEventType type,
+                                      std::vector<int> percentiles
+                                          = DefaultOutcomePercentiles);
+
     std::shared_ptr<CarbonConnector> connector;
 };
 
@@ -488,6 +553,16 @@ struct EventRecorder {
         es->onEvent(eventPrefix_, eventName, type, value, extra);
     }
 
+    /** Register an event once and return a handle that records it without
+        formatting or looking up its name every time.  Meant to be cached
+        by hot call sites; the handle stays valid for as long as the event
+        service does.  Returns an empty handle if there is no event service.
+    */
+    EventHandle registerEvent(const std::string & eventName,
+                              StatEventType type = ET_COUNT,
+                              std::vector<int> percentiles
+                                  = DefaultOutcomePercentiles) const;
+
     void recordEventFmt(StatEventType type,
                         float value,
                         std::initializer_list<int> extra,
@@ -14,8 +14,13 @@
 #include "jml/utils/floating_point.h"
 #include "jml/utils/smart_ptr_utils.h"
 #include "jml/utils/exc_check.h"
+#include "jml/compiler/compiler.h"
 #include <boost/tuple/tuple.hpp>
 #include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <memory>
 
 
 using namespace std;
@@ -23,6 +28,16 @@ using namespace ML;
 
 namespace Datacratic {
 
+unsigned statStripe()
+{
+    static std::atomic<unsigned> nextStripe(0);
+    static __thread int stripe = -1;
+
+    if (JML_UNLIKELY(stripe == -1))
+        stripe = nextStripe.fetch_add(1) % NumStatStripes;
+    return stripe;
+}
+
 
 /*****************************************************************************/
 /* COUNTER AGGREGATOR                                                        */
@@ -30,9 +45,12 @@ namespace Datacratic {
 
 CounterAggregator::
 CounterAggregator()
-    : start(Date::now()), total(0.0),
+    : start(Date::now()),
+      hit(false),
       totalsBuffer() // Keep 10sec of data.
 {
+    for (auto & stripe: stripes)
+        stripe.total = 0.0;
 }
 
 CounterAggregator::
@@ -44,23 +62,31 @@ void
 CounterAggregator::
 record(float value)
 {
+    double & total = stripes[statStripe()].total;
     double oldval = total;
 
     while (!ML::cmp_xchg(total, oldval, oldval + value));
+
+    if (JML_UNLIKELY(!hit.load(std::memory_order_relaxed)))
+        hit.store(true, std::memory_order_relaxed);
 }
 
 std::pair<double, Date>
 CounterAggregator::
 reset()
 {
-    double oldval = total;
+    double result = 0.0;
 
-    while (!ML::cmp_xchg(total, oldval, 0.0));
+    for (auto & stripe: stripes) {
+        double oldval = stripe.total;
+        while (!ML::cmp_xchg(stripe.total, oldval, 0.0));
+        result += oldval;
+    }
 
     Date oldStart = start;
     start = Date::now();
 
-    return make_pair(oldval, oldStart);
+    return make_pair(result, oldStart);
 }
 
 std::vector<StatReading>
@@ -70,6 +96,9 @@ read(const std::string & prefix)
     double current;
     Date oldStart;
 
+    if (!hit.load(std::memory_order_relaxed))
+        return vector<StatReading>();
+
     boost::tie(current, oldStart) = reset();
 
     if (totalsBuffer.size() >= 10)
@@ -191,4 +220,190 @@ read(const std::string & prefix)
     return result;
 }
 
+
+/*****************************************************************************/
+/* HISTOGRAM AGGREGATOR                                                      */
+/*****************************************************************************/
+
+HistogramAggregator::Stripe::
+Stripe()
+    : sum(0.0),
+      min(std::numeric_limits<double>::infinity()),
+      max(-std::numeric_limits<double>::infinity())
+{
+    for (auto & count: counts)
+        count.store(0, std::memory_order_relaxed);
+}
+
+HistogramAggregator::
+HistogramAggregator(std::vector<int> extra)
+    : start(Date::now()), extra(std::move(extra))
+{
+    ExcCheck(this->extra.size() > 0, "Can not construct with empty percentiles");
+
+    for (auto & stripe: stripes)
+        stripe = nullptr;
+}
+
+HistogramAggregator::
+~HistogramAggregator()
+{
+    for (auto & stripe: stripes)
+        delete stripe.load();
+}
+
+unsigned
+HistogramAggregator::
+bucketOf(float value)
+{
+    static const float minValue = std::ldexp(1.0f, MinExponent);
+
+    // Also catches the NaNs
+    if (!(value >= minValue))
+        return 0;
+
+    // For a positive float, the exponent and the top bits of the mantissa
+    // are directly the index of its log-linear bucket.
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    int bucket = (bits >> (23 - SubBucketBits))
+        - ((127 + MinExponent) << SubBucketBits);
+
+    return std::min<int>(bucket, NumBuckets - 1);
+}
+
+double
+HistogramAggregator::
+bucketValue(unsigned bucket)
+{
+    int exponent = (bucket >> SubBucketBits) + MinExponent;
+    double mantissa = (bucket & ((1 << SubBucketBits) - 1)) + 0.5;
+
+    return std::ldexp(1.0 + mantissa / (1 << SubBucketBits), exponent);
+}
+
+void
+HistogramAggregator::
+record(float value)
+{
+    auto & slot = stripes[statStripe()];
+
+    Stripe * stripe = slot.load(std::memory_order_acquire);
+    if (JML_UNLIKELY(!stripe)) {
+        std::unique_ptr<Stripe> newStripe(new Stripe());
+        if (slot.compare_exchange_strong(stripe, newStripe.get()))
+            stripe = newStripe.release();
+    }
+
+    double oldval = stripe->sum;
+    while (!ML::cmp_xchg(stripe->sum, oldval, oldval + value));
+
+    oldval = stripe->min;
+    while (value < oldval && !ML::cmp_xchg(stripe->min, oldval, (double)value));
+
+    oldval = stripe->max;
+    while (value > oldval && !ML::cmp_xchg(stripe->max, oldval, (double)value));
+
+    stripe->counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+HistogramAggregator::Snapshot::
+Snapshot()
+    : counts(NumBuckets), count(0), sum(0.0),
+      min(std::numeric_limits<double>::infinity()),
+      max(-std::numeric_limits<double>::infinity())
+{
+}
+
+double
+HistogramAggregator::Snapshot::
+percentile(double outOf100) const
+{
+    // Same element as the one GaugeAggregator picks in the sorted values
+    uint64_t element
+        = std::max<int64_t>(0, std::min<int64_t>(count - 1,
+                                                 outOf100 / 100.0 * count));
+
+    uint64_t seen = 0;
+    for (unsigned i = 0;  i < counts.size();  ++i) {
+        seen += counts[i];
+        if (seen > element) {
+            double value = bucketValue(i);
+            if (min <= max)
+                value = std::max(min, std::min(max, value));
+            return value;
+        }
+    }
+
+    return max;
+}
+
+HistogramAggregator::Snapshot
+HistogramAggregator::
+reset()
+{
+    Snapshot result;
+
+    for (auto & slot: stripes) {
+        Stripe * stripe = slot.load(std::memory_order_acquire);
+        if (!stripe) continue;
+
+        double oldval = stripe->sum;
+        while (!ML::cmp_xchg(stripe->sum, oldval, 0.0));
+        result.sum += oldval;
+
+        oldval = stripe->min;
+        while (!ML::cmp_xchg(stripe->min, oldval,
+                             std::numeric_limits<double>::infinity()));
+        result.min = std::min(result.min, oldval);
+
+        oldval = stripe->max;
+        while (!ML::cmp_xchg(stripe->max, oldval,
+                             -std::numeric_limits<double>::infinity()));
+        result.max = std::max(result.max, oldval);
+
+        for (unsigned i = 0;  i < NumBuckets;  ++i) {
+            if (stripe->counts[i].load(std::memory_order_relaxed) == 0)
+                continue;
+            uint32_t count = stripe->counts[i].exchange(0);
+            result.counts[i] += count;
+            result.count += count;
+        }
+    }
+
+    start = Date::now();
+
+    return result;
+}
+
+std::vector<StatReading>
+HistogramAggregator::
+read(const std::string & prefix)
+{
+    Snapshot values = reset();
+
+    if (values.count == 0)
+        return vector<StatReading>();
+
+    vector<StatReading> result;
+
+    auto addMetric = [&] (const char * name, double value)
+        {
+            result.push_back(StatReading(prefix + "." + name,
+                                         value, start));
+        };
+
+    addMetric("mean", values.sum / values.count);
+    addMetric("upper", values.max);
+    addMetric("lower", values.min);
+    addMetric("count", values.count);
+    for (int pct: extra) {
+        addMetric(ML::format("upper_%d", pct).c_str(),
+                  values.percentile(pct));
+    }
+
+    return result;
+}
+
 } // namespace Datacratic
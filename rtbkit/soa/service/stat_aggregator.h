@@ -15,6 +15,7 @@
 #include <unordered_map>
 #include <map>
 #include <deque>
+#include <atomic>
 #include <boost/scoped_ptr.hpp>
 
 
@@ -34,6 +35,17 @@ struct StatReading {
     Date timestamp;
 };
 
+/** Number of slots that the aggregators spread their state over so that
+    threads recording the same stat don't fight over a single cache line.
+*/
+enum { NumStatStripes = 8 };
+
+/** Slot used by the calling thread.  Threads are given one round robin the
+    first time they record anything.
+*/
+unsigned statStripe();
+
+
 /*****************************************************************************/
 /* STAT AGGREGATOR                                                           */
 /*****************************************************************************/
@@ -71,12 +83,23 @@ struct CounterAggregator : public StatAggregator {
     std::pair<double, Date> reset();
 
     /** Read and reset the counter, providing output in Graphite's preferred
-        format. */
+        format.  Nothing is output until the counter is first recorded to,
+        so that pre-registered counters which never fire don't show up.
+    */
     virtual std::vector<StatReading> read(const std::string & prefix);
 
 private:
     Date start;    //< Date at which we last cleared the counter
-    double total;  //< total since we last added it up
+    std::atomic<bool> hit; //< Whether record() was ever called
+
+    /** Total since we last added it up, one per thread slot.  Padded to a
+        cache line each.
+    */
+    struct Stripe {
+        double total;
+        char padding[64 - sizeof(double)];
+    };
+    Stripe stripes[NumStatStripes];
 
     std::deque<double> totalsBuffer; //< Totals for the last n reads.
 
@@ -122,4 +145,82 @@ private:
 };
 
 
+
+/*****************************************************************************/
+/* HISTOGRAM AGGREGATOR                                                      */
+/*****************************************************************************/
+
+/** Class that aggregates outcomes into a fixed set of log-linear buckets
+    instead of keeping every value around.  Each power of two between
+    2^MinExponent and 2^MaxExponent is split into 2^SubBucketBits linear
+    buckets, so that the percentiles are read back within 1.6% of their
+    true value; the mean, minimum and maximum are exact.
+
+    Each thread slot has its own set of buckets, which are only allocated
+    once a thread records into it, and they are merged when the stat is read.
+*/
+
+struct HistogramAggregator : public StatAggregator {
+
+    enum {
+        SubBucketBits = 5,
+        MinExponent = -16,
+        MaxExponent = 48,
+        NumBuckets = (MaxExponent - MinExponent) << SubBucketBits
+    };
+
+    HistogramAggregator(std::vector<int> extra = DefaultOutcomePercentiles);
+
+    virtual ~HistogramAggregator();
+
+    /** Record a new value of the stat.  Values below 2^MinExponent (including
+        negative ones) land in the first bucket and those above 2^MaxExponent
+        in the last.  Lock-free.
+    */
+    virtual void record(float value);
+
+    /** Merged content of the buckets since the last reset. */
+    struct Snapshot {
+        Snapshot();
+
+        std::vector<uint64_t> counts;
+        uint64_t count;
+        double sum;
+        double min;
+        double max;
+
+        /** Value below which the given percentage of the outcomes fall. */
+        double percentile(double outOf100) const;
+    };
+
+    /** Obtain the current buckets and clear them. */
+    Snapshot reset();
+
+    /** Read and reset the histogram, providing output in Graphite's
+        preferred format.  Produces the same stats as an Outcome gauge.
+    */
+    virtual std::vector<StatReading> read(const std::string & prefix);
+
+    /** Index of the bucket which holds the given value. */
+    static unsigned bucketOf(float value);
+
+    /** Value in the middle of the given bucket. */
+    static double bucketValue(unsigned bucket);
+
+private:
+    struct Stripe {
+        Stripe();
+
+        std::atomic<uint32_t> counts[NumBuckets];
+        double sum;
+        double min;
+        double max;
+    };
+
+    Date start;  //< Date at which we last cleared the histogram
+    std::atomic<Stripe *> stripes[NumStatStripes];
+    std::vector<int> extra;
+};
+
+
 } // namespace Datacratic
@@ -72,6 +72,22 @@ BOOST_AUTO_TEST_CASE( test_counter_aggregator )
     BOOST_CHECK_EQUAL(total, iter * nthreads);
 }
 
+BOOST_AUTO_TEST_CASE( test_counter_aggregator_never_hit )
+{
+    // A registered counter that never fires mustn't send zeros to carbon.
+    CounterAggregator aggregator;
+    BOOST_CHECK(aggregator.read("never").empty());
+    BOOST_CHECK(aggregator.read("never").empty());
+
+    aggregator.record(1.0);
+    auto readings = aggregator.read("hit");
+    BOOST_REQUIRE_EQUAL(readings.size(), 1);
+    BOOST_CHECK_EQUAL(readings[0].value, 1.0);
+
+    // Once hit, it keeps reporting its average like before.
+    BOOST_CHECK_EQUAL(aggregator.read("hit").size(), 1);
+}
+
 BOOST_AUTO_TEST_CASE( test_gauge_aggregator )
 {
     // We record events to aggregate from multiple threads with simultaneous
@@ -133,6 +149,77 @@ BOOST_AUTO_TEST_CASE( test_gauge_aggregator )
     BOOST_CHECK_EQUAL(allValues.std(), 0.5);
 }
 
+BOOST_AUTO_TEST_CASE( test_histogram_aggregator )
+{
+    // Same as above: no outcome can be lost while the histogram is reset
+    // from other threads, and the percentiles have to stay within the
+    // precision of the buckets.
+
+    cerr << "histogram aggregator" << endl;
+
+    HistogramAggregator aggregator;
+
+    uint64_t nthreads = 8, iter = 100000;
+    boost::barrier barrier(nthreads);
+    boost::thread_group tg;
+
+    boost::mutex mutex;
+    HistogramAggregator::Snapshot all;
+
+    auto merge = [&] (const HistogramAggregator::Snapshot & values)
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            for (unsigned i = 0;  i < values.counts.size();  ++i)
+                all.counts[i] += values.counts[i];
+            all.count += values.count;
+            all.sum += values.sum;
+            all.min = std::min(all.min, values.min);
+            all.max = std::max(all.max, values.max);
+        };
+
+    for (unsigned i = 0;  i < nthreads;  ++i) {
+        auto doThread = [&] ()
+            {
+                barrier.wait();
+
+                for (unsigned i = 0;  i < iter;  ++i) {
+                    aggregator.record(1 + i % 1000);
+
+                    if (random() % 1000 == 0)
+                        merge(aggregator.reset());
+                }
+            };
+
+        tg.create_thread(doThread);
+    }
+
+    tg.join_all();
+
+    merge(aggregator.reset());
+
+    BOOST_CHECK_EQUAL(all.count, iter * nthreads);
+    BOOST_CHECK_EQUAL(all.sum / all.count, 500.5);
+    BOOST_CHECK_EQUAL(all.min, 1);
+    BOOST_CHECK_EQUAL(all.max, 1000);
+
+    for (int pct: { 50, 90, 95, 98 }) {
+        double expected = 1 + pct * 10;
+        BOOST_CHECK_CLOSE(all.percentile(pct), expected, 1.6);
+    }
+
+    // Values out of the range of the buckets are clamped
+    BOOST_CHECK_EQUAL(HistogramAggregator::bucketOf(0.0), 0);
+    BOOST_CHECK_EQUAL(HistogramAggregator::bucketOf(-1.0), 0);
+    BOOST_CHECK_EQUAL(HistogramAggregator::bucketOf(1e30),
+                      HistogramAggregator::NumBuckets - 1);
+
+    for (float value: { 0.001f, 0.5f, 1.0f, 3.3f, 42.0f, 1e6f }) {
+        unsigned bucket = HistogramAggregator::bucketOf(value);
+        BOOST_CHECK_CLOSE(HistogramAggregator::bucketValue(bucket),
+                          value, 1.6);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_multi_aggregator )
 {
     std::vector<StatReading> readings;
@@ -169,6 +256,51 @@ BOOST_AUTO_TEST_CASE( test_multi_aggregator )
     BOOST_CHECK_EQUAL(readings[0].value, 50.0);
 }
 
+BOOST_AUTO_TEST_CASE( test_multi_aggregator_handles )
+{
+    std::vector<StatReading> readings;
+
+    boost::mutex m;
+    m.lock();
+
+    // Called once per stat; we want the first dump of both of them
+    int numCalls = 0;
+    auto recordReading = [&] (const std::vector<StatReading> & stats)
+        {
+            if (++numCalls > 2) return;
+            readings.insert(readings.end(), stats.begin(), stats.end());
+            if (numCalls == 2) m.unlock();
+        };
+
+    MultiAggregator agg("hello", recordReading, 0.0);
+
+    // A handle is the same stat as the one recorded by name
+    auto hits = agg.registerStat("hits", ET_HIT);
+    BOOST_CHECK_EQUAL(agg.registerStat("hits", ET_HIT), hits);
+
+    auto latency = agg.registerStat("latency", ET_OUTCOME, { 50 });
+
+    for (unsigned i = 1;  i <= 100;  ++i) {
+        hits->record(1.0);
+        agg.recordHit("hits");
+        latency->record(i);
+    }
+
+    agg.dump();
+    m.lock();
+
+    std::map<std::string, float> values;
+    for (auto & reading: readings)
+        values[reading.name] = reading.value;
+
+    BOOST_CHECK_EQUAL(values["hits"], 200);
+    BOOST_CHECK_EQUAL(values["latency.count"], 100);
+    BOOST_CHECK_EQUAL(values["latency.mean"], 50.5);
+    BOOST_CHECK_EQUAL(values["latency.upper"], 100);
+    BOOST_CHECK_EQUAL(values["latency.lower"], 1);
+    BOOST_CHECK_CLOSE(values["latency.upper_50"], 51, 1.6);
+}
+
 struct FakeCarbon : public PassiveEndpointT<SocketTransport> {
 
     FakeCarbon()
@@ -0,0 +1,308 @@
+/* hashed_timeout_map_test.cc                                      -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Tests for the hash table and timing wheel based timeout map, checked
+   against the tree based TimeoutMap.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "soa/service/hashed_timeout_map.h"
+#include "soa/service/timeout_map.h"
+#include "soa/types/id.h"
+#include <random>
+#include <set>
+#include <cmath>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+
+
+namespace {
+
+struct Value {
+    Value(int i = 0) : i(i) {}
+    int i;
+};
+
+typedef HashedTimeoutMap<Id, Value> Map;
+
+set<int> expireAll(Map & map, Date now)
+{
+    set<int> result;
+    map.expire([&] (const Id & id, const Value & value)
+               {
+                   result.insert(value.i);
+                   return Date();
+               }, now);
+    return result;
+}
+
+/* The wheel starts at the current time; timeouts well before it would all
+   sit in the slot of past timeouts.
+*/
+Date testStart()
+{
+    return Date::now().plusSeconds(1);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_basics )
+{
+    Map map;
+    Date start = testStart();
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(Id(1)) == map.end());
+    BOOST_CHECK(map.begin() == map.end());
+
+    for (int i = 0;  i < 1000;  ++i)
+        map.insert(Id(i), Value(i), start.plusSeconds(i));
+
+    BOOST_CHECK_EQUAL(map.size(), 1000);
+    BOOST_CHECK_THROW(map.insert(Id(10), Value(), start), ML::Exception);
+
+    auto it = map.find(Id(10));
+    BOOST_REQUIRE(it != map.end());
+    BOOST_CHECK_EQUAL(it->first, Id(10));
+    BOOST_CHECK_EQUAL(it->second.i, 10);
+    BOOST_CHECK_EQUAL(it->second.timeout, start.plusSeconds(10));
+
+    // References stay valid while the map grows
+    Value & v = map.insert(Id(5000), Value(5000), start);
+    for (int i = 1000;  i < 5000;  ++i)
+        map.insert(Id(i), Value(i), start.plusSeconds(i));
+    BOOST_CHECK_EQUAL(v.i, 5000);
+    BOOST_CHECK_EQUAL(&v, &map.find(Id(5000))->second);
+
+    for (int i = 0;  i < 5000;  i += 2)
+        BOOST_CHECK(map.erase(Id(i)));
+    BOOST_CHECK(!map.erase(Id(0)));
+    BOOST_CHECK_EQUAL(map.size(), 2501);
+
+    for (int i = 0;  i < 5000;  ++i)
+        BOOST_CHECK_EQUAL(map.count(Id(i)), i % 2 == 1);
+
+    size_t n = 0;
+    for (auto it = map.begin();  it != map.end();  ++it, ++n)
+        BOOST_CHECK_EQUAL(it->first, Id(it->second.i));
+    BOOST_CHECK_EQUAL(n, map.size());
+
+    BOOST_CHECK_THROW(map[Id(-1)], ML::Exception);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_expiry )
+{
+    Map map;
+    Date start = testStart();
+
+    // One timeout in each level of the wheel, and beyond
+    vector<double> timeouts = { -10.0, 0.0, 0.0005, 0.001, 0.2, 0.3, 20.0,
+                                1800.0, 2 * 86400.0, 80 * 86400.0 };
+    for (unsigned i = 0;  i < timeouts.size();  ++i)
+        map.insert(Id(i), Value(i), start.plusSeconds(timeouts[i]));
+    map.insert(Id(100), Value(100), Date::positiveInfinity());
+
+    BOOST_CHECK_EQUAL(expireAll(map, start.plusSeconds(-20)).size(), 0);
+    BOOST_CHECK(expireAll(map, start) == set<int>({ 0, 1 }));
+    BOOST_CHECK(expireAll(map, start.plusSeconds(0.0004)).empty());
+    BOOST_CHECK(expireAll(map, start.plusSeconds(0.0005)) == set<int>({ 2 }));
+
+    for (unsigned i = 3;  i < timeouts.size();  ++i) {
+        Date t = start.plusSeconds(timeouts[i]);
+        BOOST_CHECK(expireAll(map, t.plusSeconds(-0.0001)).empty());
+        BOOST_CHECK(expireAll(map, t) == set<int>({ int(i) }));
+    }
+
+    BOOST_CHECK_EQUAL(map.size(), 1);
+    BOOST_CHECK(expireAll(map, start.plusSeconds(1e9)).empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_next_expiry )
+{
+    Map map;
+    Date start = testStart();
+
+    BOOST_CHECK_EQUAL(map.nextExpiry(), Date::positiveInfinity());
+
+    mt19937 rng(7);
+    uniform_real_distribution<double> offset(0.0, 3600.0);
+    multiset<double> timeouts;
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        double t = i < 100 ? offset(rng) / 10000.0 : offset(rng);
+        timeouts.insert(t);
+        map.insert(Id(i), Value(i), start.plusSeconds(t));
+    }
+
+    // Never later than the first timeout, and nothing expires before it
+    while (!timeouts.empty()) {
+        Date first = start.plusSeconds(*timeouts.begin());
+        Date next = map.nextExpiry();
+        BOOST_REQUIRE_LE(next.secondsSinceEpoch(),
+                         first.secondsSinceEpoch() + 1e-6);
+        BOOST_REQUIRE(expireAll(map, next.plusSeconds(-1e-4)).empty());
+
+        auto expired = expireAll(map, first);
+        BOOST_REQUIRE(!expired.empty());
+        timeouts.erase(timeouts.begin(),
+                       timeouts.upper_bound(*timeouts.begin()));
+    }
+
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.nextExpiry(), Date::positiveInfinity());
+}
+
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_callbacks )
+{
+    Map map;
+    Date start = testStart();
+
+    for (int i = 0;  i < 10;  ++i)
+        map.insert(Id(i), Value(i), start.plusSeconds(i * 0.001));
+
+    // Entry 0 gets another second, and erases 1 which expires at the same
+    // time; the rest goes
+    set<int> seen;
+    map.expire([&] (const Id & id, Value & value)
+               {
+                   BOOST_CHECK(map.count(id));
+                   seen.insert(value.i);
+                   if (value.i == 0) {
+                       map.erase(Id(1));
+                       return start.plusSeconds(1);
+                   }
+                   return Date();
+               }, start.plusSeconds(0.01));
+
+    BOOST_CHECK_EQUAL(map.size(), 1);
+    BOOST_CHECK_EQUAL(seen.count(1), 0);
+    BOOST_CHECK_EQUAL(seen.size(), 9);
+    BOOST_CHECK_EQUAL(map.find(Id(0))->second.timeout, start.plusSeconds(1));
+
+    map.updateTimeout(Id(0), start.plusSeconds(2));
+    BOOST_CHECK(expireAll(map, start.plusSeconds(1.5)).empty());
+
+    map.expire(start.plusSeconds(2));
+    BOOST_CHECK(map.empty());
+}
+
+/* Random operations over a few minutes, checked against TimeoutMap. */
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_vs_timeout_map )
+{
+    Map map;
+    TimeoutMap<Id, Value> reference;
+
+    mt19937 rng(42);
+    Date now = testStart();
+    int next = 0;
+
+    auto randomTimeout = [&] ()
+        {
+            switch (rng() % 4) {
+            case 0: return now.plusSeconds((rng() % 1000) * 0.0001);
+            case 1: return now.plusSeconds((rng() % 1000) * 0.01);
+            case 2: return now.plusSeconds(rng() % 1000);
+            default: return now.plusSeconds(-0.001 * (rng() % 10));
+            }
+        };
+
+    for (int step = 0;  step < 20000;  ++step) {
+        int op = rng() % 10;
+        if (op < 5) {
+            Date timeout = randomTimeout();
+            map.insert(Id(next), Value(next), timeout);
+            reference.insert(Id(next), Value(next), timeout);
+            ++next;
+        }
+        else if (op < 7 && next > 0) {
+            Id id(rng() % next);
+            BOOST_CHECK_EQUAL(map.erase(id), reference.erase(id));
+        }
+        else if (op < 8 && next > 0) {
+            Id id(rng() % next);
+            if (reference.count(id)) {
+                Date timeout = randomTimeout();
+                map.updateTimeout(id, timeout);
+                reference.updateTimeout(id, timeout);
+            }
+        }
+        else {
+            now = now.plusSeconds((rng() % 100) * 0.001);
+
+            set<int> expected;
+            reference.expire([&] (const Id & id, const Value & value)
+                             {
+                                 expected.insert(value.i);
+                                 return Date();
+                             }, now);
+            set<int> expired = expireAll(map, now);
+            BOOST_CHECK(expired == expected);
+            if (expired != expected) break;
+        }
+
+        BOOST_REQUIRE_EQUAL(map.size(), reference.size());
+    }
+
+    for (auto & entry: reference.nodes)
+        BOOST_CHECK(map.count(entry.first));
+}
+
+/* A far off entry in an empty map mustn't move the wheel ahead of the
+   nearer entries scheduled after it, which would then all be scanned on
+   every expiry.
+*/
+BOOST_AUTO_TEST_CASE( test_hashed_timeout_map_far_entry_first )
+{
+    const int numEntries = 50000;
+
+    // The win timeout of the post auction loop, and no timeout at all
+    for (double farEntry: { 3600.0, double(INFINITY) }) {
+        Map map;
+
+        // Far enough ahead that none of the near entries is in the past by
+        // the time it gets inserted.
+        Date start = Date::now().plusSeconds(60);
+
+        map.insert(Id(-1), Value(-1), start.plusSeconds(farEntry));
+        for (int i = 0;  i < numEntries;  ++i)
+            map.insert(Id(i), Value(i), start.plusSeconds(i * 0.00005));
+
+        // Had the far entry moved the wheel ahead, every near entry would
+        // sit in the slot of past timeouts and be scanned on each expiry.
+        // That shows as a next expiry past the first near timeout; the
+        // timing of it is in timeout_map_bench.
+        BOOST_CHECK_LE(map.nextExpiry(), start);
+
+        // Each millisecond expires the next 20 entries, in order
+        int expired = 0, due = 0;
+        for (int ms = 1;  ms <= numEntries / 20;  ++ms) {
+            Date now = start.plusSeconds(ms * 0.001);
+            while (due < numEntries
+                   && start.plusSeconds(due * 0.00005) <= now)
+                ++due;
+
+            set<int> batch = expireAll(map, now);
+            for (int i: batch) {
+                BOOST_CHECK_GE(i, expired);
+                BOOST_CHECK_LT(i, due);
+            }
+            expired += batch.size();
+            BOOST_CHECK_EQUAL(expired, due);
+
+            if (due < numEntries)
+                BOOST_CHECK_LE(map.nextExpiry(),
+                               start.plusSeconds(due * 0.00005));
+        }
+
+        BOOST_CHECK_EQUAL(expired, numEntries);
+        BOOST_CHECK_EQUAL(map.size(), 1);
+    }
+}
@@ -115,3 +115,90 @@ BOOST_AUTO_TEST_CASE(test_http_header_query_parser_g6)
     BOOST_CHECK_EQUAL(parser.queryParams[2].second, "=");
     BOOST_CHECK_EQUAL(parser.queryParams[3].second, "");
 }
+
+BOOST_AUTO_TEST_CASE(test_http_header_parse_in_place)
+{
+    string request = ("POST /auctions HTTP/1.1\r\n"
+                      "Host: localhost\r\n"
+                      "Content-Type: application/json; charset=utf-8\r\n"
+                      "X-OpenRTB-Version: 2.1\r\n"
+                      "Connection: keep-alive\r\n"
+                      "X-Custom:value with spaces\r\n"
+                      "Content-Length: 2\r\n"
+                      "\r\n"
+                      "{}");
+    string buffer(request.begin(), request.end());  // not shared
+    const char * data = buffer.data();
+
+    Datacratic::HttpHeader header;
+    header.parseInPlace(buffer);
+
+    // The text was taken over, not copied
+    BOOST_CHECK_EQUAL((const void *)header.text.data(), (const void *)data);
+    BOOST_CHECK(buffer.empty());
+
+    BOOST_CHECK_EQUAL(header.verb, "POST");
+    BOOST_CHECK_EQUAL(header.resource, "/auctions");
+    BOOST_CHECK_EQUAL(header.version, "HTTP/1.1");
+    BOOST_CHECK_EQUAL(header.contentType, "application/json; charset=utf-8");
+    BOOST_CHECK_EQUAL(header.contentLength, 2);
+    BOOST_CHECK_EQUAL(header.knownData, "{}");
+    BOOST_CHECK_EQUAL(header.fields.size(), 6);
+    BOOST_CHECK(header.headers.empty());
+
+    typedef Datacratic::HttpHeader H;
+    BOOST_CHECK_EQUAL(header.findHeader(H::OPENRTB_VERSION), "2.1");
+    BOOST_CHECK_EQUAL(header.findHeader(H::CONNECTION), "keep-alive");
+    BOOST_CHECK_EQUAL(header.findHeader(H::CONTENT_LENGTH), "2");
+    BOOST_CHECK(!header.findHeader(H::EXPECT).data());
+
+    BOOST_CHECK_EQUAL(header.findHeader("x-openrtb-version"), "2.1");
+    BOOST_CHECK_EQUAL(header.findHeader("HOST"), "localhost");
+    BOOST_CHECK_EQUAL(header.findHeader("x-custom"), "value with spaces");
+    BOOST_CHECK(!header.hasHeader("x-missing"));
+    BOOST_CHECK_EQUAL(header.tryGetHeader("x-missing"), "");
+    BOOST_CHECK_THROW(header.getHeader("x-missing"), ML::Exception);
+
+    // Same result as the copying parser, which also fills the map
+    Datacratic::HttpHeader copied;
+    copied.parse(request);
+    BOOST_CHECK_EQUAL(copied.headers.size(), 4);
+    BOOST_CHECK_EQUAL(copied.headers["x-openrtb-version"], "2.1");
+    BOOST_CHECK_EQUAL(copied.findHeader(H::OPENRTB_VERSION), "2.1");
+    BOOST_CHECK_EQUAL(copied.contentType, header.contentType);
+
+    // The buffer gets the memory of the previous request back
+    buffer.append("GET /ready HTTP/1.1\r\n\r\n");
+    header.parseInPlace(buffer);
+    BOOST_CHECK_EQUAL(header.verb, "GET");
+    BOOST_CHECK_EQUAL(header.contentLength, -1);
+    BOOST_CHECK(header.fields.empty());
+    BOOST_CHECK(!header.findHeader(H::OPENRTB_VERSION).data());
+    BOOST_CHECK(buffer.empty());
+    BOOST_CHECK_EQUAL((const void *)buffer.data(), (const void *)data);
+}
+
+BOOST_AUTO_TEST_CASE(test_http_header_set_header)
+{
+    string buffer = ("POST /auctions HTTP/1.1\r\n"
+                     "x-openrtb-version: 2.0\r\n"
+                     "\r\n");
+    Datacratic::HttpHeader header;
+    header.parseInPlace(buffer);
+
+    Datacratic::HttpHeader patched(header);
+    patched.setHeader("X-OpenRTB-Version", "2.1");
+    patched.setHeader("X-Extra", "1");
+
+    typedef Datacratic::HttpHeader H;
+    BOOST_CHECK_EQUAL(patched.findHeader(H::OPENRTB_VERSION), "2.1");
+    BOOST_CHECK_EQUAL(patched.findHeader("x-extra"), "1");
+    BOOST_CHECK_EQUAL(patched.fields.size(), 2);
+    BOOST_CHECK_EQUAL(header.findHeader(H::OPENRTB_VERSION), "2.0");
+
+    // Headers that were filled in by hand are looked up in the map
+    Datacratic::HttpHeader manual;
+    manual.setHeader("X-OpenRTB-Version", "2.2");
+    BOOST_CHECK_EQUAL(manual.headers["x-openrtb-version"], "2.2");
+    BOOST_CHECK_EQUAL(manual.findHeader(H::OPENRTB_VERSION), "2.2");
+}
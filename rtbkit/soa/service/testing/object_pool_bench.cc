@@ -0,0 +1,276 @@
+/* object_pool_bench.cc
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Cost of allocating objects shaped like an auction and its bid request on
+   a few exchange threads and dropping them on a single router thread, with
+   the three ways the router has had to get rid of them:
+
+   - plain: the router runs the destructors itself;
+   - graveyard: the router hands them to a cleanup thread;
+   - pool: they're allocated from an ObjectPool and destroyed back on their
+     exchange thread, a few per allocation and the rest collected once a
+     second like the exchange connectors do.
+
+   Run each mode in its own process, as the peak RSS is for the process.
+   Link with the allocator to compare against, e.g. tcmalloc.
+*/
+
+#include "soa/service/object_pool.h"
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <map>
+
+using namespace std;
+using namespace Datacratic;
+
+
+namespace {
+
+/* About the shape of a bid request: strings of a few dozen to a few
+   hundred bytes, a vector of spots with their own members, an extension
+   map and the raw payload.
+*/
+struct Spot {
+    string id;
+    vector<string> formats;
+    unique_ptr<string> ext;
+};
+
+struct Request {
+    Request(mt19937 & rng)
+    {
+        auto str = [&] (size_t min, size_t max)
+            {
+                return string(min + rng() % (max - min), 'x');
+            };
+
+        id = str(16, 40);
+        url = str(40, 300);
+        userAgent = str(60, 200);
+        ip = str(8, 16);
+
+        imp.resize(1 + rng() % 3);
+        for (auto & spot: imp) {
+            spot.id = str(1, 8);
+            for (unsigned i = 0;  i < 2;  ++i)
+                spot.formats.push_back(str(5, 10));
+            spot.ext.reset(new string(str(20, 100)));
+        }
+
+        for (unsigned i = 0;  i < 5;  ++i)
+            ext[str(5, 20) + to_string(i)] = str(10, 60);
+
+        payload = str(1000, 3000);
+    }
+
+    string id, url, userAgent, ip;
+    vector<Spot> imp;
+    map<string, string> ext;
+    string payload;
+};
+
+struct Auction {
+    Auction(mt19937 & rng) : request(rng) {}
+
+    Request request;
+    vector<string> augmentations;
+};
+
+double now()
+{
+    return chrono::duration<double>
+        (chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t residentKb()
+{
+    size_t pages = 0, resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+} // file scope
+
+int main(int argc, char ** argv)
+{
+    using namespace boost::program_options;
+
+    string mode = "pool";
+    unsigned numThreads = 4;
+    size_t perThread = 1000000;
+    size_t inFlight = 20000;
+    size_t maxDestroyed = 2;
+
+    options_description options("Options");
+    options.add_options()
+        ("mode,m", value(&mode),
+         "plain, graveyard or pool")
+        ("threads,t", value(&numThreads),
+         "number of exchange threads")
+        ("auctions,n", value(&perThread),
+         "number of auctions per exchange thread")
+        ("in-flight,f", value(&inFlight),
+         "most auctions handed over but not dropped yet")
+        ("max-destroyed,d", value(&maxDestroyed),
+         "most auctions the pool destroys per allocation")
+        ("help,h", "print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(options).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")
+        || (mode != "plain" && mode != "graveyard" && mode != "pool")) {
+        cerr << options << endl;
+        return 1;
+    }
+
+    ObjectPool<Auction> & pool = *new ObjectPool<Auction>(4096, maxDestroyed);
+
+    std::mutex lock;
+    vector<shared_ptr<Auction> > handedOver;
+    std::mutex graveyardLock;
+    vector<shared_ptr<Auction> > graveyard;
+    atomic<unsigned> done(0);
+    atomic<double> allocSeconds(0.0);
+    std::mutex worstLock;
+    double worstAlloc = 0.0;
+
+    auto exchangeThread = [&] (unsigned n)
+        {
+            mt19937 rng(n);
+            double spent = 0.0, worst = 0.0;
+            double lastCollect = now();
+
+            for (size_t i = 0;  i < perThread;  ++i) {
+                for (;;) {
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (handedOver.size() < inFlight) break;
+                    }
+                    this_thread::yield();
+                }
+
+                double start = now();
+                auto auction = mode == "pool"
+                    ? pool.make(rng) : make_shared<Auction>(rng);
+                double end = now();
+                spent += end - start;
+                worst = max(worst, end - start);
+
+                if (mode == "pool" && end - lastCollect >= 1.0) {
+                    pool.collect();
+                    lastCollect = end;
+                }
+
+                std::lock_guard<std::mutex> guard(lock);
+                handedOver.push_back(std::move(auction));
+            }
+
+            double total = allocSeconds.load();
+            while (!allocSeconds.compare_exchange_weak(total, total + spent))
+                ;
+            {
+                std::lock_guard<std::mutex> guard(worstLock);
+                worstAlloc = max(worstAlloc, worst);
+            }
+            ++done;
+        };
+
+    double routerSeconds = 0.0;
+    atomic<bool> routerDone(false);
+    size_t peakKb = 0;
+
+    auto routerThread = [&] ()
+        {
+            for (;;) {
+                bool finished = done == numThreads;
+
+                vector<shared_ptr<Auction> > batch;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    batch.swap(handedOver);
+                }
+
+                if (batch.empty()) {
+                    if (finished) break;
+                    this_thread::yield();
+                    continue;
+                }
+
+                double start = now();
+                // The graveyard is a ring of 65536 auctions; when it's full
+                // the router destroys them itself.
+                if (mode == "graveyard") {
+                    std::lock_guard<std::mutex> guard(graveyardLock);
+                    for (auto & auction: batch) {
+                        if (graveyard.size() == 65536) break;
+                        graveyard.push_back(std::move(auction));
+                    }
+                }
+                batch.clear();
+                routerSeconds += now() - start;
+
+                peakKb = max(peakKb, residentKb());
+            }
+        };
+
+    // Wakes up every millisecond, like the router's cleanup thread did
+    auto cleanupThread = [&] ()
+        {
+            while (!routerDone) {
+                vector<shared_ptr<Auction> > toDelete;
+                {
+                    std::lock_guard<std::mutex> guard(graveyardLock);
+                    toDelete.swap(graveyard);
+                }
+                toDelete.clear();
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        };
+
+    double start = now();
+
+    vector<thread> threads;
+    for (unsigned i = 0;  i < numThreads;  ++i)
+        threads.emplace_back(exchangeThread, i);
+    thread router(routerThread);
+    thread cleanup;
+    if (mode == "graveyard")
+        cleanup = thread(cleanupThread);
+
+    for (auto & t: threads)
+        t.join();
+    router.join();
+    routerDone = true;
+    if (cleanup.joinable())
+        cleanup.join();
+
+    double elapsed = now() - start;
+    size_t auctions = numThreads * perThread;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    cout << mode << ": "
+         << auctions / elapsed << " auctions/s, "
+         << allocSeconds / auctions * 1e9 << " ns/allocation, "
+         << "worst " << worstAlloc * 1e6 << " us, "
+         << routerSeconds / auctions * 1e9 << " ns/drop on the router, "
+         << "peak RSS " << usage.ru_maxrss / 1024 << "MB"
+         << " (sampled " << peakKb / 1024 << "MB)" << endl;
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/* object_pool_test.cc                                             -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Tests for the object pool.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "soa/service/object_pool.h"
+#include <thread>
+#include <string>
+
+using namespace std;
+using namespace Datacratic;
+
+
+namespace {
+
+struct Object {
+    Object(int i) : i(i), str(1000, 'x'), owner(this_thread::get_id())
+    {
+        ++created;
+    }
+
+    ~Object()
+    {
+        ++destroyed;
+        if (this_thread::get_id() != owner) ++destroyedElsewhere;
+    }
+
+    int i;
+    string str;
+    thread::id owner;
+
+    static atomic<int> created, destroyed, destroyedElsewhere;
+};
+
+atomic<int> Object::created(0);
+atomic<int> Object::destroyed(0);
+atomic<int> Object::destroyedElsewhere(0);
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_object_pool_reuse )
+{
+    ObjectPool<Object> pool;
+
+    auto obj = pool.make(1);
+    BOOST_CHECK_EQUAL(obj->i, 1);
+    Object * address = obj.get();
+
+    obj.reset();
+    BOOST_CHECK_EQUAL(pool.stats().live(), 1);
+
+    // The next allocation destroys the released object and reuses its block
+    obj = pool.make(2);
+    BOOST_CHECK_EQUAL(obj.get(), address);
+    BOOST_CHECK_EQUAL(obj->i, 2);
+
+    auto stats = pool.stats();
+    BOOST_CHECK_EQUAL(stats.allocated, 2);
+    BOOST_CHECK_EQUAL(stats.reused, 1);
+    BOOST_CHECK_EQUAL(stats.destroyed, 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_object_pool_destroyed_on_owner )
+{
+    ObjectPool<Object> pool;
+    Object::destroyed = Object::destroyedElsewhere = 0;
+
+    vector<shared_ptr<Object> > objects;
+    for (unsigned i = 0;  i < 100;  ++i)
+        objects.push_back(pool.make(i));
+
+    // Dropped on another thread, they're only queued there
+    thread consumer([&] () { objects.clear(); });
+    consumer.join();
+    BOOST_CHECK_EQUAL(Object::destroyed, 0);
+
+    // Nor by a thread that never allocated from the pool
+    thread idle([&] () { pool.collect(); });
+    idle.join();
+    BOOST_CHECK_EQUAL(Object::destroyed, 0);
+    BOOST_CHECK_EQUAL(pool.stats().live(), 100);
+
+    pool.collect();
+    BOOST_CHECK_EQUAL(Object::destroyed, 100);
+    BOOST_CHECK_EQUAL(Object::destroyedElsewhere, 0);
+    BOOST_CHECK_EQUAL(pool.stats().free, 100);
+}
+
+BOOST_AUTO_TEST_CASE( test_object_pool_bounded_make )
+{
+    ObjectPool<Object> pool(4096, 2);
+    Object::destroyed = 0;
+
+    vector<shared_ptr<Object> > objects;
+    for (unsigned i = 0;  i < 100;  ++i)
+        objects.push_back(pool.make(i));
+    objects.clear();
+
+    // An allocation only destroys a couple of the released objects; the
+    // backlog waits for collect().
+    auto obj = pool.make(100);
+    BOOST_CHECK_EQUAL(Object::destroyed, 2);
+
+    pool.collect();
+    BOOST_CHECK_EQUAL(Object::destroyed, 100);
+    BOOST_CHECK_EQUAL(pool.stats().live(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_object_pool_orphans )
+{
+    ObjectPool<Object> pool;
+    Object::destroyed = 0;
+
+    shared_ptr<Object> obj;
+    thread producer([&] () { obj = pool.make(1); });
+    producer.join();
+
+    // The producer is gone; its cache goes to the next thread to allocate
+    obj.reset();
+    thread adopter([&] () { pool.make(2); });
+    adopter.join();
+
+    BOOST_CHECK_EQUAL(Object::destroyed, 1);
+    auto stats = pool.stats();
+    BOOST_CHECK_EQUAL(stats.allocated, 2);
+    BOOST_CHECK_EQUAL(stats.reused, 1);
+    BOOST_CHECK_EQUAL(stats.live(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( test_object_pool_threads )
+{
+    ObjectPool<Object> pool;
+    Object::created = Object::destroyed = Object::destroyedElsewhere = 0;
+
+    const int perThread = 100000;
+    atomic<int> done(0);
+
+    // Producers allocate and hand the objects over to a single consumer,
+    // which drops them.
+    std::mutex lock;
+    vector<shared_ptr<Object> > handedOver;
+
+    auto produce = [&] ()
+        {
+            for (int i = 0;  i < perThread;  ++i) {
+                auto obj = pool.make(i);
+                std::lock_guard<std::mutex> guard(lock);
+                handedOver.push_back(std::move(obj));
+            }
+            pool.collect();
+            ++done;
+        };
+
+    vector<thread> producers;
+    for (unsigned i = 0;  i < 4;  ++i)
+        producers.emplace_back(produce);
+
+    thread consumer([&] ()
+        {
+            while (done < 4) {
+                vector<shared_ptr<Object> > batch;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    batch.swap(handedOver);
+                }
+            }
+        });
+
+    for (auto & t: producers)
+        t.join();
+    consumer.join();
+
+    BOOST_CHECK_EQUAL(Object::destroyedElsewhere, 0);
+
+    handedOver.clear();
+    pool.collect();
+
+    BOOST_CHECK_EQUAL(Object::created, 4 * perThread);
+    BOOST_CHECK_EQUAL(Object::created - Object::destroyed,
+                      pool.stats().live());
+}
@@ -34,6 +34,8 @@ $(eval $(call test,http_header_test,endpoint,boost manual))
 $(eval $(call test,service_proxies_test,endpoint,boost manual))
 
 $(eval $(call test,message_loop_test,services,boost))
+$(eval $(call test,hashed_timeout_map_test,types,boost))
+$(eval $(call test,object_pool_test,boost_thread,boost))
 
 $(eval $(call program,runner_test_helper,utils))
 $(eval $(call test,runner_test,services,boost))
@@ -47,6 +49,8 @@ $(eval $(call test,nprobe_test,services,boost manual))
 $(eval $(call library,test_services,test_http_services.cc,services))
 
 $(eval $(call program,async_writer_bench,services))
+$(eval $(call program,zmq_named_pub_sub_bench,services))
+$(eval $(call program,object_pool_bench,boost_program_options boost_thread))
 
 # nsq_client_test is "manual" because of dependency on nsqd */
 $(eval $(call test,nsq_client_test,cloud,boost manual))
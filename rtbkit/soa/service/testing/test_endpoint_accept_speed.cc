@@ -27,18 +27,19 @@ using namespace std;
 using namespace ML;
 using namespace Datacratic;
 
-void runAcceptSpeedTest()
+void runAcceptSpeedTest(bool sharded = false, int numThreads = 1)
 {
     string connectionError;
 
     PassiveEndpointT<SocketTransport> acceptor("acceptor");
+    acceptor.shardThreads(sharded);
     
     acceptor.onMakeNewHandler = [&] ()
         {
             return ML::make_std_sp(new PongConnectionHandler(connectionError));
         };
     
-    int port = acceptor.init();
+    int port = acceptor.init(PortRange(), "localhost", numThreads);
 
     cerr << "port = " << port << endl;
 
@@ -74,6 +75,8 @@ void runAcceptSpeedTest()
         }
     }
 
+    Date connected = Date::now();
+
     /* Write to each and get a response back.  This makes sure that all are open. */
     for (unsigned i = 0;  i < sockets.size();  ++i) {
         int s = sockets[i];
@@ -91,6 +94,11 @@ void runAcceptSpeedTest()
 
     Date after = Date::now();
 
+    cerr << "accepted " << sockets.size() << " connections with "
+         << numThreads << (sharded ? " sharded" : "") << " threads in "
+         << after.secondsSince(before) << " seconds ("
+         << connected.secondsSince(before) << " connecting)" << endl;
+
     BOOST_CHECK_LT(after.secondsSince(before), 1);
 
     BOOST_CHECK_EQUAL(sockets.size(), nconnections);
@@ -99,6 +107,13 @@ void runAcceptSpeedTest()
 
     BOOST_CHECK_EQUAL(acceptor.numConnections(), nconnections);
 
+    if (sharded) {
+        BOOST_CHECK_EQUAL(acceptor.numShards(), numThreads);
+        auto byHost = acceptor.numConnectionsByHost();
+        BOOST_CHECK_EQUAL(byHost.size(), 1);
+        BOOST_CHECK_EQUAL(byHost.begin()->second, nconnections);
+    }
+
     acceptor.closePeer();
 
     for (unsigned i = 0;  i < sockets.size();  ++i) {
@@ -128,3 +143,19 @@ BOOST_AUTO_TEST_CASE( test_accept_speed )
     BOOST_CHECK_EQUAL(ConnectionHandler::created,
                       ConnectionHandler::destroyed);
 }
+
+BOOST_AUTO_TEST_CASE( test_accept_speed_sharded )
+{
+    BOOST_REQUIRE_EQUAL(TransportBase::created, TransportBase::destroyed);
+    BOOST_REQUIRE_EQUAL(ConnectionHandler::created,
+                        ConnectionHandler::destroyed);
+
+    Watchdog watchdog(50.0);
+
+    runAcceptSpeedTest(false /* sharded */, 4);
+    runAcceptSpeedTest(true /* sharded */, 4);
+
+    BOOST_CHECK_EQUAL(TransportBase::created, TransportBase::destroyed);
+    BOOST_CHECK_EQUAL(ConnectionHandler::created,
+                      ConnectionHandler::destroyed);
+}
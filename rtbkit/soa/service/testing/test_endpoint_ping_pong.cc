@@ -24,7 +24,7 @@ using namespace std;
 using namespace ML;
 using namespace Datacratic;
 
-BOOST_AUTO_TEST_CASE( test_ping_pong )
+void runPingPongTest(bool sharded)
 {
     BOOST_REQUIRE_EQUAL(TransportBase::created, TransportBase::destroyed);
     BOOST_REQUIRE_EQUAL(ConnectionHandler::created,
@@ -35,13 +35,14 @@ BOOST_AUTO_TEST_CASE( test_ping_pong )
     string connectionError;
 
     PassiveEndpointT<SocketTransport> acceptor("acceptor");
+    acceptor.shardThreads(sharded);
     
     acceptor.onMakeNewHandler = [&] ()
         {
             return ML::make_std_sp(new PongConnectionHandler(connectionError));
         };
     
-    int port = acceptor.init();
+    int port = acceptor.init(PortRange(), "localhost", sharded ? 2 : 1);
 
     cerr << "port = " << port << endl;
 
@@ -103,3 +104,13 @@ BOOST_AUTO_TEST_CASE( test_ping_pong )
     BOOST_CHECK_EQUAL(ConnectionHandler::created,
                       ConnectionHandler::destroyed);
 }
+
+BOOST_AUTO_TEST_CASE( test_ping_pong )
+{
+    runPingPongTest(false /* sharded */);
+}
+
+BOOST_AUTO_TEST_CASE( test_ping_pong_sharded )
+{
+    runPingPongTest(true /* sharded */);
+}
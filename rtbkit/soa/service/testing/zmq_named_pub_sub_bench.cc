@@ -0,0 +1,91 @@
+/* zmq_named_pub_sub_bench.cc                                      -*- C++ -*-
+   Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+   Cost of publishing a router style log message on a ZmqNamedPublisher
+   depending on who is subscribed to it.
+*/
+
+#include "jml/arch/timers.h"
+#include "soa/service/service_base.h"
+#include "soa/service/zmq_named_pub_sub.h"
+
+using namespace std;
+using namespace Datacratic;
+
+
+/* Roughly what the router logs for each bid. */
+const string bids =
+    "[{\"availableCreatives\":[0,1],\"creativeIndex\":0,"
+    "\"price\":\"1500USD/1M\",\"priority\":0.0,\"spotIndex\":0}]";
+
+template<typename Fn>
+double timeIt(size_t iterations, Fn fn)
+{
+    Date start = Date::now();
+    for (size_t i = 0;  i < iterations;  ++i)
+        fn();
+    return Date::now().secondsSince(start) / iterations * 1e9;
+}
+
+void bench(ZmqNamedPublisher & pub, const string & label, size_t iterations)
+{
+    double printed = timeIt(iterations, [&] {
+            pub.publish("BID", Date::now().print(5), "agent",
+                        "auction-id", bids, "{}");
+        });
+
+    double binary = timeIt(iterations, [&] {
+            pub.publish("BID", BinaryTimestamp(), "agent",
+                        "auction-id", bids, "{}");
+        });
+
+    cerr << label << ": " << printed << " ns/publish with a printed "
+         << "timestamp, " << binary << " ns/publish with a binary one"
+         << endl;
+
+    // Let the message loop drain what was queued
+    ML::sleep(0.5);
+}
+
+int main(int argc, char ** argv)
+{
+    size_t iterations = 100000;
+    if (argc > 1)
+        iterations = std::stoul(argv[1]);
+
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    ZmqNamedPublisher pub(proxies->zmqContext, iterations * 2);
+    pub.init(proxies->config, "bench/logger");
+    string uri = pub.bindTcp();
+    pub.start();
+
+    zmq::socket_t sub(*proxies->zmqContext, ZMQ_SUB);
+    setHwm(sub, iterations * 2);
+    sub.connect(uri.c_str());
+
+    auto waitFor = [&] (bool subscribed) {
+        while (pub.hasSubscriber("BID") != subscribed)
+            ML::sleep(0.01);
+    };
+
+    bench(pub, "no subscriber", iterations);
+
+    subscribeChannel(sub, "AUCTION");
+    while (!pub.hasSubscriber("AUCTION"))
+        ML::sleep(0.01);
+    bench(pub, "subscriber on another channel", iterations);
+
+    subscribeChannel(sub, "BID");
+    waitFor(true);
+    bench(pub, "subscriber on the channel", iterations);
+
+    unsubscribeChannel(sub, "BID");
+    unsubscribeChannel(sub, "AUCTION");
+    subscribeChannel(sub, "");
+    waitFor(true);
+    bench(pub, "subscriber on all channels", iterations);
+
+    pub.shutdown();
+    return 0;
+}
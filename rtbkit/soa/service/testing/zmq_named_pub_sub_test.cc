@@ -254,3 +254,45 @@ BOOST_AUTO_TEST_CASE( test_named_publisher )
     // Check that it got all of the messages
     BOOST_CHECK_EQUAL(numMessages, numIter * 2);
 }
+
+BOOST_AUTO_TEST_CASE( test_publisher_subscriptions )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+
+    Publisher pub("pub", proxies);
+    pub.init();
+    string uri = pub.bindTcp();
+    pub.start();
+
+    auto waitFor = [&] (const std::string & channel, bool expected)
+        {
+            for (unsigned i = 0;  i < 100;  ++i) {
+                if (pub.hasSubscriber(channel) == expected) return true;
+                ML::sleep(0.01);
+            }
+            return false;
+        };
+
+    BOOST_CHECK(!pub.hasSubscriber("BID"));
+
+    zmq::socket_t sub(*proxies->zmqContext, ZMQ_SUB);
+    sub.connect(uri.c_str());
+
+    subscribeChannel(sub, "BI");
+    BOOST_CHECK(waitFor("BID", true));
+    BOOST_CHECK(!pub.hasSubscriber("AUCTION"));
+    BOOST_CHECK(!pub.hasSubscriber("B"));
+
+    subscribeChannel(sub, "");
+    BOOST_CHECK(waitFor("AUCTION", true));
+
+    unsubscribeChannel(sub, "");
+    BOOST_CHECK(waitFor("AUCTION", false));
+    BOOST_CHECK(pub.hasSubscriber("BID"));
+
+    unsubscribeChannel(sub, "BI");
+    BOOST_CHECK(waitFor("BID", false));
+
+    // Nothing listens so nothing is encoded or queued
+    pub.publish("BID", BinaryTimestamp(), "nobody");
+}
@@ -52,7 +52,7 @@ TransportBase(EndpointBase * endpoint)
     : lockThread(0), lockActivity(0), debug(DEBUG_TRANSPORTS),
       asyncHead_(0),
       endpoint_(endpoint),
-      recycle_(0), close_(0), flags_(0),
+      recycle_(0), close_(0), flags_(0), shard_(-1),
       hasConnection_(false), zombie_(false)
 {
     atomic_add(created, 1);
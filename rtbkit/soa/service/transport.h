@@ -483,6 +483,9 @@ private:
     /** FD used for epoll when multiplexing events */
     int epollFd_;
 
+    /** Event thread of a sharded endpoint that owns the transport, or -1 */
+    int shard_;
+
     /** FD used for timeouts. */
     int timerFd_;
 
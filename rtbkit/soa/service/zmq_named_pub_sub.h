@@ -9,7 +9,10 @@
 
 #include "zmq_endpoint.h"
 #include "typed_message_channel.h"
+#include "soa/gc/gc_lock.h"
 #include <sys/utsname.h>
+#include <atomic>
+#include <map>
 #include "jml/arch/backtrace.h"
 
 namespace Datacratic {
@@ -21,19 +24,29 @@ namespace Datacratic {
 /*****************************************************************************/
 
 /** Class that publishes messages.  It also knows what is connected to it.
+
+    The XPUB socket tells us about every subscription prefix that appears or
+    disappears.  They are kept in a snapshot that publishing threads read
+    under a GC lock, so that a message on a channel nobody listens to is
+    dropped before any of its arguments are encoded.
  */
 struct ZmqNamedPublisher: public MessageLoop {
 
     ZmqNamedPublisher(std::shared_ptr<zmq::context_t> context,
                       int messageBufferSize = 65536)
         : publishEndpoint(context),
-          publishQueue(messageBufferSize)
+          publishQueue(messageBufferSize),
+          numSubscriptions(0),
+          subscribedToAll(false),
+          subscriptions(new Subscriptions())
     {
     }
 
     virtual ~ZmqNamedPublisher()
     {
         shutdown();
+        subscriptionsGc.deferBarrier();
+        delete subscriptions.load();
     }
 
     void init(std::shared_ptr<ConfigurationService> config,
@@ -64,6 +77,8 @@ struct ZmqNamedPublisher: public MessageLoop {
                 cerr << "msg[0].size() = " << msg[0].size() << endl;
                 cerr << "msg[0][0] = " << (int)msg[0][0] << endl;
 #endif
+                if (msg.empty() || msg[0].empty()) return;
+                this->updateSubscriptions(msg[0][0] == 1, msg[0].substr(1));
             };
 
         publishEndpoint.messageHandler = doPublishMessage;
@@ -90,6 +105,24 @@ struct ZmqNamedPublisher: public MessageLoop {
     //{
     //}
 
+    /** Returns whether something is subscribed to messages on the given
+        channel.  publish() already checks this; callers can use it to skip
+        building expensive arguments for a message nobody will receive.
+    */
+    bool hasSubscriber(const std::string & channel) const
+    {
+        if (!numSubscriptions.load(std::memory_order_acquire)) return false;
+        if (subscribedToAll.load(std::memory_order_relaxed)) return true;
+
+        GcLock::SharedGuard guard(subscriptionsGc, GcLock::RD_NO);
+        const Subscriptions * current = subscriptions.load();
+        for (auto & prefix: *current) {
+            if (channel.compare(0, prefix.size(), prefix) == 0)
+                return true;
+        }
+        return false;
+    }
+
     template<typename Head, typename... Tail>
     void encodeAll(std::vector<zmq::message_t> & messages,
                    Head head,
@@ -117,6 +150,8 @@ struct ZmqNamedPublisher: public MessageLoop {
     template<typename... Args>
     void publish(const std::string & channel, Args&&... args)
     {
+        if (!hasSubscriber(channel)) return;
+
         std::vector<zmq::message_t> messages;
         messages.reserve(sizeof...(Args) + 1);
         
@@ -131,6 +166,49 @@ private:
 
     /// Queue of things to be published
     TypedMessageSink<std::vector<zmq::message_t> > publishQueue;
+
+    /** Called from the message loop when the XPUB socket forwards a
+        subscription or an unsubscription.  The socket only forwards the
+        first subscription and the last unsubscription of each prefix, but
+        we count them anyway in case it was made verbose.
+    */
+    void updateSubscriptions(bool subscribe, const std::string & prefix)
+    {
+        if (subscribe)
+            ++subscriptionCounts[prefix];
+        else {
+            auto it = subscriptionCounts.find(prefix);
+            if (it == subscriptionCounts.end()) return;
+            if (--it->second == 0)
+                subscriptionCounts.erase(it);
+        }
+
+        std::unique_ptr<Subscriptions> newSubscriptions(new Subscriptions());
+        for (auto & entry: subscriptionCounts)
+            newSubscriptions->push_back(entry.first);
+
+        subscribedToAll = subscriptionCounts.count("");
+        const Subscriptions * old
+            = subscriptions.exchange(newSubscriptions.release());
+        numSubscriptions = subscriptionCounts.size();
+
+        subscriptionsGc.defer([=] () { delete old; });
+    }
+
+    typedef std::vector<std::string> Subscriptions;
+
+    /// Number of prefixes subscribed to; nothing is published while zero
+    std::atomic<size_t> numSubscriptions;
+
+    /// Set when the empty prefix, which matches all channels, is subscribed
+    std::atomic<bool> subscribedToAll;
+
+    /// Subscribed prefixes, replaced as a whole and read under the GC lock
+    std::atomic<const Subscriptions *> subscriptions;
+    mutable GcLock subscriptionsGc;
+
+    /// Reference count of each prefix; only touched by the message loop
+    std::map<std::string, int> subscriptionCounts;
 };
 
 
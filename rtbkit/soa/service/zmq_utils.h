@@ -11,6 +11,7 @@
 #include <string>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 #include <boost/utility.hpp>
 #include "soa/service/zmq.hpp"
@@ -168,6 +169,38 @@ inline zmq::message_t encodeMessage(const Date & date)
     return ML::format("%.5f", date.secondsSinceEpoch());
 }
 
+/** Timestamp sent as the 8 raw bytes of its seconds since the epoch, which
+    costs nothing to produce compared to printing it.  Receivers turn it back
+    into text with printTimestamp().
+*/
+struct BinaryTimestamp {
+    explicit BinaryTimestamp(Date date = Date::now())
+        : secondsSinceEpoch(date.secondsSinceEpoch())
+    {
+    }
+
+    double secondsSinceEpoch;
+};
+
+inline zmq::message_t encodeMessage(const BinaryTimestamp & ts)
+{
+    zmq::message_t zmsg(sizeof(ts.secondsSinceEpoch));
+    memcpy(zmsg.data(), &ts.secondsSinceEpoch, sizeof(ts.secondsSinceEpoch));
+    return zmsg;
+}
+
+/** Returns the printed form of a timestamp message part.  Binary timestamps
+    are printed like Date::print(5); anything else is assumed to already be
+    printed and is returned as is.
+*/
+inline std::string printTimestamp(const std::string & part)
+{
+    double secondsSinceEpoch;
+    if (part.size() != sizeof(secondsSinceEpoch)) return part;
+    memcpy(&secondsSinceEpoch, part.data(), sizeof(secondsSinceEpoch));
+    return Date::fromSecondsSinceEpoch(secondsSinceEpoch).print(5);
+}
+
 inline zmq::message_t encodeMessage(int i)
 {
     return ML::format("%d", i);
@@ -9,6 +9,10 @@
 
 #include "json_printing.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 
 using namespace std;
 
@@ -54,4 +58,374 @@ writeStringUtf8(const Utf8String & s)
 }
 
 
+/*****************************************************************************/
+/* STRING JSON PRINTING CONTEXT                                              */
+/*****************************************************************************/
+
+namespace {
+
+/* The helpers below reproduce Json::valueToString() and
+   Json::valueToQuotedString(), appending to the output instead of returning
+   a new string.
+*/
+
+void appendUnsigned(std::string & out, unsigned long long value)
+{
+    char buffer[32];
+    char * current = buffer + sizeof(buffer);
+    do {
+        *--current = (value % 10) + '0';
+        value /= 10;
+    } while (value != 0);
+    out.append(current, buffer + sizeof(buffer));
+}
+
+void appendSigned(std::string & out, long long value)
+{
+    if (value < 0) {
+        out += '-';
+        appendUnsigned(out, -(unsigned long long)value);
+    }
+    else appendUnsigned(out, value);
+}
+
+void appendDouble(std::string & out, double value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%#.16g", value);
+
+    char * ch = buffer + strlen(buffer) - 1;
+    if (*ch != '0') {
+        out += buffer;
+        return;
+    }
+
+    // Truncate the trailing zeros of the fractional part but keep one
+    while (ch > buffer && *ch == '0')
+        --ch;
+    char * lastNonZero = ch;
+    while (ch >= buffer && *ch >= '0' && *ch <= '9')
+        --ch;
+    if (ch >= buffer && *ch == '.')
+        *(lastNonZero + 2) = '\0';
+
+    out += buffer;
+}
+
+void appendQuoted(std::string & out, const char * value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    out += '\"';
+    for (const char * c = value;  *c;  ++c) {
+        switch (*c) {
+        case '\"': out += "\\\"";  break;
+        case '\\': out += "\\\\";  break;
+        case '\b': out += "\\b";  break;
+        case '\f': out += "\\f";  break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            if (*c > 0 && *c <= 0x1f) {
+                out += "\\u00";
+                out += hex[*c >> 4];
+                out += hex[*c & 0xf];
+            }
+            else out += *c;
+        }
+    }
+    out += '\"';
+}
+
+void appendJson(std::string & out, const Json::Value & val)
+{
+    switch (val.type()) {
+    case Json::nullValue:
+        out += "null";
+        break;
+    case Json::intValue:
+        appendSigned(out, val.asInt());
+        break;
+    case Json::uintValue:
+        appendUnsigned(out, val.asUInt());
+        break;
+    case Json::realValue:
+        appendDouble(out, val.asDouble());
+        break;
+    case Json::stringValue:
+        appendQuoted(out, val.asCString());
+        break;
+    case Json::booleanValue:
+        out += val.asBool() ? "true" : "false";
+        break;
+    case Json::arrayValue:
+        out += '[';
+        for (unsigned i = 0;  i < val.size();  ++i) {
+            if (i > 0)
+                out += ',';
+            appendJson(out, val[i]);
+        }
+        out += ']';
+        break;
+    case Json::objectValue:
+        // Members are iterated in the same (sorted) order as FastWriter
+        out += '{';
+        for (auto it = val.begin(), end = val.end();  it != end;  ++it) {
+            if (it != val.begin())
+                out += ',';
+            appendQuoted(out, it.memberNameC());
+            out += ':';
+            appendJson(out, *it);
+        }
+        out += '}';
+        break;
+    }
+}
+
+} // file scope
+
+StringJsonPrintingContext::
+StringJsonPrintingContext()
+{
+}
+
+void
+StringJsonPrintingContext::
+clear()
+{
+    output.clear();
+    path.clear();
+    members.clear();
+    keys.clear();
+}
+
+void
+StringJsonPrintingContext::
+startObject()
+{
+    path.push_back({ true /* isObject */, -1, members.size() });
+    output += '{';
+}
+
+void
+StringJsonPrintingContext::
+startMember(const std::string & memberName)
+{
+    ExcAssert(path.back().isObject);
+
+    if (++path.back().memberNum != 0) {
+        members.back().end = output.size();
+        output += ',';
+    }
+
+    // Like Json::Value, the key stops at the first null character
+    size_t length = strlen(memberName.c_str());
+    members.push_back({ keys.size(), length, output.size(), 0 });
+    keys.append(memberName.c_str(), length);
+
+    appendQuoted(output, memberName.c_str());
+    output += ':';
+}
+
+void
+StringJsonPrintingContext::
+endObject()
+{
+    ExcAssert(path.back().isObject);
+
+    size_t firstMember = path.back().firstMember;
+    if (members.size() > firstMember) {
+        members.back().end = output.size();
+        sortMembers(firstMember);
+        members.resize(firstMember);
+    }
+
+    // Keys of the outermost object aren't needed anymore
+    if (members.empty())
+        keys.clear();
+
+    path.pop_back();
+    output += '}';
+}
+
+bool
+StringJsonPrintingContext::
+keyLess(const Member & m1, const Member & m2) const
+{
+    int res = memcmp(keys.data() + m1.keyStart, keys.data() + m2.keyStart,
+                     std::min(m1.keyLength, m2.keyLength));
+    if (res != 0)
+        return res < 0;
+    return m1.keyLength < m2.keyLength;
+}
+
+void
+StringJsonPrintingContext::
+sortMembers(size_t firstMember)
+{
+    size_t n = members.size() - firstMember;
+    const Member * mbrs = &members[firstMember];
+
+    bool sorted = true;
+    for (size_t i = 1;  i < n && sorted;  ++i)
+        sorted = keyLess(mbrs[i - 1], mbrs[i]);
+    if (sorted)
+        return;
+
+    // Objects are small so a stable insertion sort does the job without
+    // needing any memory
+    order.resize(n);
+    for (size_t i = 0;  i < n;  ++i) {
+        unsigned current = i;
+        size_t j = i;
+        for (;  j > 0 && keyLess(mbrs[current], mbrs[order[j - 1]]);  --j)
+            order[j] = order[j - 1];
+        order[j] = current;
+    }
+
+    size_t start = mbrs[0].start;
+    scratch.assign(output, start, std::string::npos);
+    output.resize(start);
+
+    bool first = true;
+    for (size_t i = 0;  i < n;  ++i) {
+        const Member & member = mbrs[order[i]];
+
+        // When a member is written more than once the last value wins
+        if (i + 1 < n && !keyLess(member, mbrs[order[i + 1]]))
+            continue;
+
+        if (!first)
+            output += ',';
+        first = false;
+        output.append(scratch, member.start - start, member.end - member.start);
+    }
+}
+
+void
+StringJsonPrintingContext::
+startArray(int knownSize)
+{
+    path.push_back({ false /* isObject */, -1, members.size() });
+    output += '[';
+}
+
+void
+StringJsonPrintingContext::
+newArrayElement()
+{
+    ExcAssert(!path.back().isObject);
+    if (++path.back().memberNum != 0)
+        output += ',';
+}
+
+void
+StringJsonPrintingContext::
+endArray()
+{
+    ExcAssert(!path.back().isObject);
+    path.pop_back();
+    output += ']';
+}
+
+void
+StringJsonPrintingContext::
+skip()
+{
+    output += "null";
+}
+
+void
+StringJsonPrintingContext::
+writeNull()
+{
+    output += "null";
+}
+
+void
+StringJsonPrintingContext::
+writeInt(int i)
+{
+    appendSigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeUnsignedInt(unsigned int i)
+{
+    appendUnsigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeLong(long int i)
+{
+    appendSigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeUnsignedLong(unsigned long int i)
+{
+    appendUnsigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeLongLong(long long int i)
+{
+    appendSigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeUnsignedLongLong(unsigned long long int i)
+{
+    appendUnsigned(output, i);
+}
+
+void
+StringJsonPrintingContext::
+writeFloat(float f)
+{
+    appendDouble(output, f);
+}
+
+void
+StringJsonPrintingContext::
+writeDouble(double d)
+{
+    appendDouble(output, d);
+}
+
+void
+StringJsonPrintingContext::
+writeString(const std::string & s)
+{
+    appendQuoted(output, s.c_str());
+}
+
+void
+StringJsonPrintingContext::
+writeStringUtf8(const Utf8String & s)
+{
+    appendQuoted(output, s.rawData());
+}
+
+void
+StringJsonPrintingContext::
+writeJson(const Json::Value & val)
+{
+    appendJson(output, val);
+}
+
+void
+StringJsonPrintingContext::
+writeBool(bool b)
+{
+    output += b ? "true" : "false";
+}
+
+
 } // namespace Datacratic
@@ -329,5 +329,81 @@ struct StructuredJsonPrintingContext
     }
 };
 
+
+/*****************************************************************************/
+/* STRING JSON PRINTING CONTEXT                                              */
+/*****************************************************************************/
+
+/** JSON printing context that writes straight into a string.
+
+    The output is byte for byte what printing into a
+    StructuredJsonPrintingContext and calling toStringNoNewLine() on the
+    result gives (members sorted by name with the last duplicate winning,
+    jsoncpp number formatting and escaping) but no intermediate Json::Value
+    is built.  Like toStringNoNewLine(), it doesn't end the output with a
+    newline; callers that need what toString() gives append it themselves.
+    The buffers are kept across calls to clear() so a context that is
+    reused for each message stops allocating once it is warm.
+*/
+
+struct StringJsonPrintingContext
+    : public JsonPrintingContext {
+
+    StringJsonPrintingContext();
+
+    std::string output;
+
+    /** Empty the output and get ready to print a new value. */
+    void clear();
+
+    virtual void startObject();
+    virtual void startMember(const std::string & memberName);
+    virtual void endObject();
+
+    virtual void startArray(int knownSize = -1);
+    virtual void newArrayElement();
+    virtual void endArray();
+
+    virtual void skip();
+    virtual void writeNull();
+    virtual void writeInt(int i);
+    virtual void writeUnsignedInt(unsigned int i);
+    virtual void writeLong(long int i);
+    virtual void writeUnsignedLong(unsigned long int i);
+    virtual void writeLongLong(long long int i);
+    virtual void writeUnsignedLongLong(unsigned long long int i);
+    virtual void writeFloat(float f);
+    virtual void writeDouble(double d);
+    virtual void writeString(const std::string & s);
+    virtual void writeStringUtf8(const Utf8String & s);
+    virtual void writeJson(const Json::Value & val);
+    virtual void writeBool(bool b);
+
+private:
+    struct Member {
+        size_t keyStart;         ///< Offset of the raw name in keys
+        size_t keyLength;
+        size_t start;            ///< Offset of the quoted name in output
+        size_t end;              ///< Offset past the value in output
+    };
+
+    struct PathEntry {
+        bool isObject;
+        int memberNum;
+        size_t firstMember;      ///< Index of our first entry in members
+    };
+
+    std::vector<PathEntry> path;
+    std::vector<Member> members;
+    std::string keys;
+
+    // Scratch space used to put the members of an object in order
+    std::vector<unsigned> order;
+    std::string scratch;
+
+    bool keyLess(const Member & m1, const Member & m2) const;
+    void sortMembers(size_t firstMember);
+};
+
 } // namespace Datacratic
 
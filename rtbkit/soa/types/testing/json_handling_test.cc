@@ -63,3 +63,55 @@ BOOST_AUTO_TEST_CASE(test_utf8_round_trip_streaming_ascii)
         BOOST_CHECK_EQUAL(str, str2);
     }
 }
+
+BOOST_AUTO_TEST_CASE(test_string_printing_matches_structured)
+{
+    Json::Value ext;
+    ext["zeta"] = 1.5;
+    ext["alpha"][0] = "a\tb\x01";
+    ext["alpha"][1] = Json::Value();
+
+    auto print = [&] (JsonPrintingContext & context) {
+        context.startObject();
+        context.startMember("tmax");
+        context.writeDouble(99.0);
+        context.startMember("id");
+        context.writeString("quote\" and \\ slash");
+        context.startMember("imp");
+        context.startArray();
+        for (int i = 0;  i < 2;  ++i) {
+            context.newArrayElement();
+            context.startObject();
+            context.startMember("w");
+            context.writeInt(-300 * i);
+            context.startMember("bidfloor");
+            context.writeFloat(0.1f);
+            context.startMember("h");
+            context.writeUnsignedLongLong(250ULL << 40);
+            context.endObject();
+        }
+        context.endArray();
+        context.startMember("ext");
+        context.writeJson(ext);
+        context.startMember("at");
+        context.writeInt(1);
+        // Written twice; the last value is the one that's kept
+        context.startMember("id");
+        context.writeStringUtf8(Utf8String("\xe2\x80\xa2skin"));
+        context.startMember("empty");
+        context.startObject();
+        context.endObject();
+        context.endObject();
+    };
+
+    StructuredJsonPrintingContext structured;
+    print(structured);
+
+    StringJsonPrintingContext context;
+    for (int i = 0;  i < 2;  ++i) {
+        context.clear();
+        print(context);
+        BOOST_CHECK_EQUAL(context.output,
+                          structured.output.toStringNoNewLine());
+    }
+}